@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 static void CL_FinishTimeDemo (void);
+static void CL_SaveDemoIndex (void);
+static void CL_ResetDemoSeek (void);
 
 /*
 ==============================================================================
@@ -80,6 +82,73 @@ static struct
 	}				prev;
 }					demo_rewind;
 
+// Demo seeking
+#define DEMO_KEYFRAME_INTERVAL	10.0	// seconds of server time between keyframes
+#define DEMO_INDEX_MAGIC		0x49444B49	// "IKDI"
+#define DEMO_INDEX_VERSION		1
+
+typedef struct
+{
+	double			time;			// cl.mtime[0] when the snapshot was taken
+	qfileofs_t		fileofs;		// start of the message following the snapshot
+	int				segment;		// map index inside the demo
+	int				numscores;
+	int				numents;
+	size_t			dataofs;		// snapshot location in demo_seek.data
+} demokeyframe_t;
+
+typedef struct
+{
+	int				stats[MAX_CL_STATS];
+	float			statsf[MAX_CL_STATS];
+	int				items;
+	int				viewentity;
+	int				intermission;
+	int				completed_time;
+	qboolean		forceunderwater;
+	cshift_t		cshift;
+	vec3_t			mviewangles;
+} demostate_t;
+
+typedef struct
+{
+	char			name[MAX_SCOREBOARDNAME];
+	int				frags;
+	int				colors;
+} demoscore_t;
+
+typedef struct
+{
+	int				num;
+	entity_state_t	baseline;
+	entity_state_t	state;
+} demoentity_t;
+
+typedef struct
+{
+	int				magic;
+	int				version;
+	int				keyframesize;
+	int				statesize;
+	int				entsize;
+	int				numkeyframes;
+	qfileofs_t		demosize;
+	qfileofs_t		datasize;
+} demoindexheader_t;
+
+static struct
+{
+	demokeyframe_t	*keyframes;
+	byte			*data;
+	int				segment;		// current map index inside the demo
+	qboolean		newsegment;		// signon in progress, segment will change
+	size_t			numloaded;		// keyframes read from the index file
+	qboolean		pending;
+	double			target;
+}					demo_seek;
+
+cvar_t	cl_demoseek_cache = {"cl_demoseek_cache", "0", CVAR_ARCHIVE};
+
 /*
 ==============
 CL_ClearSignons
@@ -119,6 +188,10 @@ void CL_StopPlayback (void)
 	VEC_CLEAR (demo_rewind.pending_sounds);
 	demo_rewind.backstop = false;
 
+	if (cl_demoseek_cache.value && VEC_SIZE (demo_seek.keyframes) > demo_seek.numloaded)
+		CL_SaveDemoIndex ();
+	CL_ResetDemoSeek ();
+
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
 }
@@ -147,6 +220,59 @@ static void CL_WriteDemoMessage (void)
 	fflush (cls.demofile);
 }
 
+/*
+====================
+CL_RecordServerMessage
+
+Writes the server message that was just parsed to the demo, leaving out
+the byte ranges in strip (start/end pairs): commands like svc_moveack and
+svc_entkeep that only this engine understands
+====================
+*/
+void CL_RecordServerMessage (const int *strip, int numstrip)
+{
+	int	len;
+	int	i, pos;
+	float	f;
+
+	if (!cls.demorecording)
+		return;
+
+	len = net_message.cursize;
+	for (i = 0; i < numstrip; i++)
+		len -= strip[2*i+1] - strip[2*i];
+	len = LittleLong (len);
+	fwrite (&len, 4, 1, cls.demofile);
+	for (i = 0; i < 3; i++)
+	{
+		f = LittleFloat (cl.viewangles[i]);
+		fwrite (&f, 4, 1, cls.demofile);
+	}
+	for (i = 0, pos = 0; i < numstrip; i++)
+	{
+		fwrite (net_message.data + pos, strip[2*i] - pos, 1, cls.demofile);
+		pos = strip[2*i+1];
+	}
+	fwrite (net_message.data + pos, net_message.cursize - pos, 1, cls.demofile);
+	fflush (cls.demofile);
+}
+
+/*
+====================
+CL_RequestEntKeep
+
+Deferred entity updates can't be played back by other engines, so they
+are turned off on the server while a demo is being recorded
+====================
+*/
+static void CL_RequestEntKeep (qboolean enable)
+{
+	if (cls.state != ca_connected || cls.signon < 2 || cls.demoplayback)
+		return;
+	MSG_WriteByte (&cls.message, clc_stringcmd);
+	MSG_WriteString (&cls.message, enable ? "entkeep 1" : "entkeep 0");
+}
+
 /*
 ===============
 CL_AddDemoRewindSound
@@ -232,6 +358,582 @@ void CL_AdvanceTime (void)
 }
 
 
+/*
+==============================================================================
+
+DEMO SEEKING
+
+Every DEMO_KEYFRAME_INTERVAL seconds of playback a snapshot of the client
+state that isn't resent every frame (stats, lightstyles, scores, entities)
+is stored together with the file offset of the next message.  Seeking
+restores the closest keyframe and only parses the few messages between it
+and the target time.  Keyframes can't be restored across map changes, so
+each one is tagged with the index of the map it belongs to.
+==============================================================================
+*/
+
+/*
+===============
+CL_ResetDemoSeek
+===============
+*/
+static void CL_ResetDemoSeek (void)
+{
+	VEC_CLEAR (demo_seek.keyframes);
+	VEC_CLEAR (demo_seek.data);
+	demo_seek.segment = -1;
+	demo_seek.newsegment = true;
+	demo_seek.numloaded = 0;
+	demo_seek.pending = false;
+	cls.demoseeking = false;
+}
+
+/*
+====================
+CL_ReadDemoMessage
+====================
+*/
+static qboolean CL_ReadDemoMessage (void)
+{
+	int		i;
+	float	f;
+
+	if (fread (&net_message.cursize, 4, 1, cls.demofile) != 1)
+		return false;
+	VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
+	for (i = 0 ; i < 3 ; i++)
+	{
+		if (fread (&f, 4, 1, cls.demofile) != 1)
+			return false;
+		cl.mviewangles[0][i] = LittleFloat (f);
+	}
+
+	net_message.cursize = LittleLong (net_message.cursize);
+	if (net_message.cursize > MAX_MSGLEN)
+		Sys_Error ("Demo message > MAX_MSGLEN");
+	if (fread (net_message.data, net_message.cursize, 1, cls.demofile) != 1)
+		return false;
+
+	return true;
+}
+
+/*
+===============
+CL_DemoModelIndex
+===============
+*/
+static int CL_DemoModelIndex (const entity_t *ent)
+{
+	int i;
+
+	if (!ent->model)
+		return 0;
+	if (ent->baseline.modelindex < MAX_MODELS && cl.model_precache[ent->baseline.modelindex] == ent->model)
+		return ent->baseline.modelindex;
+	for (i = 1; i < MAX_MODELS && cl.model_precache[i]; i++)
+		if (cl.model_precache[i] == ent->model)
+			return i;
+
+	return 0;
+}
+
+/*
+===============
+CL_DemoColormapIndex
+===============
+*/
+static int CL_DemoColormapIndex (const entity_t *ent)
+{
+	int i;
+
+	for (i = 0; i < cl.maxclients; i++)
+		if (ent->colormap == cl.scores[i].translations)
+			return i + 1;
+
+	return 0;
+}
+
+/*
+===============
+CL_AddDemoKeyframe
+
+Snapshots the client state after the message that was just parsed,
+unless the previous keyframe is recent enough
+===============
+*/
+static void CL_AddDemoKeyframe (void)
+{
+	demokeyframe_t	kf;
+	demostate_t		state;
+	demoscore_t		score;
+	demoentity_t	dent;
+	entity_t		*ent;
+	size_t			count;
+	int				i;
+	byte			len;
+
+	if (cls.signon < SIGNONS)
+	{
+		demo_seek.newsegment = true;
+		return;
+	}
+
+	if (demo_seek.newsegment)
+	{
+		demo_seek.segment++;
+		demo_seek.newsegment = false;
+	}
+
+	memset (&kf, 0, sizeof (kf));
+	kf.time = cl.mtime[0];
+	kf.fileofs = Sys_ftell (cls.demofile);
+	kf.segment = demo_seek.segment;
+
+	count = VEC_SIZE (demo_seek.keyframes);
+	if (count)
+	{
+		const demokeyframe_t *last = &demo_seek.keyframes[count - 1];
+		if (kf.fileofs <= last->fileofs)
+			return; // this part of the demo is already indexed
+		if (kf.segment == last->segment && kf.time < last->time + DEMO_KEYFRAME_INTERVAL)
+			return;
+	}
+
+	kf.dataofs = VEC_SIZE (demo_seek.data);
+
+	memset (&state, 0, sizeof (state));
+	memcpy (state.stats, cl.stats, sizeof (state.stats));
+	memcpy (state.statsf, cl.statsf, sizeof (state.statsf));
+	state.items = cl.items;
+	state.viewentity = cl.viewentity;
+	state.intermission = cl.intermission;
+	state.completed_time = cl.completed_time;
+	state.forceunderwater = cl.forceunderwater;
+	state.cshift = cshift_empty;
+	VectorCopy (cl.mviewangles[0], state.mviewangles);
+	Vec_Append ((void**)&demo_seek.data, 1, &state, sizeof (state));
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		len = (byte) strlen (cl_lightstyle[i].map);
+		VEC_PUSH (demo_seek.data, len);
+		Vec_Append ((void**)&demo_seek.data, 1, cl_lightstyle[i].map, len);
+	}
+
+	kf.numscores = cl.maxclients;
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		memset (&score, 0, sizeof (score));
+		q_strlcpy (score.name, cl.scores[i].name, sizeof (score.name));
+		score.frags = cl.scores[i].frags;
+		score.colors = cl.scores[i].colors;
+		Vec_Append ((void**)&demo_seek.data, 1, &score, sizeof (score));
+	}
+
+	// Only entities present in the last server frame are visible, the rest will be hidden on restore
+	for (i = 1; i < cl.num_entities; i++)
+	{
+		ent = &cl_entities[i];
+		if (ent->msgtime != cl.mtime[0])
+			continue;
+
+		memset (&dent, 0, sizeof (dent));
+		dent.num = i;
+		dent.baseline = ent->baseline;
+		VectorCopy (ent->msg_origins[0], dent.state.origin);
+		VectorCopy (ent->msg_angles[0], dent.state.angles);
+		dent.state.modelindex = CL_DemoModelIndex (ent);
+		dent.state.frame = ent->frame;
+		dent.state.colormap = CL_DemoColormapIndex (ent);
+		dent.state.skin = ent->skinnum;
+		dent.state.alpha = ent->alpha;
+		dent.state.scale = ent->scale;
+		dent.state.effects = ent->effects;
+		Vec_Append ((void**)&demo_seek.data, 1, &dent, sizeof (dent));
+		kf.numents++;
+	}
+
+	VEC_PUSH (demo_seek.keyframes, kf);
+}
+
+/*
+===============
+CL_RestoreDemoKeyframe
+===============
+*/
+static void CL_RestoreDemoKeyframe (const demokeyframe_t *kf)
+{
+	const byte		*data;
+	demostate_t		state;
+	demoscore_t		score;
+	demoentity_t	dent;
+	entity_t		*ent;
+	char			str[MAX_STYLESTRING];
+	int				i, num;
+	byte			len;
+
+	Sys_fseek (cls.demofile, kf->fileofs, SEEK_SET);
+	data = demo_seek.data + kf->dataofs;
+
+	memcpy (&state, data, sizeof (state));
+	data += sizeof (state);
+	memcpy (cl.stats, state.stats, sizeof (cl.stats));
+	memcpy (cl.statsf, state.statsf, sizeof (cl.statsf));
+	cl.items = state.items;
+	cl.viewentity = state.viewentity;
+	if (cl.intermission != state.intermission)
+		vid.recalc_refdef = true;
+	cl.intermission = state.intermission;
+	cl.completed_time = state.completed_time;
+	cl.forceunderwater = state.forceunderwater;
+	cshift_empty = state.cshift;
+	VectorCopy (state.mviewangles, cl.mviewangles[0]);
+	VectorCopy (state.mviewangles, cl.mviewangles[1]);
+	Sbar_Changed ();
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		len = q_min (*data++, MAX_STYLESTRING - 1);
+		memcpy (str, data, len);
+		str[len] = '\0';
+		data += len;
+		CL_SetLightstyle (i, str);
+	}
+
+	for (i = 0; i < kf->numscores; i++)
+	{
+		memcpy (&score, data, sizeof (score));
+		data += sizeof (score);
+		if (i >= cl.maxclients)
+			continue;
+		q_strlcpy (cl.scores[i].name, score.name, MAX_SCOREBOARDNAME);
+		cl.scores[i].frags = score.frags;
+		if (cl.scores[i].colors != score.colors)
+		{
+			cl.scores[i].colors = score.colors;
+			CL_NewTranslation (i);
+		}
+	}
+
+	for (i = 1; i < cl.num_entities; i++)
+		cl_entities[i].msgtime = 0;
+
+	for (i = 0; i < kf->numents; i++)
+	{
+		memcpy (&dent, data, sizeof (dent));
+		data += sizeof (dent);
+
+		num = dent.num;
+		if (num <= 0 || num >= cl_max_edicts || dent.state.modelindex >= MAX_MODELS)
+			continue;
+
+		ent = CL_EntityNum (num);
+		ent->baseline = dent.baseline;
+		ent->msgtime = kf->time;
+		ent->model = cl.model_precache[dent.state.modelindex];
+		ent->frame = dent.state.frame;
+		ent->skinnum = dent.state.skin;
+		ent->alpha = dent.state.alpha;
+		ent->scale = dent.state.scale;
+		ent->effects = dent.state.effects;
+		if (dent.state.colormap && dent.state.colormap <= cl.maxclients)
+			ent->colormap = cl.scores[dent.state.colormap - 1].translations;
+		else
+			ent->colormap = vid.colormap;
+		VectorCopy (dent.state.origin, ent->msg_origins[0]);
+		VectorCopy (dent.state.origin, ent->msg_origins[1]);
+		VectorCopy (dent.state.origin, ent->origin);
+		VectorCopy (dent.state.angles, ent->msg_angles[0]);
+		VectorCopy (dent.state.angles, ent->msg_angles[1]);
+		VectorCopy (dent.state.angles, ent->angles);
+		ent->lerpflags |= LERP_RESETMOVE|LERP_RESETANIM;
+		ent->forcelink = true;
+		if (num <= cl.maxclients)
+			R_TranslateNewPlayerSkin (num - 1);
+	}
+
+	cl.mtime[0] = cl.mtime[1] = kf->time;
+	cl.time = cl.oldtime = kf->time;
+}
+
+/*
+===============
+CL_FindDemoKeyframe
+
+Returns the last keyframe of the current map at or before the given time,
+or the first one if the time is earlier than that
+===============
+*/
+static const demokeyframe_t *CL_FindDemoKeyframe (double time)
+{
+	const demokeyframe_t	*best = NULL;
+	size_t					i, count;
+
+	for (i = 0, count = VEC_SIZE (demo_seek.keyframes); i < count; i++)
+	{
+		const demokeyframe_t *kf = &demo_seek.keyframes[i];
+		if (kf->segment < demo_seek.segment)
+			continue;
+		if (kf->segment > demo_seek.segment)
+			break;
+		if (best && kf->time > time)
+			break;
+		best = kf;
+	}
+
+	return best;
+}
+
+/*
+===============
+CL_GetDemoIndexPath
+===============
+*/
+static void CL_GetDemoIndexPath (char *path, size_t size)
+{
+	char name[MAX_OSPATH];
+
+	COM_StripExtension (cls.demofilename, name, sizeof (name));
+	q_snprintf (path, size, "%s/%s.dki", com_gamedir, name);
+}
+
+/*
+===============
+CL_ValidDemoKeyframe
+
+Checks that a keyframe read from disk points inside the demo file
+and that its whole snapshot fits in the datasize bytes of demo_seek.data
+===============
+*/
+static qboolean CL_ValidDemoKeyframe (const demokeyframe_t *kf, size_t datasize)
+{
+	const byte	*data;
+	size_t		ofs, need;
+	int			i;
+
+	if (kf->fileofs < 0 || kf->fileofs > cls.demofilesize)
+		return false;
+	if (kf->numscores < 0 || kf->numscores > MAX_SCOREBOARD)
+		return false;
+	if (kf->numents < 0 || (size_t) kf->numents > datasize / sizeof (demoentity_t))
+		return false;
+	if (kf->dataofs > datasize || datasize - kf->dataofs < sizeof (demostate_t))
+		return false;
+
+	data = demo_seek.data;
+	ofs = kf->dataofs + sizeof (demostate_t);
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		if (ofs >= datasize || data[ofs] >= MAX_STYLESTRING)
+			return false;
+		ofs += 1 + data[ofs];
+	}
+
+	need = kf->numscores * sizeof (demoscore_t) + kf->numents * sizeof (demoentity_t);
+	return ofs <= datasize && datasize - ofs >= need;
+}
+
+/*
+===============
+CL_LoadDemoIndex
+===============
+*/
+static void CL_LoadDemoIndex (void)
+{
+	char				path[MAX_OSPATH];
+	demoindexheader_t	header;
+	FILE				*f;
+	int					i;
+
+	CL_GetDemoIndexPath (path, sizeof (path));
+	f = Sys_fopen (path, "rb");
+	if (!f)
+		return;
+
+	if (fread (&header, sizeof (header), 1, f) != 1 ||
+		header.magic != DEMO_INDEX_MAGIC ||
+		header.version != DEMO_INDEX_VERSION ||
+		header.keyframesize != (int) sizeof (demokeyframe_t) ||
+		header.statesize != (int) sizeof (demostate_t) ||
+		header.entsize != (int) sizeof (demoentity_t) ||
+		header.demosize != cls.demofilesize ||
+		header.numkeyframes <= 0 || header.datasize <= 0)
+	{
+		Con_DPrintf ("Ignoring stale demo index %s\n", path);
+		fclose (f);
+		return;
+	}
+
+	Vec_Grow ((void**)&demo_seek.keyframes, sizeof (demokeyframe_t), header.numkeyframes);
+	Vec_Grow ((void**)&demo_seek.data, 1, (size_t) header.datasize);
+	if (fread (demo_seek.keyframes, sizeof (demokeyframe_t), header.numkeyframes, f) != (size_t) header.numkeyframes ||
+		fread (demo_seek.data, (size_t) header.datasize, 1, f) != 1)
+	{
+		Con_DPrintf ("Couldn't read demo index %s\n", path);
+		fclose (f);
+		return;
+	}
+	fclose (f);
+
+	// CL_RestoreDemoKeyframe trusts the offsets, so one bad keyframe discards the whole index
+	for (i = 0; i < header.numkeyframes; i++)
+	{
+		if (!CL_ValidDemoKeyframe (&demo_seek.keyframes[i], (size_t) header.datasize))
+		{
+			Con_DPrintf ("Ignoring corrupt demo index %s\n", path);
+			return;
+		}
+	}
+
+	VEC_HEADER (demo_seek.keyframes).size = header.numkeyframes;
+	VEC_HEADER (demo_seek.data).size = (size_t) header.datasize;
+	demo_seek.numloaded = header.numkeyframes;
+
+	Con_DPrintf ("Loaded %d demo keyframes from %s\n", header.numkeyframes, path);
+}
+
+/*
+===============
+CL_SaveDemoIndex
+===============
+*/
+static void CL_SaveDemoIndex (void)
+{
+	char				path[MAX_OSPATH];
+	demoindexheader_t	header;
+	FILE				*f;
+
+	CL_GetDemoIndexPath (path, sizeof (path));
+	f = Sys_fopen (path, "wb");
+	if (!f)
+	{
+		Con_DPrintf ("Couldn't write demo index %s\n", path);
+		return;
+	}
+
+	memset (&header, 0, sizeof (header));
+	header.magic = DEMO_INDEX_MAGIC;
+	header.version = DEMO_INDEX_VERSION;
+	header.keyframesize = sizeof (demokeyframe_t);
+	header.statesize = sizeof (demostate_t);
+	header.entsize = sizeof (demoentity_t);
+	header.numkeyframes = VEC_SIZE (demo_seek.keyframes);
+	header.demosize = cls.demofilesize;
+	header.datasize = VEC_SIZE (demo_seek.data);
+
+	fwrite (&header, sizeof (header), 1, f);
+	fwrite (demo_seek.keyframes, sizeof (demokeyframe_t), header.numkeyframes, f);
+	fwrite (demo_seek.data, (size_t) header.datasize, 1, f);
+	fclose (f);
+}
+
+/*
+===============
+CL_DemoSeek
+
+Jumps to the closest keyframe and parses the remaining messages
+until the target time is reached
+===============
+*/
+static void CL_DemoSeek (double target)
+{
+	const demokeyframe_t	*kf;
+	qfileofs_t				ofs;
+
+	if (target < cl.mtime[0])
+	{
+		kf = CL_FindDemoKeyframe (target);
+		if (!kf)
+			return;
+		CL_RestoreDemoKeyframe (kf);
+	}
+
+	cls.demoseeking = true;
+	while (cls.demoplayback)
+	{
+		if (cls.signon == SIGNONS)
+		{
+			if (cl.mtime[0] >= target)
+				break;
+			// skip ahead if the target is past an indexed part of the demo
+			kf = CL_FindDemoKeyframe (target);
+			if (kf && kf->time > cl.mtime[0] && kf->fileofs > Sys_ftell (cls.demofile))
+				CL_RestoreDemoKeyframe (kf);
+		}
+
+		ofs = Sys_ftell (cls.demofile);
+		if (!CL_ReadDemoMessage ())
+		{
+			// leave the end of the demo to regular playback
+			Sys_fseek (cls.demofile, ofs, SEEK_SET);
+			break;
+		}
+		CL_ParseServerMessage ();
+	}
+	cls.demoseeking = false;
+
+	if (!cls.demoplayback)
+		return;
+
+	// rewind history is only valid for consecutive frames
+	VEC_CLEAR (demo_rewind.frames);
+	VEC_CLEAR (demo_rewind.frame_events);
+	VEC_CLEAR (demo_rewind.pending_sounds);
+	demo_rewind.backstop = false;
+
+	// drop transient effects from the skipped part of the demo
+	R_ClearParticles ();
+	memset (cl_dlights, 0, sizeof (cl_dlights));
+	memset (cl_temp_entities, 0, sizeof (cl_temp_entities));
+	memset (cl_beams, 0, sizeof (cl_beams));
+
+	cl.time = cl.oldtime = cl.mtime[0];
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek <time> | +<seconds> | -<seconds>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	const char	*arg;
+	double		target;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (!cls.demoplayback)
+	{
+		Con_Printf ("Not playing a demo.\n");
+		return;
+	}
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("demoseek <time> : jumps to the given map time (in seconds)\n");
+		Con_Printf ("demoseek +/-<seconds> : jumps forward/backward\n");
+		Con_Printf ("current time: %.1f, %d keyframes\n", cl.mtime[0], (int) VEC_SIZE (demo_seek.keyframes));
+		return;
+	}
+
+	if (cls.timedemo)
+	{
+		Con_Printf ("Can't seek during timedemo\n");
+		return;
+	}
+
+	arg = Cmd_Argv (1);
+	target = atof (arg);
+	if (*arg == '+' || *arg == '-')
+		target += cl.mtime[0];
+
+	demo_seek.target = q_max (target, 0.0);
+	demo_seek.pending = true;
+}
+
 /*
 ====================
 CL_NextDemoFrame
@@ -294,13 +996,18 @@ void CL_FinishDemoFrame (void)
 	size_t		i, len, numframes;
 	demoframe_t	*lastframe;
 
-	if (!cls.demoplayback || !cls.demospeed)
+	if (!cls.demoplayback || (!cls.demospeed && !cls.demoseeking))
 		return;
 
 	// Flush any pending stuffcmds (such as v_chifts)
 	// so that they take effect this frame, not the next
 	Cbuf_Execute ();
 
+	if (cls.demospeed > 0.f || cls.demoseeking)
+		CL_AddDemoKeyframe ();
+	if (cls.demoseeking)
+		return;
+
 	// We're not going to rewind before the first frame,
 	// so we only track state changes from the second one onwards
 	numframes = VEC_SIZE (demo_rewind.frames);
@@ -419,8 +1126,15 @@ void CL_FinishDemoFrame (void)
 
 static int CL_GetDemoMessage (void)
 {
-	int		i;
-	float	f;
+	if (demo_seek.pending)
+	{
+		demo_seek.pending = false;
+		if (cls.signon == SIGNONS)
+		{
+			CL_DemoSeek (demo_seek.target);
+			return 0;
+		}
+	}
 
 	if (!cls.demospeed || demo_rewind.backstop)
 		return 0;
@@ -448,22 +1162,8 @@ static int CL_GetDemoMessage (void)
 	if (!CL_NextDemoFrame ())
 		return 0;
 
-	if (fread (&net_message.cursize, 4, 1, cls.demofile) != 1)
-		goto readerror;
-	VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
-	for (i = 0 ; i < 3 ; i++)
+	if (!CL_ReadDemoMessage ())
 	{
-		if (fread (&f, 4, 1, cls.demofile) != 1)
-			goto readerror;
-		cl.mviewangles[0][i] = LittleFloat (f);
-	}
-
-	net_message.cursize = LittleLong (net_message.cursize);
-	if (net_message.cursize > MAX_MSGLEN)
-		Sys_Error ("Demo message > MAX_MSGLEN");
-	if (fread (net_message.data, net_message.cursize, 1, cls.demofile) != 1)
-	{
-	readerror:
 		CL_StopPlayback ();
 		return 0;
 	}
@@ -499,8 +1199,7 @@ int CL_GetMessage (void)
 			break;
 	}
 
-	if (cls.demorecording)
-		CL_WriteDemoMessage ();
+	// recorded by CL_ParseServerMessage, see CL_RecordServerMessage
 
 	if (cls.signon < 2)
 	{
@@ -541,6 +1240,7 @@ void CL_Stop_f (void)
 	fclose (cls.demofile);
 	cls.demofile = NULL;
 	cls.demorecording = false;
+	CL_RequestEntKeep (true);
 	Con_Printf ("Completed demo\n");
 	
 // ericw -- update demo tab-completion list
@@ -641,6 +1341,7 @@ void CL_Record_f (void)
 	q_strlcpy (cls.demofilename, name, sizeof (cls.demofilename));
 
 	cls.demorecording = true;
+	CL_RequestEntKeep (false);
 
 	// from ProQuake: initialize the demo file if we're already connected
 	if (c == 2 && cls.state == ca_connected)
@@ -813,6 +1514,10 @@ void CL_PlayDemo_f (void)
 	cls.demofilestart = Sys_ftell (cls.demofile);
 	cls.demofilesize = com_filesize;
 
+	CL_ResetDemoSeek ();
+	if (cl_demoseek_cache.value)
+		CL_LoadDemoIndex ();
+
 // if this is a player-initiated demo, get rid of the console
 	if (cls.demonum == -1 && key_dest == key_console)
 		key_dest = key_game;
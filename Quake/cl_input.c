@@ -433,6 +433,9 @@ void CL_SendMove (const usercmd_t *cmd)
 
 		MSG_WriteByte (&buf, in_impulse);
 		in_impulse = 0;
+
+		if (cl.predict.active && !cls.demoplayback)
+			CL_PredictSendMove (&buf, cmd, bits);
 	}
 
 //
@@ -63,6 +63,7 @@ dlight_t		cl_dlights[MAX_DLIGHTS];
 
 entity_t		*cl_entities; //johnfitz -- was a static array, now on hunk
 int				cl_max_edicts; //johnfitz -- only changes when new map loads
+static int		cl_committed_edicts;
 
 int				cl_numvisedicts;
 entity_t		*cl_visedicts[MAX_VISEDICTS];
@@ -97,7 +98,7 @@ void CL_ClearState (void)
 		PR_SwitchQCVM(NULL);
 	}
 
-	if (!sv.active)
+	if (!sv->active)
 		Host_ClearMemory ();
 
 // wipe the entire cl structure
@@ -110,15 +111,63 @@ void CL_ClearState (void)
 	memset (cl_lightstyle, 0, sizeof(cl_lightstyle));
 	memset (cl_temp_entities, 0, sizeof(cl_temp_entities));
 	memset (cl_beams, 0, sizeof(cl_beams));
+	NetStats_Clear (&cl_netstats);
 
 	//johnfitz -- cl_entities is now dynamically allocated
-	cl_max_edicts = CLAMP (MIN_EDICTS,(int)max_edicts.value,MAX_EDICTS);
-	cl_entities = (entity_t *) Hunk_AllocName (cl_max_edicts*sizeof(entity_t), "cl_entities");
+	CL_AllocEntities ();
 	//johnfitz
 
 	memset (v_punchangles, 0, sizeof (v_punchangles));
 }
 
+/*
+=====================
+CL_AllocEntities
+
+The client doesn't know how many edicts the server will use,
+so address space is reserved for as many as possible and only
+committed as entity numbers show up (see CL_EntityNum)
+=====================
+*/
+void CL_AllocEntities (void)
+{
+	Sys_ReleaseMemory (cl_entities, (size_t)cl_max_edicts * sizeof(entity_t));
+
+	cl_max_edicts = MAX_EDICTS;
+	for (;;)
+	{
+		cl_entities = (entity_t *) Sys_ReserveMemory ((size_t)cl_max_edicts * sizeof(entity_t));
+		if (cl_entities || cl_max_edicts <= MIN_EDICTS)
+			break;
+		cl_max_edicts /= 2;
+	}
+	if (!cl_entities)
+		Sys_Error ("CL_AllocEntities: couldn't reserve %d entities", cl_max_edicts);
+
+	cl_committed_edicts = 0;
+	CL_CommitEntities (MIN_EDICTS);
+}
+
+/*
+=====================
+CL_CommitEntities
+
+Makes sure at least count entities are backed by memory
+=====================
+*/
+void CL_CommitEntities (int count)
+{
+	if (count <= cl_committed_edicts)
+		return;
+
+	count = (count + EDICT_STORE_CHUNK - 1) / EDICT_STORE_CHUNK * EDICT_STORE_CHUNK;
+	count = q_min (count, cl_max_edicts);
+	if (!Sys_CommitMemory (cl_entities, (size_t)count * sizeof(entity_t)))
+		Sys_Error ("CL_CommitEntities: out of memory (%d entities)", count);
+
+	cl_committed_edicts = count;
+}
+
 /*
 =====================
 CL_Disconnect
@@ -152,7 +201,7 @@ void CL_Disconnect (void)
 		NET_Close (cls.netcon);
 
 		cls.state = ca_disconnected;
-		if (sv.active)
+		if (sv->active)
 			Host_ShutdownServer(false);
 	}
 
@@ -170,7 +219,7 @@ void CL_Disconnect_f (void)
 	CL_Disconnect ();
 	BGM_Stop ();
 	CDAudio_Stop ();
-	if (sv.active)
+	if (sv->active)
 		Host_ShutdownServer (false);
 }
 
@@ -229,6 +278,18 @@ void CL_SignonReply (void)
 		MSG_WriteByte (&cls.message, clc_stringcmd);
 		MSG_WriteString (&cls.message, va("color %i %i\n", ((int)cl_color.value)>>4, ((int)cl_color.value)&15));
 
+		if (cl_predict.value)
+		{
+			MSG_WriteByte (&cls.message, clc_stringcmd);
+			MSG_WriteString (&cls.message, "predict 1");
+		}
+
+		if (!cls.demorecording)
+		{
+			MSG_WriteByte (&cls.message, clc_stringcmd);
+			MSG_WriteString (&cls.message, "entkeep 1");
+		}
+
 		MSG_WriteByte (&cls.message, clc_stringcmd);
 		sprintf (str, "spawn %s", cls.spawnparms);
 		MSG_WriteString (&cls.message, str);
@@ -436,7 +497,7 @@ float	CL_LerpPoint (void)
 
 	f = cl.mtime[0] - cl.mtime[1];
 
-	if (!f || cls.timedemo || (sv.active && !host_netinterval))
+	if (!f || cls.timedemo || (sv->active && !host_netinterval))
 	{
 		cl.time = cl.mtime[0];
 		return 1;
@@ -736,6 +797,16 @@ int CL_ReadFromServer (void)
 			break;
 
 		cl.last_received_message = realtime;
+
+	// one telemetry sample per server tick, reliable messages join the current one
+		if (ret == 2 || cls.demoplayback || !NetStats_Current (&cl_netstats))
+			NetStats_Begin (&cl_netstats, cls.demoplayback ? NULL : cls.netcon);
+		if (ret == 2)
+			NetStats_Datagram (&cl_netstats, net_message.cursize,
+				Q_strcmp (NET_QSocketGetAddressString (cls.netcon), "LOCAL") ? DATAGRAM_MTU : MAX_DATAGRAM);
+		else
+			NetStats_Current (&cl_netstats)->reliable += net_message.cursize;
+
 		CL_ParseServerMessage ();
 	} while (ret && cls.state == ca_connected);
 
@@ -743,6 +814,7 @@ int CL_ReadFromServer (void)
 		Con_Printf ("\n");
 
 	CL_RelinkEntities ();
+	CL_PredictMove ();
 	CL_UpdateTEnts ();
 
 //johnfitz -- devstats
@@ -1017,6 +1089,7 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_anglespeedkey);
 	Cvar_RegisterVariable (&cl_shownet);
 	Cvar_RegisterVariable (&cl_nolerp);
+	Cvar_RegisterVariable (&cl_predict);
 	Cvar_RegisterVariable (&freelook);
 	Cvar_RegisterVariable (&lookspring);
 	Cvar_RegisterVariable (&lookstrafe);
@@ -1038,6 +1111,7 @@ void CL_Init (void)
 
 	Cvar_RegisterVariable (&cl_startdemos);
 	Cvar_RegisterVariable (&cl_confirmquit);
+	Cvar_RegisterVariable (&cl_demoseek_cache);
 
 	Cmd_AddCommand ("entities", CL_PrintEntities_f);
 	Cmd_AddCommand ("disconnect", CL_Disconnect_f);
@@ -1045,6 +1119,7 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("demoseek", CL_DemoSeek_f);
 
 	Cmd_AddCommand ("tracepos", CL_Tracepos_f); //johnfitz
 	cmd = Cmd_AddCommand ("viewpos", CL_Viewpos_f); //johnfitz
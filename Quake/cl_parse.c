@@ -96,7 +96,9 @@ const char *svc_strings[] =
 	"svc_chat", // 53
 	"svc_levelcompleted", // 54
 	"svc_backtolobby", // 55
-	"svc_localsound" // 56
+	"svc_localsound", // 56
+	"svc_moveack", // 57
+	"svc_entkeep" // 58
 };
 #define NUM_SVC_STRINGS Q_COUNTOF(svc_strings)
 
@@ -124,6 +126,7 @@ entity_t	*CL_EntityNum (int num)
 	{
 		if (num >= cl_max_edicts) //johnfitz -- no more MAX_EDICTS
 			Host_Error ("CL_EntityNum: %i is an invalid number",num);
+		CL_CommitEntities (num + 1);
 		while (cl.num_entities<=num)
 		{
 			cl_entities[cl.num_entities].colormap = vid.colormap;
@@ -167,7 +170,7 @@ void CL_ParseStartSoundPacket(void)
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (field_mask & SND_LARGEENTITY)
 	{
-		ent = (unsigned short) MSG_ReadShort ();
+		ent = MSG_ReadEntity (cl.protocolflags);
 		channel = MSG_ReadByte ();
 	}
 	else
@@ -194,6 +197,9 @@ void CL_ParseStartSoundPacket(void)
 	for (i = 0; i < 3; i++)
 		pos[i] = MSG_ReadCoord (cl.protocolflags);
 
+	if (cls.demoseeking)
+		return;
+
 	S_StartSound (ent, channel, cl.sound_precache[sound_num], pos, volume/255.0, attenuation);
 }
 
@@ -211,6 +217,9 @@ void CL_ParseLocalSound(void)
 	if (sound_num >= MAX_SOUNDS)
 		Host_Error ("CL_ParseLocalSound: %i > MAX_SOUNDS", sound_num);
 
+	if (cls.demoseeking)
+		return;
+
 	S_LocalSound (cl.sound_precache[sound_num]->name);
 }
 
@@ -231,7 +240,7 @@ void CL_KeepaliveMessage (void)
 	sizebuf_t	old;
 	byte	*olddata;
 
-	if (sv.active)
+	if (sv->active)
 		return;		// no need if server is local
 	if (cls.demoplayback)
 		return;
@@ -314,7 +323,7 @@ void CL_ParseServerInfo (void)
 
 	if (cl.protocol == PROTOCOL_RMQ)
 	{
-		const unsigned int supportedflags = (PRFL_SHORTANGLE | PRFL_FLOATANGLE | PRFL_24BITCOORD | PRFL_FLOATCOORD | PRFL_EDICTSCALE | PRFL_INT32COORD);
+		const unsigned int supportedflags = (PRFL_SHORTANGLE | PRFL_FLOATANGLE | PRFL_24BITCOORD | PRFL_FLOATCOORD | PRFL_EDICTSCALE | PRFL_INT32COORD | PRFL_LARGEEDICTS);
 		
 		// mh - read protocol flags from server so that we know what protocol features to expect
 		cl.protocolflags = (unsigned int) MSG_ReadLong ();
@@ -484,7 +493,7 @@ void CL_ParseUpdate (int bits)
 	//johnfitz
 
 	if (bits & U_LONGENTITY)
-		num = MSG_ReadShort ();
+		num = MSG_ReadEntity (cl.protocolflags);
 	else
 		num = MSG_ReadByte ();
 
@@ -670,6 +679,31 @@ void CL_ParseUpdate (int bits)
 	}
 }
 
+/*
+==================
+CL_ParseEntKeep
+
+The server had no room to update these visible entities this time,
+so keep them where they are instead of dropping them
+==================
+*/
+static void CL_ParseEntKeep (void)
+{
+	int			i, count;
+	entity_t	*ent;
+
+	count = MSG_ReadByte ();
+	for (i = 0; i < count; i++)
+	{
+		ent = CL_EntityNum (MSG_ReadEntity (cl.protocolflags));
+		if (ent->msgtime == cl.mtime[0])
+			continue;
+		VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
+		VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
+		ent->msgtime = cl.mtime[0];
+	}
+}
+
 /*
 ==================
 CL_ParseBaseline
@@ -1061,6 +1095,45 @@ static void CL_ParseStuffText(const char *msg)
 	}
 }
 
+/*
+=====================
+CL_NetCategory
+
+Telemetry bucket for a server message command
+=====================
+*/
+static netcategory_t CL_NetCategory (int cmd)
+{
+	if (cmd & U_SIGNAL)
+		return NETCAT_ENTITIES;
+
+	switch (cmd)
+	{
+	case svc_entkeep:
+		return NETCAT_ENTITIES;
+	case svc_time:
+	case svc_clientdata:
+	case svc_updatestat:
+	case svc_setangle:
+	case svc_moveack:
+		return NETCAT_CLIENTDATA;
+	case svc_sound:
+	case svc_stopsound:
+	case svc_localsound:
+		return NETCAT_SOUND;
+	case svc_particle:
+	case svc_temp_entity:
+		return NETCAT_TEMPENTS;
+	case svc_stufftext:
+		return NETCAT_STUFFCMD;
+	case svc_print:
+	case svc_centerprint:
+		return NETCAT_PRINT;
+	default:
+		return NETCAT_OTHER;
+	}
+}
+
 /*
 =====================
 CL_ParseServerMessage
@@ -1072,6 +1145,10 @@ void CL_ParseServerMessage (void)
 	int			i;
 	const char		*str; //johnfitz
 	int			lastcmd; //johnfitz
+	netsample_t		*stats;
+	int			cmdstart;
+	netcategory_t		cmdcat;
+	static int		*demostrip;	// start/end offsets of commands left out of demos
 
 //
 // if recording demos, copy the message out
@@ -1087,6 +1164,11 @@ void CL_ParseServerMessage (void)
 // parse the message
 //
 	MSG_BeginReading ();
+	VEC_CLEAR (demostrip);
+
+	stats = NetStats_Current (&cl_netstats);
+	cmdstart = 0;
+	cmdcat = NETCAT_OTHER;
 
 	lastcmd = 0;
 	while (1)
@@ -1094,7 +1176,13 @@ void CL_ParseServerMessage (void)
 		if (msg_badread)
 			Host_Error ("CL_ParseServerMessage: Bad server message");
 
+	// charge the previous command's bytes to its telemetry bucket
+		if (stats)
+			stats->bytes[cmdcat] += msg_readcount - cmdstart;
+		cmdstart = msg_readcount;
+
 		cmd = MSG_ReadByte ();
+		cmdcat = CL_NetCategory (cmd);
 
 		if (cmd == -1)
 		{
@@ -1103,6 +1191,7 @@ void CL_ParseServerMessage (void)
 			if (*cl.stuffcmdbuf && net_message.cursize < 512)
 				CL_ParseStuffText("\n");	//there's a few mods that forget to write \ns, that then fuck up other things too. So make sure it gets flushed to the cbuf. the cursize check is to reduce backbuffer overflows that would give a false positive.
 
+			CL_RecordServerMessage (demostrip, VEC_SIZE (demostrip) / 2);
 			CL_FinishDemoFrame ();
 			return;		// end of message
 		}
@@ -1185,7 +1274,10 @@ void CL_ParseServerMessage (void)
 			break;
 
 		case svc_setview:
-			cl.viewentity = MSG_ReadShort ();
+			cl.viewentity = MSG_ReadEntity (cl.protocolflags);
+			if (cl.viewentity >= cl_max_edicts)
+				Host_Error ("svc_setview: %i is an invalid number", cl.viewentity);
+			CL_CommitEntities (cl.viewentity + 1);
 			break;
 
 		case svc_lightstyle:
@@ -1234,7 +1326,7 @@ void CL_ParseServerMessage (void)
 			break;
 
 		case svc_spawnbaseline:
-			i = MSG_ReadShort ();
+			i = MSG_ReadEntity (cl.protocolflags);
 			// must use CL_EntityNum() to force cl.num_entities up
 			CL_ParseBaseline (CL_EntityNum(i), 1); // johnfitz -- added second parameter
 			break;
@@ -1357,7 +1449,7 @@ void CL_ParseServerMessage (void)
 			break;
 
 		case svc_spawnbaseline2: //PROTOCOL_FITZQUAKE
-			i = MSG_ReadShort ();
+			i = MSG_ReadEntity (cl.protocolflags);
 			// must use CL_EntityNum() to force cl.num_entities up
 			CL_ParseBaseline (CL_EntityNum(i), 2);
 			break;
@@ -1382,6 +1474,18 @@ void CL_ParseServerMessage (void)
 		case svc_localsound:
 			CL_ParseLocalSound();
 			break;
+
+		case svc_moveack:
+			CL_ParseMoveAck ();
+			VEC_PUSH (demostrip, cmdstart);
+			VEC_PUSH (demostrip, msg_readcount);
+			break;
+
+		case svc_entkeep:
+			CL_ParseEntKeep ();
+			VEC_PUSH (demostrip, cmdstart);
+			VEC_PUSH (demostrip, msg_readcount);
+			break;
 		}
 
 		lastcmd = cmd; //johnfitz
@@ -0,0 +1,613 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_pred.c -- client side movement prediction
+
+#include "quakedef.h"
+
+/*
+
+The client numbers every move it sends and keeps the ones the server has not
+acknowledged yet. Each datagram from a server that agreed to "predict" carries
+an svc_moveack with the sequence of the last move it applied and the player's
+resulting origin and velocity. The view origin is then rebuilt from that state
+by replaying the remaining moves through a copy of the walking physics in
+sv_user.c / sv_phys.c, clipped against the world and the brush entities the
+client knows about.
+
+The server applies the latest move once per server frame rather than once per
+move, and QC may change the player in ways the client can't see, so the
+replay is an estimate that gets corrected by every acknowledgement.
+
+*/
+
+cvar_t	cl_predict = {"cl_predict", "0", CVAR_ARCHIVE};
+
+extern	cvar_t	sv_friction;
+extern	cvar_t	sv_edgefriction;
+extern	cvar_t	sv_stopspeed;
+extern	cvar_t	sv_maxspeed;
+extern	cvar_t	sv_accelerate;
+extern	cvar_t	sv_gravity;
+extern	cvar_t	sv_maxvelocity;
+extern	cvar_t	sv_nostep;
+
+#define	PRED_STEPSIZE	18
+#define	PRED_JUMPSPEED	270		// PlayerJump in id1 client.qc
+
+typedef struct
+{
+	vec3_t		origin;
+	vec3_t		velocity;
+	int			flags;			// MOVEACK_* bits
+} predstate_t;
+
+static const vec3_t pred_mins = {-16, -16, -24};
+
+/*
+==================
+CL_PredictClipHull
+
+Same bookkeeping as SV_ClipMoveToEntity, for a brush model at offset
+==================
+*/
+static void CL_PredictClipHull (hull_t *hull, const vec3_t offset, vec3_t start, vec3_t end, trace_t *trace)
+{
+	vec3_t		start_l, end_l;
+
+	memset (trace, 0, sizeof (*trace));
+	trace->fraction = 1;
+	trace->allsolid = true;
+	VectorCopy (end, trace->endpos);
+
+	VectorSubtract (start, offset, start_l);
+	VectorSubtract (end, offset, end_l);
+
+	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, trace);
+
+	if (trace->fraction != 1)
+		VectorAdd (trace->endpos, offset, trace->endpos);
+}
+
+/*
+==================
+CL_PredictTrace
+
+Hull 0 for point traces, hull 1 for the player box. Only brush models are
+solid: the world and any unrotated submodel sent in the last packet.
+==================
+*/
+static trace_t CL_PredictTrace (int hullnum, vec3_t start, vec3_t end)
+{
+	trace_t		trace, clip;
+	entity_t	*ent;
+	int			i;
+
+	CL_PredictClipHull (&cl.worldmodel->hulls[hullnum], vec3_origin, start, end, &trace);
+
+	for (i = 1, ent = cl_entities + 1; i < cl.num_entities; i++, ent++)
+	{
+		if (i == cl.viewentity || !ent->model || ent->model->type != mod_brush || ent->model->name[0] != '*')
+			continue;
+		if (ent->msgtime != cl.mtime[0])
+			continue;
+		if (ent->angles[0] || ent->angles[1] || ent->angles[2])
+			continue;	// rotating brushes are left to the server
+
+		CL_PredictClipHull (&ent->model->hulls[hullnum], ent->origin, start, end, &clip);
+
+		if (clip.allsolid || clip.startsolid || clip.fraction < trace.fraction)
+		{
+			if (trace.startsolid)
+			{
+				trace = clip;
+				trace.startsolid = true;
+			}
+			else
+				trace = clip;
+		}
+		else if (clip.startsolid)
+			trace.startsolid = true;
+	}
+
+	return trace;
+}
+
+/*
+==================
+CL_PredictFriction
+
+SV_UserFriction
+==================
+*/
+static void CL_PredictFriction (predstate_t *ps, float frametime)
+{
+	float	*vel;
+	float	speed, newspeed, control;
+	vec3_t	start, stop;
+	float	friction;
+	trace_t	trace;
+
+	vel = ps->velocity;
+
+	speed = sqrt(vel[0]*vel[0] +vel[1]*vel[1]);
+	if (!speed)
+		return;
+
+// if the leading edge is over a dropoff, increase friction
+	start[0] = stop[0] = ps->origin[0] + vel[0]/speed*16;
+	start[1] = stop[1] = ps->origin[1] + vel[1]/speed*16;
+	start[2] = ps->origin[2] + pred_mins[2];
+	stop[2] = start[2] - 34;
+
+	trace = CL_PredictTrace (0, start, stop);
+
+	if (trace.fraction == 1.0)
+		friction = sv_friction.value*sv_edgefriction.value;
+	else
+		friction = sv_friction.value;
+
+// apply friction
+	control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
+	newspeed = speed - frametime*control*friction;
+
+	if (newspeed < 0)
+		newspeed = 0;
+	newspeed /= speed;
+
+	VectorScale (vel, newspeed, vel);
+}
+
+/*
+==================
+CL_PredictAccelerate
+
+SV_Accelerate
+==================
+*/
+static void CL_PredictAccelerate (predstate_t *ps, float frametime, float wishspeed, const vec3_t wishdir)
+{
+	float		addspeed, accelspeed, currentspeed;
+
+	currentspeed = DotProduct (ps->velocity, wishdir);
+	addspeed = wishspeed - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = sv_accelerate.value*frametime*wishspeed;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	VectorMA (ps->velocity, accelspeed, wishdir, ps->velocity);
+}
+
+/*
+==================
+CL_PredictAirAccelerate
+
+SV_AirAccelerate
+==================
+*/
+static void CL_PredictAirAccelerate (predstate_t *ps, float frametime, float wishspeed, vec3_t wishveloc)
+{
+	float		addspeed, wishspd, accelspeed, currentspeed;
+
+	wishspd = VectorNormalize (wishveloc);
+	if (wishspd > 30)
+		wishspd = 30;
+	currentspeed = DotProduct (ps->velocity, wishveloc);
+	addspeed = wishspd - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = sv_accelerate.value*wishspeed * frametime;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	VectorMA (ps->velocity, accelspeed, wishveloc, ps->velocity);
+}
+
+/*
+==================
+CL_PredictAirMove
+
+SV_ClientThink + SV_AirMove for MOVETYPE_WALK
+==================
+*/
+static void CL_PredictAirMove (predstate_t *ps, const predmove_t *move)
+{
+	vec3_t		angles, forward, right, up;
+	vec3_t		wishvel, wishdir;
+	float		wishspeed;
+	int			i;
+
+	angles[PITCH] = -move->angles[PITCH]/3;
+	angles[YAW] = move->angles[YAW];
+	angles[ROLL] = 0;
+	angles[ROLL] = V_CalcRoll (angles, ps->velocity)*4;
+
+	AngleVectors (angles, forward, right, up);
+
+	for (i=0 ; i<3 ; i++)
+		wishvel[i] = forward[i]*move->forwardmove + right[i]*move->sidemove;
+	wishvel[2] = 0;
+
+	VectorCopy (wishvel, wishdir);
+	wishspeed = VectorNormalize(wishdir);
+	if (wishspeed > sv_maxspeed.value)
+	{
+		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
+		wishspeed = sv_maxspeed.value;
+	}
+
+	if (ps->flags & MOVEACK_ONGROUND)
+	{
+		CL_PredictFriction (ps, move->frametime);
+		CL_PredictAccelerate (ps, move->frametime, wishspeed, wishdir);
+	}
+	else
+		CL_PredictAirAccelerate (ps, move->frametime, wishspeed, wishvel);
+}
+
+/*
+==================
+CL_PredictFlyMove
+
+SV_FlyMove, without touch functions
+==================
+*/
+#define	PRED_MAX_CLIP_PLANES	5
+static int CL_PredictFlyMove (predstate_t *ps, float time, trace_t *steptrace)
+{
+	int			bumpcount, numbumps;
+	vec3_t		dir;
+	float		d;
+	int			numplanes;
+	vec3_t		planes[PRED_MAX_CLIP_PLANES];
+	vec3_t		primal_velocity, original_velocity, new_velocity;
+	int			i, j;
+	trace_t		trace;
+	vec3_t		end;
+	float		time_left;
+	int			blocked;
+
+	numbumps = 4;
+
+	blocked = 0;
+	VectorCopy (ps->velocity, original_velocity);
+	VectorCopy (ps->velocity, primal_velocity);
+	numplanes = 0;
+
+	time_left = time;
+
+	for (bumpcount=0 ; bumpcount<numbumps ; bumpcount++)
+	{
+		if (!ps->velocity[0] && !ps->velocity[1] && !ps->velocity[2])
+			break;
+
+		for (i=0 ; i<3 ; i++)
+			end[i] = ps->origin[i] + time_left * ps->velocity[i];
+
+		trace = CL_PredictTrace (1, ps->origin, end);
+
+		if (trace.allsolid)
+		{	// entity is trapped in another solid
+			VectorCopy (vec3_origin, ps->velocity);
+			return 3;
+		}
+
+		if (trace.fraction > 0)
+		{	// actually covered some distance
+			VectorCopy (trace.endpos, ps->origin);
+			VectorCopy (ps->velocity, original_velocity);
+			numplanes = 0;
+		}
+
+		if (trace.fraction == 1)
+			 break;		// moved the entire distance
+
+		if (trace.plane.normal[2] > 0.7)
+		{
+			blocked |= 1;		// floor
+			ps->flags |= MOVEACK_ONGROUND;
+		}
+		if (!trace.plane.normal[2])
+		{
+			blocked |= 2;		// step
+			if (steptrace)
+				*steptrace = trace;
+		}
+
+		time_left -= time_left * trace.fraction;
+
+	// cliped to another plane
+		if (numplanes >= PRED_MAX_CLIP_PLANES)
+		{	// this shouldn't really happen
+			VectorCopy (vec3_origin, ps->velocity);
+			return 3;
+		}
+
+		VectorCopy (trace.plane.normal, planes[numplanes]);
+		numplanes++;
+
+//
+// modify original_velocity so it parallels all of the clip planes
+//
+		for (i=0 ; i<numplanes ; i++)
+		{
+			ClipVelocity (original_velocity, planes[i], new_velocity, 1);
+			for (j=0 ; j<numplanes ; j++)
+				if (j != i)
+				{
+					if (DotProduct (new_velocity, planes[j]) < 0)
+						break;	// not ok
+				}
+			if (j == numplanes)
+				break;
+		}
+
+		if (i != numplanes)
+		{	// go along this plane
+			VectorCopy (new_velocity, ps->velocity);
+		}
+		else
+		{	// go along the crease
+			if (numplanes != 2)
+			{
+				VectorCopy (vec3_origin, ps->velocity);
+				return 7;
+			}
+			CrossProduct (planes[0], planes[1], dir);
+			d = DotProduct (dir, ps->velocity);
+			VectorScale (dir, d, ps->velocity);
+		}
+
+//
+// if original velocity is against the original velocity, stop dead
+// to avoid tiny occilations in sloping corners
+//
+		if (DotProduct (ps->velocity, primal_velocity) <= 0)
+		{
+			VectorCopy (vec3_origin, ps->velocity);
+			return blocked;
+		}
+	}
+
+	return blocked;
+}
+
+/*
+==================
+CL_PredictPush
+
+SV_PushEntity
+==================
+*/
+static trace_t CL_PredictPush (predstate_t *ps, const vec3_t push)
+{
+	trace_t		trace;
+	vec3_t		end;
+
+	VectorAdd (ps->origin, push, end);
+	trace = CL_PredictTrace (1, ps->origin, end);
+	VectorCopy (trace.endpos, ps->origin);
+
+	return trace;
+}
+
+/*
+==================
+CL_PredictWalkMove
+
+SV_WalkMove, minus the unstick and wall friction passes
+==================
+*/
+static void CL_PredictWalkMove (predstate_t *ps, float frametime)
+{
+	vec3_t		upmove, downmove;
+	vec3_t		oldorg, oldvel;
+	vec3_t		nosteporg, nostepvel;
+	int			clip;
+	int			oldonground;
+	trace_t		steptrace, downtrace;
+
+//
+// do a regular slide move unless it looks like you ran into a step
+//
+	oldonground = ps->flags & MOVEACK_ONGROUND;
+	ps->flags &= ~MOVEACK_ONGROUND;
+
+	VectorCopy (ps->origin, oldorg);
+	VectorCopy (ps->velocity, oldvel);
+
+	clip = CL_PredictFlyMove (ps, frametime, &steptrace);
+
+	if ( !(clip & 2) )
+		return;		// move didn't block on a step
+
+	if (!oldonground)
+		return;		// don't stair up while jumping
+
+	if (sv_nostep.value)
+		return;
+
+	VectorCopy (ps->origin, nosteporg);
+	VectorCopy (ps->velocity, nostepvel);
+
+//
+// try moving up and forward to go up a step
+//
+	VectorCopy (oldorg, ps->origin);	// back to start pos
+
+	VectorCopy (vec3_origin, upmove);
+	VectorCopy (vec3_origin, downmove);
+	upmove[2] = PRED_STEPSIZE;
+	downmove[2] = -PRED_STEPSIZE + oldvel[2]*frametime;
+
+// move up
+	CL_PredictPush (ps, upmove);
+
+// move forward
+	ps->velocity[0] = oldvel[0];
+	ps->velocity[1] = oldvel[1];
+	ps->velocity[2] = 0;
+	CL_PredictFlyMove (ps, frametime, &steptrace);
+
+// move down
+	downtrace = CL_PredictPush (ps, downmove);
+
+	if (downtrace.plane.normal[2] > 0.7)
+		ps->flags |= MOVEACK_ONGROUND;
+	else
+	{
+// if the push down didn't end up on good ground, use the move without
+// the step up.  This happens near wall / slope combinations, and can
+// cause the player to hop up higher on a slope too steep to climb
+		VectorCopy (nosteporg, ps->origin);
+		VectorCopy (nostepvel, ps->velocity);
+	}
+}
+
+/*
+==================
+CL_PredictPlayerMove
+
+One move, in the order the server runs it: SV_ClientThink, PlayerPreThink
+(jumping), gravity and SV_WalkMove
+==================
+*/
+static void CL_PredictPlayerMove (predstate_t *ps, const predmove_t *move)
+{
+	int		i;
+
+	CL_PredictAirMove (ps, move);
+
+	if (!(move->buttons & 2))
+		ps->flags |= MOVEACK_JUMPRELEASED;
+	else if ((ps->flags & MOVEACK_ONGROUND) && (ps->flags & MOVEACK_JUMPRELEASED))
+	{
+		ps->flags &= ~(MOVEACK_ONGROUND|MOVEACK_JUMPRELEASED);
+		ps->velocity[2] += PRED_JUMPSPEED;
+	}
+
+	for (i=0 ; i<3 ; i++)
+		ps->velocity[i] = CLAMP (-sv_maxvelocity.value, ps->velocity[i], sv_maxvelocity.value);
+
+	ps->velocity[2] -= sv_gravity.value * move->frametime;
+
+	CL_PredictWalkMove (ps, move->frametime);
+}
+
+/*
+==================
+CL_PredictSendMove
+
+Called by CL_SendMove to number the move being sent and remember it for replay
+==================
+*/
+void CL_PredictSendMove (sizebuf_t *buf, const usercmd_t *cmd, int buttons)
+{
+	predmove_t	*move;
+
+	cl.predict.outgoing++;
+	move = &cl.predict.moves[cl.predict.outgoing & (PREDICT_BACKUP - 1)];
+	move->sequence = cl.predict.outgoing;
+	move->sendtime = realtime;
+	move->frametime = host_frametime;
+	VectorCopy (cl.viewangles, move->angles);
+	move->forwardmove = cmd->forwardmove;
+	move->sidemove = cmd->sidemove;
+	move->upmove = cmd->upmove;
+	move->buttons = buttons;
+
+	MSG_WriteByte (buf, clc_moveseq);
+	MSG_WriteLong (buf, cl.predict.outgoing);
+}
+
+/*
+==================
+CL_ParseMoveAck
+==================
+*/
+void CL_ParseMoveAck (void)
+{
+	int		i;
+
+	cl.predict.acknowledged = MSG_ReadLong ();
+	cl.predict.flags = MSG_ReadByte ();
+	for (i=0 ; i<3 ; i++)
+		cl.predict.origin[i] = MSG_ReadFloat ();
+	for (i=0 ; i<3 ; i++)
+		cl.predict.velocity[i] = MSG_ReadFloat ();
+
+	cl.predict.active = true;
+}
+
+/*
+==================
+CL_PredictMove
+
+Replaces the lerped view entity origin with the predicted one. Called after
+CL_RelinkEntities.
+==================
+*/
+void CL_PredictMove (void)
+{
+	predstate_t		state, prev;
+	const predmove_t	*move;
+	unsigned		seq, pending;
+	entity_t		*ent;
+	float			frac;
+
+	if (!cl_predict.value || !cl.predict.active || cls.demoplayback)
+		return;
+	if (cls.signon != SIGNONS || cl.paused || cl.intermission || !cl.worldmodel)
+		return;
+	if (!(cl.predict.flags & MOVEACK_PREDICTABLE))
+		return;
+	if (cl.viewentity <= 0 || cl.viewentity >= cl.num_entities)
+		return;
+
+	pending = cl.predict.outgoing - cl.predict.acknowledged;
+	if (pending >= PREDICT_BACKUP)
+		return;		// ack from an earlier connection, or too far behind
+
+	VectorCopy (cl.predict.origin, state.origin);
+	VectorCopy (cl.predict.velocity, state.velocity);
+	state.flags = cl.predict.flags;
+	prev = state;
+	move = NULL;
+
+	for (seq = cl.predict.acknowledged + 1; seq - cl.predict.acknowledged <= pending; seq++)
+	{
+		move = &cl.predict.moves[seq & (PREDICT_BACKUP - 1)];
+		prev = state;
+		CL_PredictPlayerMove (&state, move);
+	}
+
+// spread the newest move over the time until the next one is sent
+	if (move && move->frametime > 0)
+		frac = CLAMP (0.f, (float)((realtime - move->sendtime) / move->frametime), 1.f);
+	else
+		frac = 1.f;
+
+	ent = &cl_entities[cl.viewentity];
+	VectorLerp (prev.origin, state.origin, frac, ent->origin);
+	cl.onground = (state.flags & MOVEACK_ONGROUND) != 0;
+}
@@ -131,6 +131,9 @@ typedef struct
 // (we want to be able to set playback speed to 1/2x, pause, and then resume playback at 1/2x not 1x)
 	float		basedemospeed;
 
+// parsing skipped messages while jumping to a different point in the demo
+	qboolean	demoseeking;
+
 	qboolean	timedemo;
 	int		forcetrack;		// -1 = use normal cd track
 	char		demofilename[MAX_OSPATH];
@@ -150,6 +153,31 @@ typedef struct
 
 extern client_static_t	cls;
 
+#define	PREDICT_BACKUP	64		// moves kept for replay, must be a power of two
+
+typedef struct
+{
+	unsigned	sequence;
+	double		sendtime;		// realtime when sent
+	float		frametime;		// time the move covers
+	vec3_t		angles;
+	float		forwardmove;
+	float		sidemove;
+	float		upmove;
+	int			buttons;
+} predmove_t;
+
+typedef struct
+{
+	qboolean	active;			// server sends svc_moveack
+	unsigned	outgoing;		// sequence of the last move sent
+	unsigned	acknowledged;	// sequence of the last move the server applied
+	int			flags;			// MOVEACK_* for the acknowledged state
+	vec3_t		origin;			// authoritative state after the acknowledged move
+	vec3_t		velocity;
+	predmove_t	moves[PREDICT_BACKUP];
+} predict_t;
+
 //
 // the client_state_t structure is wiped completely at every
 // server signon
@@ -257,6 +285,8 @@ typedef struct
 	float		zoom;
 	float		zoomdir;
 
+	predict_t	predict;		// movement prediction, see cl_pred.c
+
 	qboolean	forceunderwater;	// force underwater warping/sound distortion even when camera is not submerged (e.g. alk1.2 liquidbrush)
 } client_state_t;
 
@@ -302,6 +332,8 @@ extern	cvar_t	m_side;
 extern	cvar_t	cl_startdemos;
 extern	cvar_t	cl_confirmquit;
 
+extern	cvar_t	cl_demoseek_cache;
+
 
 #define	MAX_TEMP_ENTITIES	256		//johnfitz -- was 64
 #define	MAX_STATIC_ENTITIES	4096	//ericw -- was 512	//johnfitz -- was 128
@@ -320,6 +352,8 @@ extern	int				cl_numvisedicts;
 
 extern	entity_t		*cl_entities; //johnfitz -- was a static array, now on hunk
 extern	int				cl_max_edicts; //johnfitz -- only changes when new map loads
+void CL_AllocEntities (void);
+void CL_CommitEntities (int count);
 
 //=============================================================================
 
@@ -373,6 +407,7 @@ void CL_ClearState (void);
 //
 void CL_StopPlayback (void);
 int CL_GetMessage (void);
+void CL_RecordServerMessage (const int *strip, int numstrip);
 void CL_ClearSignons (void);
 void CL_AdvanceTime (void);
 void CL_FinishDemoFrame (void);
@@ -382,12 +417,23 @@ void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_DemoSeek_f (void);
 
 //
 // cl_parse.c
 //
 void CL_ParseServerMessage (void);
 void CL_NewTranslation (int slot);
+entity_t *CL_EntityNum (int num);
+
+//
+// cl_pred.c
+//
+extern	cvar_t	cl_predict;
+
+void CL_PredictSendMove (sizebuf_t *buf, const usercmd_t *cmd, int buttons);
+void CL_ParseMoveAck (void);
+void CL_PredictMove (void);
 
 //
 // view
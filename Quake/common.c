@@ -806,6 +806,13 @@ void MSG_WriteAngle16 (sizebuf_t *sb, float f, unsigned int flags)
 }
 //johnfitz
 
+void MSG_WriteEntity (sizebuf_t *sb, int num, unsigned int flags)
+{
+	MSG_WriteShort (sb, num & 65535);
+	if (flags & PRFL_LARGEEDICTS)
+		MSG_WriteByte (sb, num >> 16);
+}
+
 //
 // reading functions
 //
@@ -977,6 +984,14 @@ float MSG_ReadAngle16 (unsigned int flags)
 }
 //johnfitz
 
+int MSG_ReadEntity (unsigned int flags)
+{
+	int num = (unsigned short) MSG_ReadShort ();
+	if (flags & PRFL_LARGEEDICTS)
+		num |= MSG_ReadByte () << 16;
+	return num;
+}
+
 //===========================================================================
 
 void SZ_Alloc (sizebuf_t *buf, int startsize)
@@ -2685,7 +2700,7 @@ void COM_SwitchGame (const char *paths)
 
 	//Kill the server
 	CL_Disconnect ();
-	Host_ShutdownServer(true);
+	SV_ShutdownInstances (true);
 
 	//Write config file
 	Host_WriteConfiguration ();
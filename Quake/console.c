@@ -1214,8 +1214,267 @@ static void Con_Print (const char *txt)
 
 // borrowed from uhexen2 by S.A. for new procs, LOG_Init, LOG_Close
 
-static char	logfilename[MAX_OSPATH];	// current logfile name
-static int	log_fd = -1;			// log file descriptor
+// Log output is queued in a lock-free ring buffer and written out in large
+// chunks by a background thread, so heavy printing (e.g. developer 1) never
+// waits on disk I/O. Producers claim space with a CAS on log_reserve, copy
+// their record, then publish it in claim order by advancing log_commit.
+// The flush thread, or whoever calls LOG_Flush, consumes records under
+// log_drainlock, collapsing runs of identical lines along the way.
+
+#define LOG_RING_SIZE		(1 << 20)		// must be a power of two
+#define LOG_RING_MASK		(LOG_RING_SIZE - 1)
+#define LOG_MAX_RECORD		(LOG_RING_SIZE / 4)
+#define LOG_MAX_LINE		4096
+#define LOG_FLUSH_INTERVAL	100				// ms
+
+typedef struct
+{
+	int		length;
+	double	time;
+} logrecord_t;
+
+static char			logfilename[MAX_OSPATH];	// current logfile name
+static int			log_fd = -1;			// log file descriptor
+static qboolean		log_json;				// write JSON lines instead of plain text
+static double		log_timebase;			// wall clock time at Sys_DoubleTime () == 0
+
+static byte			log_ring[LOG_RING_SIZE];
+static SDL_atomic_t	log_reserve;			// end of claimed space
+static SDL_atomic_t	log_commit;				// end of published records
+static SDL_atomic_t	log_tail;				// start of unconsumed records
+static SDL_SpinLock	log_drainlock;
+static SDL_atomic_t	log_quit;
+static SDL_sem		*log_wake;
+static SDL_Thread	*log_thread;
+
+// consumer state, only used with log_drainlock held
+static char			log_line[LOG_MAX_LINE];
+static int			log_linelen;
+static double		log_linetime;
+static char			log_prevline[LOG_MAX_LINE];
+static int			log_prevlen = -1;
+static int			log_repeats;
+static char			log_out[65536];
+static int			log_outlen;
+
+/*
+================
+LOG_WriteOut
+================
+*/
+static void LOG_WriteOut (void)
+{
+	if (log_outlen && log_fd != -1 && write (log_fd, log_out, log_outlen) < 0)
+	{
+		close (log_fd);
+		log_fd = -1;
+		fprintf (stderr, "Error writing to log file\n");
+	}
+	log_outlen = 0;
+}
+
+/*
+================
+LOG_Write
+================
+*/
+static void LOG_Write (const char *data, int len)
+{
+	while (len > 0)
+	{
+		int chunk = q_min (len, (int) sizeof (log_out) - log_outlen);
+		memcpy (log_out + log_outlen, data, chunk);
+		log_outlen += chunk;
+		data += chunk;
+		len -= chunk;
+		if (log_outlen == sizeof (log_out))
+			LOG_WriteOut ();
+	}
+}
+
+/*
+================
+LOG_EmitLine
+
+Writes a single line, without its trailing newline, in the current format
+================
+*/
+static void LOG_EmitLine (const char *line, int len, double time)
+{
+	char	buf[32];
+	int		i;
+
+	if (!log_json)
+	{
+		LOG_Write (line, len);
+		LOG_Write ("\n", 1);
+		return;
+	}
+
+	LOG_Write (buf, q_snprintf (buf, sizeof (buf), "{\"time\":%.3f,\"msg\":\"", log_timebase + time));
+	for (i = 0; i < len; i++)
+	{
+		unsigned char c = (unsigned char) line[i];
+		if (c == '"' || c == '\\')
+		{
+			buf[0] = '\\';
+			buf[1] = c;
+			LOG_Write (buf, 2);
+		}
+		else if (c == '\t')
+			LOG_Write ("\\t", 2);
+		else if (c < 0x20)
+			LOG_Write (buf, q_snprintf (buf, sizeof (buf), "\\u%04x", c));
+		else
+			LOG_Write ((const char *) &c, 1);
+	}
+	LOG_Write ("\"}\n", 3);
+}
+
+/*
+================
+LOG_FlushRepeats
+================
+*/
+static void LOG_FlushRepeats (double time)
+{
+	char buf[64];
+
+	if (!log_repeats)
+		return;
+	LOG_EmitLine (buf, q_snprintf (buf, sizeof (buf), "(last message repeated %d times)", log_repeats), time);
+	log_repeats = 0;
+}
+
+/*
+================
+LOG_EndLine
+
+Emits the pending line, or just counts it if it repeats the previous one
+================
+*/
+static void LOG_EndLine (void)
+{
+	if (log_linelen && log_linelen == log_prevlen && !memcmp (log_line, log_prevline, log_linelen))
+	{
+		log_repeats++;
+	}
+	else
+	{
+		LOG_FlushRepeats (log_linetime);
+		LOG_EmitLine (log_line, log_linelen, log_linetime);
+		memcpy (log_prevline, log_line, log_linelen);
+		log_prevlen = log_linelen;
+	}
+	log_linelen = 0;
+}
+
+/*
+================
+LOG_Consume
+================
+*/
+static void LOG_Consume (const byte *data, int len, double time)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (!log_linelen)
+			log_linetime = time;
+		if (data[i] == '\n')
+		{
+			LOG_EndLine ();
+			continue;
+		}
+		if (log_linelen == LOG_MAX_LINE)
+		{
+			LOG_EndLine ();
+			log_linetime = time;
+		}
+		log_line[log_linelen++] = data[i];
+	}
+}
+
+/*
+================
+LOG_Drain
+
+Consumes all published records. Caller must hold log_drainlock.
+If final is true, partial lines and repeat counts are written out too.
+================
+*/
+static void LOG_Drain (qboolean final)
+{
+	unsigned	tail = (unsigned) SDL_AtomicGet (&log_tail);
+	unsigned	commit = (unsigned) SDL_AtomicGet (&log_commit);
+	logrecord_t	rec;
+	unsigned	pos, first;
+	byte		*dst;
+	int			i;
+
+	while (tail != commit)
+	{
+		dst = (byte *) &rec;
+		for (i = 0; i < (int) sizeof (rec); i++)
+			dst[i] = log_ring[(tail + i) & LOG_RING_MASK];
+
+		pos = (tail + sizeof (rec)) & LOG_RING_MASK;
+		first = q_min ((unsigned) rec.length, LOG_RING_SIZE - pos);
+		LOG_Consume (log_ring + pos, first, rec.time);
+		LOG_Consume (log_ring, rec.length - first, rec.time);
+
+		tail += sizeof (rec) + rec.length;
+		SDL_AtomicSet (&log_tail, (int) tail);
+	}
+
+	if (final)
+	{
+		if (log_linelen)
+		{
+			LOG_FlushRepeats (log_linetime);
+			LOG_EmitLine (log_line, log_linelen, log_linetime);
+			log_linelen = 0;
+			log_prevlen = -1;
+		}
+		LOG_FlushRepeats (Sys_DoubleTime ());
+	}
+
+	LOG_WriteOut ();
+}
+
+/*
+================
+LOG_Flush
+
+Synchronously writes out everything logged so far
+================
+*/
+void LOG_Flush (void)
+{
+	if (log_fd == -1)
+		return;
+	SDL_AtomicLock (&log_drainlock);
+	LOG_Drain (true);
+	SDL_AtomicUnlock (&log_drainlock);
+}
+
+/*
+================
+LOG_ThreadFunc
+================
+*/
+static int SDLCALL LOG_ThreadFunc (void *unused)
+{
+	while (!SDL_AtomicGet (&log_quit))
+	{
+		SDL_SemWaitTimeout (log_wake, LOG_FLUSH_INTERVAL);
+		SDL_AtomicLock (&log_drainlock);
+		LOG_Drain (false);
+		SDL_AtomicUnlock (&log_drainlock);
+	}
+	return 0;
+}
 
 /*
 ================
@@ -1228,15 +1487,53 @@ Note: msg is expected to be in UTF-8, not Quake charset
 */
 void Con_DebugLog(const char *msg)
 {
+	logrecord_t	rec;
+	unsigned	start, total, i;
+	const byte	*src;
+
 	if (log_fd == -1)
 		return;
 
-	if (write(log_fd, msg, strlen(msg)) < 0)
+	rec.length = q_min ((int) strlen (msg), LOG_MAX_RECORD);
+	if (!rec.length)
+		return;
+	rec.time = Sys_DoubleTime ();
+	total = sizeof (rec) + rec.length;
+
+	// claim space, draining on this thread if the ring is full
+	for (;;)
 	{
-		close (log_fd);
-		log_fd = -1;
-		fprintf (stderr, "Error writing to log file\n");
+		start = (unsigned) SDL_AtomicGet (&log_reserve);
+		if (start + total - (unsigned) SDL_AtomicGet (&log_tail) > LOG_RING_SIZE)
+		{
+			SDL_AtomicLock (&log_drainlock);
+			LOG_Drain (false);
+			SDL_AtomicUnlock (&log_drainlock);
+			continue;
+		}
+		if (SDL_AtomicCAS (&log_reserve, (int) start, (int) (start + total)))
+			break;
 	}
+
+	src = (const byte *) &rec;
+	for (i = 0; i < sizeof (rec); i++)
+		log_ring[(start + i) & LOG_RING_MASK] = src[i];
+	src = (const byte *) msg;
+	for (i = 0; i < (unsigned) rec.length; i++)
+		log_ring[(start + sizeof (rec) + i) & LOG_RING_MASK] = src[i];
+
+	// publish in claim order: wait for earlier producers to finish copying
+	while (!SDL_AtomicCAS (&log_commit, (int) start, (int) (start + total)))
+		SDL_Delay (0);
+
+	if (!log_thread)
+	{
+		SDL_AtomicLock (&log_drainlock);
+		LOG_Drain (false);
+		SDL_AtomicUnlock (&log_drainlock);
+	}
+	else if (start + total - (unsigned) SDL_AtomicGet (&log_tail) > LOG_RING_SIZE / 2)
+		SDL_SemPost (log_wake);
 }
 
 
@@ -2404,17 +2701,27 @@ void Con_NotifyBox (const char *text)
 }
 
 
+/*
+================
+LOG_Init
+
+-condebug writes qconsole.log, -condebugjson writes qconsole.jsonl
+with one {"time":...,"msg":...} object per line
+================
+*/
 void LOG_Init (quakeparms_t *parms)
 {
 	time_t	inittime;
 	char	session[24];
 
-	if (!COM_CheckParm("-condebug"))
+	log_json = COM_CheckParm("-condebugjson") != 0;
+	if (!log_json && !COM_CheckParm("-condebug"))
 		return;
 
 	inittime = time (NULL);
 	strftime (session, sizeof(session), "%m/%d/%Y %H:%M:%S", localtime(&inittime));
-	q_snprintf (logfilename, sizeof(logfilename), "%s/qconsole.log", parms->basedir);
+	q_snprintf (logfilename, sizeof(logfilename), "%s/qconsole.%s", parms->basedir, log_json ? "jsonl" : "log");
+	log_timebase = (double) inittime - Sys_DoubleTime ();
 
 //	unlink (logfilename);
 
@@ -2425,12 +2732,33 @@ void LOG_Init (quakeparms_t *parms)
 		return;
 	}
 
+	// without a writer thread every message is written synchronously
+	SDL_AtomicSet (&log_quit, 0);
+	log_wake = SDL_CreateSemaphore (0);
+	if (log_wake)
+		log_thread = SDL_CreateThread (LOG_ThreadFunc, "Log writer", NULL);
+
 	Con_DebugLog (va("LOG started on: %s \n", session));
 
 }
 
 void LOG_Close (void)
 {
+	if (log_fd == -1)
+		return;
+	if (log_thread)
+	{
+		SDL_AtomicSet (&log_quit, 1);
+		SDL_SemPost (log_wake);
+		SDL_WaitThread (log_thread, NULL);
+		log_thread = NULL;
+	}
+	if (log_wake)
+	{
+		SDL_DestroySemaphore (log_wake);
+		log_wake = NULL;
+	}
+	LOG_Flush ();
 	if (log_fd == -1)
 		return;
 	close (log_fd);
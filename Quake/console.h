@@ -72,6 +72,7 @@ qboolean Con_CopySelectionToClipboard (void);
 //
 void LOG_Init (quakeparms_t *parms);
 void LOG_Close (void);
+void LOG_Flush (void);
 void Con_DebugLog (const char *msg);
 
 #endif	/* __CONSOLE_H */
@@ -48,6 +48,46 @@ static int	mod_novis_capacity;
 static byte	*mod_decompressed;
 static int	mod_decompressed_capacity;
 
+cvar_t			pvs_cachesize = {"pvs_cachesize", "32", CVAR_NONE}; // megabytes, 0 disables the leaf pvs cache
+
+// cache of decompressed leaf pvs rows for a single bsp model.
+// when the whole matrix fits in pvs_cachesize rows are never evicted,
+// otherwise they are kept in an LRU list (most recently used at head).
+// there is one per world in use, so server instances and the client
+// don't keep rebinding a shared one
+typedef struct
+{
+	int			leaf;
+	int			prev;
+	int			next;
+} pvsslot_t;
+
+typedef struct
+{
+	qmodel_t	*model;
+	int			visbytes;		// (numleafs+7)>>3
+	int			rowbytes;		// visbytes rounded up to VIS_ALIGN_MASK, padding zeroed
+	int			capacity;
+	int			numrows;
+	qboolean	matrix;			// capacity covers every leaf, no eviction
+	byte		*rows;
+	int			*leafslot;		// [numleafs+1], -1 if not cached
+	pvsslot_t	*slots;
+	int			head;
+	int			tail;
+	unsigned	lastused;
+} pvscache_t;
+
+#define MAX_PVSCACHES	(MAX_SV_INSTANCES + 1)	// every server instance's world and the client's
+
+static pvscache_t	pvscaches[MAX_PVSCACHES];
+static unsigned		pvscache_tick;
+static unsigned		pvscache_hits;
+static unsigned		pvscache_misses;
+static unsigned		pvscache_evictions;
+
+int			mod_pvsgeneration;
+
 #define	MAX_MOD_KNOWN	4096 /*johnfitz -- was 512 */
 static qmodel_t	mod_known[MAX_MOD_KNOWN];
 static int		mod_numknown;
@@ -86,6 +126,18 @@ static void R_ENHANCEDMODELS_f (cvar_t *cvar)
 			R_TranslateNewPlayerSkin (i);
 }
 
+static void Mod_FreePVSCaches (qmodel_t *model);
+
+/*
+===============
+Mod_PVSCacheSize_f -- called when pvs_cachesize changes
+===============
+*/
+static void Mod_PVSCacheSize_f (cvar_t *cvar)
+{
+	Mod_FreePVSCaches (NULL);
+}
+
 /*
 ===============
 Mod_Init
@@ -99,6 +151,8 @@ void Mod_Init (void)
 	Cvar_RegisterVariable (&r_enhancedmodels_prio);
 	Cvar_SetCallback (&r_enhancedmodels, R_ENHANCEDMODELS_f);
 	Cvar_SetCallback (&r_enhancedmodels_prio, R_ENHANCEDMODELS_f);
+	Cvar_RegisterVariable (&pvs_cachesize);
+	Cvar_SetCallback (&pvs_cachesize, Mod_PVSCacheSize_f);
 
 	Cmd_AddCommand ("mcache", Mod_Print);
 
@@ -168,10 +222,13 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model)
 
 /*
 ===================
-Mod_DecompressVis
+Mod_DecompressVisRow
+
+Decompresses a single pvs row into dest, which must hold at least
+(numleafs+7)>>3 bytes
 ===================
 */
-static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+static byte *Mod_DecompressVisRow (byte *in, qmodel_t *model, byte *dest)
 {
 	int		c;
 	byte	*out;
@@ -179,15 +236,8 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 	int		row;
 
 	row = (model->numleafs+7)>>3;
-	if (mod_decompressed == NULL || row > mod_decompressed_capacity)
-	{
-		mod_decompressed_capacity = (row + VIS_ALIGN_MASK) & ~VIS_ALIGN_MASK;
-		mod_decompressed = (byte *) realloc (mod_decompressed, mod_decompressed_capacity);
-		if (!mod_decompressed)
-			Sys_Error ("Mod_DecompressVis: realloc() failed on %d bytes", mod_decompressed_capacity);
-	}
-	out = mod_decompressed;
-	outend = mod_decompressed + row;
+	out = dest;
+	outend = dest + row;
 
 	if (!in)
 	{	// no vis info, so make all visible
@@ -196,7 +246,7 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 			*out++ = 0xff;
 			row--;
 		}
-		return mod_decompressed;
+		return dest;
 	}
 
 	do
@@ -209,8 +259,8 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 
 		c = in[1];
 		in += 2;
-		if (c > row - (out - mod_decompressed))
-			c = row - (out - mod_decompressed);	//now that we're dynamically allocating pvs buffers, we have to be more careful to avoid heap overflows with buggy maps.
+		if (c > row - (out - dest))
+			c = row - (out - dest);	//now that we're dynamically allocating pvs buffers, we have to be more careful to avoid heap overflows with buggy maps.
 		while (c)
 		{
 			if (out == outend)
@@ -219,21 +269,293 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 					model->viswarn = true;
 					Con_Warning("Mod_DecompressVis: output overrun on model \"%s\"\n", model->name);
 				}
-				return mod_decompressed;
+				return dest;
 			}
 			*out++ = 0;
 			c--;
 		}
-	} while (out - mod_decompressed < row);
+	} while (out - dest < row);
 
-	return mod_decompressed;
+	return dest;
+}
+
+/*
+===================
+Mod_DecompressVis
+===================
+*/
+static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+{
+	int		row;
+
+	row = (model->numleafs+7)>>3;
+	if (mod_decompressed == NULL || row > mod_decompressed_capacity)
+	{
+		mod_decompressed_capacity = (row + VIS_ALIGN_MASK) & ~VIS_ALIGN_MASK;
+		mod_decompressed = (byte *) realloc (mod_decompressed, mod_decompressed_capacity);
+		if (!mod_decompressed)
+			Sys_Error ("Mod_DecompressVis: realloc() failed on %d bytes", mod_decompressed_capacity);
+	}
+
+	return Mod_DecompressVisRow (in, model, mod_decompressed);
+}
+
+/*
+===================
+Mod_FreePVSCache
+===================
+*/
+static void Mod_FreePVSCache (pvscache_t *c)
+{
+	free (c->rows);
+	free (c->leafslot);
+	free (c->slots);
+	c->rows = NULL;
+	c->leafslot = NULL;
+	c->slots = NULL;
+	c->model = NULL;
+	c->capacity = 0;
+	c->numrows = 0;
+	c->matrix = false;
+}
+
+/*
+===================
+Mod_FreePVSCaches
+
+Frees the caches bound to model, or all of them if model is NULL
+===================
+*/
+static void Mod_FreePVSCaches (qmodel_t *model)
+{
+	int i;
+
+	for (i = 0; i < MAX_PVSCACHES; i++)
+		if (!model || pvscaches[i].model == model)
+			Mod_FreePVSCache (&pvscaches[i]);
+}
+
+/*
+===================
+Mod_BindPVSCache
+
+Sizes the leaf pvs cache for the given model.
+Returns false if caching is disabled or the allocation failed.
+===================
+*/
+static qboolean Mod_BindPVSCache (pvscache_t *c, qmodel_t *model)
+{
+	size_t	budget, matrix;
+	int		i;
+
+	Mod_FreePVSCache (c);
+
+	if (pvs_cachesize.value <= 0.f || model->numleafs <= 0)
+		return false;
+
+	c->visbytes = (model->numleafs+7)>>3;
+	c->rowbytes = (c->visbytes + VIS_ALIGN_MASK) & ~VIS_ALIGN_MASK;
+
+	budget = (size_t)(pvs_cachesize.value * 1024.0 * 1024.0);
+	matrix = (size_t)model->numleafs * c->rowbytes;
+	if (matrix <= budget)
+	{
+		c->capacity = model->numleafs;
+		c->matrix = true;
+	}
+	else
+	{
+		c->capacity = (int)q_min (budget / c->rowbytes, (size_t)model->numleafs);
+		c->capacity = q_max (c->capacity, q_min (64, model->numleafs));
+	}
+
+	c->rows = (byte *) malloc ((size_t)c->capacity * c->rowbytes);
+	c->leafslot = (int *) malloc (sizeof (int) * (model->numleafs + 1));
+	c->slots = (pvsslot_t *) malloc (sizeof (pvsslot_t) * c->capacity);
+	if (!c->rows || !c->leafslot || !c->slots)
+	{
+		Con_DWarning ("Mod_BindPVSCache: couldn't allocate %d rows of %d bytes\n", c->capacity, c->rowbytes);
+		Mod_FreePVSCache (c);
+		return false;
+	}
+
+	for (i = 0; i <= model->numleafs; i++)
+		c->leafslot[i] = -1;
+	c->head = c->tail = -1;
+	c->model = model;
+
+	return true;
+}
+
+/*
+===================
+Mod_FindPVSCache
+
+Returns the cache bound to model, binding the least recently used one if
+there is none. NULL if caching is disabled or the allocation failed.
+===================
+*/
+static pvscache_t *Mod_FindPVSCache (qmodel_t *model)
+{
+	pvscache_t	*c, *best;
+	int			i;
+
+	pvscache_tick++;
+
+	best = &pvscaches[0];
+	for (i = 0, c = pvscaches; i < MAX_PVSCACHES; i++, c++)
+	{
+		if (c->model == model)
+		{
+			c->lastused = pvscache_tick;
+			return c;
+		}
+		if (c->lastused < best->lastused)
+			best = c;
+	}
+
+	best->lastused = pvscache_tick;
+	if (!Mod_BindPVSCache (best, model))
+		return NULL;
+
+	return best;
+}
+
+/*
+===================
+Mod_UnlinkPVSSlot
+===================
+*/
+static void Mod_UnlinkPVSSlot (pvscache_t *c, int slot)
+{
+	pvsslot_t *s = &c->slots[slot];
+
+	if (s->prev != -1)
+		c->slots[s->prev].next = s->next;
+	else
+		c->head = s->next;
+	if (s->next != -1)
+		c->slots[s->next].prev = s->prev;
+	else
+		c->tail = s->prev;
+}
+
+/*
+===================
+Mod_LinkPVSSlot
+===================
+*/
+static void Mod_LinkPVSSlot (pvscache_t *c, int slot)
+{
+	pvsslot_t *s = &c->slots[slot];
+
+	s->prev = -1;
+	s->next = c->head;
+	if (c->head != -1)
+		c->slots[c->head].prev = slot;
+	else
+		c->tail = slot;
+	c->head = slot;
+}
+
+/*
+===================
+Mod_CachedLeafPVS
+===================
+*/
+static byte *Mod_CachedLeafPVS (mleaf_t *leaf, qmodel_t *model)
+{
+	pvscache_t	*c;
+	int			leafnum, slot;
+	byte		*row;
+
+	c = Mod_FindPVSCache (model);
+	if (!c)
+	{
+		pvscache_misses++;
+		return Mod_DecompressVis (leaf->compressed_vis, model);
+	}
+
+	leafnum = leaf - model->leafs;
+	if ((unsigned)leafnum > (unsigned)model->numleafs)
+	{
+		pvscache_misses++;
+		return Mod_DecompressVis (leaf->compressed_vis, model);
+	}
+
+	slot = c->leafslot[leafnum];
+	if (slot != -1)
+	{
+		pvscache_hits++;
+		if (!c->matrix && slot != c->head)
+		{
+			Mod_UnlinkPVSSlot (c, slot);
+			Mod_LinkPVSSlot (c, slot);
+		}
+		return c->rows + (size_t)slot * c->rowbytes;
+	}
+
+	pvscache_misses++;
+	if (c->numrows < c->capacity)
+		slot = c->numrows++;
+	else
+	{
+		slot = c->tail;
+		Mod_UnlinkPVSSlot (c, slot);
+		c->leafslot[c->slots[slot].leaf] = -1;
+		pvscache_evictions++;
+	}
+	if (!c->matrix)
+		Mod_LinkPVSSlot (c, slot);
+	c->slots[slot].leaf = leafnum;
+	c->leafslot[leafnum] = slot;
+
+	row = c->rows + (size_t)slot * c->rowbytes;
+	Mod_DecompressVisRow (leaf->compressed_vis, model, row);
+	memset (row + c->visbytes, 0, c->rowbytes - c->visbytes);
+
+	return row;
+}
+
+/*
+===================
+Mod_PVSCacheStats
+
+Prints leaf pvs cache usage, optionally resetting the counters
+===================
+*/
+void Mod_PVSCacheStats (qboolean reset)
+{
+	unsigned	total = pvscache_hits + pvscache_misses;
+	pvscache_t	*c;
+	int			i, bound;
+
+	for (i = 0, bound = 0, c = pvscaches; i < MAX_PVSCACHES; i++, c++)
+	{
+		if (!c->model)
+			continue;
+		Con_Printf ("leaf pvs: %s, %d/%d rows of %d bytes (%.1f MB) for %s\n",
+			c->matrix ? "full matrix" : "lru",
+			c->numrows, c->capacity, c->rowbytes,
+			(double)c->capacity * c->rowbytes / (1024.0 * 1024.0),
+			c->model->name);
+		bound++;
+	}
+	if (!bound)
+		Con_Printf ("leaf pvs: cache not bound\n");
+	Con_Printf ("leaf pvs: %u hits, %u misses, %u evictions (%.1f%% hit rate)\n",
+		pvscache_hits, pvscache_misses, pvscache_evictions,
+		total ? 100.0 * pvscache_hits / total : 0.0);
+
+	if (reset)
+		pvscache_hits = pvscache_misses = pvscache_evictions = 0;
 }
 
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
 {
 	if (leaf == model->leafs)
 		return Mod_NoVisPVS (model);
-	return Mod_DecompressVis (leaf->compressed_vis, model);
+	return Mod_CachedLeafPVS (leaf, model);
 }
 
 byte *Mod_NoVisPVS (qmodel_t *model)
@@ -254,6 +576,54 @@ byte *Mod_NoVisPVS (qmodel_t *model)
 	return mod_novis;
 }
 
+/*
+===================
+Mod_SubmodelName
+
+Inline models are normally shared "*1", "*2"... slots refilled by each map.
+Server instances running different maps at once need them kept apart, so
+they are named after their world instead ("maps/e1m1.bsp*1").
+===================
+*/
+static void Mod_SubmodelName (const char *worldname, int num, char *out, size_t size)
+{
+	if (sv_numinstances > 1)
+		q_snprintf (out, size, "%s*%i", worldname, num);
+	else
+		q_snprintf (out, size, "*%i", num);
+}
+
+/*
+===================
+Mod_Unload
+
+Frees a model loaded into an arena, along with the submodels sharing its data
+===================
+*/
+static void Mod_Unload (qmodel_t *mod)
+{
+	char		prefix[MAX_QPATH + 1];
+	size_t		len;
+	int			i;
+	qmodel_t	*sub;
+
+	q_snprintf (prefix, sizeof (prefix), "%s*", mod->name);
+	len = strlen (prefix);
+	for (i = 0, sub = mod_known; i < mod_numknown; i++, sub++)
+	{
+		if (strncmp (sub->name, prefix, len) != 0)
+			continue;
+		TexMgr_FreeTexturesForOwner (sub);
+		memset (sub, 0, sizeof (*sub));		// slot can be reused by Mod_FindName
+	}
+
+	Mod_FreePVSCaches (mod);
+	TexMgr_FreeTexturesForOwner (mod);
+	Hunk_FreeArena (&mod->arena);
+	mod->needload = true;
+	mod->refcount = 0;
+}
+
 /*
 ===================
 Mod_ClearAll
@@ -266,7 +636,10 @@ void Mod_ClearAll (void)
 
 	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
 	{
-		if (mod->type != mod_alias)
+		mod->refcount = 0;
+		if (mod->arena)
+			Mod_Unload (mod);
+		else if (mod->type != mod_alias)
 		{
 			mod->needload = true;
 			TexMgr_FreeTexturesForOwner (mod); //johnfitz
@@ -286,6 +659,8 @@ void Mod_ResetAll (void)
 	{
 		if (!mod->needload) //otherwise Mod_ClearAll() did it already
 			TexMgr_FreeTexturesForOwner (mod);
+		if (mod->arena)
+			Hunk_FreeArena (&mod->arena);
 		memset(mod, 0, sizeof(qmodel_t));
 	}
 	mod_numknown = 0;
@@ -300,7 +675,7 @@ Mod_FindName
 static qmodel_t *Mod_FindName (const char *name)
 {
 	int		i;
-	qmodel_t	*mod;
+	qmodel_t	*mod, *freeslot;
 
 	if (!name[0])
 		Sys_Error ("Mod_FindName: NULL name"); //johnfitz -- was "Mod_ForName"
@@ -308,19 +683,25 @@ static qmodel_t *Mod_FindName (const char *name)
 //
 // search the currently loaded models
 //
+	freeslot = NULL;
 	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
 	{
 		if (!strcmp (mod->name, name) )
 			break;
+		if (!mod->name[0] && !freeslot)
+			freeslot = mod;		// left by Mod_Unload
 	}
 
 	if (i == mod_numknown)
 	{
-		if (mod_numknown == MAX_MOD_KNOWN)
+		if (freeslot)
+			mod = freeslot;
+		else if (mod_numknown == MAX_MOD_KNOWN)
 			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
+		else
+			mod_numknown++;
 		q_strlcpy (mod->name, name, MAX_QPATH);
 		mod->needload = true;
-		mod_numknown++;
 	}
 
 	return mod;
@@ -402,6 +783,14 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 	mod->needload = false;
 
 	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
+
+	// with several server instances, the hunk is only freed once they are
+	// all stopped, so brush models and sprites get memory they can give back
+	// on their own when the last instance using them lets go (alias models
+	// live in the cache)
+	if (sv_numinstances > 1 && mod_type != IDPOLYHEADER)
+		Hunk_BeginArena (&mod->arena);
+
 	switch (mod_type)
 	{
 	case IDPOLYHEADER:
@@ -436,6 +825,8 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 		break;
 	}
 
+	Hunk_EndArena ();
+
 	free (buf);
 
 	return mod;
@@ -457,6 +848,51 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash)
 	return Mod_LoadModel (mod, crash);
 }
 
+/*
+==================
+Mod_ForSubmodel
+
+Returns inline model num of a loaded world
+==================
+*/
+qmodel_t *Mod_ForSubmodel (qmodel_t *world, int num)
+{
+	char	name[MAX_QPATH];
+
+	Mod_SubmodelName (world->name, num, name, sizeof (name));
+
+	return Mod_ForName (name, false);
+}
+
+/*
+==================
+Mod_Reference
+
+Called by every server instance that starts using mod
+==================
+*/
+void Mod_Reference (qmodel_t *mod)
+{
+	if (mod)
+		mod->refcount++;
+}
+
+/*
+==================
+Mod_Release
+
+Undoes Mod_Reference. A model that had its own arena is freed once no
+instance uses it anymore; the others stay until Mod_ClearAll.
+==================
+*/
+void Mod_Release (qmodel_t *mod)
+{
+	if (!mod || mod->refcount <= 0)
+		return;
+	if (--mod->refcount == 0 && mod->arena)
+		Mod_Unload (mod);
+}
+
 
 /*
 ===============================================================================
@@ -1915,6 +2351,37 @@ static void Mod_FindUsedTextures (qmodel_t *mod)
 	//Con_Printf("%s: %d/%d textures\n", mod->name, count, mod->numtextures);
 }
 
+/*
+=================
+Mod_CompileHull
+
+Builds a cache-aligned copy of the hull's clipnodes with their planes inlined
+=================
+*/
+static mhullnode_t *Mod_CompileHull (hull_t *hull, int count)
+{
+	mhullnode_t	*nodes, *out;
+	mclipnode_t	*in;
+	mplane_t	*plane;
+	int			i;
+
+	nodes = (mhullnode_t *) Hunk_AllocNameNoFill (count * sizeof (*nodes) + 31, loadname);
+	nodes = (mhullnode_t *) (((uintptr_t) nodes + 31) & ~(uintptr_t) 31);
+
+	for (i = 0, in = hull->clipnodes, out = nodes; i < count; i++, in++, out++)
+	{
+		plane = hull->planes + in->planenum;
+		VectorCopy (plane->normal, out->normal);
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+		out->pad = 0;
+	}
+
+	return nodes;
+}
+
 /*
 =================
 Mod_LoadClipnodes
@@ -2019,6 +2486,9 @@ static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 			//johnfitz
 		}
 	}
+
+	loadmodel->hulls[1].nodes = Mod_CompileHull (&loadmodel->hulls[1], count);
+	loadmodel->hulls[2].nodes = loadmodel->hulls[1].nodes;
 }
 
 /*
@@ -2058,6 +2528,8 @@ static void Mod_MakeHull0 (void)
 				out->children[j] = child - loadmodel->nodes;
 		}
 	}
+
+	hull->nodes = Mod_CompileHull (hull, count);
 }
 
 /*
@@ -2416,9 +2888,14 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 	dheader_t	*header;
 	dmodel_t 	*bm;
 	float		radius; //johnfitz
+	qmodel_t	*world = mod;
 
 	loadmodel->type = mod_brush;
 
+	// mod_known slots are reused across maps, so cached pvs data for this pointer is stale
+	Mod_FreePVSCaches (mod);
+	mod_pvsgeneration++;
+
 	header = (dheader_t *)buffer;
 
 	mod->bspversion = LittleLong (header->version);
@@ -2460,7 +2937,7 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 	Mod_LoadFaces (&header->lumps[LUMP_FACES], bsp2);
 	Mod_LoadMarksurfaces (&header->lumps[LUMP_MARKSURFACES], bsp2);
 
-	if (mod->bspversion == BSPVERSION && external_vis.value && sv.modelname[0] && !q_strcasecmp(loadname, sv.name))
+	if (mod->bspversion == BSPVERSION && external_vis.value && sv->modelname[0] && !q_strcasecmp(loadname, sv->name))
 	{
 		FILE* fvis;
 		Con_DPrintf("trying to open external vis file\n");
@@ -2535,7 +3012,7 @@ visdone:
 		//johnfitz
 
 		//johnfitz -- correct physics cullboxes so that outlying clip brushes on doors and stuff are handled right
-		if (i > 0 || strcmp(mod->name, sv.modelname) != 0) //skip submodel 0 of sv.worldmodel, which is the actual world
+		if (i > 0 || strcmp(mod->name, sv->modelname) != 0) //skip submodel 0 of sv->worldmodel, which is the actual world
 		{
 			// start with the hull0 bounds
 			VectorCopy (mod->maxs, mod->clipmaxs);
@@ -2555,12 +3032,14 @@ visdone:
 
 		if (i < mod->numsubmodels-1)
 		{	// duplicate the basic information
-			char	name[12];
+			char	name[MAX_QPATH];
 
-			sprintf (name, "*%i", i+1);
+			Mod_SubmodelName (world->name, i+1, name, sizeof (name));
 			loadmodel = Mod_FindName (name);
 			*loadmodel = *mod;
-			strcpy (loadmodel->name, name);
+			q_strlcpy (loadmodel->name, name, sizeof (loadmodel->name));
+			loadmodel->arena = NULL;	// the world owns the data
+			loadmodel->refcount = 0;
 			mod = loadmodel;
 		}
 	}
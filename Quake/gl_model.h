@@ -203,6 +203,17 @@ typedef struct mclipnode_s
 } mclipnode_t;
 //johnfitz
 
+// clipnode with its plane inlined, built at load time for hull tracing
+// (32 bytes, so two nodes share a cache line)
+typedef struct mhullnode_s
+{
+	float		normal[3];
+	float		dist;
+	int			type;		// PLANE_X/Y/Z for axial planes
+	int			children[2];
+	int			pad;
+} mhullnode_t;
+
 // !!! if this is changed, it must be changed in asm_i386.h too !!!
 typedef struct
 {
@@ -212,6 +223,7 @@ typedef struct
 	int			lastclipnode;
 	vec3_t		clip_mins;
 	vec3_t		clip_maxs;
+	mhullnode_t	*nodes;		// compiled copy of clipnodes/planes, same indices
 } hull_t;
 
 /*
@@ -424,6 +436,8 @@ typedef struct qmodel_s
 	unsigned int	path_id;		// path id of the game directory
 							// that this model came from
 	qboolean	needload;		// bmodels and sprites don't cache normally
+	void		**arena;		// hunk arena holding the data, when loaded for a server instance
+	int			refcount;		// server instances using it
 
 	modtype_t	type;
 	int			numframes;
@@ -537,6 +551,9 @@ void	Mod_ResetAll (void); // for gamedir changes (Host_Game_f)
 qmodel_t *Mod_ForName (const char *name, qboolean crash);
 void	*Mod_Extradata (qmodel_t *mod);	// handles caching
 void	Mod_TouchModel (const char *name);
+qmodel_t *Mod_ForSubmodel (qmodel_t *world, int num);
+void	Mod_Reference (qmodel_t *mod);
+void	Mod_Release (qmodel_t *mod);
 
 #define VIS_ALIGN			16						// vis buffer size alignment (in bytes)
 #define VIS_ALIGN_MASK		(VIS_ALIGN - 1)			// alignment - 1, to simplify alignment code
@@ -544,6 +561,9 @@ void	Mod_TouchModel (const char *name);
 mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model);
 byte	*Mod_NoVisPVS (qmodel_t *model);
+void	Mod_PVSCacheStats (qboolean reset);
+
+extern int	mod_pvsgeneration;	// bumped whenever a brush model is (re)loaded
 
 void Mod_SetExtraFlags (qmodel_t *mod);
 size_t Mod_SanitizeMapDescription (char *dst, size_t dstsize, const char *src);
@@ -283,6 +283,18 @@ void GL_CreateFrameBuffers (void)
 		);
 	}
 
+	/* depth pyramid for occlusion culling (half resolution, rounded up to a power of two) */
+	framebufs.hiz.width = Q_nextPow2 ((vid.width + 1) / 2);
+	framebufs.hiz.height = Q_nextPow2 ((vid.height + 1) / 2);
+	framebufs.hiz.levels = Q_log2 (q_max (framebufs.hiz.width, framebufs.hiz.height)) + 1;
+	glGenTextures (1, &framebufs.hiz.tex);
+	GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, framebufs.hiz.tex);
+	GL_ObjectLabelFunc (GL_TEXTURE, framebufs.hiz.tex, -1, "hi-z pyramid");
+	GL_TexStorage2DFunc (GL_TEXTURE_2D, framebufs.hiz.levels, GL_R32F, framebufs.hiz.width, framebufs.hiz.height);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, framebufs.hiz.levels - 1);
+
 	GL_BindFramebufferFunc (GL_FRAMEBUFFER, 0);
 	GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, 0);
 }
@@ -301,6 +313,9 @@ void GL_DeleteFrameBuffers (void)
 	GL_DeleteFramebuffersFunc (1, &framebufs.composite.fbo);
 	GL_BindFramebufferFunc (GL_FRAMEBUFFER, 0);
 
+	R_ClearOcclusion ();
+
+	GL_DeleteNativeTexture (framebufs.hiz.tex);
 	GL_DeleteNativeTexture (framebufs.resolved_scene.color_tex);
 	GL_DeleteNativeTexture (framebufs.oit.revealage_tex);
 	GL_DeleteNativeTexture (framebufs.oit.accum_tex);
@@ -651,6 +666,8 @@ static void R_SortEntities (void)
 			continue;
 		if (ent->model->type == mod_brush && R_CullModelForEntity (ent))
 			continue;
+		if ((ent->model->type == mod_brush || ent->model->type == mod_alias) && R_CullOcclusionEntity (ent))
+			continue;
 		cl_visedicts[j++] = ent;
 	}
 	cl_numvisedicts = j;
@@ -886,7 +903,8 @@ GL_NeedsPostprocess
 */
 qboolean GL_NeedsPostprocess (void)
 {
-	return vid_gamma.value != 1.f || vid_contrast.value != 1.f || softemu || R_GetEffectiveAlphaMode () == ALPHAMODE_OIT;
+	// occlusion culling needs the depth of the opaque pass in a texture
+	return vid_gamma.value != 1.f || vid_contrast.value != 1.f || softemu || R_GetEffectiveAlphaMode () == ALPHAMODE_OIT || r_occlusion.value;
 }
 
 /*
@@ -967,6 +985,7 @@ void R_SetupView (void)
 	R_AnimateLight ();
 
 	r_framecount++;
+	R_UpdateBakedLightmaps ();
 	r_framedata.eyepos[0] = r_refdef.vieworg[0];
 	r_framedata.eyepos[1] = r_refdef.vieworg[1];
 	r_framedata.eyepos[2] = r_refdef.vieworg[2];
@@ -1035,6 +1054,8 @@ void R_SetupView (void)
 
 	R_SetFrustum ();
 
+	R_UpdateOcclusionReadback ();
+
 	R_MarkSurfaces (); //johnfitz -- create texture chains from PVS
 
 	R_SortEntities ();
@@ -1492,7 +1513,7 @@ static void R_ShowBoundingBoxes (void)
 	focused = NULL;
 
 	mode = abs ((int)r_showbboxes.value);
-	if ((!mode && !r_showfields.value) || cl.maxclients > 1 || !r_drawentities.value || !sv.active)
+	if ((!mode && !r_showfields.value) || cl.maxclients > 1 || !r_drawentities.value || !sv->active)
 		return;
 
 	GL_BeginGroup ("Show bounding boxes");
@@ -1501,14 +1522,14 @@ static void R_ShowBoundingBoxes (void)
 
 	oldvm = qcvm;
 	PR_SwitchQCVM(NULL);
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 
 	// Use PVS if r_showbboxes >= 2, or if r_showbboxes is 0 (which means r_showfields is active)
 	if (mode >= 2 || mode == 0)
 	{
 		vec3_t org;
 		VectorAdd (sv_player->v.origin, sv_player->v.view_ofs, org);
-		pvs = SV_FatPVS (org, sv.worldmodel);
+		pvs = SV_FatPVS (org, sv->worldmodel);
 	}
 	else
 		pvs = NULL;
@@ -1552,7 +1573,7 @@ static void R_ShowBoundingBoxes (void)
 			qboolean inpvs =
 				ed->num_leafs ?
 					SV_EdictInPVS (ed, pvs) :
-					SV_BoxInPVS (ed->v.absmin, ed->v.absmax, pvs, sv.worldmodel->nodes)
+					SV_BoxInPVS (ed->v.absmin, ed->v.absmax, pvs, sv->worldmodel->nodes)
 			;
 			if (!inpvs)
 				continue;
@@ -1647,9 +1668,9 @@ static void R_ShowBoundingBoxes (void)
 		{
 			int modelindex = (int)ed->v.modelindex;
 			color = 0x7f800080;
-			if (modelindex >= 0 && modelindex < MAX_MODELS && sv.models[modelindex])
+			if (modelindex >= 0 && modelindex < MAX_MODELS && sv->models[modelindex])
 			{
-				switch (sv.models[modelindex]->type)
+				switch (sv->models[modelindex]->type)
 				{
 					case mod_brush:  color = 0x7fff8080; break;
 					case mod_alias:  color = 0x7f408080; break;
@@ -1930,6 +1951,8 @@ void R_RenderScene (void)
 
 	R_DrawWater (false);
 
+	R_BuildOcclusionPyramid ();
+
 	R_BeginTranslucency ();
 
 	R_DrawWater (true);
@@ -2088,6 +2111,12 @@ void R_RenderView (void)
 					rs_brushpolys,
 					rs_aliaspolys,
 					rs_dynamiclightmaps);
+	if (r_speeds.value && r_occlusion.value)
+		Con_Printf ("%4i/%4i occluded wsurf %3i/%3i occluded ent\n",
+					rs_occlusion_surfs_culled,
+					rs_occlusion_surfs,
+					rs_occlusion_ents_culled,
+					rs_occlusion_ents);
 	//johnfitz
 }
 
@@ -119,10 +119,10 @@ static void R_ShowbboxesFilter_Completion_f (const char *partial)
 	edict_t	*ed;
 	int		i;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
-	PR_PushQCVM (&sv.qcvm, &oldvm);
+	PR_PushQCVM (&sv->qcvm, &oldvm);
 
 	if (*partial == '#')
 	{
@@ -359,6 +359,8 @@ void R_Init (void)
 	Cvar_SetCallback (&r_lavaalpha, R_SetLavaalpha_f);
 	Cvar_SetCallback (&r_telealpha, R_SetTelealpha_f);
 	Cvar_SetCallback (&r_slimealpha, R_SetSlimealpha_f);
+	Cvar_RegisterVariable (&r_occlusion);
+	Cvar_RegisterVariable (&r_lightmapcache);
 
 	R_InitParticles ();
 	R_SetClearColor_f (&r_clearcolor); //johnfitz
@@ -526,6 +528,7 @@ void R_NewMap (void)
 
 	r_framecount = 0; //johnfitz -- paranoid?
 	r_visframecount = 0; //johnfitz -- paranoid?
+	R_ClearOcclusion ();
 
 	Sky_NewMap (); //johnfitz -- skybox in worldspawn
 	Fog_NewMap (); //johnfitz -- global fog in worldspawn
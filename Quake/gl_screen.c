@@ -110,6 +110,7 @@ cvar_t		scr_zoomspeed = {"zoom_speed","8",CVAR_ARCHIVE};
 cvar_t		scr_conspeed = {"scr_conspeed","2000",CVAR_ARCHIVE};
 cvar_t		scr_centertime = {"scr_centertime","2",CVAR_NONE};
 cvar_t		scr_showturtle = {"showturtle","0",CVAR_NONE};
+cvar_t		scr_netgraph = {"scr_netgraph","0",CVAR_NONE};
 cvar_t		scr_showpause = {"showpause","1",CVAR_NONE};
 cvar_t		scr_printspeed = {"scr_printspeed","8",CVAR_NONE};
 cvar_t		gl_triplebuffer = {"gl_triplebuffer", "1", CVAR_ARCHIVE};
@@ -684,6 +685,7 @@ void SCR_Init (void)
 	Cvar_RegisterVariable (&scr_viewsize);
 	Cvar_RegisterVariable (&scr_conspeed);
 	Cvar_RegisterVariable (&scr_showturtle);
+	Cvar_RegisterVariable (&scr_netgraph);
 	Cvar_RegisterVariable (&scr_showpause);
 	Cvar_RegisterVariable (&scr_centertime);
 	Cvar_RegisterVariable (&scr_printspeed);
@@ -1102,6 +1104,65 @@ static void SCR_DrawNet (void)
 	Draw_Pic (scr_vrect.x+64, scr_vrect.y, scr_net);
 }
 
+/*
+==============
+SCR_DrawNetGraph
+
+One stacked bar per server tick received, split by message category
+and scaled so that the full height is the datagram MTU
+==============
+*/
+#define NETGRAPH_WIDTH		128
+#define NETGRAPH_HEIGHT		56
+
+static void SCR_DrawNetGraph (void)
+{
+	static const byte colors[NETCAT_COUNT] = {212, 8, 196, 228, 148, 52, 100};
+	netsample_t	*s;
+	int			i, cat, x, y, h, top, mtu, bytes;
+	char		str[32];
+
+	if (!scr_netgraph.value || cls.state != ca_connected)
+		return;
+
+	GL_SetCanvas (CANVAS_BOTTOMLEFT);
+
+	x = 0;
+	y = 200 - NETGRAPH_HEIGHT - (devstats.value ? 10*8 : 0);
+	Draw_Fill (x, y - 8, NETGRAPH_WIDTH + 12*8, NETGRAPH_HEIGHT + 8, 0, 0.5); //dark rectangle
+
+	for (i = 0, bytes = 0; i < NETGRAPH_WIDTH; i++)
+	{
+		s = NetStats_Sample (&cl_netstats, i);
+		if (!s)
+			break;
+		mtu = s->mtu ? s->mtu : DATAGRAM_MTU;
+		top = y + NETGRAPH_HEIGHT;
+		for (cat = 0; cat < NETCAT_COUNT; cat++)
+		{
+			if (realtime - s->time < 1.0)
+				bytes += s->bytes[cat];
+			h = q_min (s->bytes[cat] * NETGRAPH_HEIGHT / mtu, top - y);
+			if (h <= 0)
+				continue;
+			top -= h;
+			Draw_Fill (x + NETGRAPH_WIDTH - 1 - i, top, 1, h, colors[cat], 1);
+		}
+		if (s->resends)
+			Draw_Fill (x + NETGRAPH_WIDTH - 1 - i, y, 1, 2, 73, 1);
+	}
+
+	s = NetStats_Current (&cl_netstats);
+	q_snprintf (str, sizeof (str), "%5.1fk/s %3ims", bytes / 1024.f, s ? (int)(s->rtt * 1000.f) : 0);
+	Draw_String (x, y - 8, str);
+
+	for (cat = 0; cat < NETCAT_COUNT; cat++)
+	{
+		Draw_Fill (x + NETGRAPH_WIDTH + 8, y + cat*8 + 1, 6, 6, colors[cat], 1);
+		Draw_String (x + NETGRAPH_WIDTH + 16, y + cat*8, netcategory_names[cat]);
+	}
+}
+
 /*
 ==============
 DrawPause
@@ -1417,7 +1478,7 @@ static void SCR_DrawEdictInfo (void)
 	if (VEC_SIZE (bbox_linked) == 0)
 		return;
 
-	PR_SwitchQCVM (&sv.qcvm);
+	PR_SwitchQCVM (&sv->qcvm);
 
 	SCR_GetEntityCenter (bbox_linked[0], focus);
 	SCR_ClipToFrustum (focus, crosshair);
@@ -2186,11 +2247,13 @@ void SCR_UpdateScreen (void)
 	{
 		SCR_DrawCrosshair (); //johnfitz
 		SCR_DrawNet ();
+		SCR_DrawNetGraph ();
 		SCR_DrawTurtle ();
 		SCR_DrawPause ();
 		SCR_CheckDrawCenterString ();
 		Sbar_Draw ();
 		SCR_DrawDevStats (); //johnfitz
+		Prof_Draw ();
 		SCR_DrawClock (); //johnfitz
 		SCR_DrawDemoControls ();
 		SCR_DrawSpeed ();
@@ -292,6 +292,7 @@ NOISE_FUNCTIONS
 "	float	ZLogScale;\n"\
 "	float	ZLogBias;\n"\
 "	uint	NumLights;\n"\
+"	float	BakedLightScale;\n"\
 "};\n"\
 "\n"\
 "vec3 ApplyFog(vec3 clr, vec3 p)\n"\
@@ -544,6 +545,8 @@ WORLD_VERTEX_BUFFER
 "			GetLightStyle(in_styles.z),\n"
 "			GetLightStyle(in_styles.w)\n"
 "		);\n"
+"	if (BakedLightScale > 0. && in_styles.x != 255) // styles already composited into the lightmap\n"
+"		out_styles.xy = vec2(BakedLightScale, -1.);\n"
 "	if ((call.flags & CF_NOLIGHTMAP) != 0u)\n"
 "		out_styles.xy = vec2(1., -1.);\n"
 "	out_lmofs = in_lmofs;\n"
@@ -1044,7 +1047,7 @@ NOISE_FUNCTIONS
 "	int		Pose1;\n"\
 "	int		Pose2;\n"\
 "	float	Blend;\n"\
-"	int		Padding;\n"\
+"	int		Palette;\n"\
 "};\n"\
 "\n"\
 "layout(std430, binding=1) restrict readonly buffer InstanceBuffer\n"\
@@ -1143,8 +1146,13 @@ ALIAS_INSTANCE_BUFFER
 "{\n"
 "	InstanceData inst = instances[gl_InstanceID];\n"
 "	out_texcoord = in_uv;\n"
+"#if POSEVERTTYPE == 1 // PV_IQM: bones already blended by the skinning pass\n"
+"	PoseVertex pose1 = GetPoseVertex(inst.Palette);\n"
+"	PoseVertex pose2 = pose1;\n"
+"#else\n"
 "	PoseVertex pose1 = GetPoseVertex(inst.Pose1);\n"
 "	PoseVertex pose2 = GetPoseVertex(inst.Pose2);\n"
+"#endif\n"
 "	mat4x3 worldmatrix = transpose(mat3x4(inst.WorldMatrix[0], inst.WorldMatrix[1], inst.WorldMatrix[2]));\n"
 "	vec3 lerpedVert = (worldmatrix * vec4(mix(pose1.pos, pose2.pos, inst.Blend), 1.0)).xyz;\n"
 "	gl_Position = ViewProj * vec4(lerpedVert, 1.0);\n"
@@ -1223,6 +1231,37 @@ OIT_OUTPUT (out_fragcolor)
 "#endif\n"
 "}\n";
 
+////////////////////////////////////////////////////////////////
+
+static const char alias_skin_compute_shader[] =
+ALIAS_INSTANCE_BUFFER
+"\n"
+"layout(local_size_x=64) in;\n"
+"\n"
+"layout(std430, binding=2) restrict readonly buffer PoseBuffer\n"
+"{\n"
+"	mat3x4 BonePoses[];\n"
+"};\n"
+"\n"
+"layout(std430, binding=3) restrict writeonly buffer PaletteBuffer\n"
+"{\n"
+"	mat3x4 Palette[];\n"
+"};\n"
+"\n"
+"layout(location=0) uniform int NumBones;\n"
+"\n"
+"void main()\n"
+"{\n"
+"	int thread_id = int(gl_GlobalInvocationID.x);\n"
+"	if (thread_id >= Palette.length())\n"
+"		return;\n"
+"	int bone = thread_id % NumBones;\n"
+"	InstanceData inst = instances[thread_id / NumBones];\n"
+"	Palette[inst.Palette + bone] =\n"
+"		BonePoses[inst.Pose1 + bone] * (1.0 - inst.Blend) +\n"
+"		BonePoses[inst.Pose2 + bone] * inst.Blend;\n"
+"}\n";
+
 ////////////////////////////////////////////////////////////////
 //
 // Sprites
@@ -1600,8 +1639,58 @@ DRAW_ELEMENTS_INDIRECT_COMMAND
 "	vec3	vieworg;\n"
 "	uint	oldskyleaf;\n"
 "	uint	framecount;\n"
+"	mat4	hiz_viewproj;\n"
+"	vec4	hiz_params; // x = box expansion\n"
+"	ivec4	hiz_size; // xy = viewport size, z = levels (0 = disabled), w = reversed z\n"
 "};\n"
 "\n"
+"layout(binding=0) uniform sampler2D HiZ;\n"
+"\n"
+"layout(std430, binding=6) restrict buffer OcclusionCounters\n"
+"{\n"
+"	uint	num_tested;\n"
+"	uint	num_occluded;\n"
+"};\n"
+"\n"
+"// Tests the box against the depth pyramid built at the end of the previous frame\n"
+"bool IsOccluded(vec3 mins, vec3 maxs)\n"
+"{\n"
+"	mins -= hiz_params.x;\n"
+"	maxs += hiz_params.x;\n"
+"\n"
+"	vec3 ndcmin = vec3(1e30);\n"
+"	vec3 ndcmax = vec3(-1e30);\n"
+"	for (int i = 0; i < 8; i++)\n"
+"	{\n"
+"		vec3 p = vec3((i & 1) != 0 ? maxs.x : mins.x, (i & 2) != 0 ? maxs.y : mins.y, (i & 4) != 0 ? maxs.z : mins.z);\n"
+"		vec4 clip = hiz_viewproj * vec4(p, 1.0);\n"
+"		if (clip.w < 1.0)\n"
+"			return false; // crosses the near plane\n"
+"		vec3 ndc = clip.xyz / clip.w;\n"
+"		ndcmin = min(ndcmin, ndc);\n"
+"		ndcmax = max(ndcmax, ndc);\n"
+"	}\n"
+"	if (any(lessThan(ndcmin.xy, vec2(-1.0))) || any(greaterThan(ndcmax.xy, vec2(1.0))))\n"
+"		return false;\n"
+"\n"
+"	float nearest = hiz_size.w != 0 ? 1.0 - ndcmax.z : ndcmin.z * 0.5 + 0.5;\n"
+"	ivec2 p0 = clamp(ivec2((ndcmin.xy * 0.5 + 0.5) * vec2(hiz_size.xy)), ivec2(0), hiz_size.xy - 1);\n"
+"	ivec2 p1 = clamp(ivec2((ndcmax.xy * 0.5 + 0.5) * vec2(hiz_size.xy)), ivec2(0), hiz_size.xy - 1);\n"
+"\n"
+"	// pick the level where the box covers at most 2x2 texels\n"
+"	int extent = max(p1.x - p0.x, p1.y - p0.y) + 1;\n"
+"	int level = clamp(findMSB(extent - 1), 0, hiz_size.z - 1);\n"
+"	p0 >>= level + 1;\n"
+"	p1 >>= level + 1;\n"
+"\n"
+"	float farthest = 0.0;\n"
+"	for (int y = p0.y; y <= p1.y; y++)\n"
+"		for (int x = p0.x; x <= p1.x; x++)\n"
+"			farthest = max(farthest, texelFetch(HiZ, ivec2(x, y), level).r);\n"
+"\n"
+"	return nearest > farthest;\n"
+"}\n"
+"\n"
 "void main()\n"
 "{\n"
 "	uint thread_id = gl_GlobalInvocationID.x;\n"
@@ -1645,6 +1734,17 @@ DRAW_ELEMENTS_INDIRECT_COMMAND
 "	if (atomicExchange(SURF_FRAMECOUNT(surfbase), framecount) == framecount)\n"
 "		return;\n"
 "\n"
+"	// occlusion culling\n"
+"	if (hiz_size.z != 0)\n"
+"	{\n"
+"		atomicAdd(num_tested, 1u);\n"
+"		if (IsOccluded(mins, maxs))\n"
+"		{\n"
+"			atomicAdd(num_occluded, 1u);\n"
+"			return;\n"
+"		}\n"
+"	}\n"
+"\n"
 "	// surface is visible, append its triangles to the index buffer\n"
 "	// and update the draw command corresponding to its texture number\n"
 "	uint texnum = SURF_TEXNUM(surfbase);\n"
@@ -1662,6 +1762,78 @@ DRAW_ELEMENTS_INDIRECT_COMMAND
 "	}\n"
 "}\n";
 
+////////////////////////////////////////////////////////////////
+//
+// Hi-Z pyramid: first level (max of 2x2 depth texels/samples)
+//
+////////////////////////////////////////////////////////////////
+
+static const char hiz_init_compute_shader[] =
+"layout(local_size_x=8, local_size_y=8) in;\n"
+"\n"
+"#if MSAA\n"
+"	layout(binding=0) uniform sampler2DMS Depth;\n"
+"	#define FetchDepth(c, s)	texelFetch(Depth, c, s).r\n"
+"#else\n"
+"	layout(binding=0) uniform sampler2D Depth;\n"
+"	#define FetchDepth(c, s)	texelFetch(Depth, c, 0).r\n"
+"#endif\n"
+"\n"
+"layout(r32f, binding=1) uniform writeonly image2D HiZ;\n"
+"\n"
+"layout(location=0) uniform ivec4 Viewport;\n"
+"layout(location=1) uniform ivec2 Params; // x = reversed z, y = samples\n"
+"\n"
+"void main()\n"
+"{\n"
+"	ivec2 dst = ivec2(gl_GlobalInvocationID.xy);\n"
+"	if (any(greaterThanEqual(dst, (Viewport.zw + 1) >> 1)))\n"
+"		return;\n"
+"\n"
+"	float farthest = 0.0;\n"
+"	for (int i = 0; i < 4; i++)\n"
+"	{\n"
+"		ivec2 src = min(dst * 2 + ivec2(i & 1, i >> 1), Viewport.zw - 1) + Viewport.xy;\n"
+"		for (int s = 0; s < Params.y; s++)\n"
+"		{\n"
+"			float depth = FetchDepth(src, s);\n"
+"			farthest = max(farthest, Params.x != 0 ? 1.0 - depth : depth);\n"
+"		}\n"
+"	}\n"
+"\n"
+"	imageStore(HiZ, dst, vec4(farthest));\n"
+"}\n";
+
+////////////////////////////////////////////////////////////////
+//
+// Hi-Z pyramid: downsampling
+//
+////////////////////////////////////////////////////////////////
+
+static const char hiz_reduce_compute_shader[] =
+"layout(local_size_x=8, local_size_y=8) in;\n"
+"\n"
+"layout(r32f, binding=1) uniform readonly image2D Src;\n"
+"layout(r32f, binding=2) uniform writeonly image2D Dst;\n"
+"\n"
+"layout(location=0) uniform ivec2 SrcSize;\n"
+"\n"
+"void main()\n"
+"{\n"
+"	ivec2 dst = ivec2(gl_GlobalInvocationID.xy);\n"
+"	if (any(greaterThanEqual(dst, (SrcSize + 1) >> 1)))\n"
+"		return;\n"
+"\n"
+"	float farthest = 0.0;\n"
+"	for (int i = 0; i < 4; i++)\n"
+"	{\n"
+"		ivec2 src = min(dst * 2 + ivec2(i & 1, i >> 1), SrcSize - 1);\n"
+"		farthest = max(farthest, imageLoad(Src, src).r);\n"
+"	}\n"
+"\n"
+"	imageStore(Dst, dst, vec4(farthest));\n"
+"}\n";
+
 ////////////////////////////////////////////////////////////////
 //
 // Light clustering
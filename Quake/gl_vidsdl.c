@@ -905,6 +905,7 @@ void GL_BeginGroup (const char *name)
 {
 	if (glmarkers)
 		GL_PushDebugGroupFunc (GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+	Prof_BeginGPUZone (name);
 }
 
 /*
@@ -914,6 +915,7 @@ GL_EndGroup
 */
 void GL_EndGroup (void)
 {
+	Prof_EndGPUZone ();
 	if (glmarkers)
 		GL_PopDebugGroupFunc ();
 }
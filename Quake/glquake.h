@@ -172,6 +172,8 @@ extern	const char	*gl_version;
 	x(GLint,		GetUniformLocation, (GLuint program, const GLchar *name))\
 	x(void,			GetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name))\
 	x(void,			Uniform1i, (GLint location, GLint v0))\
+	x(void,			Uniform2i, (GLint location, GLint v0, GLint v1))\
+	x(void,			Uniform4i, (GLint location, GLint v0, GLint v1, GLint v2, GLint v3))\
 	x(void,			Uniform1f, (GLint location, GLfloat v0))\
 	x(void,			Uniform2f, (GLint location, GLfloat v0, GLfloat v1))\
 	x(void,			Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2))\
@@ -433,7 +435,7 @@ typedef struct gpuframedata_s {
 	float	zlogscale;
 	float	zlogbias;
 	int		numlights;
-	int		_padding2;
+	float	bakedlightscale;	// 0 = lightstyles applied per-pixel, otherwise see R_UpdateBakedLightmaps
 } gpuframedata_t;
 
 extern gpulightbuffer_t r_lightbuffer;
@@ -443,6 +445,7 @@ void R_AnimateLight (void);
 void R_MarkSurfaces (void);
 qboolean R_CullBox (vec3_t emins, vec3_t emaxs);
 qboolean R_CullModelForEntity (entity_t *e);
+void R_GetEntityBounds (const entity_t *e, vec3_t mins, vec3_t maxs);
 void R_EntityMatrix (float matrix[16], vec3_t origin, vec3_t angles, unsigned char scale);
 
 void R_InitParticles (void);
@@ -508,7 +511,27 @@ typedef struct bmodel_gpu_surf_s {
 	GLuint		padding1;
 } bmodel_gpu_surf_t;
 
+typedef struct gpu_hizcull_s {
+	float		viewproj[16];	// view the pyramid was built with
+	float		margin;			// box expansion, in world units
+	float		padding[3];
+	GLint		size[4];		// viewport width, height, levels (0 = disabled), reversed Z
+} gpu_hizcull_t;
+
+extern cvar_t r_occlusion;
+extern cvar_t r_lightmapcache;
+extern int rs_occlusion_surfs, rs_occlusion_surfs_culled;
+extern int rs_occlusion_ents, rs_occlusion_ents_culled;
+
+void R_ClearOcclusion (void);
+void R_UpdateOcclusionReadback (void);
+void R_SetupOcclusionCull (gpu_hizcull_t *cull);
+void R_BuildOcclusionPyramid (void);
+qboolean R_CullOcclusionEntity (entity_t *e);
+
 void GL_BuildLightmaps (void);
+void R_UpdateBakedLightmaps (void);
+gltexture_t *R_GetLightmapTexture (void);
 
 void GL_DeleteBModelBuffers (void);
 void GL_BuildBModelVertexBuffer (void);
@@ -543,6 +566,7 @@ typedef struct glprogs_s {
 	GLuint		skycubemap[2][2];	// [anim][dither]
 	GLuint		skyboxside[2];		// [dither]
 	GLuint		alias[2][3][2][3];	// [OIT][mode:standard/dithered/noperspective][alpha test][poseverttype]
+	GLuint		alias_skin;
 	GLuint		sprites[2];			// [dither]
 	GLuint		particles[2][2];	// [OIT][dither]
 	GLuint		debug3d;
@@ -552,6 +576,8 @@ typedef struct glprogs_s {
 	GLuint		gather_indirect;
 	GLuint		cull_mark;
 	GLuint		cluster_lights;
+	GLuint		hiz_init[2];		// [msaa]
+	GLuint		hiz_reduce;
 	GLuint		palette_init[3];	// [metric:naive/riemersma/oklab]
 	GLuint		palette_postprocess;
 } glprogs_t;
@@ -597,6 +623,13 @@ typedef struct glframebufs_s {
 		GLuint		fbo_scene;
 		GLuint		fbo_composite;
 	}				oit;
+
+	struct {
+		GLuint		tex;			// R32F max-depth pyramid, half resolution
+		GLint		width;			// level 0 size (power of two)
+		GLint		height;
+		GLint		levels;
+	}				hiz;
 } glframebufs_t;
 
 extern glframebufs_t framebufs;
@@ -63,10 +63,11 @@ cvar_t	host_framerate = {"host_framerate","0",CVAR_NONE};	// set for slow motion
 cvar_t	host_speeds = {"host_speeds","0",CVAR_NONE};			// set for running times
 cvar_t	host_maxfps = {"host_maxfps", "250", CVAR_ARCHIVE}; //johnfitz
 cvar_t	host_timescale = {"host_timescale", "0", CVAR_NONE}; //johnfitz
-cvar_t	max_edicts = {"max_edicts", "16384", CVAR_NONE}; //johnfitz //ericw -- changed from 2048 to 8192, removed CVAR_ARCHIVE
+cvar_t	max_edicts = {"max_edicts", "32000", CVAR_NONE}; //johnfitz //ericw -- changed from 2048 to 8192, removed CVAR_ARCHIVE (memory is only committed as edicts get used)
 cvar_t	cl_nocsqc = {"cl_nocsqc", "0", CVAR_NONE};	//spike -- blocks the loading of any csqc modules
 
 cvar_t	sys_ticrate = {"sys_ticrate","0.05",CVAR_NONE}; // dedicated server
+cvar_t	sys_idlewait = {"sys_idlewait","1",CVAR_NONE}; // dedicated server: max seconds to sleep with no clients, 0 = keep ticking
 cvar_t	serverprofile = {"serverprofile","0",CVAR_NONE};
 
 cvar_t	fraglimit = {"fraglimit","0",CVAR_NOTIFY|CVAR_SERVERINFO};
@@ -106,7 +107,7 @@ Max_Edicts_f -- johnfitz
 static void Max_Edicts_f (cvar_t *var)
 {
 	//TODO: clamp it here?
-	if (cls.state == ca_connected || sv.active)
+	if (cls.state == ca_connected || sv->active)
 		Con_Printf ("Changes to max_edicts will not take effect until the next time a map is loaded.\n");
 }
 
@@ -166,7 +167,7 @@ void Host_EndGame (const char *message, ...)
 
 	PR_SwitchQCVM(NULL);
 
-	if (sv.active)
+	if (sv->active)
 		Host_ShutdownServer (false);
 
 	if (cls.state == ca_dedicated)
@@ -198,6 +199,7 @@ void Host_ReportError (const char *error, ...)
 	inerror = true;
 
 	PR_SwitchQCVM(NULL);
+	Hunk_EndArena ();				// in case it came from inside a model load
 
 	SCR_EndLoadingPlaque ();		// reenable screen updates
 
@@ -206,11 +208,16 @@ void Host_ReportError (const char *error, ...)
 	va_end (argptr);
 	Con_Printf ("Host_Error: %s\n",string);
 
-	if (sv.active)
+	if (sv->active)
 		Host_ShutdownServer (false);
 
 	if (cls.state == ca_dedicated)
-		Sys_Error ("Host_Error: %s\n",string);	// dedicated servers exit
+	{
+		if (sv_numinstances == 1)
+			Sys_Error ("Host_Error: %s\n",string);	// dedicated servers exit
+		inerror = false;
+		longjmp (host_abortserver, 1);	// keep the other instances running
+	}
 
 	CL_Disconnect ();
 	cls.demonum = -1;
@@ -266,6 +273,8 @@ void	Host_FindMaxClients (void)
 		svs.maxclientslimit = 4;
 	svs.clients = (struct client_s *) Hunk_AllocName (svs.maxclientslimit*sizeof(client_t), "clients");
 
+	SV_InitInstances ();
+
 	if (svs.maxclients > 1)
 		Cvar_SetQuick (&deathmatch, "1");
 	else
@@ -291,7 +300,7 @@ void Host_Version_f (void)
 /* cvar callback functions : */
 void Host_Callback_Notify (cvar_t *var)
 {
-	if (sv.active)
+	if (sv->active)
 		SV_BroadcastPrintf ("\"%s\" changed to \"%s\"\n", var->name, var->string);
 }
 
@@ -377,6 +386,7 @@ void Host_InitLocal (void)
 	Cvar_RegisterVariable (&cl_titlestats);
 
 	Cvar_RegisterVariable (&sys_ticrate);
+	Cvar_RegisterVariable (&sys_idlewait);
 	Cvar_RegisterVariable (&serverprofile);
 
 	Cvar_RegisterVariable (&fraglimit);
@@ -439,6 +449,7 @@ void SV_ClientPrintf (const char *fmt, ...)
 
 	MSG_WriteByte (&host_client->message, svc_print);
 	MSG_WriteString (&host_client->message, string);
+	NetStats_Queue (&host_client->netstats, NETCAT_PRINT, strlen (string) + 2);
 }
 
 /*
@@ -464,6 +475,7 @@ void SV_BroadcastPrintf (const char *fmt, ...)
 		{
 			MSG_WriteByte (&svs.clients[i].message, svc_print);
 			MSG_WriteString (&svs.clients[i].message, string);
+			NetStats_Queue (&svs.clients[i].netstats, NETCAT_PRINT, strlen (string) + 2);
 		}
 	}
 }
@@ -486,6 +498,7 @@ void Host_ClientCommands (const char *fmt, ...)
 
 	MSG_WriteByte (&host_client->message, svc_stufftext);
 	MSG_WriteString (&host_client->message, string);
+	NetStats_Queue (&host_client->netstats, NETCAT_STUFFCMD, strlen (string) + 2);
 }
 
 /*
@@ -517,7 +530,7 @@ void SV_DropClient (qboolean crash)
 		// this will set the body to a dead frame, among other things
 			qcvm_t *oldvm = qcvm;
 			PR_SwitchQCVM(NULL);
-			PR_SwitchQCVM(&sv.qcvm);
+			PR_SwitchQCVM(&sv->qcvm);
 			saveSelf = pr_global_struct->self;
 			pr_global_struct->self = EDICT_TO_PROG(host_client->edict);
 			PR_ExecuteProgram (pr_global_struct->ClientDisconnect);
@@ -537,6 +550,10 @@ void SV_DropClient (qboolean crash)
 	host_client->active = false;
 	host_client->name[0] = 0;
 	host_client->old_frags = -999999;
+	host_client->entkeep = false;
+	free (host_client->entages);
+	host_client->entages = NULL;
+	host_client->numentages = 0;
 	net_activeconnections--;
 
 // send notification to all clients
@@ -571,10 +588,10 @@ void Host_ShutdownServer(qboolean crash)
 	byte		message[4];
 	double	start;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
-	sv.active = false;
+	sv->active = false;
 
 // stop all client sounds immediately
 	if (cls.state == ca_connected)
@@ -615,7 +632,7 @@ void Host_ShutdownServer(qboolean crash)
 	if (count)
 		Con_Printf("Host_ShutdownServer: NET_SendToAll failed for %u clients\n", count);
 
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++)
 		if (host_client->active)
 			SV_DropClient(crash);
@@ -625,7 +642,7 @@ void Host_ShutdownServer(qboolean crash)
 //
 // clear structures
 //
-//	memset (&sv, 0, sizeof(sv)); // ServerSpawn already do this by Host_ClearMemory
+//	memset (sv, 0, sizeof(*sv)); // ServerSpawn already do this by Host_ClearMemory
 	memset (svs.clients, 0, svs.maxclientslimit*sizeof(client_t));
 }
 
@@ -636,10 +653,21 @@ Host_ClearMemory
 
 This clears all the memory used by both the client and server, but does
 not reinitialize anything.
+
+While other server instances are running, the hunk still holds the models
+and progs they use, so only this instance's own state is released; the
+hunk is reclaimed by whichever instance changes level last.
 ================
 */
 void Host_ClearMemory (void)
 {
+	if (SV_OtherInstancesActive ())
+	{
+		SV_ClearInstance ();
+		return;
+	}
+	SV_ClearIdleInstances ();
+
 	R_ClearBoundingBoxes ();
 
 	if (cl.qcvm.extfuncs.CSQC_Shutdown)
@@ -653,12 +681,12 @@ void Host_ClearMemory (void)
 	Con_DPrintf ("Clearing memory\n");
 	Mod_ClearAll ();
 	Sky_ClearAll();
-	PR_ClearProgs(&sv.qcvm);
+	PR_ClearProgs(&sv->qcvm);
 	PR_ClearProgs(&cl.qcvm);
 /* host_hunklevel MUST be set at this point */
 	Hunk_FreeToLowMark (host_hunklevel);
 	cls.signon = 0; // not CL_ClearSignons()
-	memset (&sv, 0, sizeof(sv));
+	memset (sv, 0, sizeof(*sv));
 
 	CL_FreeState ();
 }
@@ -859,41 +887,41 @@ static void Host_CheckAutosave (void)
 	if (cls.signon == SIGNONS)
 	{
 		// Track new secrets
-		if (pr_global_struct->found_secrets != sv.autosave.prev_secrets)
+		if (pr_global_struct->found_secrets != sv->autosave.prev_secrets)
 		{
-			sv.autosave.prev_secrets = pr_global_struct->found_secrets;
-			sv.autosave.secret_boost = 1.f;
+			sv->autosave.prev_secrets = pr_global_struct->found_secrets;
+			sv->autosave.secret_boost = 1.f;
 		}
 		else
-			sv.autosave.secret_boost = q_max (0.f, sv.autosave.secret_boost - host_frametime / 1.5f);
+			sv->autosave.secret_boost = q_max (0.f, sv->autosave.secret_boost - host_frametime / 1.5f);
 	}
 
 	// Track health changes
-	if (!sv.autosave.prev_health)
-		sv.autosave.prev_health = sv_player->v.health;
-	health_change = sv_player->v.health - sv.autosave.prev_health;
+	if (!sv->autosave.prev_health)
+		sv->autosave.prev_health = sv_player->v.health;
+	health_change = sv_player->v.health - sv->autosave.prev_health;
 	if (health_change < 0.f)
 		if (health_change < -3.f || sv_player->v.health < 100.f || sv_player->v.watertype == CONTENTS_SLIME || sv_player->v.watertype == CONTENTS_LAVA)
-			sv.autosave.hurt_time = qcvm->time;
-	sv.autosave.prev_health = sv_player->v.health;
+			sv->autosave.hurt_time = qcvm->time;
+	sv->autosave.prev_health = sv_player->v.health;
 
 	// Track attacking
 	if (sv_player->v.button0)
-		sv.autosave.shoot_time = qcvm->time;
+		sv->autosave.shoot_time = qcvm->time;
 
 	// Time spent with cheats active doesn't count
 	if (sv_player->v.movetype == MOVETYPE_NOCLIP || (int)sv_player->v.flags & (FL_GODMODE|FL_NOTARGET))
 	{
-		sv.autosave.cheat += host_frametime;
+		sv->autosave.cheat += host_frametime;
 		return;
 	}
 
 	// Don't save if the player has been hurt recently
-	if (qcvm->time - sv.autosave.hurt_time < 3.f)
+	if (qcvm->time - sv->autosave.hurt_time < 3.f)
 		return;
 
 	// Don't save if the player has fired recently
-	if (qcvm->time - sv.autosave.shoot_time < 3.f)
+	if (qcvm->time - sv->autosave.shoot_time < 3.f)
 		return;
 
 	// Only save when the player slows down a bit
@@ -907,7 +935,7 @@ static void Host_CheckAutosave (void)
 		return;
 
 	// Don't save too often
-	elapsed = qcvm->time - sv.autosave.time - sv.autosave.cheat;
+	elapsed = qcvm->time - sv->autosave.time - sv->autosave.cheat;
 	if (elapsed < 3.f)
 		return;
 
@@ -922,7 +950,7 @@ static void Host_CheckAutosave (void)
 	// Lower score a bit based on speed (favor standing still/slowing down)
 	score -= (speed / 100.f) * 0.25f;
 	// Boost the score after finding a secret
-	score += sv.autosave.secret_boost * 0.25f;
+	score += sv->autosave.secret_boost * 0.25f;
 	// Boost the score after teleporting
 	score += CLAMP (0.f, 1.f - (qcvm->time - sv_player->v.teleport_time) / 1.5f, 1.f) * 0.5f;
 
@@ -930,9 +958,9 @@ static void Host_CheckAutosave (void)
 	if (score < 1.f)
 		return;
 
-	sv.autosave.time = qcvm->time;
-	sv.autosave.cheat = 0;
-	Cbuf_AddText (va ("save \"autosave/%s\" 0\n", sv.name));
+	sv->autosave.time = qcvm->time;
+	sv->autosave.cheat = 0;
+	Cbuf_AddText (va ("save \"autosave/%s\" 0\n", sv->name));
 }
 
 /*
@@ -959,7 +987,7 @@ void Host_ServerFrame (void)
 
 // move things around and think
 // always pause in single player if in console or menus
-	if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
+	if (!sv->paused && (svs.maxclients > 1 || key_dest == key_game) )
 		SV_Physics ();
 
 //johnfitz -- devstats
@@ -1105,8 +1133,7 @@ static void CL_LoadCSProgs (void)
 		if ((PR_LoadProgs ("csprogs.dat", false) && (qcvm->extfuncs.CSQC_DrawHud||qcvm->extfuncs.CSQC_DrawScores)) ||
 		    (PR_LoadProgs ("progs.dat", false) && qcvm->extfuncs.CSQC_DrawHud))
 		{
-			qcvm->max_edicts = CLAMP (MIN_EDICTS, (int)max_edicts.value, MAX_EDICTS);
-			qcvm->edicts = (edict_t *)malloc (qcvm->max_edicts * qcvm->edict_size);
+			ED_AllocEdictStore (CLAMP (MIN_EDICTS, (int)max_edicts.value, MAX_EDICTS), 1);
 			qcvm->num_edicts = qcvm->reserved_edicts = 1;
 			memset (qcvm->edicts, 0, qcvm->num_edicts * qcvm->edict_size);
 
@@ -1201,11 +1228,17 @@ void _Host_Frame (double time)
 	static double	accumtime = 0;
 	double time1, time2, time3;
 	qboolean ranserver = false;
+	int i;
 
 	time1 = Sys_DoubleTime ();
 
 	if (setjmp (host_abortserver) )
+	{
+		SV_SwitchInstance (0);
 		return;			// something bad happened, or the server disconnected
+	}
+
+	Prof_BeginFrame ();
 
 // keep the random time dependent
 	rand ();
@@ -1229,7 +1262,9 @@ void _Host_Frame (double time)
 	Host_GetConsoleCommands ();
 
 // process console commands
+	Prof_BeginZone ("Commands");
 	Cbuf_Execute ();
+	Prof_EndZone ();
 
 	NET_Poll();
 
@@ -1261,12 +1296,18 @@ void _Host_Frame (double time)
 		else
 			accumtime -= host_netinterval;
 		CL_SendCmd ();
-		if (sv.active)
+		for (i = 0; i < sv_numinstances; i++)
 		{
-			PR_SwitchQCVM(&sv.qcvm);
+			SV_SwitchInstance (i);
+			if (!sv->active)
+				continue;
+			Prof_BeginZone ("Server");
+			PR_SwitchQCVM(&sv->qcvm);
 			Host_ServerFrame ();
 			PR_SwitchQCVM(NULL);
+			Prof_EndZone ();
 		}
+		SV_SwitchInstance (0);
 		host_frametime = realframetime;
 		Cbuf_Waited();
 		ranserver = true;
@@ -1274,13 +1315,19 @@ void _Host_Frame (double time)
 
 // fetch results from server
 	if (cls.state == ca_connected)
+	{
+		Prof_BeginZone ("Client");
 		CL_ReadFromServer ();
+		Prof_EndZone ();
+	}
 
 // update video
 	if (host_speeds.value)
 		time2 = Sys_DoubleTime ();
 
+	Prof_BeginZone ("Render");
 	SCR_UpdateScreen ();
+	Prof_EndZone ();
 
 	CL_RunParticles (); //johnfitz -- seperated from rendering
 
@@ -1288,6 +1335,7 @@ void _Host_Frame (double time)
 		time3 = Sys_DoubleTime ();
 
 // update audio
+	Prof_BeginZone ("Sound");
 	BGM_Update();	// adds music raw samples and/or advances midi driver
 	if (cls.signon == SIGNONS)
 	{
@@ -1296,6 +1344,7 @@ void _Host_Frame (double time)
 	}
 	else
 		S_Update (vec3_origin, vec3_origin, vec3_origin, vec3_origin);
+	Prof_EndZone ();
 
 	CDAudio_Update();
 	UpdateWindowTitle();
@@ -1335,6 +1384,8 @@ void _Host_Frame (double time)
 		}
 	}
 
+	Prof_EndFrame ();
+
 	host_framecount++;
 }
 
@@ -1400,6 +1451,7 @@ void Host_Init (void)
 	COM_Init ();
 	COM_InitFilesystem ();
 	Host_InitLocal ();
+	Prof_Init ();
 	W_LoadWadFile (); //johnfitz -- filename is now hard-coded for honesty
 	if (cls.state != ca_dedicated)
 	{
@@ -1473,7 +1525,7 @@ void Host_Init (void)
 		Cbuf_AddText ("exec autoexec.cfg\n");
 		Cbuf_AddText ("stuffcmds");
 		Cbuf_Execute ();
-		if (!sv.active)
+		if (!sv->active)
 			Cbuf_AddText ("map start\n");
 	}
 }
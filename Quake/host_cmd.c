@@ -51,7 +51,7 @@ void Host_Quit_f (void)
 		return;
 	}
 	CL_Disconnect ();
-	Host_ShutdownServer(false);
+	SV_ShutdownInstances (false);
 
 	Sys_Quit ();
 }
@@ -1556,9 +1556,9 @@ Host_Mapname_f -- johnfitz
 */
 static void Host_Mapname_f (void)
 {
-	if (sv.active)
+	if (sv->active)
 	{
-		Con_Printf ("\"mapname\" is \"%s\"\n", sv.name);
+		Con_Printf ("\"mapname\" is \"%s\"\n", sv->name);
 		return;
 	}
 
@@ -1588,7 +1588,7 @@ static void Host_Status_f (void)
 
 	if (cmd_source == src_command)
 	{
-		if (!sv.active)
+		if (!sv->active)
 		{
 			Cmd_ForwardToServer ();
 			return;
@@ -1604,7 +1604,7 @@ static void Host_Status_f (void)
 		print_fn ("tcp/ip:  %s\n", my_tcpip_address);
 	if (ipxAvailable)
 		print_fn ("ipx:     %s\n", my_ipx_address);
-	print_fn ("map:     %s\n", sv.name);
+	print_fn ("map:     %s\n", sv->name);
 	print_fn ("players: %i active (%i max)\n\n", net_activeconnections, svs.maxclients);
 	for (j = 0, client = svs.clients; j < svs.maxclients; j++, client++)
 	{
@@ -1899,6 +1899,43 @@ static void Host_Fly_f (void)
 	//johnfitz
 }
 
+/*
+==================
+Host_Predict_f
+
+"predict 1" asks for svc_moveack in every datagram, see cl_pred.c
+==================
+*/
+static void Host_Predict_f (void)
+{
+	if (cmd_source == src_command)
+	{
+		Cmd_ForwardToServer ();
+		return;
+	}
+
+	host_client->predict = Cmd_Argc () > 1 && atoi (Cmd_Argv (1)) != 0;
+	host_client->moveseq = 0;
+}
+
+/*
+==================
+Host_EntKeep_f
+
+"entkeep 1" lets the server defer entity updates with svc_entkeep
+==================
+*/
+static void Host_EntKeep_f (void)
+{
+	if (cmd_source == src_command)
+	{
+		Cmd_ForwardToServer ();
+		return;
+	}
+
+	host_client->entkeep = Cmd_Argc () > 1 && atoi (Cmd_Argv (1)) != 0;
+}
+
 /*
 ==================
 Host_Ping_f
@@ -1956,8 +1993,8 @@ static void Host_Map_f (void)
 	{
 		if (cls.state == ca_dedicated)
 		{
-			if (sv.active)
-				Con_Printf ("Current map: %s\n", sv.name);
+			if (sv->active)
+				Con_Printf ("Current map: %s\n", sv->name);
 			else
 				Con_Printf ("Server not active\n");
 		}
@@ -1991,10 +2028,10 @@ static void Host_Map_f (void)
 	p = strstr(name, ".bsp");
 	if (p && p[4] == '\0')
 		*p = '\0';
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	SV_SpawnServer (name);
 	PR_SwitchQCVM(NULL);
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
 	if (cls.state != ca_dedicated)
@@ -2054,28 +2091,28 @@ Host_AutoLoad
 */
 static qboolean Host_AutoLoad (void)
 {
-	if (!sv_autoload.value || !sv.lastsave[0] || svs.maxclients != 1 || cl.intermission)
+	if (!sv_autoload.value || !sv->lastsave[0] || svs.maxclients != 1 || cl.intermission)
 		return false;
 
 	if (sv_autoload.value < 2.f)
 	{
 		if (!SCR_ModalMessage ("Load last save? (y/n)", 0.f))
 		{
-			sv.lastsave[0] = '\0';
+			sv->lastsave[0] = '\0';
 			return false;
 		}
 	}
 	else if (sv_autoload.value < 3.f && sv_player->v.health > 0.f)
 		return false;
 
-	sv.autoloading = true;
+	sv->autoloading = true;
 	Con_Printf ("Autoloading...\n");
-	Cbuf_AddText (va ("load \"%s\"\n", sv.lastsave));
+	Cbuf_AddText (va ("load \"%s\"\n", sv->lastsave));
 	Cbuf_Execute ();
 
-	if (sv.autoloading)
+	if (sv->autoloading)
 	{
-		sv.autoloading = false;
+		sv->autoloading = false;
 		Con_Printf ("Autoload failed!\n");
 		return false;
 	}
@@ -2099,7 +2136,7 @@ static void Host_Changelevel_f (void)
 		Con_Printf ("changelevel <levelname> : continue game on a new level\n");
 		return;
 	}
-	if (!sv.active || cls.demoplayback)
+	if (!sv->active || cls.demoplayback)
 	{
 		Con_Printf ("Only the server may changelevel\n");
 		return;
@@ -2112,18 +2149,18 @@ static void Host_Changelevel_f (void)
 	//johnfitz
 
 	q_strlcpy (level, Cmd_Argv(1), sizeof(level));
-	if (!strcmp (sv.name, level) && Host_AutoLoad ())
+	if (!strcmp (sv->name, level) && Host_AutoLoad ())
 		return;
 
 	if (cls.state != ca_dedicated)
 		IN_Activate();	// -- S.A.
 	key_dest = key_game;	// remove console or menu
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	SV_SaveSpawnparms ();
 	SV_SpawnServer (level);
 	PR_SwitchQCVM(NULL);
 	// also issue an error if spawn failed -- O.S.
-	if (!sv.active)
+	if (!sv->active)
 		Host_Error ("cannot run map %s", level);
 }
 
@@ -2138,7 +2175,7 @@ static void Host_Restart_f (void)
 {
 	char	mapname[MAX_QPATH];
 
-	if (cls.demoplayback || !sv.active)
+	if (cls.demoplayback || !sv->active)
 		return;
 
 	if (cmd_source != src_command)
@@ -2147,11 +2184,11 @@ static void Host_Restart_f (void)
 	if (Host_AutoLoad ())
 		return;
 
-	q_strlcpy (mapname, sv.name, sizeof(mapname));	// mapname gets cleared in spawnserver
-	PR_SwitchQCVM(&sv.qcvm);
+	q_strlcpy (mapname, sv->name, sizeof(mapname));	// mapname gets cleared in spawnserver
+	PR_SwitchQCVM(&sv->qcvm);
 	SV_SpawnServer (mapname);
 	PR_SwitchQCVM(NULL);
-	if (!sv.active)
+	if (!sv->active)
 		Host_Error ("cannot restart map %s", mapname);
 }
 
@@ -2254,8 +2291,8 @@ void Host_SavegameComment (char text[SAVEGAME_COMMENT_LENGTH + 1])
 
 static void Host_InvalidateSave (const char *relname)
 {
-	if (!strcmp (sv.lastsave, relname))
-		sv.lastsave[0] = '\0';
+	if (!strcmp (sv->lastsave, relname))
+		sv->lastsave[0] = '\0';
 }
 
 void Host_ShutdownSave (void)
@@ -2301,9 +2338,9 @@ qboolean Host_IsSaving (void)
 	if (saving)
 		return true;
 
-	if (save_data.abort.value && sv.lastsave[0])
+	if (save_data.abort.value && sv->lastsave[0])
 	{
-		sv.lastsave[0] = '\0';
+		sv->lastsave[0] = '\0';
 		if (save_data.abort.value < 0)
 			Con_Printf ("Save error.\n");
 	}
@@ -2329,7 +2366,7 @@ static int Host_BackgroundSave (void *param)
 		if (!save->file)
 			break;
 
-		PR_SwitchQCVM (&sv.qcvm);
+		PR_SwitchQCVM (&sv->qcvm);
 		SaveData_WriteHeader (save);
 		for (i = 0, ed = save->edicts; i < save->num_edicts; i++, ed = NEXT_EDICT (ed))
 		{
@@ -2384,13 +2421,13 @@ static void Host_Savegame_f (void)
 	if (cmd_source != src_command)
 		return;
 
-	if (!sv.active)
+	if (!sv->active)
 	{
 		Con_Printf ("Not playing a local game.\n");
 		return;
 	}
 
-	if (sv.nomonsters)
+	if (sv->nomonsters)
 	{
 		Con_Printf ("Can't save when using \"nomonsters\".\n");
 		return;
@@ -2439,7 +2476,7 @@ static void Host_Savegame_f (void)
 	Con_LinkPrintf (name, "%s%s", skipnotify, relname);
 	Con_SafePrintf ("%s...\n", skipnotify);
 
-	if (!strcmp (relname, sv.lastsave) && Host_IsSaving ())
+	if (!strcmp (relname, sv->lastsave) && Host_IsSaving ())
 	{
 		SDL_AtomicCAS (&save_data.abort, 0, 1);
 		SDL_LockMutex (save_mutex);
@@ -2463,7 +2500,7 @@ static void Host_Savegame_f (void)
 	save_data.file = f;
 	save_data.abort.value = 0;
 
-	PR_SwitchQCVM (&sv.qcvm);
+	PR_SwitchQCVM (&sv->qcvm);
 	SaveData_Fill (&save_data);
 	PR_SwitchQCVM (NULL);
 
@@ -2471,8 +2508,8 @@ static void Host_Savegame_f (void)
 	SDL_CondSignal (save_pending_condition);
 	SDL_UnlockMutex (save_mutex);
 
-	q_strlcpy (sv.lastsave, relname, sizeof (sv.lastsave));
-	COM_StripExtension (sv.lastsave, relname, sizeof (relname));
+	q_strlcpy (sv->lastsave, relname, sizeof (sv->lastsave));
+	COM_StripExtension (sv->lastsave, relname, sizeof (relname));
 	FileList_Add (relname, &savelist);
 }
 
@@ -2594,7 +2631,7 @@ static void Host_Loadgame_f (void)
 		int expected = kexonly ? SAVEGAME_VERSION_KEX : SAVEGAME_VERSION;
 		free (start);
 		start = NULL;
-		if (sv.autoloading)
+		if (sv->autoloading)
 			Con_Printf ("ERROR: Savegame is version %i, not %i\n", version, expected);
 		else
 			Host_Error ("Savegame is version %i, not %i", version, expected);
@@ -2616,13 +2653,13 @@ static void Host_Loadgame_f (void)
 
 // Note: calling CL_Disconnect instead of CL_Disconnect_f to avoid stopping the music
 	CL_Disconnect ();
-	if (sv.active)
+	if (sv->active)
 		Host_ShutdownServer (false);
 
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	SV_SpawnServer (mapname);
 
-	if (!sv.active)
+	if (!sv->active)
 	{
 		PR_SwitchQCVM(NULL);
 		free (start);
@@ -2631,14 +2668,15 @@ static void Host_Loadgame_f (void)
 		Con_Printf ("Couldn't load map\n");
 		return;
 	}
-	sv.paused = true;		// pause until all clients connect
-	sv.loadgame = true;
+	sv->paused = true;		// pause until all clients connect
+	sv->loadgame = true;
 
 // load the light styles
 	for (i = 0; i < MAX_LIGHTSTYLES; i++)
 	{
 		data = COM_ParseStringNewline (data);
-		sv.lightstyles[i] = (const char *)Hunk_Strdup (com_token, "lightstyles");
+		q_strlcpy (sv->lightstylebuf[i], com_token, MAX_STYLESTRING);
+		sv->lightstyles[i] = sv->lightstylebuf[i];
 	}
 
 // load the edicts out of the savegame file
@@ -2687,7 +2725,7 @@ static void Host_Loadgame_f (void)
 
 	qcvm->num_edicts = entnum;
 	qcvm->time = time;
-	sv.autosave.time = time;
+	sv->autosave.time = time;
 
 	free (start);
 	start = NULL;
@@ -2697,7 +2735,7 @@ static void Host_Loadgame_f (void)
 
 	PR_SwitchQCVM(NULL);
 
-	q_strlcpy (sv.lastsave, relname, sizeof (sv.lastsave));
+	q_strlcpy (sv->lastsave, relname, sizeof (sv->lastsave));
 
 	if (cls.state != ca_dedicated)
 	{
@@ -2750,9 +2788,9 @@ static void Host_Name_f (void)
 	host_client->edict->v.netname = PR_SetEngineString(host_client->name);
 
 // send notification to all clients
-	MSG_WriteByte (&sv.reliable_datagram, svc_updatename);
-	MSG_WriteByte (&sv.reliable_datagram, host_client - svs.clients);
-	MSG_WriteString (&sv.reliable_datagram, host_client->name);
+	MSG_WriteByte (&sv->reliable_datagram, svc_updatename);
+	MSG_WriteByte (&sv->reliable_datagram, host_client - svs.clients);
+	MSG_WriteString (&sv->reliable_datagram, host_client->name);
 }
 
 static void Host_Say(qboolean teamonly)
@@ -2952,9 +2990,9 @@ static void Host_Color_f(void)
 	host_client->edict->v.team = bottom + 1;
 
 // send notification to all clients
-	MSG_WriteByte (&sv.reliable_datagram, svc_updatecolors);
-	MSG_WriteByte (&sv.reliable_datagram, host_client - svs.clients);
-	MSG_WriteByte (&sv.reliable_datagram, host_client->colors);
+	MSG_WriteByte (&sv->reliable_datagram, svc_updatecolors);
+	MSG_WriteByte (&sv->reliable_datagram, host_client - svs.clients);
+	MSG_WriteByte (&sv->reliable_datagram, host_client->colors);
 }
 
 /*
@@ -3004,9 +3042,9 @@ static void Host_Pause_f (void)
 		SV_ClientPrintf ("Pause not allowed.\n");
 	else
 	{
-		sv.paused ^= 1;
+		sv->paused ^= 1;
 
-		if (sv.paused)
+		if (sv->paused)
 		{
 			SV_BroadcastPrintf ("%s paused the game\n", PR_GetString(sv_player->v.netname));
 		}
@@ -3016,8 +3054,8 @@ static void Host_Pause_f (void)
 		}
 
 	// send notification to all clients
-		MSG_WriteByte (&sv.reliable_datagram, svc_setpause);
-		MSG_WriteByte (&sv.reliable_datagram, sv.paused);
+		MSG_WriteByte (&sv->reliable_datagram, svc_setpause);
+		MSG_WriteByte (&sv->reliable_datagram, sv->paused);
 	}
 }
 
@@ -3070,10 +3108,10 @@ static void Host_Spawn_f (void)
 	}
 
 // run the entrance script
-	if (sv.loadgame)
+	if (sv->loadgame)
 	{	// loaded games are fully inited already
 		// if this is the last client to be connected, unpause
-		sv.paused = false;
+		sv->paused = false;
 	}
 	else
 	{
@@ -3124,7 +3162,7 @@ static void Host_Spawn_f (void)
 	{
 		MSG_WriteByte (&host_client->message, svc_lightstyle);
 		MSG_WriteByte (&host_client->message, (char)i);
-		MSG_WriteString (&host_client->message, sv.lightstyles[i]);
+		MSG_WriteString (&host_client->message, sv->lightstyles[i]);
 	}
 
 //
@@ -3155,11 +3193,11 @@ static void Host_Spawn_f (void)
 	ent = EDICT_NUM( 1 + (host_client - svs.clients) );
 	MSG_WriteByte (&host_client->message, svc_setangle);
 	for (i = 0; i < 2; i++)
-		if (sv.loadgame)
-			MSG_WriteAngle (&host_client->message, ent->v.v_angle[i], sv.protocolflags );
+		if (sv->loadgame)
+			MSG_WriteAngle (&host_client->message, ent->v.v_angle[i], sv->protocolflags );
 		else
-			MSG_WriteAngle (&host_client->message, ent->v.angles[i], sv.protocolflags );
-	MSG_WriteAngle (&host_client->message, 0, sv.protocolflags );
+			MSG_WriteAngle (&host_client->message, ent->v.angles[i], sv->protocolflags );
+	MSG_WriteAngle (&host_client->message, 0, sv->protocolflags );
 
 	SV_WriteClientdataToMessage (sv_player, &host_client->message);
 
@@ -3203,7 +3241,7 @@ static void Host_Kick_f (void)
 
 	if (cmd_source == src_command)
 	{
-		if (!sv.active)
+		if (!sv->active)
 		{
 			Cmd_ForwardToServer ();
 			return;
@@ -3515,7 +3553,7 @@ static edict_t	*FindViewthing (void)
 	int		i;
 	edict_t	*e = NULL;
 
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	for (i=0 ; i<qcvm->num_edicts ; i++)
 	{
 		e = EDICT_NUM(i);
@@ -3554,7 +3592,7 @@ static void Host_Viewmodel_f (void)
 		return;
 	}
 
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 	e->v.frame = 0;
 	cl.model_precache[(int)e->v.modelindex] = m;
 	PR_SwitchQCVM(NULL);
@@ -3672,7 +3710,7 @@ static void Host_Startdemos_f (void)
 	for (i = 1; i < c + 1; i++)
 		q_strlcpy (cls.demos[i-1], Cmd_Argv(i), sizeof(cls.demos[0]));
 
-	if (!sv.active && cls.demonum != -1 && !cls.demoplayback)
+	if (!sv->active && cls.demonum != -1 && !cls.demoplayback)
 	{
 		cls.demonum = 0;
 		Cbuf_InsertText ("menu_main\n");
@@ -3780,6 +3818,8 @@ void Host_InitCommands (void)
 	Cmd_AddCommand_ClientCommand ("prespawn", Host_PreSpawn_f);
 	Cmd_AddCommand_ClientCommand ("kick", Host_Kick_f);
 	Cmd_AddCommand_ClientCommand ("ping", Host_Ping_f);
+	Cmd_AddCommand_ClientCommand ("predict", Host_Predict_f);
+	Cmd_AddCommand_ClientCommand ("entkeep", Host_EntKeep_f);
 	Cmd_AddCommand ("load", Host_Loadgame_f);
 	Cmd_AddCommand ("save", Host_Savegame_f);
 	Cmd_AddCommand_ClientCommand ("give", Host_Give_f);
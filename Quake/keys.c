@@ -1333,6 +1333,13 @@ void Key_EventWithKeycode (int key, qboolean down, int keycode)
 			}
 			return;
 
+		case K_PGUP:
+		case K_PGDN:
+			// Jump forward/backward
+			if (down > wasdown)
+				Cbuf_AddText (key == K_PGUP ? "demoseek +10\n" : "demoseek -10\n");
+			return;
+
 		case K_LEFTARROW:
 		case K_RIGHTARROW:
 		case K_DPAD_LEFT:
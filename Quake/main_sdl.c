@@ -114,6 +114,18 @@ static double Sys_Throttle (double oldtime)
 	return Sys_WaitUntil (oldtime + Host_GetFrameInterval ());
 }
 
+/*
+==================
+Sys_ServerIdle
+
+True if the dedicated server has nobody to simulate for
+==================
+*/
+static qboolean Sys_ServerIdle (void)
+{
+	return SV_InstancesIdle ();
+}
+
 #define DEFAULT_MEMORY (384 * 1024 * 1024) // ericw -- was 72MB (64-bit) / 64MB (32-bit)
 
 static quakeparms_t	parms;
@@ -166,8 +178,28 @@ int main(int argc, char *argv[])
 	oldtime = Sys_DoubleTime();
 	if (isDedicated)
 	{
+		float		interval = 0.f;
+		qboolean	ticker = false;
+
 		while (1)
 		{
+			// fixed tick from a kernel timer where available; when nobody is
+			// connected, sleep until a connection request or console input
+			if (interval != sys_ticrate.value)
+			{
+				interval = sys_ticrate.value;
+				ticker = Sys_StartTicker (interval);
+			}
+
+			if (ticker)
+			{
+				Sys_WaitTicker (Sys_ServerIdle () ? sys_idlewait.value : 0.0);
+				newtime = Sys_DoubleTime ();
+				Host_Frame (newtime - oldtime);
+				oldtime = newtime;
+				continue;
+			}
+
 			newtime = Sys_DoubleTime ();
 			time = newtime - oldtime;
 
@@ -1348,7 +1348,7 @@ void M_SinglePlayer_Key (int key)
 		switch (m_singleplayer_cursor)
 		{
 		case 0:
-			if (sv.active)
+			if (sv->active)
 				if (!SCR_ModalMessage("Are you sure you want to\nstart a new game? (y/n)\n", 0.0f))
 					break;
 			if (quake64)
@@ -1359,7 +1359,7 @@ void M_SinglePlayer_Key (int key)
 			}
 			IN_Activate();
 			key_dest = key_game;
-			if (sv.active)
+			if (sv->active)
 				Cbuf_AddText ("disconnect\n");
 			Cbuf_AddText ("maxplayers 1\n");
 			Cbuf_AddText ("deathmatch 0\n"); //johnfitz
@@ -1448,7 +1448,7 @@ void M_Menu_Load_f (void)
 
 void M_Menu_Save_f (void)
 {
-	if (!sv.active)
+	if (!sv->active)
 		return;
 	if (cl.intermission)
 		return;
@@ -2142,7 +2142,7 @@ void M_Skill_Key (int key)
 	case K_MOUSE1:
 		IN_Activate();
 		key_dest = key_game;
-		if (sv.active)
+		if (sv->active)
 			Cbuf_AddText ("disconnect\n");
 		if (m_skill_cursor == 4)
 		{
@@ -6321,7 +6321,7 @@ void M_GameOptions_Key (int key)
 		M_ThrottledSound ("misc/menu2.wav");
 		if (gameoptions_cursor == 0)
 		{
-			if (sv.active)
+			if (sv->active)
 				Cbuf_AddText ("disconnect\n");
 			Cbuf_AddText ("listen 0\n");	// so host_netport will be re-examined
 			Cbuf_AddText ( va ("maxplayers %u\n", maxplayers) );
@@ -6382,24 +6382,25 @@ void M_Search_Draw (void)
 	M_DrawTextBox (x-8, 32, 12, 1);
 	M_Print (x, 40, "Searching...");
 
-	if(slistInProgress)
-	{
+	if (slistInProgress)
 		NET_Poll();
+
+	// show the list as soon as the first reply is in, it keeps filling up
+	if (hostCacheCount)
+	{
+		M_Menu_ServerList_f ();
 		return;
 	}
 
+	if (slistInProgress)
+		return;
+
 	if (! searchComplete)
 	{
 		searchComplete = true;
 		searchCompleteTime = realtime;
 	}
 
-	if (hostCacheCount)
-	{
-		M_Menu_ServerList_f ();
-		return;
-	}
-
 	M_PrintWhite ((320/2) - ((22*8)/2), 64, "No Quake servers found");
 	if ((realtime - searchCompleteTime) < 3.0)
 		return;
@@ -6415,8 +6416,13 @@ void M_Search_Key (int key)
 //=============================================================================
 /* SLIST MENU */
 
-int		slist_cursor;
-qboolean slist_sorted;
+#define SLIST_VIEWSIZE	14
+
+static struct
+{
+	menulist_t	list;
+	int			sortedcount;	// hostCacheCount when the list was last sorted
+} slistmenu;
 
 void M_Menu_ServerList_f (void)
 {
@@ -6424,32 +6430,62 @@ void M_Menu_ServerList_f (void)
 	key_dest = key_menu;
 	m_state = m_slist;
 	m_entersound = true;
-	slist_cursor = 0;
+	memset (&slistmenu.list, 0, sizeof (slistmenu.list));
+	slistmenu.list.viewsize = SLIST_VIEWSIZE;
+	slistmenu.sortedcount = -1;
 	m_return_onerror = false;
 	m_return_reason[0] = 0;
-	slist_sorted = false;
 }
 
 
-void M_ServerList_Draw (void)
+static void M_ServerList_Update (void)
 {
-	int	n;
-	qpic_t	*p;
+	char	selected[32];
+	int		i;
 
-	if (!slist_sorted)
+	if (slistInProgress)
+		NET_Poll ();
+
+	if (slistmenu.sortedcount == hostCacheCount)
+		return;
+
+	// keep the cursor on the same server while new replies are sorted in
+	q_strlcpy (selected, NET_SlistPrintServerName (slistmenu.list.cursor), sizeof (selected));
+	NET_SlistSort ();
+	slistmenu.sortedcount = hostCacheCount;
+	slistmenu.list.numitems = hostCacheCount;
+	slistmenu.list.cursor = 0;
+	for (i = 0; i < hostCacheCount; i++)
 	{
-		slist_sorted = true;
-		NET_SlistSort ();
+		if (!strcmp (NET_SlistPrintServerName (i), selected))
+		{
+			slistmenu.list.cursor = i;
+			break;
+		}
 	}
+	M_List_Rescroll (&slistmenu.list);
+}
+
+
+void M_ServerList_Draw (void)
+{
+	int	i, first, count;
+	qpic_t	*p;
+
+	M_ServerList_Update ();
 
 	p = Draw_CachePic ("gfx/p_multi.lmp");
 	M_DrawPic ( (320-p->width)/2, 4, p);
-	for (n = 0; n < hostCacheCount; n++)
-		M_Print (16, 32 + 8*n, NET_SlistPrintServer (n));
-	M_DrawArrowCursor (0, 32 + slist_cursor*8);
+	M_List_GetVisibleRange (&slistmenu.list, &first, &count);
+	for (i = 0; i < count; i++)
+		M_Print (16, 32 + 8*i, NET_SlistPrintServer (first + i));
+	if (count)
+		M_DrawArrowCursor (0, 32 + (slistmenu.list.cursor - first)*8);
 
 	if (*m_return_reason)
 		M_PrintWhite (16, 148, m_return_reason);
+	else if (slistInProgress)
+		M_Print (16, 148, "Searching...");
 }
 
 
@@ -6468,37 +6504,32 @@ void M_ServerList_Key (int k)
 		M_Menu_Search_f ();
 		break;
 
-	case K_UPARROW:
 	case K_LEFTARROW:
-		M_ThrottledSound ("misc/menu1.wav");
-		slist_cursor--;
-		if (slist_cursor < 0)
-			slist_cursor = hostCacheCount - 1;
+		M_List_Key (&slistmenu.list, K_UPARROW);
 		break;
 
-	case K_DOWNARROW:
 	case K_RIGHTARROW:
-		M_ThrottledSound ("misc/menu1.wav");
-		slist_cursor++;
-		if (slist_cursor >= hostCacheCount)
-			slist_cursor = 0;
+		M_List_Key (&slistmenu.list, K_DOWNARROW);
 		break;
 
 	case K_ENTER:
 	case K_KP_ENTER:
 	case K_ABUTTON:
 	case K_MOUSE1:
+		if (!hostCacheCount)
+			break;
 		M_ThrottledSound ("misc/menu2.wav");
 		m_return_state = m_state;
 		m_return_onerror = true;
-		slist_sorted = false;
 		IN_Activate();
 		key_dest = key_game;
 		m_state = m_none;
-		Cbuf_AddText ( va ("connect \"%s\"\n", NET_SlistPrintServerName(slist_cursor)) );
+		Cbuf_AddText ( va ("connect \"%s\"\n", NET_SlistPrintServerName(slistmenu.list.cursor)) );
 		break;
 
 	default:
+		if (hostCacheCount)
+			M_List_Key (&slistmenu.list, k);
 		break;
 	}
 
@@ -6507,9 +6538,9 @@ void M_ServerList_Key (int k)
 
 void M_ServerList_Mousemove (float cx, float cy)
 {
-	int prev = slist_cursor;
-	M_UpdateCursor (cy, 32, 8, hostCacheCount, &slist_cursor);
-	if (slist_cursor != prev)
+	int prev = slistmenu.list.cursor;
+	M_List_Mousemove (&slistmenu.list, cy - 32);
+	if (slistmenu.list.cursor != prev)
 		M_MouseSound ("misc/menu1.wav");
 }
 
@@ -57,11 +57,17 @@ struct qsocket_s	*NET_Connect (const char *host);
 
 double NET_QSocketGetTime (const struct qsocket_s *sock);
 const char *NET_QSocketGetAddressString (const struct qsocket_s *sock);
+void NET_QSocketGetStats (const struct qsocket_s *sock, int *resends, double *rtt);
+// cumulative reliable retransmits and smoothed round-trip time (0 if unknown)
 
 qboolean NET_CanSendMessage (struct qsocket_s *sock);
 // Returns true or false if the given qsocket can currently accept a
 // message to be transmitted.
 
+qboolean NET_SendDrained (struct qsocket_s *sock);
+// Returns true once every reliable message sent on the qsocket
+// has been acknowledged.
+
 int	NET_GetMessage (struct qsocket_s *sock);
 // returns data in net_message sizebuf
 // returns 0 if no data is waiting
@@ -90,6 +96,9 @@ void	NET_Close (struct qsocket_s *sock);
 
 void	NET_Poll (void);
 
+void	NET_Flush (void);
+// sends any datagrams the drivers queued up this frame
+
 
 // Server list related globals:
 extern	qboolean	slistInProgress;
@@ -104,6 +113,57 @@ const char *NET_SlistPrintServer (int n);
 const char *NET_SlistPrintServerName (int n);
 
 
+/* per-connection telemetry (net_stats.c): one sample per network tick,
+ * kept for the local client and for every client on the server
+ */
+typedef enum
+{
+	NETCAT_ENTITIES,	// entity updates
+	NETCAT_CLIENTDATA,	// svc_time, svc_clientdata, stats, move acks
+	NETCAT_SOUND,
+	NETCAT_TEMPENTS,	// temp entities, particles, other QC broadcast writes
+	NETCAT_STUFFCMD,
+	NETCAT_PRINT,		// print and centerprint
+	NETCAT_OTHER,
+	NETCAT_COUNT
+} netcategory_t;
+
+#define	NETSTATS_SAMPLES	256
+
+typedef struct
+{
+	double		time;
+	int		bytes[NETCAT_COUNT];
+	int		datagrams;		// unreliable datagrams in this tick
+	int		maxdatagram;		// largest of them
+	int		mtu;			// size budget they were built against
+	int		reliable;		// reliable message bytes
+	int		resends;		// reliable fragments retransmitted
+	int		overflows;		// server datagram left out for lack of room
+	int		droppedents;		// visible entities that didn't fit
+	float		rtt;			// smoothed round-trip time, in seconds
+} netsample_t;
+
+typedef struct
+{
+	netsample_t	samples[NETSTATS_SAMPLES];
+	int		count;			// samples ever started, current is count-1
+	int		pending[NETCAT_COUNT];	// reliable bytes queued but not sent yet
+	int		lastresends;
+} netstats_t;
+
+extern	netstats_t	cl_netstats;
+extern	const char	*netcategory_names[NETCAT_COUNT];
+
+void	NetStats_Init (void);
+void	NetStats_Clear (netstats_t *st);
+netsample_t *NetStats_Begin (netstats_t *st, struct qsocket_s *sock);
+netsample_t *NetStats_Current (netstats_t *st);
+netsample_t *NetStats_Sample (netstats_t *st, int age);
+void	NetStats_Datagram (netstats_t *st, int size, int mtu);
+void	NetStats_Queue (netstats_t *st, netcategory_t cat, int bytes);
+void	NetStats_Reliable (netstats_t *st, int size);
+
 /* FIXME: driver related, but public:
  */
 extern	qboolean	ipxAvailable;
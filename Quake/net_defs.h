@@ -53,6 +53,12 @@ struct qsockaddr
 
 #define NET_PROTOCOL_VERSION	3
 
+#define NET_WINDOW_MAGIC	0x49575231	// "IWR1"
+#define NET_WINDOW_SIZE		32
+#define NET_WINDOW_FRAGMENT	1400
+
+#define NET_COMPRESS_MAGIC	0x49575A31	// "IWZ1"
+
 /**
 
 This is the network info/connection protocol.  It is used to find Quake
@@ -67,6 +73,11 @@ General notes:
 CCREQ_CONNECT
 		string	game_name		"QUAKE"
 		byte	net_protocol_version	NET_PROTOCOL_VERSION
+	optional, if the client supports the windowed reliable channel
+	and/or reliable message compression:
+		byte	mod			0 (reads as "no mod" to ProQuake servers)
+		long	window_magic		NET_WINDOW_MAGIC (if supported, always first)
+		long	compress_magic		NET_COMPRESS_MAGIC (if supported)
 
 CCREQ_SERVER_INFO
 		string	game_name		"QUAKE"
@@ -80,6 +91,11 @@ CCREQ_RULE_INFO
 
 CCREP_ACCEPT
 		long	port
+	optional, if the server agreed to the windowed reliable channel
+	and/or reliable message compression:
+		byte	mod			0
+		long	window_magic		NET_WINDOW_MAGIC (if agreed, always first)
+		long	compress_magic		NET_COMPRESS_MAGIC (if agreed)
 
 CCREP_REJECT
 		string	reason
@@ -114,6 +130,17 @@ CCREP_RULE_INFO
 		a full address and port in a string.  It is used for returning the
 		address of a server that is not running locally.
 
+	windowed reliable channel:
+		Reliable messages are cut into fragments of at most NET_WINDOW_FRAGMENT
+		bytes, each with its own sequence number, NETFLAG_EOM on the last one.
+		Up to NET_WINDOW_SIZE fragments may be unacknowledged at a time.
+		Acks carry the next in-order sequence the receiver expects, followed by
+		a long whose bit i means sequence+1+i has also arrived.
+
+	reliable message compression:
+		Every reliable message in either direction starts with a byte, 0 for
+		a message sent as is, 1 for an LZ77-compressed one (see net_dgrm.c).
+
 **/
 
 #define CCREQ_CONNECT		0x01
@@ -157,12 +184,31 @@ typedef struct qsocket_s
 	struct qsockaddr	addr;
 	char		address[NET_NAMELEN];
 
+	int		resends;	// reliable fragments sent more than once
+	qboolean	resent;		// current legacy fragment was retransmitted (Karn)
+	double		rtt;		// smoothed round-trip time
+
+	qboolean	compress;	// reliable messages carry a compression byte
+	int		compressSaved;
+
+	struct netwindow_s	*window;	// windowed reliable channel, NULL for legacy peers
+	struct netimpair_s	*impair;	// net_fake* impairment state, NULL until first used
+
 } qsocket_t;
 
 extern qsocket_t	*net_activeSockets;
 extern qsocket_t	*net_freeSockets;
 extern int		net_numsockets;
 
+#define	NET_BATCHSIZE		32
+
+typedef struct
+{
+	byte		*data;		// NET_DATAGRAMSIZE bytes when reading
+	int		length;
+	struct qsockaddr	addr;
+} netpacket_t;
+
 typedef struct
 {
 	const char	*name;
@@ -186,19 +232,25 @@ typedef struct
 	int		(*AddrCompare) (struct qsockaddr *addr1, struct qsockaddr *addr2);
 	int		(*GetSocketPort) (struct qsockaddr *addr);
 	int		(*SetSocketPort) (struct qsockaddr *addr, int port);
+	sys_socket_t	(*GetListenSocket) (void);
+	// optional, NULL if the driver can only move one datagram per call
+	int		(*ReadBatch) (sys_socket_t socketid, netpacket_t *packets, int count);
+	int		(*WriteBatch) (sys_socket_t socketid, netpacket_t *packets, int count);
 } net_landriver_t;
 
 #define	MAX_NET_DRIVERS		8
 extern net_landriver_t	net_landrivers[];
 extern const int	net_numlandrivers;
 
+int NET_GetListenSockets (sys_socket_t *sockets, int maxsockets);
+
 typedef struct
 {
 	const char	*name;
 	qboolean	initialized;
 	int		(*Init) (void);
 	void		(*Listen) (qboolean state);
-	void		(*SearchForHosts) (qboolean xmit);
+	qboolean	(*SearchForHosts) (qboolean xmit);	// true while replies may still arrive
 	qsocket_t	*(*Connect) (const char *host);
 	qsocket_t	*(*CheckNewConnections) (void);
 	int		(*QGetMessage) (qsocket_t *sock);
@@ -208,6 +260,8 @@ typedef struct
 	qboolean	(*CanSendUnreliableMessage) (qsocket_t *sock);
 	void		(*Close) (qsocket_t *sock);
 	void		(*Shutdown) (void);
+	void		(*Flush) (void);	// optional, sends anything queued this frame
+	qboolean	(*SendDrained) (qsocket_t *sock);	// optional, every reliable message acknowledged
 } net_driver_t;
 
 extern net_driver_t	net_drivers[];
@@ -228,7 +282,7 @@ void NET_FreeQSocket(qsocket_t *);
 double SetNetTime(void);
 
 
-#define HOSTCACHESIZE	8
+#define HOSTCACHESIZE	256
 
 typedef struct
 {
@@ -237,6 +291,7 @@ typedef struct
 	char	cname[32];
 	int		users;
 	int		maxusers;
+	int		ping;		// milliseconds
 	int		driver;
 	int		ldriver;
 	struct qsockaddr addr;
@@ -25,6 +25,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "net_sys.h"
 #include "net_defs.h"
 #include "net_dgrm.h"
+#include "q_ctype.h"
+#if defined(PLATFORM_WINDOWS)
+#include "wsaerror.h"
+#endif
 
 // This is enables a simple IP banning mechanism
 #define BAN_TEST
@@ -81,7 +85,7 @@ static void NET_Ban_f (void)
 
 	if (cmd_source == src_command)
 	{
-		if (!sv.active)
+		if (!sv->active)
 		{
 			Cmd_ForwardToServer ();
 			return;
@@ -129,1104 +133,3147 @@ static void NET_Ban_f (void)
 #endif	// BAN_TEST
 
 
-int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
-{
-	unsigned int	packetLen;
-	unsigned int	dataLen;
-	unsigned int	eom;
+/*
+=============================================================================
 
-#ifdef DEBUG
-	if (data->cursize == 0)
-		Sys_Error("Datagram_SendMessage: zero length message");
+SINGLE-SOCKET SERVER MODE
 
-	if (data->cursize > NET_MAXMESSAGE)
-		Sys_Error("Datagram_SendMessage: message too big: %u", data->cursize);
+With net_mux enabled, accepted clients are not given a socket of their own:
+the accept reply names the listen port, so every client talks to the one
+socket. Incoming datagrams are drained in batches once per frame and routed
+to the owning qsocket by source address; outgoing ones are queued and sent
+in batches by Datagram_Flush at the end of the frame.
 
-	if (sock->canSend == false)
-		Sys_Error("SendMessage: called with canSend == false");
-#endif
+=============================================================================
+*/
 
-	Q_memcpy(sock->sendMessage, data->data, data->cursize);
-	sock->sendMessageLength = data->cursize;
+static cvar_t	net_mux = {"net_mux", "0", CVAR_NONE};
 
-	if (data->cursize <= MAX_DATAGRAM)
-	{
-		dataLen = data->cursize;
-		eom = NETFLAG_EOM;
-	}
-	else
+#define MUX_MAXBATCHES		16		// per driver per pump, bounds the work under a flood
+#define MUX_MAXCONTROL		256		// queued connectionless packets
+#define MUX_PUMPINTERVAL	0.005	// re-drain within a frame (blocking sends wait on acks)
+
+typedef struct
+{
+	byte		*queue;		// [int length][data] records
+	size_t		readpos;
+} muxconn_t;
+
+typedef struct
+{
+	int			landriver;
+	sys_socket_t	socket;
+	struct qsockaddr	addr;
+	size_t		offset;
+	int			length;
+} muxpacket_t;
+
+static muxpacket_t	*mux_outgoing;
+static byte			*mux_outdata;
+static muxpacket_t	*mux_control;
+static byte			*mux_controldata;
+static byte			*mux_readbuffers;
+static int			mux_numconns;
+static int			mux_pumpframe = -1;
+static double		mux_pumptime;
+
+static qboolean Mux_Active (void)
+{
+	return net_mux.value || mux_numconns > 0;
+}
+
+static void Mux_QueueWrite (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
+{
+	muxpacket_t	p;
+
+	p.landriver = sock->landriver;
+	p.socket = sock->socket;
+	p.addr = *addr;
+	p.offset = VEC_SIZE (mux_outdata);
+	p.length = len;
+	Vec_Append ((void **)&mux_outdata, 1, buf, len);
+	VEC_PUSH (mux_outgoing, p);
+}
+
+static int Datagram_RawWrite (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
+{
+	if (sock->driverdata)
 	{
-		dataLen = MAX_DATAGRAM;
-		eom = 0;
+		Mux_QueueWrite (sock, buf, len, addr);
+		return len;
 	}
-	packetLen = NET_HEADERSIZE + dataLen;
+	return sfunc.Write (sock->socket, buf, len, addr);
+}
 
-	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
-	packetBuffer.sequence = BigLong(sock->sendSequence++);
-	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
 
-	sock->canSend = false;
+/*
+=============================================================================
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
-		return -1;
+NETWORK IMPAIRMENT
 
-	sock->lastSendTime = net_time;
-	packetsSent++;
-	return 1;
-}
+Sits between the connection logic and the lan driver and delays, drops,
+duplicates and rate-limits datagrams of established connections according
+to the net_fake* cvars. Each connection draws from its own generator seeded
+from net_fakeseed and the order in which connections were made, so a given
+packet sequence is always impaired the same way. Reordering comes from
+jitter: packets leave in order of their release time.
+
+=============================================================================
+*/
 
+static cvar_t	net_fakelag = {"net_fakelag", "0", CVAR_NONE};			// one-way delay, milliseconds
+static cvar_t	net_fakejitter = {"net_fakejitter", "0", CVAR_NONE};	// extra random delay, milliseconds
+static cvar_t	net_fakeloss = {"net_fakeloss", "0", CVAR_NONE};		// percent
+static cvar_t	net_fakedup = {"net_fakedup", "0", CVAR_NONE};			// percent
+static cvar_t	net_fakerate = {"net_fakerate", "0", CVAR_NONE};		// bytes per second, 0 = unlimited
+static cvar_t	net_fakeseed = {"net_fakeseed", "0", CVAR_NONE};
+static cvar_t	net_fakedir = {"net_fakedir", "3", CVAR_NONE};			// 1 = outgoing, 2 = incoming, 3 = both
 
-static int SendMessageNext (qsocket_t *sock)
+#define IMPAIR_OUT			0
+#define IMPAIR_IN			1
+#define IMPAIR_MAXQUEUE		1024	// per direction, further packets are tail-dropped
+
+typedef struct
 {
-	unsigned int	packetLen;
-	unsigned int	dataLen;
-	unsigned int	eom;
+	double		due;
+	int			length;
+	byte		*data;
+	struct qsockaddr	addr;
+} impairpacket_t;
 
-	if (sock->sendMessageLength <= MAX_DATAGRAM)
-	{
-		dataLen = sock->sendMessageLength;
-		eom = NETFLAG_EOM;
-	}
-	else
+typedef struct netimpair_s
+{
+	unsigned int	rng;
+	double			rateclock[2];	// when the simulated link is next idle
+	impairpacket_t	*queue[2];
+	unsigned int	passed;
+	unsigned int	lost;
+	unsigned int	duplicated;
+	unsigned int	overflowed;
+} netimpair_t;
+
+static unsigned int	impair_numconnections;
+
+static qboolean Impair_Active (int dir)
+{
+	if (!((int)net_fakedir.value & (1 << dir)))
+		return false;
+	return net_fakelag.value > 0.f || net_fakejitter.value > 0.f || net_fakeloss.value > 0.f ||
+		net_fakedup.value > 0.f || net_fakerate.value > 0.f;
+}
+
+static netimpair_t *Impair_Get (qsocket_t *sock)
+{
+	netimpair_t *imp = sock->impair;
+
+	if (!imp)
 	{
-		dataLen = MAX_DATAGRAM;
-		eom = 0;
+		imp = (netimpair_t *) calloc (1, sizeof (netimpair_t));
+		if (!imp)
+			Sys_Error ("Impair_Get: out of memory");
+		imp->rng = ((unsigned int)net_fakeseed.value * 2654435761u) ^ (++impair_numconnections * 0x9e3779b9u);
+		if (!imp->rng)
+			imp->rng = 1;
+		sock->impair = imp;
 	}
-	packetLen = NET_HEADERSIZE + dataLen;
 
-	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
-	packetBuffer.sequence = BigLong(sock->sendSequence++);
-	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+	return imp;
+}
 
-	sock->sendNext = false;
+// xorshift32, returns [0..1)
+static double Impair_Random (netimpair_t *imp)
+{
+	imp->rng ^= imp->rng << 13;
+	imp->rng ^= imp->rng >> 17;
+	imp->rng ^= imp->rng << 5;
+	return (imp->rng >> 8) * (1.0 / 16777216.0);
+}
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
-		return -1;
+static void Impair_Enqueue (netimpair_t *imp, int dir, byte *buf, int len, struct qsockaddr *addr, double due)
+{
+	impairpacket_t	p;
 
-	sock->lastSendTime = net_time;
-	packetsSent++;
-	return 1;
+	if (VEC_SIZE (imp->queue[dir]) >= IMPAIR_MAXQUEUE)
+	{
+		imp->overflowed++;
+		return;
+	}
+
+	p.due = due;
+	p.length = len;
+	p.data = (byte *) malloc (len);
+	if (!p.data)
+		Sys_Error ("Impair_Enqueue: out of memory");
+	memcpy (p.data, buf, len);
+	p.addr = *addr;
+	VEC_PUSH (imp->queue[dir], p);
 }
 
+/*
+==================
+Impair_Submit
 
-static int ReSendMessage (qsocket_t *sock)
+Decides the fate of one datagram entering the simulated link
+==================
+*/
+static void Impair_Submit (qsocket_t *sock, int dir, byte *buf, int len, struct qsockaddr *addr)
 {
-	unsigned int	packetLen;
-	unsigned int	dataLen;
-	unsigned int	eom;
+	netimpair_t	*imp = Impair_Get (sock);
+	double		start, due;
+	int			copies;
 
-	if (sock->sendMessageLength <= MAX_DATAGRAM)
+	if (Impair_Random (imp) * 100.0 < net_fakeloss.value)
 	{
-		dataLen = sock->sendMessageLength;
-		eom = NETFLAG_EOM;
+		imp->lost++;
+		return;
 	}
-	else
+	copies = Impair_Random (imp) * 100.0 < net_fakedup.value ? 2 : 1;
+	if (copies > 1)
+		imp->duplicated++;
+	imp->passed++;
+
+	// serialisation delay on a link of net_fakerate bytes per second
+	start = net_time;
+	if (net_fakerate.value > 0.f)
 	{
-		dataLen = MAX_DATAGRAM;
-		eom = 0;
+		start = q_max (net_time, imp->rateclock[dir]) + len / (double) net_fakerate.value;
+		imp->rateclock[dir] = start;
 	}
-	packetLen = NET_HEADERSIZE + dataLen;
-
-	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
-	packetBuffer.sequence = BigLong(sock->sendSequence - 1);
-	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
-
-	sock->sendNext = false;
-
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
-		return -1;
 
-	sock->lastSendTime = net_time;
-	packetsReSent++;
-	return 1;
+	while (copies--)
+	{
+		due = start + (net_fakelag.value + Impair_Random (imp) * net_fakejitter.value) * 0.001;
+		Impair_Enqueue (imp, dir, buf, len, addr, due);
+	}
 }
 
+/*
+==================
+Impair_Next
 
-qboolean Datagram_CanSendMessage (qsocket_t *sock)
+Removes and returns the earliest queued datagram that is due, if any.
+The caller frees the data.
+==================
+*/
+static qboolean Impair_Next (netimpair_t *imp, int dir, qboolean all, impairpacket_t *out)
 {
-	if (sock->sendNext)
-		SendMessageNext (sock);
+	impairpacket_t	*q = imp->queue[dir];
+	size_t			i, best, count = VEC_SIZE (q);
 
-	return sock->canSend;
-}
+	if (!count)
+		return false;
 
+	for (i = 1, best = 0; i < count; i++)
+		if (q[i].due < q[best].due)
+			best = i;
+	if (!all && q[best].due > net_time)
+		return false;
 
-qboolean Datagram_CanSendUnreliableMessage (qsocket_t *sock)
-{
+	*out = q[best];
+	memmove (q + best, q + best + 1, (count - best - 1) * sizeof (*q));
+	VEC_POP (imp->queue[dir]);
 	return true;
 }
 
+/*
+==================
+Impair_ReleaseOutgoing
 
-int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
+Sends the outgoing datagrams whose time has come, or all of them
+==================
+*/
+static void Impair_ReleaseOutgoing (qsocket_t *sock, qboolean all)
 {
-	int	packetLen;
-
-#ifdef DEBUG
-	if (data->cursize == 0)
-		Sys_Error("Datagram_SendUnreliableMessage: zero length message");
+	impairpacket_t	p;
 
-	if (data->cursize > MAX_DATAGRAM)
-		Sys_Error("Datagram_SendUnreliableMessage: message too big: %u", data->cursize);
-#endif
+	if (!sock->impair)
+		return;
+	while (Impair_Next (sock->impair, IMPAIR_OUT, all, &p))
+	{
+		Datagram_RawWrite (sock, p.data, p.length, &p.addr);
+		free (p.data);
+	}
+}
 
-	packetLen = NET_HEADERSIZE + data->cursize;
+static void Impair_Free (qsocket_t *sock)
+{
+	netimpair_t		*imp = sock->impair;
+	impairpacket_t	p;
 
-	packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE);
-	packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
-	Q_memcpy (packetBuffer.data, data->data, data->cursize);
+	if (!imp)
+		return;
+	Impair_ReleaseOutgoing (sock, true);	// don't lose the disconnect message
+	while (Impair_Next (imp, IMPAIR_IN, true, &p))
+		free (p.data);
+	VEC_FREE (imp->queue[IMPAIR_OUT]);
+	VEC_FREE (imp->queue[IMPAIR_IN]);
+	free (imp);
+	sock->impair = NULL;
+}
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
-		return -1;
+static void Impair_Stats_f (void)
+{
+	qsocket_t	*s;
+	netimpair_t	*imp;
 
-	packetsSent++;
-	return 1;
+	Con_Printf ("lag %gms jitter %gms loss %g%% dup %g%% rate %g B/s seed %g dir %g\n",
+		net_fakelag.value, net_fakejitter.value, net_fakeloss.value, net_fakedup.value,
+		net_fakerate.value, net_fakeseed.value, net_fakedir.value);
+	for (s = net_activeSockets; s; s = s->next)
+	{
+		if (s->driver != myDriverLevel || !(imp = s->impair))
+			continue;
+		Con_Printf ("%-21s passed %u lost %u dup %u overflow %u queued %u/%u\n", s->address,
+			imp->passed, imp->lost, imp->duplicated, imp->overflowed,
+			(unsigned) VEC_SIZE (imp->queue[IMPAIR_OUT]), (unsigned) VEC_SIZE (imp->queue[IMPAIR_IN]));
+	}
 }
 
+/*
+==================
+Datagram_Write
 
-int	Datagram_GetMessage (qsocket_t *sock)
+All sends on an established connection go through here
+==================
+*/
+static int Datagram_Write (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
 {
-	unsigned int	length;
-	unsigned int	flags;
-	int				ret = 0;
-	struct qsockaddr readaddr;
-	unsigned int	sequence;
-	unsigned int	count;
-
-	if (!sock->canSend)
-		if ((net_time - sock->lastSendTime) > 1.0)
-			ReSendMessage (sock);
-
-	while (1)
+	if (Impair_Active (IMPAIR_OUT))
 	{
-		length = (unsigned int) sfunc.Read(sock->socket, (byte *)&packetBuffer,
-							NET_DATAGRAMSIZE, &readaddr);
+		Impair_Submit (sock, IMPAIR_OUT, buf, len, addr);
+		Impair_ReleaseOutgoing (sock, false);
+		return len;
+	}
+	Impair_ReleaseOutgoing (sock, false);
+	return Datagram_RawWrite (sock, buf, len, addr);
+}
 
-	//	if ((rand() & 255) > 220)
-	//		continue;
+void Datagram_Flush (void)
+{
+	netpacket_t	packets[NET_BATCHSIZE];
+	muxpacket_t	*p;
+	size_t		i, count, total;
+	int			j, sent;
+	qsocket_t	*s;
 
-		if (length == 0)
-			break;
+	for (s = net_activeSockets; s; s = s->next)
+		if (s->driver == myDriverLevel)
+			Impair_ReleaseOutgoing (s, false);
 
-		if (length == (unsigned int)-1)
+	total = VEC_SIZE (mux_outgoing);
+	for (i = 0; i < total; i += count)
+	{
+		net_landriver_t *drv = &net_landrivers[mux_outgoing[i].landriver];
+
+		// group consecutive packets that leave through the same socket
+		for (count = 0; i + count < total && count < NET_BATCHSIZE; count++)
 		{
-			Con_Printf("Read error\n");
-			return -1;
+			p = &mux_outgoing[i + count];
+			if (p->landriver != mux_outgoing[i].landriver || p->socket != mux_outgoing[i].socket)
+				break;
+			packets[count].data = mux_outdata + p->offset;
+			packets[count].length = p->length;
+			packets[count].addr = p->addr;
 		}
 
-		if (sfunc.AddrCompare(&readaddr, &sock->addr) != 0)
+		if (drv->WriteBatch)
 		{
-			Con_Printf("Forged packet received\n");
-			Con_Printf("Expected: %s\n", StrAddr (&sock->addr));
-			Con_Printf("Received: %s\n", StrAddr (&readaddr));
-			continue;
+			for (j = 0; j < (int)count; j += sent)
+			{
+				sent = drv->WriteBatch (mux_outgoing[i].socket, packets + j, (int)count - j);
+				if (sent <= 0)
+					break;
+			}
 		}
-
-		if (length < NET_HEADERSIZE)
+		else
 		{
-			shortPacketCount++;
-			continue;
+			for (j = 0; j < (int)count; j++)
+				drv->Write (mux_outgoing[i].socket, packets[j].data, packets[j].length, &packets[j].addr);
 		}
+	}
 
-		length = BigLong(packetBuffer.length);
-		flags = length & (~NETFLAG_LENGTH_MASK);
-		length &= NETFLAG_LENGTH_MASK;
+	VEC_CLEAR (mux_outgoing);
+	VEC_CLEAR (mux_outdata);
+}
 
-		if (flags & NETFLAG_CTL)
-			continue;
+static void Mux_Route (int landriver, netpacket_t *packet)
+{
+	qsocket_t	*s;
+	muxconn_t	*conn;
+	muxpacket_t	p;
+	int			control;
 
-		sequence = BigLong(packetBuffer.sequence);
-		packetsReceived++;
+	if (packet->length < (int) sizeof(int))
+		return;
 
-		if (flags & NETFLAG_UNRELIABLE)
+	control = BigLong (*((int *)packet->data));
+	if (control != -1 && !(control & NETFLAG_CTL))
+	{
+		for (s = net_activeSockets; s; s = s->next)
 		{
-			if (sequence < sock->unreliableReceiveSequence)
-			{
-				Con_DPrintf("Got a stale datagram\n");
-				ret = 0;
-				break;
-			}
-			if (sequence != sock->unreliableReceiveSequence)
-			{
-				count = sequence - sock->unreliableReceiveSequence;
-				droppedDatagrams += count;
-				Con_DPrintf("Dropped %u datagram(s)\n", count);
-			}
-			sock->unreliableReceiveSequence = sequence + 1;
+			if (!s->driverdata || s->driver != myDriverLevel || s->landriver != landriver)
+				continue;
+			if (net_landrivers[landriver].AddrCompare (&packet->addr, &s->addr) != 0)
+				continue;
+			conn = (muxconn_t *) s->driverdata;
+			Vec_Append ((void **)&conn->queue, 1, &packet->length, sizeof (packet->length));
+			Vec_Append ((void **)&conn->queue, 1, packet->data, packet->length);
+			return;
+		}
+		return;	// not one of ours, same as an unconnected socket would see it
+	}
 
-			length -= NET_HEADERSIZE;
+	if (VEC_SIZE (mux_control) >= MUX_MAXCONTROL)
+		return;
+	p.landriver = landriver;
+	p.socket = INVALID_SOCKET;
+	p.addr = packet->addr;
+	p.offset = VEC_SIZE (mux_controldata);
+	p.length = packet->length;
+	Vec_Append ((void **)&mux_controldata, 1, packet->data, packet->length);
+	VEC_PUSH (mux_control, p);
+}
 
-			SZ_Clear (&net_message);
-			SZ_Write (&net_message, packetBuffer.data, length);
+/*
+==================
+Mux_Pump
 
-			ret = 2;
-			break;
-		}
+Sends whatever is queued, then drains every listen socket
+==================
+*/
+static void Mux_Pump (void)
+{
+	netpacket_t	packets[NET_BATCHSIZE];
+	sys_socket_t	listensock;
+	int			i, j, n, batch;
 
-		if (flags & NETFLAG_ACK)
+	Datagram_Flush ();
+
+	mux_pumpframe = host_framecount;
+	mux_pumptime = net_time;
+
+	if (!mux_readbuffers)
+	{
+		mux_readbuffers = (byte *) malloc (NET_BATCHSIZE * NET_DATAGRAMSIZE);
+		if (!mux_readbuffers)
+			Sys_Error ("Mux_Pump: out of memory");
+	}
+	for (j = 0; j < NET_BATCHSIZE; j++)
+		packets[j].data = mux_readbuffers + j * NET_DATAGRAMSIZE;
+
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		if (!net_landrivers[i].initialized)
+			continue;
+		listensock = net_landrivers[i].GetListenSocket ();
+		if (listensock == INVALID_SOCKET)
+			continue;
+
+		for (batch = 0; batch < MUX_MAXBATCHES; batch++)
 		{
-			if (sequence != (sock->sendSequence - 1))
+			if (net_landrivers[i].ReadBatch)
+				n = net_landrivers[i].ReadBatch (listensock, packets, NET_BATCHSIZE);
+			else
 			{
-				Con_DPrintf("Stale ACK received\n");
-				continue;
-			}
-			if (sequence == sock->ackSequence)
-			{
-				sock->ackSequence++;
-				if (sock->ackSequence != sock->sendSequence)
-					Con_DPrintf("ack sequencing error\n");
-			}
-			else
-			{
-				Con_DPrintf("Duplicate ACK received\n");
-				continue;
-			}
-			sock->sendMessageLength -= MAX_DATAGRAM;
-			if (sock->sendMessageLength > 0)
-			{
-				memmove (sock->sendMessage, sock->sendMessage + MAX_DATAGRAM, sock->sendMessageLength);
-				sock->sendNext = true;
-			}
-			else
-			{
-				sock->sendMessageLength = 0;
-				sock->canSend = true;
-			}
-			continue;
-		}
-
-		if (flags & NETFLAG_DATA)
-		{
-			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
-			packetBuffer.sequence = BigLong(sequence);
-			sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
-
-			if (sequence != sock->receiveSequence)
-			{
-				receivedDuplicateCount++;
-				continue;
+				for (n = 0; n < NET_BATCHSIZE; n++)
+				{
+					packets[n].length = net_landrivers[i].Read (listensock, packets[n].data, NET_DATAGRAMSIZE, &packets[n].addr);
+					if (packets[n].length <= 0)
+						break;
+				}
 			}
-			sock->receiveSequence++;
-
-			length -= NET_HEADERSIZE;
 
-			if (flags & NETFLAG_EOM)
-			{
-				SZ_Clear(&net_message);
-				SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
-				SZ_Write(&net_message, packetBuffer.data, length);
-				sock->receiveMessageLength = 0;
-
-				ret = 1;
+			for (j = 0; j < n; j++)
+				Mux_Route (i, &packets[j]);
+			if (n < NET_BATCHSIZE)
 				break;
-			}
-
-			Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data, length);
-			sock->receiveMessageLength += length;
-			continue;
 		}
 	}
-
-	if (sock->sendNext)
-		SendMessageNext (sock);
-
-	return ret;
 }
 
-
-static void PrintStats(qsocket_t *s)
+static void Mux_PumpIfDue (void)
 {
-	Con_Printf("canSend = %4u   \n", s->canSend);
-	Con_Printf("sendSeq = %4u   ", s->sendSequence);
-	Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
-	Con_Printf("\n");
+	if (mux_pumpframe != host_framecount || net_time - mux_pumptime > MUX_PUMPINTERVAL)
+		Mux_Pump ();
 }
 
-static void NET_Stats_f (void)
+static int Mux_Read (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
 {
-	qsocket_t	*s;
+	muxconn_t	*conn = (muxconn_t *) sock->driverdata;
+	int			length;
 
-	if (Cmd_Argc () == 1)
+	if (conn->readpos >= VEC_SIZE (conn->queue))
 	{
-		Con_Printf("unreliable messages sent   = %i\n", unreliableMessagesSent);
-		Con_Printf("unreliable messages recv   = %i\n", unreliableMessagesReceived);
-		Con_Printf("reliable messages sent     = %i\n", messagesSent);
-		Con_Printf("reliable messages received = %i\n", messagesReceived);
-		Con_Printf("packetsSent                = %i\n", packetsSent);
-		Con_Printf("packetsReSent              = %i\n", packetsReSent);
-		Con_Printf("packetsReceived            = %i\n", packetsReceived);
-		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
-		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
-		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+		Mux_PumpIfDue ();
+		if (conn->readpos >= VEC_SIZE (conn->queue))
+			return 0;
 	}
-	else if (Q_strcmp(Cmd_Argv(1), "*") == 0)
+
+	memcpy (&length, conn->queue + conn->readpos, sizeof (length));
+	conn->readpos += sizeof (length);
+	memcpy (buf, conn->queue + conn->readpos, q_min (length, len));
+	conn->readpos += length;
+	if (conn->readpos >= VEC_SIZE (conn->queue))
 	{
-		for (s = net_activeSockets; s; s = s->next)
-			PrintStats(s);
-		for (s = net_freeSockets; s; s = s->next)
-			PrintStats(s);
+		VEC_CLEAR (conn->queue);
+		conn->readpos = 0;
 	}
-	else
+
+	*addr = sock->addr;
+	return q_min (length, len);
+}
+
+/*
+==================
+Datagram_Read
+
+All reads on an established connection go through here
+==================
+*/
+static int Datagram_Read (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
+{
+	impairpacket_t	p;
+	int				ret;
+
+	if (Impair_Active (IMPAIR_IN))
 	{
-		for (s = net_activeSockets; s; s = s->next)
+		// move everything the driver has into the simulated link
+		for (;;)
 		{
-			if (q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+			if (sock->driverdata)
+				ret = Mux_Read (sock, buf, len, addr);
+			else
+				ret = sfunc.Read (sock->socket, buf, len, addr);
+			if (ret <= 0)
 				break;
+			Impair_Submit (sock, IMPAIR_IN, buf, ret, addr);
 		}
+		if (ret < 0)
+			return ret;
+	}
+	else if (!sock->impair || !VEC_SIZE (sock->impair->queue[IMPAIR_IN]))
+	{
+		if (sock->driverdata)
+			return Mux_Read (sock, buf, len, addr);
+		return sfunc.Read (sock->socket, buf, len, addr);
+	}
 
-		if (s == NULL)
-		{
-			for (s = net_freeSockets; s; s = s->next)
-			{
-				if (q_strcasecmp(Cmd_Argv(1), s->address) == 0)
-					break;
-			}
-		}
+	// drains what is left in the link even after impairment was switched off
+	if (!Impair_Next (sock->impair, IMPAIR_IN, !Impair_Active (IMPAIR_IN), &p))
+		return 0;
+	ret = q_min (p.length, len);
+	memcpy (buf, p.data, ret);
+	*addr = p.addr;
+	free (p.data);
+	return ret;
+}
 
-		if (s == NULL)
-			return;
+static int Mux_ReadControl (byte *buf, int len, struct qsockaddr *addr)
+{
+	muxpacket_t	*p;
+	size_t		i;
+	int			length = 0;
 
-		PrintStats(s);
-	}
-}
+	Mux_PumpIfDue ();
 
+	for (i = 0; i < VEC_SIZE (mux_control); i++)
+	{
+		p = &mux_control[i];
+		if (p->landriver != net_landriverlevel || p->length < 0)
+			continue;
+		length = q_min (p->length, len);
+		memcpy (buf, mux_controldata + p->offset, length);
+		*addr = p->addr;
+		p->length = -1;
+		break;
+	}
 
-// recognize ip:port (based on ProQuake)
-static const char *Strip_Port (const char *host)
-{
-	static char	noport[MAX_QPATH];
-			/* array size as in Host_Connect_f() */
-	char		*p;
-	int		port;
+	if (i == VEC_SIZE (mux_control))
+		return 0;
 
-	if (!host || !*host)
-		return host;
-	q_strlcpy (noport, host, sizeof(noport));
-	if ((p = Q_strrchr(noport, ':')) == NULL)
-		return host;
-	*p++ = '\0';
-	port = Q_atoi (p);
-	if (port > 0 && port < 65536 && port != net_hostport)
+	// reset the queue once everything in it has been consumed
+	for (i = 0; i < VEC_SIZE (mux_control); i++)
+		if (mux_control[i].length >= 0)
+			break;
+	if (i == VEC_SIZE (mux_control))
 	{
-		net_hostport = port;
-		Con_Printf("Port set to %d\n", net_hostport);
+		VEC_CLEAR (mux_control);
+		VEC_CLEAR (mux_controldata);
 	}
-	return noport;
+
+	return length;
 }
 
+static void Mux_CloseConn (qsocket_t *sock)
+{
+	muxconn_t	*conn = (muxconn_t *) sock->driverdata;
 
-static qboolean testInProgress = false;
-static int		testPollCount;
-static int		testDriver;
-static sys_socket_t	testSocket;
+	Datagram_Flush ();	// the disconnect message is usually still queued
+	VEC_FREE (conn->queue);
+	free (conn);
+	sock->driverdata = NULL;
+	mux_numconns--;
+}
 
-static void Test_Poll (void *);
-static PollProcedure	testPollProcedure = {NULL, 0.0, Test_Poll};
 
-static void Test_Poll (void *unused)
+/*
+=============================================================================
+
+WINDOWED RELIABLE CHANNEL
+
+Negotiated in CCREQ_CONNECT/CCREP_ACCEPT (see net_defs.h). Reliable messages
+are queued in a backlog and cut into small fragments, up to NET_WINDOW_SIZE
+of which are in flight at once. Acks are cumulative plus a selective bitmask,
+and fragments are resent after an RTT-derived timeout, or early once three
+later fragments have been acknowledged.
+
+=============================================================================
+*/
+
+static cvar_t	net_window = {"net_window", "1", CVAR_NONE};
+
+#define NETWIN_BACKLOG		(256 * 1024)	// queued reliable bytes before CanSendMessage says no
+#define NETWIN_MINRTO		0.05
+#define NETWIN_MAXRTO		1.0		// the legacy fixed resend interval
+
+typedef struct
 {
-	struct qsockaddr clientaddr;
-	int		control;
-	int		len;
-	char	name[32];
-	char	address[64];
-	int		colors;
-	int		frags;
-	int		connectTime;
+	int			length;
+	unsigned int	flags;		// NETFLAG_EOM on the last fragment of a message
+	qboolean	present;	// send: unacknowledged, recv: arrived out of order
+	int			transmits;
+	double		sendtime;
+	byte		data[NET_WINDOW_FRAGMENT];
+} netwinfrag_t;
+
+typedef struct netwindow_s
+{
+	// sending
+	unsigned int	sendbase;		// oldest unacknowledged sequence
+	unsigned int	sendnext;		// next sequence to assign
+	netwinfrag_t	sendfrags[NET_WINDOW_SIZE];
+	byte			*backlog;		// [int length][data] messages not yet cut
+	size_t			backlogread;
+	int				msgremaining;	// bytes of the message at backlogread left to cut
+	double			srtt;
+	double			rttvar;
+	double			rto;
+
+	// receiving
+	unsigned int	recvbase;		// next sequence expected in order
+	netwinfrag_t	recvfrags[NET_WINDOW_SIZE];
+	byte			*ready;			// [int length][data] complete messages
+	size_t			readyread;
+	qboolean		discarding;		// rest of an oversized message, skipped until EOM
+} netwindow_t;
+
+static netwindow_t *Window_Alloc (void)
+{
+	netwindow_t	*win = (netwindow_t *) calloc (1, sizeof (netwindow_t));
 
-	net_landriverlevel = testDriver;
+	if (win)
+		win->rto = NETWIN_MAXRTO;
+	return win;
+}
 
-	while (1)
-	{
-		len = dfunc.Read (testSocket, net_message.data, net_message.maxsize, &clientaddr);
-		if (len < (int) sizeof(int))
-			break;
+static void Window_Free (qsocket_t *sock)
+{
+	netwindow_t	*win = sock->window;
 
-		net_message.cursize = len;
+	if (!win)
+		return;
+	VEC_FREE (win->backlog);
+	VEC_FREE (win->ready);
+	free (win);
+	sock->window = NULL;
+}
 
-		MSG_BeginReading ();
-		control = BigLong(*((int *)net_message.data));
-		MSG_ReadLong();
-		if (control == -1)
-			break;
-		if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
-			break;
-		if ((control & NETFLAG_LENGTH_MASK) != len)
-			break;
+static void Window_Transmit (qsocket_t *sock, unsigned int sequence)
+{
+	netwinfrag_t	*frag = &sock->window->sendfrags[sequence % NET_WINDOW_SIZE];
+	unsigned int	packetLen = NET_HEADERSIZE + frag->length;
 
-		if (MSG_ReadByte() != CCREP_PLAYER_INFO)
-			Sys_Error("Unexpected response to Player Info request\n");
+	packetBuffer.length = BigLong(packetLen | NETFLAG_DATA | frag->flags);
+	packetBuffer.sequence = BigLong(sequence);
+	Q_memcpy (packetBuffer.data, frag->data, frag->length);
 
-		MSG_ReadByte(); /* playerNumber */
-		Q_strcpy(name, MSG_ReadString());
-		colors = MSG_ReadLong();
-		frags = MSG_ReadLong();
-		connectTime = MSG_ReadLong();
-		Q_strcpy(address, MSG_ReadString());
+	Datagram_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr);
 
-		Con_Printf("%s\n  frags:%3i  colors:%d %d  time:%d\n  %s\n", name, frags, colors >> 4, colors & 0x0f, connectTime / 60, address);
+	if (frag->transmits++)
+	{
+		packetsReSent++;
+		sock->resends++;
 	}
+	else
+		packetsSent++;
+	frag->sendtime = net_time;
+	sock->lastSendTime = net_time;
+}
 
-	testPollCount--;
-	if (testPollCount)
+/*
+==================
+Window_Fill
+
+Cuts backlog data into fragments while there is room in the window
+==================
+*/
+static void Window_Fill (qsocket_t *sock)
+{
+	netwindow_t		*win = sock->window;
+	netwinfrag_t	*frag;
+
+	while (win->sendnext - win->sendbase < NET_WINDOW_SIZE && win->backlogread < VEC_SIZE (win->backlog))
 	{
-		SchedulePollProcedure(&testPollProcedure, 0.1);
+		if (!win->msgremaining)
+		{
+			memcpy (&win->msgremaining, win->backlog + win->backlogread, sizeof (int));
+			win->backlogread += sizeof (int);
+		}
+
+		frag = &win->sendfrags[win->sendnext % NET_WINDOW_SIZE];
+		frag->length = q_min (win->msgremaining, NET_WINDOW_FRAGMENT);
+		memcpy (frag->data, win->backlog + win->backlogread, frag->length);
+		win->backlogread += frag->length;
+		win->msgremaining -= frag->length;
+		frag->flags = win->msgremaining ? 0 : NETFLAG_EOM;
+		frag->present = true;
+		frag->transmits = 0;
+
+		Window_Transmit (sock, win->sendnext++);
 	}
-	else
+
+	if (win->backlogread >= VEC_SIZE (win->backlog))
 	{
-		dfunc.Close_Socket(testSocket);
-		testInProgress = false;
+		VEC_CLEAR (win->backlog);
+		win->backlogread = 0;
 	}
 }
 
-static void Test_f (void)
+static qboolean Window_CanSend (qsocket_t *sock)
 {
-	const char	*host;
-	int		n;
-	int		maxusers = MAX_SCOREBOARD;
-	struct qsockaddr sendaddr;
+	netwindow_t *win = sock->window;
+	return VEC_SIZE (win->backlog) - win->backlogread + NET_MAXMESSAGE + sizeof (int) <= NETWIN_BACKLOG;
+}
 
-	if (testInProgress)
-		return;
+static int Window_SendMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	netwindow_t	*win = sock->window;
+	int			length = data->cursize;
 
-	host = Strip_Port (Cmd_Argv(1));
+	if (!Window_CanSend (sock))
+		return 0;
 
-	if (host && hostCacheCount)
+	Vec_Append ((void **)&win->backlog, 1, &length, sizeof (length));
+	Vec_Append ((void **)&win->backlog, 1, data->data, length);
+	Window_Fill (sock);
+	sock->canSend = Window_CanSend (sock);
+
+	return 1;
+}
+
+/*
+==================
+Window_Service
+
+Resends fragments whose timer ran out and keeps the window full
+==================
+*/
+static void Window_Service (qsocket_t *sock)
+{
+	netwindow_t		*win = sock->window;
+	netwinfrag_t	*frag;
+	unsigned int	seq;
+	qboolean		timedout = false;
+
+	for (seq = win->sendbase; seq != win->sendnext; seq++)
 	{
-		for (n = 0; n < hostCacheCount; n++)
+		frag = &win->sendfrags[seq % NET_WINDOW_SIZE];
+		if (frag->present && net_time - frag->sendtime > win->rto)
 		{
-			if (q_strcasecmp (host, hostcache[n].name) == 0)
-			{
-				if (hostcache[n].driver != myDriverLevel)
-					continue;
-				net_landriverlevel = hostcache[n].ldriver;
-				maxusers = hostcache[n].maxusers;
-				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
-				break;
-			}
+			Window_Transmit (sock, seq);
+			timedout = true;
 		}
+	}
+	if (timedout)
+		win->rto = q_min (win->rto * 2.0, NETWIN_MAXRTO);
 
-		if (n < hostCacheCount)
-			goto JustDoIt;
+	Window_Fill (sock);
+	sock->canSend = Window_CanSend (sock);
+}
+
+static void Window_HandleAck (qsocket_t *sock, unsigned int ack, unsigned int mask)
+{
+	netwindow_t		*win = sock->window;
+	netwinfrag_t	*frag;
+	unsigned int	seq, highest;
+	qboolean		any = false;
+	double			sample;
+
+	if ((int)(ack - win->sendbase) < 0 || (int)(ack - win->sendnext) > 0)
+	{
+		Con_DPrintf("Stale ACK received\n");
+		return;
 	}
 
-	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	highest = win->sendbase;
+	for (seq = win->sendbase; seq != win->sendnext; seq++)
 	{
-		if (!net_landrivers[net_landriverlevel].initialized)
+		frag = &win->sendfrags[seq % NET_WINDOW_SIZE];
+		if ((int)(seq - ack) >= 0 && (seq - ack - 1 >= 32 || !(mask & (1u << (seq - ack - 1)))))
 			continue;
+		highest = seq;
+		any = true;
+		if (!frag->present)
+			continue;
+		frag->present = false;
+
+		// Karn: only time fragments that went out once
+		if (frag->transmits == 1)
+		{
+			sample = net_time - frag->sendtime;
+			if (!win->srtt)
+			{
+				win->srtt = sample;
+				win->rttvar = sample * 0.5;
+			}
+			else
+			{
+				win->rttvar = 0.75 * win->rttvar + 0.25 * fabs (win->srtt - sample);
+				win->srtt = 0.875 * win->srtt + 0.125 * sample;
+			}
+			// variance floor: acks are only sent once per frame, so a steady link still jitters
+			win->rto = CLAMP (NETWIN_MINRTO, win->srtt + q_max (4.0 * win->rttvar, 0.5 * win->srtt), NETWIN_MAXRTO);
+			sock->rtt = win->srtt;
+		}
+	}
+
+	while (win->sendbase != win->sendnext && !win->sendfrags[win->sendbase % NET_WINDOW_SIZE].present)
+		win->sendbase++;
+
+	// fast retransmit of holes with at least three acknowledged fragments after them
+	if (any)
+	{
+		for (seq = win->sendbase; (int)(highest - seq) >= 3; seq++)
+		{
+			frag = &win->sendfrags[seq % NET_WINDOW_SIZE];
+			if (frag->present && net_time - frag->sendtime >= win->srtt)
+				Window_Transmit (sock, seq);
+		}
+	}
+
+	Window_Fill (sock);
+	sock->canSend = Window_CanSend (sock);
+}
+
+static void Window_SendAck (qsocket_t *sock)
+{
+	netwindow_t		*win = sock->window;
+	unsigned int	mask = 0;
+	int				i;
+
+	for (i = 0; i < NET_WINDOW_SIZE - 1; i++)
+		if (win->recvfrags[(win->recvbase + 1 + i) % NET_WINDOW_SIZE].present)
+			mask |= 1u << i;
+
+	packetBuffer.length = BigLong((NET_HEADERSIZE + 4) | NETFLAG_ACK);
+	packetBuffer.sequence = BigLong(win->recvbase);
+	*((unsigned int *)packetBuffer.data) = BigLong(mask);
+	Datagram_Write (sock, (byte *)&packetBuffer, NET_HEADERSIZE + 4, &sock->addr);
+}
+
+static void Window_HandleData (qsocket_t *sock, unsigned int sequence, unsigned int flags, byte *data, int length)
+{
+	netwindow_t		*win = sock->window;
+	netwinfrag_t	*frag;
+	int				ahead;
+
+	ahead = (int)(sequence - win->recvbase);
+	frag = &win->recvfrags[sequence % NET_WINDOW_SIZE];
+	if (length < 0)
+		return;
+	if (ahead < 0 || (ahead < NET_WINDOW_SIZE && frag->present))
+		receivedDuplicateCount++;
+	else if (ahead < NET_WINDOW_SIZE && length <= NET_WINDOW_FRAGMENT)
+	{
+		frag->present = true;
+		frag->length = length;
+		frag->flags = flags & NETFLAG_EOM;
+		memcpy (frag->data, data, length);
+	}
+
+	// move everything that is now in order into the reassembly buffer
+	for (frag = &win->recvfrags[win->recvbase % NET_WINDOW_SIZE]; frag->present;
+		frag = &win->recvfrags[win->recvbase % NET_WINDOW_SIZE])
+	{
+		frag->present = false;
+		win->recvbase++;
+
+		if (win->discarding)
+		{
+			if (frag->flags & NETFLAG_EOM)
+				win->discarding = false;
+			continue;
+		}
+		if (sock->receiveMessageLength + frag->length > NET_MAXMESSAGE)
+		{
+			Con_DPrintf("Oversized reliable message dropped\n");
+			sock->receiveMessageLength = 0;
+			// its tail would otherwise be read as the start of the next message
+			win->discarding = !(frag->flags & NETFLAG_EOM);
+			continue;
+		}
+		Q_memcpy (sock->receiveMessage + sock->receiveMessageLength, frag->data, frag->length);
+		sock->receiveMessageLength += frag->length;
+
+		if (frag->flags & NETFLAG_EOM)
+		{
+			Vec_Append ((void **)&win->ready, 1, &sock->receiveMessageLength, sizeof (int));
+			Vec_Append ((void **)&win->ready, 1, sock->receiveMessage, sock->receiveMessageLength);
+			sock->receiveMessageLength = 0;
+		}
+	}
+
+	Window_SendAck (sock);
+}
+
+/*
+==================
+Window_ReadMessage
+
+Moves the next complete reliable message into net_message
+==================
+*/
+static qboolean Window_ReadMessage (qsocket_t *sock)
+{
+	netwindow_t	*win = sock->window;
+	int			length;
+
+	if (win->readyread >= VEC_SIZE (win->ready))
+		return false;
+
+	memcpy (&length, win->ready + win->readyread, sizeof (length));
+	win->readyread += sizeof (length);
+	SZ_Clear (&net_message);
+	SZ_Write (&net_message, win->ready + win->readyread, length);
+	win->readyread += length;
+
+	if (win->readyread >= VEC_SIZE (win->ready))
+	{
+		VEC_CLEAR (win->ready);
+		win->readyread = 0;
+	}
+
+	return true;
+}
+
+
+/*
+=============================================================================
+
+RELIABLE MESSAGE COMPRESSION
+
+Negotiated in CCREQ_CONNECT/CCREP_ACCEPT like the windowed channel. Every
+reliable message then starts with a byte: NETZ_RAW followed by the message
+as is, or NETZ_LZ followed by the original length as a little-endian short
+and an LZ77 stream. The match window starts out primed with net_zdict, so
+the model and sound names in signon buffers and the console commands mods
+stuff to clients find matches from the first byte on.
+
+An LZ77 stream is a series of sequences: a token byte whose high nibble
+is the literal count and low nibble the match length - NETZ_MINMATCH (15
+meaning more length bytes follow, each adding up to 255), the literals,
+then the match distance as a little-endian short. The last sequence has
+literals only.
+
+=============================================================================
+*/
+
+static cvar_t	net_compress = {"net_compress", "1", CVAR_NONE};
+static cvar_t	net_compress_min = {"net_compress_min", "256", CVAR_NONE};	// smaller reliable messages go out raw
+
+#define NETZ_RAW		0
+#define NETZ_LZ			1
+#define NETZ_MINMATCH	4
+#define NETZ_HASHBITS	12
+#define NETZ_MAXDIST	65535
+
+static const char net_zdict[] =
+	"progs/player.mdl\0progs/eyes.mdl\0progs/h_player.mdl\0progs/gib1.mdl\0progs/gib2.mdl\0progs/gib3.mdl\0"
+	"progs/s_bubble.spr\0progs/s_explod.spr\0progs/v_axe.mdl\0progs/v_shot.mdl\0progs/v_shot2.mdl\0"
+	"progs/v_nail.mdl\0progs/v_nail2.mdl\0progs/v_rock.mdl\0progs/v_rock2.mdl\0progs/v_light.mdl\0"
+	"progs/bolt.mdl\0progs/bolt2.mdl\0progs/bolt3.mdl\0progs/lavaball.mdl\0progs/missile.mdl\0"
+	"progs/grenade.mdl\0progs/spike.mdl\0progs/s_spike.mdl\0progs/backpack.mdl\0progs/zom_gib.mdl\0"
+	"progs/armor.mdl\0progs/g_shot.mdl\0progs/g_nail.mdl\0progs/g_nail2.mdl\0progs/g_rock.mdl\0"
+	"progs/g_rock2.mdl\0progs/g_light.mdl\0progs/quaddama.mdl\0progs/invulner.mdl\0progs/suit.mdl\0"
+	"maps/b_bh10.bsp\0maps/b_bh25.bsp\0maps/b_bh100.bsp\0maps/b_shell0.bsp\0maps/b_shell1.bsp\0"
+	"maps/b_nail0.bsp\0maps/b_nail1.bsp\0maps/b_rock0.bsp\0maps/b_rock1.bsp\0maps/b_batt0.bsp\0"
+	"maps/b_batt1.bsp\0maps/b_explob.bsp\0"
+	"weapons/ric1.wav\0weapons/ric2.wav\0weapons/ric3.wav\0weapons/tink1.wav\0weapons/r_exp3.wav\0"
+	"weapons/lhit.wav\0weapons/lstart.wav\0weapons/guncock.wav\0weapons/rocket1i.wav\0weapons/spike2.wav\0"
+	"weapons/grenade.wav\0weapons/bounce.wav\0weapons/sgun1.wav\0weapons/shotgn2.wav\0weapons/pkup.wav\0"
+	"items/damage.wav\0items/damage2.wav\0items/damage3.wav\0items/health1.wav\0items/r_item1.wav\0"
+	"items/r_item2.wav\0items/armor1.wav\0items/itembk2.wav\0items/protect.wav\0items/protect2.wav\0"
+	"items/protect3.wav\0items/suit.wav\0items/suit2.wav\0items/inv1.wav\0items/inv2.wav\0items/inv3.wav\0"
+	"player/plyrjmp8.wav\0player/land.wav\0player/land2.wav\0player/drown1.wav\0player/drown2.wav\0"
+	"player/gasp1.wav\0player/gasp2.wav\0player/h2odeath.wav\0player/h2ojump.wav\0player/slimbrn2.wav\0"
+	"player/inh2o.wav\0player/lburn1.wav\0player/lburn2.wav\0player/tornoff2.wav\0player/udeath.wav\0"
+	"player/gib.wav\0player/death1.wav\0player/death2.wav\0player/death3.wav\0player/death4.wav\0"
+	"player/death5.wav\0player/pain1.wav\0player/pain2.wav\0player/pain3.wav\0player/pain4.wav\0"
+	"player/pain5.wav\0player/pain6.wav\0player/axhit1.wav\0player/axhit2.wav\0player/teledth1.wav\0"
+	"misc/h2ohit1.wav\0misc/water1.wav\0misc/water2.wav\0misc/outwater.wav\0misc/talk.wav\0"
+	"misc/r_tele1.wav\0misc/r_tele2.wav\0misc/r_tele3.wav\0misc/r_tele4.wav\0misc/r_tele5.wav\0"
+	"misc/menu1.wav\0misc/menu2.wav\0misc/menu3.wav\0misc/power.wav\0misc/secret.wav\0"
+	"demon/dland2.wav\0ambience/fire1.wav\0ambience/hum1.wav\0ambience/windfly.wav\0ambience/water1.wav\0"
+	"ambience/buzz1.wav\0ambience/comp1.wav\0ambience/drip1.wav\0ambience/drone6.wav\0ambience/swamp1.wav\0"
+	"progs/\0maps/\0sound/\0gfx/\0.mdl\0.bsp\0.spr\0.wav\0.lit\0"
+	"alias \0bind \0unbind \0set \0seta \0cmd \0impulse \0wait;\0echo \0exec \0"
+	"v_cshift \0bf\n\0reconnect\n\0cd \0fov \0cl_rollangle \0chase_active \0crosshair \0"
+	"//st \0\"\n\0 has joined the game\n\0 entered the game\n\0 left the game with \0 frags\n\0"
+	" was \0 by \0's \0 rocket\n\0 nails\n\0 gibbed\0 fragged\0 rides \0 eats \0 sleeps with the fishes\n\0"
+	" becomes bored with life\n\0 tries to put the pin back in\n\0 discharges into the water\n\0";
+
+static byte		netz_window[sizeof (net_zdict) + NET_MAXMESSAGE];
+static int		netz_dicthash[1 << NETZ_HASHBITS];
+static int		netz_hash[1 << NETZ_HASHBITS];
+static qboolean	netz_dictready;
+static byte		netz_buf[NET_MAXMESSAGE];
+static sizebuf_t	netz_message = {false, false, netz_buf, sizeof (netz_buf), 0};
+
+/* statistic counters */
+static int compressedMessages = 0;
+static int compressedBytesIn = 0;
+static int compressedBytesOut = 0;
+
+#define NETZ_DICTSIZE	((int) sizeof (net_zdict) - 1)
+
+static int Compress_Hash (const byte *p)
+{
+	unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+	return (v * 2654435761u) >> (32 - NETZ_HASHBITS);
+}
+
+static byte *Compress_PutLength (byte *op, int n)
+{
+	for ( ; n >= 255; n -= 255)
+		*op++ = 255;
+	*op++ = n;
+	return op;
+}
+
+/*
+==================
+Compress_Encode
+
+Returns the stream length, or -1 if it wouldn't fit in outmax bytes
+==================
+*/
+static int Compress_Encode (const byte *in, int inlen, byte *out, int outmax)
+{
+	byte	*src = netz_window;
+	byte	*op = out, *outend = out + outmax;
+	int		pos, end, anchor, cand, lit, len, i, h;
+
+	if (!netz_dictready)
+	{
+		memset (netz_dicthash, -1, sizeof (netz_dicthash));
+		memcpy (netz_window, net_zdict, NETZ_DICTSIZE);
+		for (pos = 0; pos + NETZ_MINMATCH <= NETZ_DICTSIZE; pos++)
+			netz_dicthash[Compress_Hash (src + pos)] = pos;
+		netz_dictready = true;
+	}
+	memcpy (netz_hash, netz_dicthash, sizeof (netz_hash));
+	memcpy (src + NETZ_DICTSIZE, in, inlen);
+
+	pos = anchor = NETZ_DICTSIZE;
+	end = NETZ_DICTSIZE + inlen;
+	while (pos + NETZ_MINMATCH <= end)
+	{
+		h = Compress_Hash (src + pos);
+		cand = netz_hash[h];
+		netz_hash[h] = pos;
+		if (cand < 0 || pos - cand > NETZ_MAXDIST || memcmp (src + cand, src + pos, NETZ_MINMATCH) != 0)
+		{
+			pos++;
+			continue;
+		}
+
+		for (len = NETZ_MINMATCH; pos + len < end && src[cand + len] == src[pos + len]; len++)
+			;
+
+		lit = pos - anchor;
+		if (op + 1 + lit / 255 + 1 + lit + 2 + len / 255 + 1 > outend)
+			return -1;
+		*op++ = (q_min (lit, 15) << 4) | q_min (len - NETZ_MINMATCH, 15);
+		if (lit >= 15)
+			op = Compress_PutLength (op, lit - 15);
+		memcpy (op, src + anchor, lit);
+		op += lit;
+		*op++ = (pos - cand) & 255;
+		*op++ = (pos - cand) >> 8;
+		if (len - NETZ_MINMATCH >= 15)
+			op = Compress_PutLength (op, len - NETZ_MINMATCH - 15);
+
+		for (i = 1; i < len && pos + i + NETZ_MINMATCH <= end; i++)
+			netz_hash[Compress_Hash (src + pos + i)] = pos + i;
+		pos += len;
+		anchor = pos;
+	}
+
+	lit = end - anchor;
+	if (op + 1 + lit / 255 + 1 + lit > outend)
+		return -1;
+	*op++ = q_min (lit, 15) << 4;
+	if (lit >= 15)
+		op = Compress_PutLength (op, lit - 15);
+	memcpy (op, src + anchor, lit);
+	op += lit;
+
+	return op - out;
+}
+
+static qboolean Compress_GetLength (const byte **ip, const byte *inend, int *n)
+{
+	int b;
+
+	do
+	{
+		if (*ip >= inend)
+			return false;
+		b = *(*ip)++;
+		*n += b;
+	} while (b == 255);
+
+	return true;
+}
+
+/*
+==================
+Compress_Decode
+
+Expands a stream into netz_window, right after the dictionary
+==================
+*/
+static qboolean Compress_Decode (const byte *in, int inlen, int outlen)
+{
+	const byte	*ip = in, *inend = in + inlen;
+	byte		*op, *outend;
+	int			token, lit, len, dist;
+
+	memcpy (netz_window, net_zdict, NETZ_DICTSIZE);
+	op = netz_window + NETZ_DICTSIZE;
+	outend = op + outlen;
+
+	while (ip < inend)
+	{
+		token = *ip++;
+		lit = token >> 4;
+		if (lit == 15 && !Compress_GetLength (&ip, inend, &lit))
+			return false;
+		if (lit > inend - ip || lit > outend - op)
+			return false;
+		memcpy (op, ip, lit);
+		op += lit;
+		ip += lit;
+		if (ip == inend)
+			break;
+
+		if (inend - ip < 2)
+			return false;
+		dist = ip[0] | (ip[1] << 8);
+		ip += 2;
+		len = (token & 15) + NETZ_MINMATCH;
+		if (len == 15 + NETZ_MINMATCH && !Compress_GetLength (&ip, inend, &len))
+			return false;
+		if (!dist || dist > op - netz_window || len > outend - op)
+			return false;
+		for ( ; len > 0; len--, op++)
+			*op = op[-dist];
+	}
+
+	return op == outend;
+}
+
+/*
+==================
+Compress_Pack
+
+Wraps an outgoing reliable message for a connection that negotiated compression
+==================
+*/
+static sizebuf_t *Compress_Pack (qsocket_t *sock, sizebuf_t *data)
+{
+	int	len;
+
+	SZ_Clear (&netz_message);
+	if (data->cursize >= net_compress_min.value)
+	{
+		len = Compress_Encode (data->data, data->cursize, netz_buf + 3, data->cursize - 4);
+		if (len > 0)
+		{
+			netz_buf[0] = NETZ_LZ;
+			netz_buf[1] = data->cursize & 255;
+			netz_buf[2] = data->cursize >> 8;
+			netz_message.cursize = len + 3;
+			compressedMessages++;
+			compressedBytesIn += data->cursize;
+			compressedBytesOut += netz_message.cursize;
+			sock->compressSaved += data->cursize - netz_message.cursize;
+			return &netz_message;
+		}
+	}
+
+	if (data->cursize + 1 > netz_message.maxsize)
+		Sys_Error ("Compress_Pack: message too big: %u", data->cursize);
+	netz_buf[0] = NETZ_RAW;
+	memcpy (netz_buf + 1, data->data, data->cursize);
+	netz_message.cursize = data->cursize + 1;
+	return &netz_message;
+}
+
+/*
+==================
+Compress_Unpack
+
+Restores the reliable message in net_message
+==================
+*/
+static qboolean Compress_Unpack (void)
+{
+	byte	*data = net_message.data;
+	int		len;
+
+	if (net_message.cursize < 1)
+		return false;
+
+	if (data[0] == NETZ_RAW)
+	{
+		memmove (data, data + 1, --net_message.cursize);
+		return true;
+	}
+
+	if (data[0] != NETZ_LZ || net_message.cursize < 3)
+		return false;
+	len = data[1] | (data[2] << 8);
+	if (len > net_message.maxsize || !Compress_Decode (data + 3, net_message.cursize - 3, len))
+		return false;
+	memcpy (data, netz_window + NETZ_DICTSIZE, len);
+	net_message.cursize = len;
+	return true;
+}
+
+
+int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+#ifdef DEBUG
+	if (data->cursize == 0)
+		Sys_Error("Datagram_SendMessage: zero length message");
+
+	if (data->cursize > NET_MAXMESSAGE)
+		Sys_Error("Datagram_SendMessage: message too big: %u", data->cursize);
+
+	if (sock->canSend == false)
+		Sys_Error("SendMessage: called with canSend == false");
+#endif
+
+	if (sock->compress)
+		data = Compress_Pack (sock, data);
+
+	if (sock->window)
+		return Window_SendMessage (sock, data);
+
+	Q_memcpy(sock->sendMessage, data->data, data->cursize);
+	sock->sendMessageLength = data->cursize;
+
+	if (data->cursize <= MAX_DATAGRAM)
+	{
+		dataLen = data->cursize;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence++);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->canSend = false;
+	sock->resent = false;
+
+	if (Datagram_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsSent++;
+	return 1;
+}
+
+
+static int SendMessageNext (qsocket_t *sock)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
+	{
+		dataLen = sock->sendMessageLength;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence++);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->sendNext = false;
+	sock->resent = false;
+
+	if (Datagram_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsSent++;
+	return 1;
+}
+
+
+static int ReSendMessage (qsocket_t *sock)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
+	{
+		dataLen = sock->sendMessageLength;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence - 1);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->sendNext = false;
+	sock->resent = true;
+	sock->resends++;
+
+	if (Datagram_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsReSent++;
+	return 1;
+}
+
+
+qboolean Datagram_CanSendMessage (qsocket_t *sock)
+{
+	if (sock->window)
+	{
+		Window_Service (sock);
+		return sock->canSend;
+	}
+
+	if (sock->sendNext)
+		SendMessageNext (sock);
+
+	return sock->canSend;
+}
+
+
+qboolean Datagram_SendDrained (qsocket_t *sock)
+{
+	netwindow_t	*win = sock->window;
+
+	if (!win)
+		return Datagram_CanSendMessage (sock);	// one message in flight at most
+
+	Window_Service (sock);
+	return win->sendbase == win->sendnext && win->backlogread >= VEC_SIZE (win->backlog);
+}
+
+
+qboolean Datagram_CanSendUnreliableMessage (qsocket_t *sock)
+{
+	return true;
+}
+
+
+int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	int	packetLen;
+
+#ifdef DEBUG
+	if (data->cursize == 0)
+		Sys_Error("Datagram_SendUnreliableMessage: zero length message");
+
+	if (data->cursize > MAX_DATAGRAM)
+		Sys_Error("Datagram_SendUnreliableMessage: message too big: %u", data->cursize);
+#endif
+
+	packetLen = NET_HEADERSIZE + data->cursize;
+
+	packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE);
+	packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
+	Q_memcpy (packetBuffer.data, data->data, data->cursize);
+
+	if (Datagram_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	packetsSent++;
+	return 1;
+}
+
+
+static int Datagram_GetRawMessage (qsocket_t *sock)
+{
+	unsigned int	length;
+	unsigned int	readlength;
+	unsigned int	flags;
+	int				ret = 0;
+	struct qsockaddr readaddr;
+	unsigned int	sequence;
+	unsigned int	count;
+
+	Impair_ReleaseOutgoing (sock, false);
+
+	if (sock->window)
+	{
+		Window_Service (sock);
+		if (Window_ReadMessage (sock))
+			return 1;
+	}
+	else if (!sock->canSend)
+		if ((net_time - sock->lastSendTime) > 1.0)
+			ReSendMessage (sock);
+
+	while (1)
+	{
+		length = (unsigned int) Datagram_Read (sock, (byte *)&packetBuffer, NET_DATAGRAMSIZE, &readaddr);
+
+	//	if ((rand() & 255) > 220)
+	//		continue;
+
+		if (length == 0)
+			break;
+
+		if (length == (unsigned int)-1)
+		{
+			Con_Printf("Read error\n");
+			return -1;
+		}
+
+		if (sfunc.AddrCompare(&readaddr, &sock->addr) != 0)
+		{
+			Con_Printf("Forged packet received\n");
+			Con_Printf("Expected: %s\n", StrAddr (&sock->addr));
+			Con_Printf("Received: %s\n", StrAddr (&readaddr));
+			continue;
+		}
+
+		if (length < NET_HEADERSIZE)
+		{
+			shortPacketCount++;
+			continue;
+		}
+
+		readlength = length;
+		length = BigLong(packetBuffer.length);
+		flags = length & (~NETFLAG_LENGTH_MASK);
+		length &= NETFLAG_LENGTH_MASK;
+
+		if (flags & NETFLAG_CTL)
+			continue;
+
+		// the header must not claim more (or less) than what actually arrived
+		if (length < NET_HEADERSIZE || length > readlength)
+		{
+			shortPacketCount++;
+			continue;
+		}
+
+		sequence = BigLong(packetBuffer.sequence);
+		packetsReceived++;
+
+		if (flags & NETFLAG_UNRELIABLE)
+		{
+			if (sequence < sock->unreliableReceiveSequence)
+			{
+				Con_DPrintf("Got a stale datagram\n");
+				ret = 0;
+				break;
+			}
+			if (sequence != sock->unreliableReceiveSequence)
+			{
+				count = sequence - sock->unreliableReceiveSequence;
+				droppedDatagrams += count;
+				Con_DPrintf("Dropped %u datagram(s)\n", count);
+			}
+			sock->unreliableReceiveSequence = sequence + 1;
+
+			length -= NET_HEADERSIZE;
+
+			SZ_Clear (&net_message);
+			SZ_Write (&net_message, packetBuffer.data, length);
+
+			ret = 2;
+			break;
+		}
+
+		if (sock->window)
+		{
+			length -= NET_HEADERSIZE;
+			if (flags & NETFLAG_ACK)
+			{
+				if (length >= 4)
+					Window_HandleAck (sock, sequence, BigLong(*((unsigned int *)packetBuffer.data)));
+				continue;
+			}
+			if (flags & NETFLAG_DATA)
+			{
+				Window_HandleData (sock, sequence, flags, packetBuffer.data, length);
+				if (Window_ReadMessage (sock))
+				{
+					ret = 1;
+					break;
+				}
+			}
+			continue;
+		}
+
+		if (flags & NETFLAG_ACK)
+		{
+			if (sequence != (sock->sendSequence - 1))
+			{
+				Con_DPrintf("Stale ACK received\n");
+				continue;
+			}
+			if (sequence == sock->ackSequence)
+			{
+				sock->ackSequence++;
+				if (sock->ackSequence != sock->sendSequence)
+					Con_DPrintf("ack sequencing error\n");
+			}
+			else
+			{
+				Con_DPrintf("Duplicate ACK received\n");
+				continue;
+			}
+			// Karn: a retransmitted fragment can't tell which copy was acked
+			if (!sock->resent)
+			{
+				double sample = net_time - sock->lastSendTime;
+				sock->rtt = sock->rtt ? 0.875 * sock->rtt + 0.125 * sample : sample;
+			}
+			sock->sendMessageLength -= MAX_DATAGRAM;
+			if (sock->sendMessageLength > 0)
+			{
+				memmove (sock->sendMessage, sock->sendMessage + MAX_DATAGRAM, sock->sendMessageLength);
+				sock->sendNext = true;
+			}
+			else
+			{
+				sock->sendMessageLength = 0;
+				sock->canSend = true;
+			}
+			continue;
+		}
+
+		if (flags & NETFLAG_DATA)
+		{
+			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
+			packetBuffer.sequence = BigLong(sequence);
+			Datagram_Write (sock, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
+
+			if (sequence != sock->receiveSequence)
+			{
+				receivedDuplicateCount++;
+				continue;
+			}
+			sock->receiveSequence++;
+
+			length -= NET_HEADERSIZE;
+
+			if (flags & NETFLAG_EOM)
+			{
+				SZ_Clear(&net_message);
+				SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
+				SZ_Write(&net_message, packetBuffer.data, length);
+				sock->receiveMessageLength = 0;
+
+				ret = 1;
+				break;
+			}
+
+			Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data, length);
+			sock->receiveMessageLength += length;
+			continue;
+		}
+	}
+
+	if (sock->sendNext && !sock->window)
+		SendMessageNext (sock);
+
+	return ret;
+}
+
+
+int	Datagram_GetMessage (qsocket_t *sock)
+{
+	int	ret = Datagram_GetRawMessage (sock);
+
+	if (ret == 1 && sock->compress && !Compress_Unpack ())
+	{
+		Con_Printf ("Bad compressed message from %s\n", sock->address);
+		return -1;
+	}
+
+	return ret;
+}
+
+
+static void PrintStats(qsocket_t *s)
+{
+	Con_Printf("canSend = %4u   \n", s->canSend);
+	Con_Printf("sendSeq = %4u   ", s->sendSequence);
+	Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+	if (s->compress)
+		Con_Printf("compressed, %d bytes saved\n", s->compressSaved);
+	Con_Printf("\n");
+}
+
+static void NET_Stats_f (void)
+{
+	qsocket_t	*s;
+
+	if (Cmd_Argc () == 1)
+	{
+		Con_Printf("unreliable messages sent   = %i\n", unreliableMessagesSent);
+		Con_Printf("unreliable messages recv   = %i\n", unreliableMessagesReceived);
+		Con_Printf("reliable messages sent     = %i\n", messagesSent);
+		Con_Printf("reliable messages received = %i\n", messagesReceived);
+		Con_Printf("packetsSent                = %i\n", packetsSent);
+		Con_Printf("packetsReSent              = %i\n", packetsReSent);
+		Con_Printf("packetsReceived            = %i\n", packetsReceived);
+		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
+		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
+		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+		Con_Printf("compressedMessages         = %i\n", compressedMessages);
+		Con_Printf("compressed bytes           = %i -> %i (%i saved)\n", compressedBytesIn, compressedBytesOut, compressedBytesIn - compressedBytesOut);
+	}
+	else if (Q_strcmp(Cmd_Argv(1), "*") == 0)
+	{
+		for (s = net_activeSockets; s; s = s->next)
+			PrintStats(s);
+		for (s = net_freeSockets; s; s = s->next)
+			PrintStats(s);
+	}
+	else
+	{
+		for (s = net_activeSockets; s; s = s->next)
+		{
+			if (q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+				break;
+		}
+
+		if (s == NULL)
+		{
+			for (s = net_freeSockets; s; s = s->next)
+			{
+				if (q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+					break;
+			}
+		}
+
+		if (s == NULL)
+			return;
+
+		PrintStats(s);
+	}
+}
+
+
+// recognize ip:port (based on ProQuake)
+static const char *Strip_Port (const char *host)
+{
+	static char	noport[MAX_QPATH];
+			/* array size as in Host_Connect_f() */
+	char		*p;
+	int		port;
+
+	if (!host || !*host)
+		return host;
+	q_strlcpy (noport, host, sizeof(noport));
+	if ((p = Q_strrchr(noport, ':')) == NULL)
+		return host;
+	*p++ = '\0';
+	port = Q_atoi (p);
+	if (port > 0 && port < 65536 && port != net_hostport)
+	{
+		net_hostport = port;
+		Con_Printf("Port set to %d\n", net_hostport);
+	}
+	return noport;
+}
+
+
+static qboolean testInProgress = false;
+static int		testPollCount;
+static int		testDriver;
+static sys_socket_t	testSocket;
+
+static void Test_Poll (void *);
+static PollProcedure	testPollProcedure = {NULL, 0.0, Test_Poll};
+
+static void Test_Poll (void *unused)
+{
+	struct qsockaddr clientaddr;
+	int		control;
+	int		len;
+	char	name[32];
+	char	address[64];
+	int		colors;
+	int		frags;
+	int		connectTime;
+
+	net_landriverlevel = testDriver;
+
+	while (1)
+	{
+		len = dfunc.Read (testSocket, net_message.data, net_message.maxsize, &clientaddr);
+		if (len < (int) sizeof(int))
+			break;
+
+		net_message.cursize = len;
+
+		MSG_BeginReading ();
+		control = BigLong(*((int *)net_message.data));
+		MSG_ReadLong();
+		if (control == -1)
+			break;
+		if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
+			break;
+		if ((control & NETFLAG_LENGTH_MASK) != len)
+			break;
+
+		if (MSG_ReadByte() != CCREP_PLAYER_INFO)
+			Sys_Error("Unexpected response to Player Info request\n");
+
+		MSG_ReadByte(); /* playerNumber */
+		Q_strcpy(name, MSG_ReadString());
+		colors = MSG_ReadLong();
+		frags = MSG_ReadLong();
+		connectTime = MSG_ReadLong();
+		Q_strcpy(address, MSG_ReadString());
+
+		Con_Printf("%s\n  frags:%3i  colors:%d %d  time:%d\n  %s\n", name, frags, colors >> 4, colors & 0x0f, connectTime / 60, address);
+	}
+
+	testPollCount--;
+	if (testPollCount)
+	{
+		SchedulePollProcedure(&testPollProcedure, 0.1);
+	}
+	else
+	{
+		dfunc.Close_Socket(testSocket);
+		testInProgress = false;
+	}
+}
+
+static void Test_f (void)
+{
+	const char	*host;
+	int		n;
+	int		maxusers = MAX_SCOREBOARD;
+	struct qsockaddr sendaddr;
+
+	if (testInProgress)
+		return;
+
+	host = Strip_Port (Cmd_Argv(1));
+
+	if (host && hostCacheCount)
+	{
+		for (n = 0; n < hostCacheCount; n++)
+		{
+			if (q_strcasecmp (host, hostcache[n].name) == 0)
+			{
+				if (hostcache[n].driver != myDriverLevel)
+					continue;
+				net_landriverlevel = hostcache[n].ldriver;
+				maxusers = hostcache[n].maxusers;
+				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
+				break;
+			}
+		}
+
+		if (n < hostCacheCount)
+			goto JustDoIt;
+	}
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	{
+		if (!net_landrivers[net_landriverlevel].initialized)
+			continue;
+
+		// see if we can resolve the host name
+		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
+			break;
+	}
+
+	if (net_landriverlevel == net_numlandrivers)
+	{
+		Con_Printf("Could not resolve %s\n", host);
+		return;
+	}
+
+JustDoIt:
+	testSocket = dfunc.Open_Socket(0);
+	if (testSocket == INVALID_SOCKET)
+		return;
+
+	testInProgress = true;
+	testPollCount = 20;
+	testDriver = net_landriverlevel;
+
+	for (n = 0; n < maxusers; n++)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREQ_PLAYER_INFO);
+		MSG_WriteByte(&net_message, n);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (testSocket, net_message.data, net_message.cursize, &sendaddr);
+	}
+	SZ_Clear(&net_message);
+	SchedulePollProcedure(&testPollProcedure, 0.1);
+}
+
+
+static qboolean test2InProgress = false;
+static int		test2Driver;
+static sys_socket_t	test2Socket;
+
+static void Test2_Poll (void *);
+static PollProcedure	test2PollProcedure = {NULL, 0.0, Test2_Poll};
+
+static void Test2_Poll (void *unused)
+{
+	struct qsockaddr clientaddr;
+	int		control;
+	int		len;
+	char	name[256];
+	char	value[256];
+
+	net_landriverlevel = test2Driver;
+	name[0] = 0;
+
+	len = dfunc.Read (test2Socket, net_message.data, net_message.maxsize, &clientaddr);
+	if (len < (int) sizeof(int))
+		goto Reschedule;
+
+	net_message.cursize = len;
+
+	MSG_BeginReading ();
+	control = BigLong(*((int *)net_message.data));
+	MSG_ReadLong();
+	if (control == -1)
+		goto Error;
+	if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
+		goto Error;
+	if ((control & NETFLAG_LENGTH_MASK) != len)
+		goto Error;
+
+	if (MSG_ReadByte() != CCREP_RULE_INFO)
+		goto Error;
+
+	Q_strcpy(name, MSG_ReadString());
+	if (name[0] == 0)
+		goto Done;
+	Q_strcpy(value, MSG_ReadString());
+
+	Con_Printf("%-16.16s  %-16.16s\n", name, value);
+
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
+	MSG_WriteString(&net_message, name);
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &clientaddr);
+	SZ_Clear(&net_message);
+
+Reschedule:
+	SchedulePollProcedure(&test2PollProcedure, 0.05);
+	return;
+
+Error:
+	Con_Printf("Unexpected response to Rule Info request\n");
+Done:
+	dfunc.Close_Socket(test2Socket);
+	test2InProgress = false;
+	return;
+}
+
+static void Test2_f (void)
+{
+	const char	*host;
+	int		n;
+	struct qsockaddr sendaddr;
+
+	if (test2InProgress)
+		return;
+
+	host = Strip_Port (Cmd_Argv(1));
+
+	if (host && hostCacheCount)
+	{
+		for (n = 0; n < hostCacheCount; n++)
+		{
+			if (q_strcasecmp (host, hostcache[n].name) == 0)
+			{
+				if (hostcache[n].driver != myDriverLevel)
+					continue;
+				net_landriverlevel = hostcache[n].ldriver;
+				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
+				break;
+			}
+		}
+
+		if (n < hostCacheCount)
+			goto JustDoIt;
+	}
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	{
+		if (!net_landrivers[net_landriverlevel].initialized)
+			continue;
+
+		// see if we can resolve the host name
+		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
+			break;
+	}
+
+	if (net_landriverlevel == net_numlandrivers)
+	{
+		Con_Printf("Could not resolve %s\n", host);
+		return;
+	}
+
+JustDoIt:
+	test2Socket = dfunc.Open_Socket(0);
+	if (test2Socket == INVALID_SOCKET)
+		return;
+
+	test2InProgress = true;
+	test2Driver = net_landriverlevel;
+
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
+	MSG_WriteString(&net_message, "");
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &sendaddr);
+	SZ_Clear(&net_message);
+	SchedulePollProcedure(&test2PollProcedure, 0.05);
+}
+
+
+static void Query_Init (void);
+static void Query_Stop (void);
+
+int Datagram_Init (void)
+{
+	int	i, num_inited;
+	sys_socket_t	csock;
+
+#ifdef BAN_TEST
+	banAddr.s_addr = INADDR_ANY;
+	banMask.s_addr = INADDR_NONE;
+#endif
+	myDriverLevel = net_driverlevel;
+
+	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cvar_RegisterVariable (&net_mux);
+	Cvar_RegisterVariable (&net_window);
+	Cvar_RegisterVariable (&net_compress);
+	Cvar_RegisterVariable (&net_compress_min);
+	Cvar_RegisterVariable (&net_fakelag);
+	Cvar_RegisterVariable (&net_fakejitter);
+	Cvar_RegisterVariable (&net_fakeloss);
+	Cvar_RegisterVariable (&net_fakedup);
+	Cvar_RegisterVariable (&net_fakerate);
+	Cvar_RegisterVariable (&net_fakeseed);
+	Cvar_RegisterVariable (&net_fakedir);
+	Cmd_AddCommand ("net_fakestats", Impair_Stats_f);
+	Query_Init ();
+
+	if (safemode || COM_CheckParm("-nolan"))
+		return -1;
+
+	num_inited = 0;
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		csock = net_landrivers[i].Init ();
+		if (csock == INVALID_SOCKET)
+			continue;
+		net_landrivers[i].initialized = true;
+		net_landrivers[i].controlSock = csock;
+		num_inited++;
+	}
+
+	if (num_inited == 0)
+		return -1;
+
+#ifdef BAN_TEST
+	Cmd_AddCommand ("ban", NET_Ban_f);
+#endif
+	Cmd_AddCommand ("test", Test_f);
+	Cmd_AddCommand ("test2", Test2_f);
+
+	return 0;
+}
+
+
+void Datagram_Shutdown (void)
+{
+	int i;
+
+	Datagram_Flush ();
+	Query_Stop ();
+
+//
+// shutdown the lan drivers
+//
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		if (net_landrivers[i].initialized)
+		{
+			net_landrivers[i].Shutdown ();
+			net_landrivers[i].initialized = false;
+		}
+	}
+}
+
+
+void Datagram_Close (qsocket_t *sock)
+{
+	Window_Free (sock);
+	Impair_Free (sock);
+	if (sock->driverdata)
+	{
+		Mux_CloseConn (sock);	// the socket belongs to the listener
+		return;
+	}
+	sfunc.Close_Socket(sock->socket);
+}
+
+
+void Datagram_Listen (qboolean state)
+{
+	int i;
+
+	Datagram_Flush ();
+
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		if (net_landrivers[i].initialized)
+			net_landrivers[i].Listen (state);
+	}
+}
+
+
+/*
+==================
+Datagram_ReadFeatures
+
+Parses the optional trailer of CCREQ_CONNECT/CCREP_ACCEPT (see net_defs.h)
+==================
+*/
+static void Datagram_ReadFeatures (qboolean *window, qboolean *compress)
+{
+	int	magic;
+
+	*window = *compress = false;
+	if (msg_readcount + 5 > net_message.cursize || MSG_ReadByte() != 0)
+		return;
+
+	while (msg_readcount + 4 <= net_message.cursize)
+	{
+		magic = MSG_ReadLong ();
+		if (magic == NET_WINDOW_MAGIC)
+			*window = true;
+		else if (magic == NET_COMPRESS_MAGIC)
+			*compress = true;
+	}
+}
+
+static void Datagram_WriteFeatures (qboolean window, qboolean compress)
+{
+	if (!window && !compress)
+		return;
+
+	MSG_WriteByte(&net_message, 0);
+	if (window)
+		MSG_WriteLong(&net_message, NET_WINDOW_MAGIC);
+	if (compress)
+		MSG_WriteLong(&net_message, NET_COMPRESS_MAGIC);
+}
+
+
+static qsocket_t *_Datagram_CheckNewConnections (void)
+{
+	struct qsockaddr clientaddr;
+	struct qsockaddr newaddr;
+	sys_socket_t		newsock;
+	sys_socket_t		acceptsock;
+	qsocket_t	*sock;
+	qsocket_t	*s;
+	int			len;
+	int			command;
+	int			control;
+	int			ret;
+	qboolean	wantwindow;
+	qboolean	wantcompress;
+
+	if (Mux_Active ())
+	{
+		// the listen socket is drained by Mux_Pump, connectionless packets wait in a queue
+		acceptsock = dfunc.GetListenSocket();
+		if (acceptsock == INVALID_SOCKET)
+			return NULL;
+		SZ_Clear(&net_message);
+		len = Mux_ReadControl (net_message.data, net_message.maxsize, &clientaddr);
+	}
+	else
+	{
+		acceptsock = dfunc.CheckNewConnections();
+		if (acceptsock == INVALID_SOCKET)
+			return NULL;
+		SZ_Clear(&net_message);
+		len = dfunc.Read (acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+	}
+	if (len < (int) sizeof(int))
+		return NULL;
+	net_message.cursize = len;
+
+	MSG_BeginReading ();
+	control = BigLong(*((int *)net_message.data));
+	MSG_ReadLong();
+	if (control == -1)
+		return NULL;
+	if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
+		return NULL;
+	if ((control & NETFLAG_LENGTH_MASK) != len)
+		return NULL;
 
-		// see if we can resolve the host name
-		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
-			break;
+	command = MSG_ReadByte();
+	if (command == CCREQ_SERVER_INFO)
+	{
+		if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
+			return NULL;
+
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_SERVER_INFO);
+		dfunc.GetSocketAddr(acceptsock, &newaddr);
+		MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+		MSG_WriteString(&net_message, hostname.string);
+		MSG_WriteString(&net_message, sv->name);
+		MSG_WriteByte(&net_message, net_activeconnections);
+		MSG_WriteByte(&net_message, svs.maxclients);
+		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
 	}
 
-	if (net_landriverlevel == net_numlandrivers)
+	if (command == CCREQ_PLAYER_INFO)
 	{
-		Con_Printf("Could not resolve %s\n", host);
-		return;
-	}
+		int			playerNumber;
+		int			activeNumber;
+		int			clientNumber;
+		client_t	*client;
 
-JustDoIt:
-	testSocket = dfunc.Open_Socket(0);
-	if (testSocket == INVALID_SOCKET)
-		return;
+		playerNumber = MSG_ReadByte();
+		activeNumber = -1;
 
-	testInProgress = true;
-	testPollCount = 20;
-	testDriver = net_landriverlevel;
+		for (clientNumber = 0, client = svs.clients; clientNumber < svs.maxclients; clientNumber++, client++)
+		{
+			if (client->active)
+			{
+				activeNumber++;
+				if (activeNumber == playerNumber)
+					break;
+			}
+		}
+
+		if (clientNumber == svs.maxclients)
+			return NULL;
 
-	for (n = 0; n < maxusers; n++)
-	{
 		SZ_Clear(&net_message);
 		// save space for the header, filled in later
 		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREQ_PLAYER_INFO);
-		MSG_WriteByte(&net_message, n);
+		MSG_WriteByte(&net_message, CCREP_PLAYER_INFO);
+		MSG_WriteByte(&net_message, playerNumber);
+		MSG_WriteString(&net_message, client->name);
+		MSG_WriteLong(&net_message, client->colors);
+		MSG_WriteLong(&net_message, (int)client->edict->v.frags);
+		MSG_WriteLong(&net_message, (int)(net_time - client->netconnection->connecttime));
+		MSG_WriteString(&net_message, client->netconnection->address);
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (testSocket, net_message.data, net_message.cursize, &sendaddr);
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+
+		return NULL;
 	}
-	SZ_Clear(&net_message);
-	SchedulePollProcedure(&testPollProcedure, 0.1);
-}
 
+	if (command == CCREQ_RULE_INFO)
+	{
+		const char	*prevCvarName;
+		cvar_t			*var;
 
-static qboolean test2InProgress = false;
-static int		test2Driver;
-static sys_socket_t	test2Socket;
+		// find the search start location
+		prevCvarName = MSG_ReadString();
+		var = Cvar_FindVarAfter (prevCvarName, CVAR_SERVERINFO);
 
-static void Test2_Poll (void *);
-static PollProcedure	test2PollProcedure = {NULL, 0.0, Test2_Poll};
+		// send the response
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_RULE_INFO);
+		if (var)
+		{
+			MSG_WriteString(&net_message, var->name);
+			MSG_WriteString(&net_message, var->string);
+		}
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
 
-static void Test2_Poll (void *unused)
-{
-	struct qsockaddr clientaddr;
-	int		control;
-	int		len;
-	char	name[256];
-	char	value[256];
+		return NULL;
+	}
 
-	net_landriverlevel = test2Driver;
-	name[0] = 0;
+	if (command != CCREQ_CONNECT)
+		return NULL;
 
-	len = dfunc.Read (test2Socket, net_message.data, net_message.maxsize, &clientaddr);
-	if (len < (int) sizeof(int))
-		goto Reschedule;
+	if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
+		return NULL;
 
-	net_message.cursize = len;
+	if (MSG_ReadByte() != NET_PROTOCOL_VERSION)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_REJECT);
+		MSG_WriteString(&net_message, "Incompatible version.\n");
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
 
-	MSG_BeginReading ();
-	control = BigLong(*((int *)net_message.data));
-	MSG_ReadLong();
-	if (control == -1)
-		goto Error;
-	if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
-		goto Error;
-	if ((control & NETFLAG_LENGTH_MASK) != len)
-		goto Error;
+	// optional trailer from clients that support the windowed reliable channel or compression
+	Datagram_ReadFeatures (&wantwindow, &wantcompress);
+	wantwindow = wantwindow && net_window.value != 0.f;
+	wantcompress = wantcompress && net_compress.value != 0.f;
 
-	if (MSG_ReadByte() != CCREP_RULE_INFO)
-		goto Error;
+#ifdef BAN_TEST
+	// check for a ban
+	if (clientaddr.qsa_family == AF_INET)
+	{
+		in_addr_t	testAddr;
+		testAddr = ((struct sockaddr_in *)&clientaddr)->sin_addr.s_addr;
+		if ((testAddr & banMask.s_addr) == banAddr.s_addr)
+		{
+			SZ_Clear(&net_message);
+			// save space for the header, filled in later
+			MSG_WriteLong(&net_message, 0);
+			MSG_WriteByte(&net_message, CCREP_REJECT);
+			MSG_WriteString(&net_message, "You have been banned.\n");
+			*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+			dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+			SZ_Clear(&net_message);
+			return NULL;
+		}
+	}
+#endif
 
-	Q_strcpy(name, MSG_ReadString());
-	if (name[0] == 0)
-		goto Done;
-	Q_strcpy(value, MSG_ReadString());
+	// see if this guy is already connected
+	for (s = net_activeSockets; s; s = s->next)
+	{
+		if (s->driver != net_driverlevel)
+			continue;
+		ret = dfunc.AddrCompare(&clientaddr, &s->addr);
+		if (ret >= 0)
+		{
+			// is this a duplicate connection reqeust?
+			if (ret == 0 && net_time - s->connecttime < 2.0)
+			{
+				// yes, so send a duplicate reply
+				SZ_Clear(&net_message);
+				// save space for the header, filled in later
+				MSG_WriteLong(&net_message, 0);
+				MSG_WriteByte(&net_message, CCREP_ACCEPT);
+				dfunc.GetSocketAddr(s->socket, &newaddr);
+				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+				Datagram_WriteFeatures (s->window != NULL, s->compress);
+				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+				SZ_Clear(&net_message);
+				return NULL;
+			}
+			// it's somebody coming back in from a crash/disconnect
+			// so close the old qsocket and let their retry get them back in
+			NET_Close(s);
+			return NULL;
+		}
+	}
 
-	Con_Printf("%-16.16s  %-16.16s\n", name, value);
+	// allocate a QSocket
+	sock = NET_NewQSocket ();
+	if (sock == NULL)	// no room; try to let him know
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_REJECT);
+		MSG_WriteString(&net_message, "Server is full.\n");
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
+
+	if (net_mux.value)
+	{
+		// share the listen socket, the accept reply below then names the server port
+		newsock = acceptsock;
+		sock->driverdata = calloc (1, sizeof (muxconn_t));
+		if (!sock->driverdata)
+		{
+			NET_FreeQSocket(sock);
+			return NULL;
+		}
+		mux_numconns++;
+	}
+	else
+	{
+		// allocate a network socket
+		newsock = dfunc.Open_Socket(0);
+		if (newsock == INVALID_SOCKET)
+		{
+			NET_FreeQSocket(sock);
+			return NULL;
+		}
+
+		// connect to the client
+		if (dfunc.Connect (newsock, &clientaddr) == -1)
+		{
+			dfunc.Close_Socket(newsock);
+			NET_FreeQSocket(sock);
+			return NULL;
+		}
+	}
+
+	// everything is allocated, just fill in the details
+	sock->socket = newsock;
+	sock->landriver = net_landriverlevel;
+	sock->addr = clientaddr;
+	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
+	if (wantwindow)
+		sock->window = Window_Alloc ();
+	sock->compress = wantcompress;
 
+	// send him back the info about the server connection he has been allocated
 	SZ_Clear(&net_message);
 	// save space for the header, filled in later
 	MSG_WriteLong(&net_message, 0);
-	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
-	MSG_WriteString(&net_message, name);
+	MSG_WriteByte(&net_message, CCREP_ACCEPT);
+	dfunc.GetSocketAddr(newsock, &newaddr);
+	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+//	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+	Datagram_WriteFeatures (sock->window != NULL, sock->compress);
 	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &clientaddr);
+	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
 	SZ_Clear(&net_message);
-
-Reschedule:
-	SchedulePollProcedure(&test2PollProcedure, 0.05);
-	return;
-
-Error:
-	Con_Printf("Unexpected response to Rule Info request\n");
-Done:
-	dfunc.Close_Socket(test2Socket);
-	test2InProgress = false;
-	return;
+
+	return sock;
 }
 
-static void Test2_f (void)
+qsocket_t *Datagram_CheckNewConnections (void)
 {
-	const char	*host;
-	int		n;
-	struct qsockaddr sendaddr;
-
-	if (test2InProgress)
-		return;
-
-	host = Strip_Port (Cmd_Argv(1));
+	qsocket_t *ret = NULL;
 
-	if (host && hostCacheCount)
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
 	{
-		for (n = 0; n < hostCacheCount; n++)
+		if (net_landrivers[net_landriverlevel].initialized)
 		{
-			if (q_strcasecmp (host, hostcache[n].name) == 0)
-			{
-				if (hostcache[n].driver != myDriverLevel)
-					continue;
-				net_landriverlevel = hostcache[n].ldriver;
-				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
+			if ((ret = _Datagram_CheckNewConnections ()) != NULL)
 				break;
-			}
 		}
-
-		if (n < hostCacheCount)
-			goto JustDoIt;
 	}
+	return ret;
+}
 
-	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
-	{
-		if (!net_landrivers[net_landriverlevel].initialized)
-			continue;
-
-		// see if we can resolve the host name
-		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
-			break;
-	}
 
-	if (net_landriverlevel == net_numlandrivers)
-	{
-		Con_Printf("Could not resolve %s\n", host);
-		return;
-	}
+/*
+=============================================================================
+
+SERVER QUERIES
+
+slist hands the whole search to a worker thread, so that hundreds of servers
+can be asked at once and every reply is timed the moment it arrives. Besides
+the broadcast, each address listed in servers.txt and in the cache of the last
+results (slist.txt, both in the user directory) is asked directly.
+
+The lan drivers aren't thread safe (they print, keep static buffers and look
+names up with gethostbyname), so everything that goes through them happens on
+the main thread, which only sends the broadcast before the worker starts. The
+worker resolves the targets itself with getaddrinfo, so slow lookups don't
+stall the frame, then does plain sendto/recvfrom on the control sockets of the
+IP drivers and keeps quiet about errors, leaving the first one in query_error
+for the main thread to report. Replies on other drivers (IPX) are read by the
+main thread as it polls. Without getaddrinfo (winsock 1, Amiga) names are
+still looked up by the driver before the worker starts.
+
+=============================================================================
+*/
 
-JustDoIt:
-	test2Socket = dfunc.Open_Socket(0);
-	if (test2Socket == INVALID_SOCKET)
-		return;
+#define QUERY_SERVERSFILE	"servers.txt"
+#define QUERY_CACHEFILE		"slist.txt"
+#define QUERY_MAXTARGETS	1024
+#define QUERY_BURST			64		// requests sent between two receive passes
+#define QUERY_RETRYTIME		0.5		// unanswered targets are asked again after this long
 
-	test2InProgress = true;
-	test2Driver = net_landriverlevel;
+#if !defined(PLATFORM_AMIGA) && (!defined(PLATFORM_WINDOWS) || defined(_USE_WINSOCK2))
+#define QUERY_GETADDRINFO	// targets are resolved by the worker thread
+#endif
 
-	SZ_Clear(&net_message);
-	// save space for the header, filled in later
-	MSG_WriteLong(&net_message, 0);
-	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
-	MSG_WriteString(&net_message, "");
-	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &sendaddr);
-	SZ_Clear(&net_message);
-	SchedulePollProcedure(&test2PollProcedure, 0.05);
-}
+static cvar_t	slist_timeout = {"slist_timeout", "1.5", CVAR_ARCHIVE};
 
+typedef struct
+{
+	char				name[NET_NAMELEN];
+	struct qsockaddr	addr;
+	int					landriver;		// -1 if the name didn't resolve
+	double				sendtime;
+	qboolean			answered;
+} querytarget_t;
+
+typedef struct
+{
+	struct qsockaddr	addr;
+	int					landriver;
+	int					ping;			// milliseconds
+	int					users;
+	int					maxusers;
+	int					protocol;
+	char				name[16];
+	char				map[16];
+} queryreply_t;
+
+static SDL_Thread		*query_thread;
+static SDL_atomic_t		query_done;
+static SDL_atomic_t		query_cancel;
+static SDL_SpinLock		query_lock;
+static querytarget_t	*query_targets;		// only touched by the thread while it runs
+static queryreply_t		*query_replies;		// guarded by query_lock
+static SDL_atomic_t		query_error;		// first socket error seen by the thread
+static struct qsockaddr	query_myaddr[MAX_NET_DRIVERS];
+static qboolean			query_rawio[MAX_NET_DRIVERS];	// plain IP socket, the thread reads it itself
+static int				query_ipdriver;		// lan driver the targets are asked on, -1 if none
+static double			query_broadcasttime[MAX_NET_DRIVERS];
+static double			query_timeout;
 
-int Datagram_Init (void)
+/*
+==================
+Query_AddTarget
+==================
+*/
+static void Query_AddTarget (const char *name)
 {
-	int	i, num_inited;
-	sys_socket_t	csock;
+	querytarget_t	target;
+	size_t			i;
 
-#ifdef BAN_TEST
-	banAddr.s_addr = INADDR_ANY;
-	banMask.s_addr = INADDR_NONE;
-#endif
-	myDriverLevel = net_driverlevel;
+	for (i = 0; i < VEC_SIZE (query_targets); i++)
+		if (!q_strcasecmp (query_targets[i].name, name))
+			return;
+	if (VEC_SIZE (query_targets) >= QUERY_MAXTARGETS)
+		return;
 
-	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	memset (&target, 0, sizeof (target));
+	q_strlcpy (target.name, name, sizeof (target.name));
+	target.landriver = -1;
+	VEC_PUSH (query_targets, target);
+}
 
-	if (safemode || COM_CheckParm("-nolan"))
-		return -1;
+/*
+==================
+Query_LoadFile
 
-	num_inited = 0;
-	for (i = 0; i < net_numlandrivers; i++)
+One address per line, anything after it is ignored
+==================
+*/
+static void Query_LoadFile (const char *filename)
+{
+	char	line[256];
+	char	*p, *end;
+	FILE	*f;
+
+	f = Sys_fopen (va ("%s/%s", host_parms->userdir, filename), "rt");
+	if (!f)
+		return;
+
+	while (fgets (line, sizeof (line), f))
 	{
-		csock = net_landrivers[i].Init ();
-		if (csock == INVALID_SOCKET)
+		p = line;
+		while (*p && q_isspace (*p))
+			p++;
+		if (!*p || *p == '#' || (p[0] == '/' && p[1] == '/'))
 			continue;
-		net_landrivers[i].initialized = true;
-		net_landrivers[i].controlSock = csock;
-		num_inited++;
+		end = p;
+		while (*end && !q_isspace (*end))
+			end++;
+		*end = 0;
+		Query_AddTarget (p);
 	}
 
-	if (num_inited == 0)
-		return -1;
-
-#ifdef BAN_TEST
-	Cmd_AddCommand ("ban", NET_Ban_f);
-#endif
-	Cmd_AddCommand ("test", Test_f);
-	Cmd_AddCommand ("test2", Test2_f);
-
-	return 0;
+	fclose (f);
 }
 
-
-void Datagram_Shutdown (void)
+/*
+==================
+Query_SaveCache
+==================
+*/
+static void Query_SaveCache (void)
 {
-	int i;
+	FILE	*f;
+	int		i;
 
-//
-// shutdown the lan drivers
-//
-	for (i = 0; i < net_numlandrivers; i++)
+	f = Sys_fopen (va ("%s/%s", host_parms->userdir, QUERY_CACHEFILE), "wt");
+	if (!f)
 	{
-		if (net_landrivers[i].initialized)
-		{
-			net_landrivers[i].Shutdown ();
-			net_landrivers[i].initialized = false;
-		}
+		Con_DPrintf ("Couldn't write %s\n", QUERY_CACHEFILE);
+		return;
 	}
-}
 
+	for (i = 0; i < hostCacheCount; i++)
+		if (hostcache[i].driver == net_driverlevel)
+			fprintf (f, "%s\t%s\t%d ms\n", hostcache[i].cname, hostcache[i].name, hostcache[i].ping);
 
-void Datagram_Close (qsocket_t *sock)
-{
-	sfunc.Close_Socket(sock->socket);
+	fclose (f);
 }
 
+/*
+==================
+Query_ReadString
 
-void Datagram_Listen (qboolean state)
+Bounded MSG_ReadString for the worker thread, which can't use net_message
+==================
+*/
+static qboolean Query_ReadString (const byte **p, const byte *end, char *out, size_t size)
 {
-	int i;
+	size_t	len = 0;
 
-	for (i = 0; i < net_numlandrivers; i++)
+	while (*p < end && **p)
 	{
-		if (net_landrivers[i].initialized)
-			net_landrivers[i].Listen (state);
+		if (len + 1 < size)
+			out[len++] = (char) **p;
+		(*p)++;
 	}
-}
+	out[len] = 0;
+	if (*p >= end)
+		return false;
+	(*p)++;
 
+	return true;
+}
 
-static qsocket_t *_Datagram_CheckNewConnections (void)
+/*
+==================
+Query_ParseReply
+==================
+*/
+static qboolean Query_ParseReply (const byte *data, int len, queryreply_t *reply)
 {
-	struct qsockaddr clientaddr;
-	struct qsockaddr newaddr;
-	sys_socket_t		newsock;
-	sys_socket_t		acceptsock;
-	qsocket_t	*sock;
-	qsocket_t	*s;
-	int			len;
-	int			command;
+	const byte	*p, *end;
+	char		address[NET_NAMELEN];
 	int			control;
-	int			ret;
-
-	acceptsock = dfunc.CheckNewConnections();
-	if (acceptsock == INVALID_SOCKET)
-		return NULL;
 
-	SZ_Clear(&net_message);
-
-	len = dfunc.Read (acceptsock, net_message.data, net_message.maxsize, &clientaddr);
-	if (len < (int) sizeof(int))
-		return NULL;
-	net_message.cursize = len;
+	if (len < (int) sizeof(int) + 1)
+		return false;
 
-	MSG_BeginReading ();
-	control = BigLong(*((int *)net_message.data));
-	MSG_ReadLong();
+	control = BigLong(*((int *)data));
 	if (control == -1)
-		return NULL;
+		return false;
 	if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
-		return NULL;
+		return false;
 	if ((control & NETFLAG_LENGTH_MASK) != len)
-		return NULL;
+		return false;
+	if (data[4] != CCREP_SERVER_INFO)
+		return false;
+
+	// the address the server reports is skipped, replies are keyed by
+	// where they came from so that servers behind NAT are reachable
+	p = data + 5;
+	end = data + len;
+	if (!Query_ReadString (&p, end, address, sizeof (address)) ||
+		!Query_ReadString (&p, end, reply->name, sizeof (reply->name)) ||
+		!Query_ReadString (&p, end, reply->map, sizeof (reply->map)) ||
+		end - p < 3)
+		return false;
+
+	reply->users = p[0];
+	reply->maxusers = p[1];
+	reply->protocol = p[2];
 
-	command = MSG_ReadByte();
-	if (command == CCREQ_SERVER_INFO)
+	return true;
+}
+
+/*
+==================
+Query_SetError
+==================
+*/
+static void Query_SetError (int err)
+{
+	SDL_AtomicCAS (&query_error, 0, err);
+}
+
+/*
+==================
+Query_RawRead
+
+The driver's Read without the console output, for the worker thread
+==================
+*/
+static int Query_RawRead (int landriver, byte *buf, int len, struct qsockaddr *addr)
+{
+	socklen_t	addrlen = sizeof (struct qsockaddr);
+	int			ret, err;
+
+	ret = recvfrom (net_landrivers[landriver].controlSock, (char *)buf, len, 0, (struct sockaddr *)addr, &addrlen);
+	if (ret == SOCKET_ERROR)
 	{
-		if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
-			return NULL;
+		err = SOCKETERRNO;
+		if (err != NET_EWOULDBLOCK && err != NET_ECONNREFUSED)
+			Query_SetError (err);
+		return 0;
+	}
 
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREP_SERVER_INFO);
-		dfunc.GetSocketAddr(acceptsock, &newaddr);
-		MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
-		MSG_WriteString(&net_message, hostname.string);
-		MSG_WriteString(&net_message, sv.name);
-		MSG_WriteByte(&net_message, net_activeconnections);
-		MSG_WriteByte(&net_message, svs.maxclients);
-		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-		return NULL;
+	return ret;
+}
+
+/*
+==================
+Query_RawWrite
+
+The driver's Write without the console output, for the worker thread
+==================
+*/
+static void Query_RawWrite (int landriver, byte *buf, int len, struct qsockaddr *addr)
+{
+	int err;
+
+	if (sendto (net_landrivers[landriver].controlSock, (char *)buf, len, 0, (struct sockaddr *)addr, sizeof (struct qsockaddr)) == SOCKET_ERROR)
+	{
+		err = SOCKETERRNO;
+		if (err != NET_EWOULDBLOCK)
+			Query_SetError (err);
 	}
+}
 
-	if (command == CCREQ_PLAYER_INFO)
+/*
+==================
+Query_Receive
+
+Drains one lan driver's control socket, returns the number of replies.
+Drivers with query_rawio set are only read by the worker thread, the others
+only by the main thread.
+==================
+*/
+static int Query_Receive (int landriver)
+{
+	net_landriver_t	*drv = &net_landrivers[landriver];
+	byte			buf[MAX_DATAGRAM];
+	struct qsockaddr readaddr;
+	queryreply_t	reply;
+	double			sendtime, now;
+	size_t			i;
+	int				ret, count = 0;
+
+	for (;;)
 	{
-		int			playerNumber;
-		int			activeNumber;
-		int			clientNumber;
-		client_t	*client;
+		if (query_rawio[landriver])
+			ret = Query_RawRead (landriver, buf, sizeof (buf), &readaddr);
+		else
+			ret = drv->Read (drv->controlSock, buf, sizeof (buf), &readaddr);
+		if (ret <= 0)
+			break;
+		now = Sys_DoubleTime ();
 
-		playerNumber = MSG_ReadByte();
-		activeNumber = -1;
+		// don't answer our own query
+		if (drv->AddrCompare (&readaddr, &query_myaddr[landriver]) >= 0)
+			continue;
+		if (!Query_ParseReply (buf, ret, &reply))
+			continue;
 
-		for (clientNumber = 0, client = svs.clients; clientNumber < svs.maxclients; clientNumber++, client++)
+		sendtime = query_broadcasttime[landriver];
+		for (i = 0; i < VEC_SIZE (query_targets); i++)
 		{
-			if (client->active)
+			querytarget_t *target = &query_targets[i];
+			if (target->landriver == landriver && drv->AddrCompare (&readaddr, &target->addr) == 0)
 			{
-				activeNumber++;
-				if (activeNumber == playerNumber)
-					break;
+				target->answered = true;
+				sendtime = target->sendtime;
+				break;
 			}
 		}
 
-		if (clientNumber == svs.maxclients)
-			return NULL;
+		reply.addr = readaddr;
+		reply.landriver = landriver;
+		reply.ping = (int) ((now - sendtime) * 1000.0 + 0.5);
 
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREP_PLAYER_INFO);
-		MSG_WriteByte(&net_message, playerNumber);
-		MSG_WriteString(&net_message, client->name);
-		MSG_WriteLong(&net_message, client->colors);
-		MSG_WriteLong(&net_message, (int)client->edict->v.frags);
-		MSG_WriteLong(&net_message, (int)(net_time - client->netconnection->connecttime));
-		MSG_WriteString(&net_message, client->netconnection->address);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
+		SDL_AtomicLock (&query_lock);
+		VEC_PUSH (query_replies, reply);
+		SDL_AtomicUnlock (&query_lock);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+==================
+Query_ReceiveAll
+
+rawio picks the drivers read by the worker thread or by the main thread
+==================
+*/
+static int Query_ReceiveAll (qboolean rawio)
+{
+	int i, count = 0;
+
+	for (i = 0; i < net_numlandrivers; i++)
+		if (net_landrivers[i].initialized && query_rawio[i] == rawio)
+			count += Query_Receive (i);
+
+	return count;
+}
+
+/*
+==================
+Query_MakeRequest
+==================
+*/
+static int Query_MakeRequest (byte *request)
+{
+	int len;
 
-		return NULL;
-	}
+	*((int *)request) = 0;
+	request[4] = CCREQ_SERVER_INFO;
+	memcpy (request + 5, "QUAKE", 6);
+	request[11] = NET_PROTOCOL_VERSION;
+	len = 12;
+	*((int *)request) = BigLong(NETFLAG_CTL | (len & NETFLAG_LENGTH_MASK));
 
-	if (command == CCREQ_RULE_INFO)
+	return len;
+}
+
+/*
+==================
+Query_Broadcast
+
+Main thread only: the driver may have to make its socket broadcast capable
+first, and says so on the console if that fails
+==================
+*/
+static void Query_Broadcast (void)
+{
+	byte	request[16];
+	int		len, i;
+
+	len = Query_MakeRequest (request);
+	for (i = 0; i < net_numlandrivers; i++)
 	{
-		const char	*prevCvarName;
-		cvar_t			*var;
+		if (!net_landrivers[i].initialized)
+			continue;
+		query_broadcasttime[i] = Sys_DoubleTime ();
+		net_landrivers[i].Broadcast (net_landrivers[i].controlSock, request, len);
+	}
+}
 
-		// find the search start location
-		prevCvarName = MSG_ReadString();
-		var = Cvar_FindVarAfter (prevCvarName, CVAR_SERVERINFO);
+#ifdef QUERY_GETADDRINFO
+/*
+==================
+Query_Resolve
 
-		// send the response
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREP_RULE_INFO);
-		if (var)
-		{
-			MSG_WriteString(&net_message, var->name);
-			MSG_WriteString(&net_message, var->string);
-		}
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
+Reentrant lookup of a "host" or "host:port" target for the worker thread
+==================
+*/
+static qboolean Query_Resolve (const char *name, struct qsockaddr *addr)
+{
+	struct addrinfo	hints, *res;
+	char			host[NET_NAMELEN];
+	char			*colon;
+	int				port;
+
+	q_strlcpy (host, name, sizeof (host));
+	port = net_hostport;
+	colon = strrchr (host, ':');
+	if (colon)
+	{
+		*colon = '\0';
+		port = atoi (colon + 1);
+		if (port <= 0 || port > 65535)
+			return false;
+	}
 
-		return NULL;
+	memset (&hints, 0, sizeof (hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo (host, NULL, &hints, &res) != 0)
+		return false;
+	if (!res || res->ai_addrlen > sizeof (struct qsockaddr))
+	{
+		if (res)
+			freeaddrinfo (res);
+		return false;
 	}
 
-	if (command != CCREQ_CONNECT)
-		return NULL;
+	memset (addr, 0, sizeof (*addr));
+	memcpy (addr, res->ai_addr, res->ai_addrlen);
+	addr->qsa_family = AF_INET;
+	((struct sockaddr_in *)addr)->sin_port = htons ((unsigned short) port);
+	freeaddrinfo (res);
 
-	if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
-		return NULL;
+	return true;
+}
+#endif
 
-	if (MSG_ReadByte() != NET_PROTOCOL_VERSION)
+/*
+==================
+Query_Send
+
+Asks each target directly. With retry set, only the targets that haven't
+answered yet are asked.
+==================
+*/
+static void Query_Send (qboolean retry)
+{
+	byte	request[16];
+	int		len, sent;
+	size_t	t;
+
+	len = Query_MakeRequest (request);
+	for (t = 0, sent = 0; t < VEC_SIZE (query_targets); t++)
 	{
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREP_REJECT);
-		MSG_WriteString(&net_message, "Incompatible version.\n");
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-		return NULL;
+		querytarget_t *target = &query_targets[t];
+		if (target->landriver < 0 || (retry && target->answered))
+			continue;
+
+		target->sendtime = Sys_DoubleTime ();
+		Query_RawWrite (target->landriver, request, len, &target->addr);
+
+		// don't let the socket buffers fill up with early replies
+		if (++sent % QUERY_BURST == 0)
+			Query_ReceiveAll (true);
 	}
+}
 
-#ifdef BAN_TEST
-	// check for a ban
-	if (clientaddr.qsa_family == AF_INET)
+/*
+==================
+Query_Thread
+==================
+*/
+static int SDLCALL Query_Thread (void *unused)
+{
+	double	start, elapsed;
+	size_t	t;
+	qboolean retried, pending;
+
+#ifdef QUERY_GETADDRINFO
+	for (t = 0; t < VEC_SIZE (query_targets) && query_ipdriver >= 0; t++)
 	{
-		in_addr_t	testAddr;
-		testAddr = ((struct sockaddr_in *)&clientaddr)->sin_addr.s_addr;
-		if ((testAddr & banMask.s_addr) == banAddr.s_addr)
-		{
-			SZ_Clear(&net_message);
-			// save space for the header, filled in later
-			MSG_WriteLong(&net_message, 0);
-			MSG_WriteByte(&net_message, CCREP_REJECT);
-			MSG_WriteString(&net_message, "You have been banned.\n");
-			*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-			dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-			SZ_Clear(&net_message);
-			return NULL;
-		}
+		querytarget_t *target = &query_targets[t];
+		if (SDL_AtomicGet (&query_cancel))
+			break;
+		if (Query_Resolve (target->name, &target->addr))
+			target->landriver = query_ipdriver;
+		// keep up with the broadcast replies while lookups are slow
+		Query_ReceiveAll (true);
 	}
 #endif
 
-	// see if this guy is already connected
-	for (s = net_activeSockets; s; s = s->next)
+	start = Sys_DoubleTime ();
+	Query_Send (false);
+	retried = false;
+
+	while (!SDL_AtomicGet (&query_cancel))
 	{
-		if (s->driver != net_driverlevel)
+		if (!Query_ReceiveAll (true))
+			SDL_Delay (1);
+
+		elapsed = Sys_DoubleTime () - start;
+		if (elapsed >= query_timeout)
+			break;
+		if (elapsed < QUERY_RETRYTIME)
 			continue;
-		ret = dfunc.AddrCompare(&clientaddr, &s->addr);
-		if (ret >= 0)
+
+		if (!retried)
 		{
-			// is this a duplicate connection reqeust?
-			if (ret == 0 && net_time - s->connecttime < 2.0)
-			{
-				// yes, so send a duplicate reply
-				SZ_Clear(&net_message);
-				// save space for the header, filled in later
-				MSG_WriteLong(&net_message, 0);
-				MSG_WriteByte(&net_message, CCREP_ACCEPT);
-				dfunc.GetSocketAddr(s->socket, &newaddr);
-				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
-				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-				SZ_Clear(&net_message);
-				return NULL;
-			}
-			// it's somebody coming back in from a crash/disconnect
-			// so close the old qsocket and let their retry get them back in
-			NET_Close(s);
-			return NULL;
+			Query_Send (true);
+			retried = true;
+			continue;
 		}
-	}
 
-	// allocate a QSocket
-	sock = NET_NewQSocket ();
-	if (sock == NULL)	// no room; try to let him know
-	{
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREP_REJECT);
-		MSG_WriteString(&net_message, "Server is full.\n");
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-		return NULL;
+		// broadcast replies have had their chance, stop once every target answered
+		for (t = 0, pending = false; t < VEC_SIZE (query_targets) && !pending; t++)
+			pending = query_targets[t].landriver >= 0 && !query_targets[t].answered;
+		if (!pending)
+			break;
 	}
 
-	// allocate a network socket
-	newsock = dfunc.Open_Socket(0);
-	if (newsock == INVALID_SOCKET)
+	SDL_AtomicSet (&query_done, 1);
+
+	return 0;
+}
+
+/*
+==================
+Query_Start
+==================
+*/
+static void Query_Start (void)
+{
+#ifndef QUERY_GETADDRINFO
+	size_t	t;
+#endif
+	int		i;
+
+	if (query_thread)
+		return;		// still running, it retries on its own
+
+	VEC_CLEAR (query_targets);
+	Query_LoadFile (QUERY_SERVERSFILE);
+	Query_LoadFile (QUERY_CACHEFILE);
+
+	query_ipdriver = -1;
+	for (i = 0; i < net_numlandrivers; i++)
 	{
-		NET_FreeQSocket(sock);
-		return NULL;
+		query_rawio[i] = false;
+		if (!net_landrivers[i].initialized)
+			continue;
+		net_landrivers[i].GetSocketAddr (net_landrivers[i].controlSock, &query_myaddr[i]);
+		query_rawio[i] = query_myaddr[i].qsa_family == AF_INET;
+		if (query_rawio[i] && query_ipdriver < 0)
+			query_ipdriver = i;
 	}
 
-	// connect to the client
-	if (dfunc.Connect (newsock, &clientaddr) == -1)
+#ifndef QUERY_GETADDRINFO
+	// the drivers' lookups aren't reentrant, so names are resolved before
+	// the thread starts; the cache file only holds numeric addresses
+	for (t = 0; t < VEC_SIZE (query_targets) && query_ipdriver >= 0; t++)
 	{
-		dfunc.Close_Socket(newsock);
-		NET_FreeQSocket(sock);
-		return NULL;
+		querytarget_t *target = &query_targets[t];
+		if (net_landrivers[query_ipdriver].GetAddrFromName (target->name, &target->addr) != -1)
+			target->landriver = query_ipdriver;
 	}
+#endif
 
-	// everything is allocated, just fill in the details
-	sock->socket = newsock;
-	sock->landriver = net_landriverlevel;
-	sock->addr = clientaddr;
-	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
+	Query_Broadcast ();
 
-	// send him back the info about the server connection he has been allocated
-	SZ_Clear(&net_message);
-	// save space for the header, filled in later
-	MSG_WriteLong(&net_message, 0);
-	MSG_WriteByte(&net_message, CCREP_ACCEPT);
-	dfunc.GetSocketAddr(newsock, &newaddr);
-	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
-//	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
-	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-	SZ_Clear(&net_message);
+	query_timeout = q_max (slist_timeout.value, QUERY_RETRYTIME);
+	SDL_AtomicSet (&query_done, 0);
+	SDL_AtomicSet (&query_cancel, 0);
+	SDL_AtomicSet (&query_error, 0);
 
-	return sock;
+	query_thread = SDL_CreateThread (Query_Thread, "Server query", NULL);
+	if (!query_thread)
+	{
+		Con_DPrintf ("Query_Start: %s, searching synchronously\n", SDL_GetError ());
+		Query_Thread (NULL);
+	}
 }
 
-qsocket_t *Datagram_CheckNewConnections (void)
+/*
+==================
+Query_Init
+==================
+*/
+static void Query_Init (void)
 {
-	qsocket_t *ret = NULL;
+	Cvar_RegisterVariable (&slist_timeout);
+}
 
-	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+/*
+==================
+Query_Stop
+==================
+*/
+static void Query_Stop (void)
+{
+	if (query_thread)
 	{
-		if (net_landrivers[net_landriverlevel].initialized)
-		{
-			if ((ret = _Datagram_CheckNewConnections ()) != NULL)
-				break;
-		}
+		SDL_AtomicSet (&query_cancel, 1);
+		SDL_WaitThread (query_thread, NULL);
+		query_thread = NULL;
 	}
-	return ret;
+	SDL_AtomicSet (&query_done, 0);
+	VEC_FREE (query_targets);
+	VEC_FREE (query_replies);
 }
 
-
-static void _Datagram_SearchForHosts (qboolean xmit)
+/*
+==================
+Datagram_AddHost
+==================
+*/
+static void Datagram_AddHost (const queryreply_t *reply)
 {
-	int		ret;
-	int		n;
-	int		i;
-	struct qsockaddr readaddr;
-	struct qsockaddr myaddr;
-	int		control;
+	net_landriver_t	*drv = &net_landrivers[reply->landriver];
+	struct qsockaddr addr;
+	int				n, i;
 
-	dfunc.GetSocketAddr (dfunc.controlSock, &myaddr);
-	if (xmit)
+	addr = reply->addr;
+
+	// search the cache for this server
+	for (n = 0; n < hostCacheCount; n++)
 	{
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREQ_SERVER_INFO);
-		MSG_WriteString(&net_message, "QUAKE");
-		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Broadcast(dfunc.controlSock, net_message.data, net_message.cursize);
-		SZ_Clear(&net_message);
+		if (hostcache[n].driver == net_driverlevel && hostcache[n].ldriver == reply->landriver &&
+			drv->AddrCompare (&addr, &hostcache[n].addr) == 0)
+			break;
 	}
 
-	while ((ret = dfunc.Read (dfunc.controlSock, net_message.data, net_message.maxsize, &readaddr)) > 0)
+	// is it already there? it answered both the broadcast and a direct query
+	if (n < hostCacheCount)
 	{
-		if (ret < (int) sizeof(int))
-			continue;
-		net_message.cursize = ret;
-
-		// don't answer our own query
-		if (dfunc.AddrCompare(&readaddr, &myaddr) >= 0)
-			continue;
-
-		// is the cache full?
-		if (hostCacheCount == HOSTCACHESIZE)
-			continue;
-
-		MSG_BeginReading ();
-		control = BigLong(*((int *)net_message.data));
-		MSG_ReadLong();
-		if (control == -1)
-			continue;
-		if ((control & (~NETFLAG_LENGTH_MASK)) != (int)NETFLAG_CTL)
-			continue;
-		if ((control & NETFLAG_LENGTH_MASK) != ret)
-			continue;
+		hostcache[n].ping = q_min (hostcache[n].ping, reply->ping);
+		return;
+	}
 
-		if (MSG_ReadByte() != CCREP_SERVER_INFO)
-			continue;
+	// is the cache full?
+	if (hostCacheCount == HOSTCACHESIZE)
+		return;
 
-		dfunc.GetAddrFromName(MSG_ReadString(), &readaddr);
-		// search the cache for this server
-		for (n = 0; n < hostCacheCount; n++)
-		{
-			if (dfunc.AddrCompare(&readaddr, &hostcache[n].addr) == 0)
-				break;
-		}
+	// add it
+	hostCacheCount++;
+	Q_strcpy(hostcache[n].name, reply->name);
+	Q_strcpy(hostcache[n].map, reply->map);
+	hostcache[n].users = reply->users;
+	hostcache[n].maxusers = reply->maxusers;
+	hostcache[n].ping = reply->ping;
+	if (reply->protocol != NET_PROTOCOL_VERSION)
+	{
+		Q_strcpy(hostcache[n].cname, hostcache[n].name);
+		hostcache[n].cname[14] = 0;
+		Q_strcpy(hostcache[n].name, "*");
+		Q_strcat(hostcache[n].name, hostcache[n].cname);
+	}
+	Q_memcpy(&hostcache[n].addr, &addr, sizeof(struct qsockaddr));
+	hostcache[n].driver = net_driverlevel;
+	hostcache[n].ldriver = reply->landriver;
+	q_strlcpy(hostcache[n].cname, drv->AddrToString(&addr), sizeof(hostcache[n].cname));
 
-		// is it already there?
-		if (n < hostCacheCount)
+	// check for a name conflict
+	for (i = 0; i < hostCacheCount; i++)
+	{
+		if (i == n)
 			continue;
-
-		// add it
-		hostCacheCount++;
-		Q_strcpy(hostcache[n].name, MSG_ReadString());
-		Q_strcpy(hostcache[n].map, MSG_ReadString());
-		hostcache[n].users = MSG_ReadByte();
-		hostcache[n].maxusers = MSG_ReadByte();
-		if (MSG_ReadByte() != NET_PROTOCOL_VERSION)
+		if (q_strcasecmp (hostcache[n].name, hostcache[i].name) == 0)
 		{
-			Q_strcpy(hostcache[n].cname, hostcache[n].name);
-			hostcache[n].cname[14] = 0;
-			Q_strcpy(hostcache[n].name, "*");
-			Q_strcat(hostcache[n].name, hostcache[n].cname);
-		}
-		Q_memcpy(&hostcache[n].addr, &readaddr, sizeof(struct qsockaddr));
-		hostcache[n].driver = net_driverlevel;
-		hostcache[n].ldriver = net_landriverlevel;
-		Q_strcpy(hostcache[n].cname, dfunc.AddrToString(&readaddr));
-
-		// check for a name conflict
-		for (i = 0; i < hostCacheCount; i++)
-		{
-			if (i == n)
-				continue;
-			if (q_strcasecmp (hostcache[n].name, hostcache[i].name) == 0)
+			i = Q_strlen(hostcache[n].name);
+			if (i < 15 && hostcache[n].name[i-1] > '8')
 			{
-				i = Q_strlen(hostcache[n].name);
-				if (i < 15 && hostcache[n].name[i-1] > '8')
-				{
-					hostcache[n].name[i] = '0';
-					hostcache[n].name[i+1] = 0;
-				}
-				else
-					hostcache[n].name[i-1]++;
-
-				i = -1;
+				hostcache[n].name[i] = '0';
+				hostcache[n].name[i+1] = 0;
 			}
+			else
+				hostcache[n].name[i-1]++;
+
+			i = -1;
 		}
 	}
 }
 
-void Datagram_SearchForHosts (qboolean xmit)
+/*
+==================
+Datagram_SearchForHosts
+
+xmit starts a query, every call moves the replies received so far into
+hostcache. Returns true while the query is still running.
+==================
+*/
+qboolean Datagram_SearchForHosts (qboolean xmit)
 {
-	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	queryreply_t	*replies;
+	qboolean		done;
+	size_t			i;
+	int				err;
+
+	if (xmit)
+		Query_Start ();
+
+	if (!query_thread && !SDL_AtomicGet (&query_done))
+		return false;
+
+	// check before draining, so nothing queued after the last drain is lost
+	done = SDL_AtomicGet (&query_done) != 0;
+
+	Query_ReceiveAll (false);
+
+	SDL_AtomicLock (&query_lock);
+	replies = query_replies;
+	query_replies = NULL;
+	SDL_AtomicUnlock (&query_lock);
+
+	for (i = 0; i < VEC_SIZE (replies); i++)
+		Datagram_AddHost (&replies[i]);
+	VEC_FREE (replies);
+
+	if (!done)
+		return true;
+
+	if (query_thread)
 	{
-		if (hostCacheCount == HOSTCACHESIZE)
-			break;
-		if (net_landrivers[net_landriverlevel].initialized)
-			_Datagram_SearchForHosts (xmit);
+		SDL_WaitThread (query_thread, NULL);
+		query_thread = NULL;
 	}
+	SDL_AtomicSet (&query_done, 0);
+	VEC_FREE (query_targets);
+	Query_SaveCache ();
+
+	err = SDL_AtomicGet (&query_error);
+	if (err)
+		Con_Printf ("Server query: %s\n", socketerror (err));
+
+	return false;
 }
 
 
@@ -1241,6 +3288,7 @@ static qsocket_t *_Datagram_Connect (const char *host)
 	double		start_time;
 	int			control;
 	const char		*reason;
+	qboolean	usewindow;
 
 	// see if we can resolve the host name
 	if (dfunc.GetAddrFromName(host, &sendaddr) == -1)
@@ -1276,6 +3324,7 @@ static qsocket_t *_Datagram_Connect (const char *host)
 		MSG_WriteByte(&net_message, CCREQ_CONNECT);
 		MSG_WriteString(&net_message, "QUAKE");
 		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		Datagram_WriteFeatures (net_window.value != 0.f, net_compress.value != 0.f);
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 		dfunc.Write (newsock, net_message.data, net_message.cursize, &sendaddr);
 		SZ_Clear(&net_message);
@@ -1363,6 +3412,15 @@ static qsocket_t *_Datagram_Connect (const char *host)
 	{
 		Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
 		dfunc.SetSocketPort (&sock->addr, MSG_ReadLong());
+		Datagram_ReadFeatures (&usewindow, &sock->compress);
+		if (usewindow && net_window.value)
+		{
+			sock->window = Window_Alloc ();
+			if (sock->window)
+				Con_DPrintf ("Using windowed reliable channel\n");
+		}
+		if (sock->compress)
+			Con_DPrintf ("Using reliable message compression\n");
 	}
 	else
 	{
@@ -1390,6 +3448,7 @@ static qsocket_t *_Datagram_Connect (const char *host)
 	return sock;
 
 ErrorReturn:
+	Window_Free (sock);
 	NET_FreeQSocket(sock);
 ErrorReturn2:
 	dfunc.Close_Socket(newsock);
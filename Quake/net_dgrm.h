@@ -24,7 +24,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 int			Datagram_Init (void);
 void		Datagram_Listen (qboolean state);
-void		Datagram_SearchForHosts (qboolean xmit);
+qboolean	Datagram_SearchForHosts (qboolean xmit);
 qsocket_t	*Datagram_Connect (const char *host);
 qsocket_t	*Datagram_CheckNewConnections (void);
 int			Datagram_GetMessage (qsocket_t *sock);
@@ -34,6 +34,8 @@ qboolean	Datagram_CanSendMessage (qsocket_t *sock);
 qboolean	Datagram_CanSendUnreliableMessage (qsocket_t *sock);
 void		Datagram_Close (qsocket_t *sock);
 void		Datagram_Shutdown (void);
+void		Datagram_Flush (void);
+qboolean	Datagram_SendDrained (qsocket_t *sock);
 
 #endif	/* __NET_DATAGRAM_H */
 
@@ -48,21 +48,24 @@ void Loop_Listen (qboolean state)
 }
 
 
-void Loop_SearchForHosts (qboolean xmit)
+qboolean Loop_SearchForHosts (qboolean xmit)
 {
-	if (!sv.active)
-		return;
+	if (!sv->active || !xmit || hostCacheCount)
+		return false;
 
 	hostCacheCount = 1;
 	if (Q_strcmp(hostname.string, "UNNAMED") == 0)
 		Q_strcpy(hostcache[0].name, "local");
 	else
 		Q_strcpy(hostcache[0].name, hostname.string);
-	Q_strcpy(hostcache[0].map, sv.name);
+	Q_strcpy(hostcache[0].map, sv->name);
 	hostcache[0].users = net_activeconnections;
 	hostcache[0].maxusers = svs.maxclients;
+	hostcache[0].ping = 0;
 	hostcache[0].driver = net_driverlevel;
 	Q_strcpy(hostcache[0].cname, "local");
+
+	return false;
 }
 
 
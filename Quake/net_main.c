@@ -114,6 +114,8 @@ qsocket_t *NET_NewQSocket (void)
 	sock->driver = net_driverlevel;
 	sock->socket = 0;
 	sock->driverdata = NULL;
+	sock->window = NULL;
+	sock->impair = NULL;
 	sock->canSend = true;
 	sock->sendNext = false;
 	sock->lastMessageTime = net_time;
@@ -124,6 +126,11 @@ qsocket_t *NET_NewQSocket (void)
 	sock->receiveSequence = 0;
 	sock->unreliableReceiveSequence = 0;
 	sock->receiveMessageLength = 0;
+	sock->resends = 0;
+	sock->resent = false;
+	sock->rtt = 0;
+	sock->compress = false;
+	sock->compressSaved = 0;
 
 	return sock;
 }
@@ -170,6 +177,13 @@ const char *NET_QSocketGetAddressString (const qsocket_t *s)
 }
 
 
+void NET_QSocketGetStats (const qsocket_t *s, int *resends, double *rtt)
+{
+	*resends = s->resends;
+	*rtt = s->rtt;
+}
+
+
 static void NET_Listen_f (void)
 {
 	if (Cmd_Argc () != 2)
@@ -199,7 +213,7 @@ static void MaxPlayers_f (void)
 		return;
 	}
 
-	if (sv.active)
+	if (sv->active)
 	{
 		Con_Printf ("maxplayers can not be changed while a server is running.\n");
 		return;
@@ -259,8 +273,8 @@ static void NET_Port_f (void)
 
 static void PrintSlistHeader(void)
 {
-	Con_Printf("Server          Map             Users\n");
-	Con_Printf("--------------- --------------- -----\n");
+	Con_Printf("Server          Map             Users Ping\n");
+	Con_Printf("--------------- --------------- ----- ----\n");
 	slistLastShown = 0;
 }
 
@@ -272,9 +286,9 @@ static void PrintSlist(void)
 	for (n = slistLastShown; n < hostCacheCount; n++)
 	{
 		if (hostcache[n].maxusers)
-			Con_Printf("%-15.15s %-15.15s %2u/%2u\n", hostcache[n].name, hostcache[n].map, hostcache[n].users, hostcache[n].maxusers);
+			Con_Printf("%-15.15s %-15.15s %2u/%2u %4d\n", hostcache[n].name, hostcache[n].map, hostcache[n].users, hostcache[n].maxusers, hostcache[n].ping);
 		else
-			Con_Printf("%-15.15s %-15.15s\n", hostcache[n].name, hostcache[n].map);
+			Con_Printf("%-15.15s %-15.15s       %4d\n", hostcache[n].name, hostcache[n].map, hostcache[n].ping);
 	}
 	slistLastShown = n;
 }
@@ -310,25 +324,16 @@ void NET_Slist_f (void)
 }
 
 
+static int SlistCompare (const void *a, const void *b)
+{
+	return strcmp (((const hostcache_t *) a)->name, ((const hostcache_t *) b)->name);
+}
+
+
 void NET_SlistSort (void)
 {
 	if (hostCacheCount > 1)
-	{
-		int	i, j;
-		hostcache_t temp;
-		for (i = 0; i < hostCacheCount; i++)
-		{
-			for (j = i + 1; j < hostCacheCount; j++)
-			{
-				if (strcmp(hostcache[j].name, hostcache[i].name) < 0)
-				{
-					memcpy(&temp, &hostcache[j], sizeof(hostcache_t));
-					memcpy(&hostcache[j], &hostcache[i], sizeof(hostcache_t));
-					memcpy(&hostcache[i], &temp, sizeof(hostcache_t));
-				}
-			}
-		}
-	}
+		qsort (hostcache, hostCacheCount, sizeof (hostcache[0]), SlistCompare);
 }
 
 
@@ -341,14 +346,16 @@ const char *NET_SlistPrintServer (int idx)
 
 	if (hostcache[idx].maxusers)
 	{
-		q_snprintf(string, sizeof(string), "%-15.15s %-15.15s %2u/%2u\n",
+		q_snprintf(string, sizeof(string), "%-15.15s %-10.10s %2u/%2u %3d\n",
 					hostcache[idx].name, hostcache[idx].map,
-					hostcache[idx].users, hostcache[idx].maxusers);
+					hostcache[idx].users, hostcache[idx].maxusers,
+					q_min (hostcache[idx].ping, 999));
 	}
 	else
 	{
-		q_snprintf(string, sizeof(string), "%-15.15s %-15.15s\n",
-					hostcache[idx].name, hostcache[idx].map);
+		q_snprintf(string, sizeof(string), "%-15.15s %-10.10s       %3d\n",
+					hostcache[idx].name, hostcache[idx].map,
+					q_min (hostcache[idx].ping, 999));
 	}
 
 	return string;
@@ -373,29 +380,31 @@ static void Slist_Send (void *unused)
 			continue;
 		dfunc.SearchForHosts (true);
 	}
-
-	if ((Sys_DoubleTime() - slistStartTime) < 0.5)
-		SchedulePollProcedure(&slistSendProcedure, 0.75);
 }
 
 
 static void Slist_Poll (void *unused)
 {
+	qboolean	busy = false;
+
 	for (net_driverlevel = 0; net_driverlevel < net_numdrivers; net_driverlevel++)
 	{
 		if (!slistLocal && IS_LOOP_DRIVER(net_driverlevel))
 			continue;
 		if (net_drivers[net_driverlevel].initialized == false)
 			continue;
-		dfunc.SearchForHosts (false);
+		if (dfunc.SearchForHosts (false))
+			busy = true;
 	}
 
 	if (! slistSilent)
 		PrintSlist();
 
-	if ((Sys_DoubleTime() - slistStartTime) < 1.5)
+	// replies are collected by the drivers, this only decides how often
+	// they are picked up (and how soon the menu shows them)
+	if (busy || (Sys_DoubleTime() - slistStartTime) < 0.5)
 	{
-		SchedulePollProcedure(&slistPollProcedure, 0.1);
+		SchedulePollProcedure(&slistPollProcedure, 0.05);
 		return;
 	}
 
@@ -676,6 +685,31 @@ qboolean NET_CanSendMessage (qsocket_t *sock)
 }
 
 
+/*
+==================
+NET_SendDrained
+
+Returns true once every reliable message sent on the given qsocket has been
+acknowledged. With the reliable window, CanSendMessage only means there is
+room in the backlog.
+==================
+*/
+qboolean NET_SendDrained (qsocket_t *sock)
+{
+	if (!sock)
+		return false;
+
+	if (sock->disconnected)
+		return false;
+
+	SetNetTime();
+
+	if (sfunc.SendDrained)
+		return sfunc.SendDrained(sock);
+	return sfunc.CanSendMessage(sock);
+}
+
+
 int NET_SendToAll (sizebuf_t *data, double blocktime)
 {
 	double		start;
@@ -734,7 +768,7 @@ int NET_SendToAll (sizebuf_t *data, double blocktime)
 
 			if (! msg_sent[i])
 			{
-				if (NET_CanSendMessage (host_client->netconnection))
+				if (NET_SendDrained (host_client->netconnection))
 				{
 					msg_sent[i] = true;
 				}
@@ -781,7 +815,7 @@ void NET_Init (void)
 	}
 	net_hostport = DEFAULTnet_hostport;
 
-	net_numsockets = svs.maxclientslimit;
+	net_numsockets = svs.maxclientslimit * sv_numinstances;
 	if (cls.state != ca_dedicated)
 		net_numsockets++;
 	if (COM_CheckParm("-listen") || cls.state == ca_dedicated)
@@ -808,6 +842,8 @@ void NET_Init (void)
 	Cmd_AddCommand ("maxplayers", MaxPlayers_f);
 	Cmd_AddCommand ("port", NET_Port_f);
 
+	NetStats_Init ();
+
 	// initialize all the drivers
 	for (i = net_driverlevel = 0; net_driverlevel < net_numdrivers; net_driverlevel++)
 	{
@@ -873,6 +909,48 @@ void NET_Shutdown (void)
 	}
 }
 
+/*
+====================
+NET_GetListenSockets
+
+Fills sockets with the accept sockets of the listening lan drivers,
+so the dedicated server can sleep until a connection request arrives
+====================
+*/
+int NET_GetListenSockets (sys_socket_t *sockets, int maxsockets)
+{
+	int		i, count;
+	sys_socket_t	s;
+
+	if (!listening)
+		return 0;
+
+	for (i = 0, count = 0; i < net_numlandrivers && count < maxsockets; i++)
+	{
+		if (!net_landrivers[i].initialized)
+			continue;
+		s = net_landrivers[i].GetListenSocket ();
+		if (s != INVALID_SOCKET)
+			sockets[count++] = s;
+	}
+
+	return count;
+}
+
+/*
+====================
+NET_Flush
+====================
+*/
+void NET_Flush (void)
+{
+	int i;
+
+	for (i = 0; i < net_numdrivers; i++)
+		if (net_drivers[i].initialized && net_drivers[i].Flush)
+			net_drivers[i].Flush ();
+}
+
 
 static PollProcedure *pollProcedureList = NULL;
 
@@ -0,0 +1,264 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_stats.c -- per-connection bandwidth telemetry
+
+#include "quakedef.h"
+
+/*
+
+Every connection keeps a ring of NETSTATS_SAMPLES samples, one per network
+tick: the client starts a new sample for each unreliable message it receives,
+the server for each datagram it builds for a client.  Bytes are broken down
+by message category, so a mod flooding stuffcmds or temp entities shows up
+on scr_netgraph and in netstats_export dumps.
+
+*/
+
+netstats_t	cl_netstats;
+
+const char	*netcategory_names[NETCAT_COUNT] =
+{
+	"entities",
+	"clientdata",
+	"sound",
+	"tempents",
+	"stuffcmd",
+	"print",
+	"other",
+};
+
+/*
+==================
+NetStats_Clear
+==================
+*/
+void NetStats_Clear (netstats_t *st)
+{
+	memset (st, 0, sizeof (*st));
+}
+
+/*
+==================
+NetStats_Begin
+
+Starts a new sample, picking up resends and RTT from the socket if there is one
+==================
+*/
+netsample_t *NetStats_Begin (netstats_t *st, struct qsocket_s *sock)
+{
+	netsample_t	*s = &st->samples[st->count++ % NETSTATS_SAMPLES];
+	int			resends;
+	double		rtt;
+
+	memset (s, 0, sizeof (*s));
+	s->time = realtime;
+	if (sock)
+	{
+		NET_QSocketGetStats (sock, &resends, &rtt);
+		s->resends = resends - st->lastresends;
+		s->rtt = rtt;
+		st->lastresends = resends;
+	}
+
+	return s;
+}
+
+/*
+==================
+NetStats_Sample
+
+Returns the sample taken 'age' ticks ago (0 = current), or NULL if it was never taken
+==================
+*/
+netsample_t *NetStats_Sample (netstats_t *st, int age)
+{
+	if (age < 0 || age >= NETSTATS_SAMPLES || age >= st->count)
+		return NULL;
+	return &st->samples[(st->count - 1 - age) % NETSTATS_SAMPLES];
+}
+
+/*
+==================
+NetStats_Current
+==================
+*/
+netsample_t *NetStats_Current (netstats_t *st)
+{
+	return NetStats_Sample (st, 0);
+}
+
+/*
+==================
+NetStats_Datagram
+==================
+*/
+void NetStats_Datagram (netstats_t *st, int size, int mtu)
+{
+	netsample_t *s = NetStats_Current (st);
+
+	if (!s)
+		return;
+	s->datagrams++;
+	s->maxdatagram = q_max (s->maxdatagram, size);
+	s->mtu = mtu;
+}
+
+/*
+==================
+NetStats_Queue
+
+Notes bytes added to a reliable buffer, they are only
+accounted for once the buffer is actually sent
+==================
+*/
+void NetStats_Queue (netstats_t *st, netcategory_t cat, int bytes)
+{
+	st->pending[cat] += bytes;
+}
+
+/*
+==================
+NetStats_Reliable
+
+A reliable message of 'size' bytes went out: attribute the queued
+bytes to their categories and whatever is left over to NETCAT_OTHER
+==================
+*/
+void NetStats_Reliable (netstats_t *st, int size)
+{
+	netsample_t	*s = NetStats_Current (st);
+	int			i, n, left;
+
+	if (s)
+	{
+		s->reliable += size;
+		for (i = 0, left = size; i < NETCAT_COUNT; i++)
+		{
+			n = q_min (st->pending[i], left);
+			s->bytes[i] += n;
+			left -= n;
+		}
+		s->bytes[NETCAT_OTHER] += left;
+	}
+	memset (st->pending, 0, sizeof (st->pending));
+}
+
+/*
+==================
+NetStats_Export_f
+
+netstats_export <file> [client]
+Writes the sample history of the local client, or of the given server
+client slot, as JSON if the file name ends in .json and CSV otherwise
+==================
+*/
+static void NetStats_Export_f (void)
+{
+	char		relname[MAX_OSPATH];
+	char		name[MAX_OSPATH];
+	netstats_t	*st;
+	netsample_t	*s;
+	qboolean	json;
+	FILE		*f;
+	int			i, age, num, slot;
+
+	if (Cmd_Argc () < 2 || Cmd_Argc () > 3)
+	{
+		Con_Printf ("usage: %s <file[.csv|.json]> [client]\n", Cmd_Argv (0));
+		return;
+	}
+
+	if (Cmd_Argc () == 3)
+	{
+		slot = Q_atoi (Cmd_Argv (2));
+		if (!sv->active || slot < 1 || slot > svs.maxclients || !svs.clients[slot-1].active)
+		{
+			Con_Printf ("No active client in slot %s\n", Cmd_Argv (2));
+			return;
+		}
+		st = &svs.clients[slot-1].netstats;
+	}
+	else
+		st = &cl_netstats;
+
+	q_strlcpy (relname, Cmd_Argv (1), sizeof (relname));
+	if (!*COM_FileGetExtension (relname))
+		q_strlcat (relname, ".csv", sizeof (relname));
+	json = !q_strcasecmp (COM_FileGetExtension (relname), "json");
+	q_snprintf (name, sizeof (name), "%s/%s", com_gamedir, relname);
+	f = Sys_fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+		return;
+	}
+
+	num = q_min (st->count, NETSTATS_SAMPLES);
+	if (json)
+		fprintf (f, "[\n");
+	else
+	{
+		fprintf (f, "time");
+		for (i = 0; i < NETCAT_COUNT; i++)
+			fprintf (f, ",%s", netcategory_names[i]);
+		fprintf (f, ",datagrams,maxdatagram,mtu,reliable,resends,overflows,droppedents,rtt\n");
+	}
+
+	for (age = num - 1; age >= 0; age--)
+	{
+		s = NetStats_Sample (st, age);
+		if (json)
+		{
+			fprintf (f, "\t{\"time\": %.3f", s->time);
+			for (i = 0; i < NETCAT_COUNT; i++)
+				fprintf (f, ", \"%s\": %d", netcategory_names[i], s->bytes[i]);
+			fprintf (f, ", \"datagrams\": %d, \"maxdatagram\": %d, \"mtu\": %d, \"reliable\": %d, "
+				"\"resends\": %d, \"overflows\": %d, \"droppedents\": %d, \"rtt\": %.4f}%s\n",
+				s->datagrams, s->maxdatagram, s->mtu, s->reliable,
+				s->resends, s->overflows, s->droppedents, s->rtt, age ? "," : "");
+		}
+		else
+		{
+			fprintf (f, "%.3f", s->time);
+			for (i = 0; i < NETCAT_COUNT; i++)
+				fprintf (f, ",%d", s->bytes[i]);
+			fprintf (f, ",%d,%d,%d,%d,%d,%d,%d,%.4f\n",
+				s->datagrams, s->maxdatagram, s->mtu, s->reliable,
+				s->resends, s->overflows, s->droppedents, s->rtt);
+		}
+	}
+
+	if (json)
+		fprintf (f, "]\n");
+	fclose (f);
+
+	Con_Printf ("Wrote %d samples to %s\n", num, relname);
+}
+
+/*
+==================
+NetStats_Init
+==================
+*/
+void NetStats_Init (void)
+{
+	Cmd_AddCommand ("netstats_export", NetStats_Export_f);
+}
@@ -20,6 +20,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		/* recvmmsg, sendmmsg */
+#endif
+
 #include "q_stdinc.h"
 #include "arch_def.h"
 #include "net_sys.h"
@@ -134,6 +138,13 @@ void UDP_Shutdown (void)
 
 //=============================================================================
 
+sys_socket_t UDP_GetListenSocket (void)
+{
+	return net_acceptsocket;
+}
+
+//=============================================================================
+
 void UDP_Listen (qboolean state)
 {
 	// enable listening
@@ -284,6 +295,76 @@ sys_socket_t UDP_CheckNewConnections (void)
 
 //=============================================================================
 
+#if defined(__linux__)
+int UDP_ReadBatch (sys_socket_t socketid, netpacket_t *packets, int count)
+{
+	struct mmsghdr	msgs[NET_BATCHSIZE];
+	struct iovec	iovs[NET_BATCHSIZE];
+	int		i, ret;
+
+	count = q_min (count, NET_BATCHSIZE);
+	for (i = 0; i < count; i++)
+	{
+		iovs[i].iov_base = packets[i].data;
+		iovs[i].iov_len = NET_DATAGRAMSIZE;
+		memset (&msgs[i], 0, sizeof (msgs[i]));
+		msgs[i].msg_hdr.msg_name = &packets[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof (struct qsockaddr);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = recvmmsg (socketid, msgs, count, MSG_DONTWAIT, NULL);
+	if (ret == SOCKET_ERROR)
+	{
+		int err = SOCKETERRNO;
+		if (err == NET_EWOULDBLOCK || err == NET_ECONNREFUSED)
+			return 0;
+		Con_SafePrintf ("UDP_ReadBatch, recvmmsg: %s\n", socketerror(err));
+		return -1;
+	}
+
+	for (i = 0; i < ret; i++)
+		packets[i].length = msgs[i].msg_len;
+
+	return ret;
+}
+
+int UDP_WriteBatch (sys_socket_t socketid, netpacket_t *packets, int count)
+{
+	struct mmsghdr	msgs[NET_BATCHSIZE];
+	struct iovec	iovs[NET_BATCHSIZE];
+	int		i, ret;
+
+	count = q_min (count, NET_BATCHSIZE);
+	for (i = 0; i < count; i++)
+	{
+		iovs[i].iov_base = packets[i].data;
+		iovs[i].iov_len = packets[i].length;
+		memset (&msgs[i], 0, sizeof (msgs[i]));
+		msgs[i].msg_hdr.msg_name = &packets[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof (struct qsockaddr);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = sendmmsg (socketid, msgs, count, 0);
+	if (ret == SOCKET_ERROR)
+	{
+		int err = SOCKETERRNO;
+		if (err == NET_EWOULDBLOCK)
+			return 0;
+		Con_SafePrintf ("UDP_WriteBatch, sendmmsg: %s\n", socketerror(err));
+		return -1;
+	}
+
+	return ret;
+}
+
+//=============================================================================
+
+#endif	/* __linux__ */
+
 int UDP_Read (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)
 {
 	socklen_t addrlen = sizeof(struct qsockaddr);
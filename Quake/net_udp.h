@@ -40,6 +40,11 @@ int  UDP_GetAddrFromName (const char *name, struct qsockaddr *addr);
 int  UDP_AddrCompare (struct qsockaddr *addr1, struct qsockaddr *addr2);
 int  UDP_GetSocketPort (struct qsockaddr *addr);
 int  UDP_SetSocketPort (struct qsockaddr *addr, int port);
+sys_socket_t  UDP_GetListenSocket (void);
+#if defined(__linux__)
+int  UDP_ReadBatch (sys_socket_t socketid, netpacket_t *packets, int count);
+int  UDP_WriteBatch (sys_socket_t socketid, netpacket_t *packets, int count);
+#endif
 
 #endif	/* __net_udp_h */
 
@@ -43,7 +43,8 @@ net_driver_t net_drivers[] =
 		Loop_CanSendMessage,
 		Loop_CanSendUnreliableMessage,
 		Loop_Close,
-		Loop_Shutdown
+		Loop_Shutdown,
+		NULL
 	},
 
 	{	"Datagram",
@@ -59,7 +60,9 @@ net_driver_t net_drivers[] =
 		Datagram_CanSendMessage,
 		Datagram_CanSendUnreliableMessage,
 		Datagram_Close,
-		Datagram_Shutdown
+		Datagram_Shutdown,
+		Datagram_Flush,
+		Datagram_SendDrained
 	}
 };
 
@@ -91,7 +94,10 @@ net_landriver_t	net_landrivers[] =
 		WINS_GetAddrFromName,
 		WINS_AddrCompare,
 		WINS_GetSocketPort,
-		WINS_SetSocketPort
+		WINS_SetSocketPort,
+		WINS_GetListenSocket,
+		NULL,
+		NULL
 	},
 
 	{	"Winsock IPX",
@@ -114,7 +120,10 @@ net_landriver_t	net_landrivers[] =
 		WIPX_GetAddrFromName,
 		WIPX_AddrCompare,
 		WIPX_GetSocketPort,
-		WIPX_SetSocketPort
+		WIPX_SetSocketPort,
+		WIPX_GetListenSocket,
+		NULL,
+		NULL
 	}
 };
 
@@ -194,6 +194,13 @@ void WINS_Shutdown (void)
 
 //=============================================================================
 
+sys_socket_t WINS_GetListenSocket (void)
+{
+	return net_acceptsocket;
+}
+
+//=============================================================================
+
 void WINS_Listen (qboolean state)
 {
 	// enable listening
@@ -120,6 +120,13 @@ void WIPX_Shutdown (void)
 
 //=============================================================================
 
+sys_socket_t WIPX_GetListenSocket (void)
+{
+	return (net_acceptsocket != INVALID_SOCKET) ? ipxsocket[net_acceptsocket] : INVALID_SOCKET;
+}
+
+//=============================================================================
+
 void WIPX_Listen (qboolean state)
 {
 	// enable listening
@@ -40,6 +40,7 @@ int  WIPX_GetAddrFromName (const char *name, struct qsockaddr *addr);
 int  WIPX_AddrCompare (struct qsockaddr *addr1, struct qsockaddr *addr2);
 int  WIPX_GetSocketPort (struct qsockaddr *addr);
 int  WIPX_SetSocketPort (struct qsockaddr *addr, int port);
+sys_socket_t  WIPX_GetListenSocket (void);
 
 #endif	/* __NET_WINIPX_H */
 
@@ -24,22 +24,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "q_ctype.h"
 
-#define	STRINGTEMP_BUFFERS		1024
-#define	STRINGTEMP_LENGTH		1024
-static	char	pr_string_temp[STRINGTEMP_BUFFERS][STRINGTEMP_LENGTH];
-static	byte	pr_string_tempindex = 0;
-
-static char *PR_GetTempString (void)
-{
-	return pr_string_temp[(STRINGTEMP_BUFFERS-1) & ++pr_string_tempindex];
-}
-
-int PR_MakeTempString (const char *val)
-{
-	char *tmp = PR_GetTempString();
-	q_strlcpy(tmp, val, STRINGTEMP_LENGTH);
-	return PR_SetEngineString(tmp);
-}
+#define	STRINGTEMP_LENGTH		1024	// initial PF_sprintf buffer, doubled as needed
+#define	STRINGTEMP_MAXLENGTH	(1024 * 1024)
 
 #define	RETURN_EDICT(e) (((int *)qcvm->globals)[OFS_RETURN] = EDICT_TO_PROG(e))
 
@@ -312,7 +298,7 @@ static void PF_setmodel (void)
 	m = G_STRING(OFS_PARM1);
 
 // check to see if model was properly precached
-	for (i = 0, check = sv.model_precache; *check; i++, check++)
+	for (i = 0, check = sv->model_precache; *check; i++, check++)
 	{
 		if (!strcmp(*check, m))
 			break;
@@ -325,7 +311,7 @@ static void PF_setmodel (void)
 	e->v.model = PR_SetEngineString(*check);
 	e->v.modelindex = i; //SV_ModelIndex (m);
 
-	mod = sv.models[ (int)e->v.modelindex];  // Mod_ForName (m, true);
+	mod = sv->models[ (int)e->v.modelindex];  // Mod_ForName (m, true);
 
 	if (mod)
 	//johnfitz -- correct physics cullboxes for bmodels
@@ -385,6 +371,7 @@ static void PF_sprint (void)
 
 	MSG_WriteChar (&client->message,svc_print);
 	MSG_WriteString (&client->message, s );
+	NetStats_Queue (&client->netstats, NETCAT_PRINT, strlen (s) + 2);
 }
 
 
@@ -416,6 +403,7 @@ static void PF_centerprint (void)
 
 	MSG_WriteChar (&client->message,svc_centerprint);
 	MSG_WriteString (&client->message, s);
+	NetStats_Queue (&client->netstats, NETCAT_PRINT, strlen (s) + 2);
 }
 
 
@@ -600,7 +588,7 @@ static void PF_ambientsound (void)
 	attenuation = G_FLOAT(OFS_PARM3);
 
 // check to see if samp was properly precached
-	for (soundnum = 0, check = sv.sound_precache; *check; check++, soundnum++)
+	for (soundnum = 0, check = sv->sound_precache; *check; check++, soundnum++)
 	{
 		if (!strcmp(*check, samp))
 			break;
@@ -615,7 +603,7 @@ static void PF_ambientsound (void)
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (soundnum > 255)
 	{
-		if (sv.protocol == PROTOCOL_NETQUAKE)
+		if (sv->protocol == PROTOCOL_NETQUAKE)
 			return; //don't send any info protocol can't support
 		else
 			large = true;
@@ -628,23 +616,23 @@ static void PF_ambientsound (void)
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (large)
-		MSG_WriteByte (sv.signon,svc_spawnstaticsound2);
+		MSG_WriteByte (sv->signon,svc_spawnstaticsound2);
 	else
-		MSG_WriteByte (sv.signon,svc_spawnstaticsound);
+		MSG_WriteByte (sv->signon,svc_spawnstaticsound);
 	//johnfitz
 
 	for (i = 0; i < 3; i++)
-		MSG_WriteCoord(sv.signon, pos[i], sv.protocolflags);
+		MSG_WriteCoord(sv->signon, pos[i], sv->protocolflags);
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (large)
-		MSG_WriteShort(sv.signon, soundnum);
+		MSG_WriteShort(sv->signon, soundnum);
 	else
-		MSG_WriteByte (sv.signon, soundnum);
+		MSG_WriteByte (sv->signon, soundnum);
 	//johnfitz
 
-	MSG_WriteByte (sv.signon, vol*255);
-	MSG_WriteByte (sv.signon, attenuation*64);
+	MSG_WriteByte (sv->signon, vol*255);
+	MSG_WriteByte (sv->signon, attenuation*64);
 
 }
 
@@ -694,6 +682,27 @@ static void PF_break (void)
 //	PR_RunError ("break statement");
 }
 
+/*
+=================
+PF_SetTraceGlobals
+=================
+*/
+static void PF_SetTraceGlobals (const trace_t *trace)
+{
+	pr_global_struct->trace_allsolid = trace->allsolid;
+	pr_global_struct->trace_startsolid = trace->startsolid;
+	pr_global_struct->trace_fraction = trace->fraction;
+	pr_global_struct->trace_inwater = trace->inwater;
+	pr_global_struct->trace_inopen = trace->inopen;
+	VectorCopy (trace->endpos, pr_global_struct->trace_endpos);
+	VectorCopy (trace->plane.normal, pr_global_struct->trace_plane_normal);
+	pr_global_struct->trace_plane_dist =  trace->plane.dist;
+	if (trace->ent)
+		pr_global_struct->trace_ent = EDICT_TO_PROG(trace->ent);
+	else
+		pr_global_struct->trace_ent = EDICT_TO_PROG(qcvm->edicts);
+}
+
 /*
 =================
 PF_traceline
@@ -711,6 +720,7 @@ static void PF_traceline (void)
 	trace_t	trace;
 	int	nomonsters;
 	edict_t	*ent;
+	qboolean	lagged;
 
 	v1 = G_VECTOR(OFS_PARM0);
 	v2 = G_VECTOR(OFS_PARM1);
@@ -731,20 +741,79 @@ static void PF_traceline (void)
 	if (IS_NAN(v2[0]) || IS_NAN(v2[1]) || IS_NAN(v2[2]))
 		v2[0] = v2[1] = v2[2] = 0;
 
+	// hitscan from a player: test against everyone where that player saw them
+	lagged = nomonsters != MOVE_NOMONSTERS && SV_LagCompBegin (ent, v1, v2);
 	trace = SV_Move (v1, vec3_origin, vec3_origin, v2, nomonsters, ent);
+	if (lagged)
+		SV_LagCompEnd ();
 
-	pr_global_struct->trace_allsolid = trace.allsolid;
-	pr_global_struct->trace_startsolid = trace.startsolid;
-	pr_global_struct->trace_fraction = trace.fraction;
-	pr_global_struct->trace_inwater = trace.inwater;
-	pr_global_struct->trace_inopen = trace.inopen;
-	VectorCopy (trace.endpos, pr_global_struct->trace_endpos);
-	VectorCopy (trace.plane.normal, pr_global_struct->trace_plane_normal);
-	pr_global_struct->trace_plane_dist =  trace.plane.dist;
-	if (trace.ent)
-		pr_global_struct->trace_ent = EDICT_TO_PROG(trace.ent);
-	else
-		pr_global_struct->trace_ent = EDICT_TO_PROG(qcvm->edicts);
+	PF_SetTraceGlobals (&trace);
+}
+
+/*
+=================
+PF_tracelines
+
+Traces from one start point to up to five end points in a single call,
+e.g. for AI visibility checks against several spots on a target.
+Returns a bitmask with bit i set if the ray to end point i was clear.
+The trace globals are set from the last ray.
+
+float (vector start, float nomonsters, entity ignore, vector end1, ...) tracelines
+=================
+*/
+static void PF_tracelines (void)
+{
+	float	*start, *end;
+	vec3_t	mins, maxs;
+	trace_t	trace;
+	int		nomonsters, i, j, clear;
+	edict_t	*ent;
+	qboolean lagged;
+
+	start = G_VECTOR(OFS_PARM0);
+	nomonsters = G_FLOAT(OFS_PARM1);
+	ent = G_EDICT(OFS_PARM2);
+
+	if (IS_NAN(start[0]) || IS_NAN(start[1]) || IS_NAN(start[2]))
+		start[0] = start[1] = start[2] = 0;
+
+	memset (&trace, 0, sizeof (trace));
+	trace.fraction = 1;
+	trace.ent = qcvm->edicts;
+	VectorCopy (start, trace.endpos);
+
+	VectorCopy (start, mins);
+	VectorCopy (start, maxs);
+	for (i = 3; i < qcvm->argc; i++)
+	{
+		end = G_VECTOR(OFS_PARM0 + i*3);
+		if (IS_NAN(end[0]) || IS_NAN(end[1]) || IS_NAN(end[2]))
+			end[0] = end[1] = end[2] = 0;
+		for (j = 0; j < 3; j++)
+		{
+			mins[j] = q_min (mins[j], end[j]);
+			maxs[j] = q_max (maxs[j], end[j]);
+		}
+	}
+
+	// same as traceline, with the box around all the rays standing in for the line
+	lagged = nomonsters != MOVE_NOMONSTERS && qcvm->argc > 3 && SV_LagCompBegin (ent, mins, maxs);
+
+	clear = 0;
+	for (i = 3; i < qcvm->argc; i++)
+	{
+		end = G_VECTOR(OFS_PARM0 + i*3);
+		trace = SV_Move (start, vec3_origin, vec3_origin, end, nomonsters, ent);
+		if (trace.fraction == 1 && !trace.allsolid)
+			clear |= 1 << (i - 3);
+	}
+
+	if (lagged)
+		SV_LagCompEnd ();
+
+	PF_SetTraceGlobals (&trace);
+	G_FLOAT(OFS_RETURN) = clear;
 }
 
 /*
@@ -812,10 +881,10 @@ static int PF_newcheckclient (int check)
 
 // get the PVS for the entity
 	VectorAdd (ent->v.origin, ent->v.view_ofs, org);
-	leaf = Mod_PointInLeaf (org, sv.worldmodel);
-	pvs = Mod_LeafPVS (leaf, sv.worldmodel);
+	leaf = Mod_PointInLeaf (org, sv->worldmodel);
+	pvs = Mod_LeafPVS (leaf, sv->worldmodel);
 	
-	pvsbytes = (sv.worldmodel->numleafs+7)>>3;
+	pvsbytes = (sv->worldmodel->numleafs+7)>>3;
 	if (checkpvs == NULL || pvsbytes > checkpvs_capacity)
 	{
 		checkpvs_capacity = pvsbytes;
@@ -853,14 +922,14 @@ static void PF_checkclient (void)
 	vec3_t	view;
 
 // find a new check if on a new frame
-	if (qcvm->time - sv.lastchecktime >= 0.1)
+	if (qcvm->time - sv->lastchecktime >= 0.1)
 	{
-		sv.lastcheck = PF_newcheckclient (sv.lastcheck);
-		sv.lastchecktime = qcvm->time;
+		sv->lastcheck = PF_newcheckclient (sv->lastcheck);
+		sv->lastchecktime = qcvm->time;
 	}
 
 // return check if it might be visible
-	ent = EDICT_NUM(sv.lastcheck);
+	ent = EDICT_NUM(sv->lastcheck);
 	if (ent->free || ent->v.health <= 0)
 	{
 		RETURN_EDICT(qcvm->edicts);
@@ -870,8 +939,8 @@ static void PF_checkclient (void)
 // if current entity can't possibly see the check entity, return 0
 	self = PROG_TO_EDICT(pr_global_struct->self);
 	VectorAdd (self->v.origin, self->v.view_ofs, view);
-	leaf = Mod_PointInLeaf (view, sv.worldmodel);
-	l = (leaf - sv.worldmodel->leafs) - 1;
+	leaf = Mod_PointInLeaf (view, sv->worldmodel);
+	l = (leaf - sv->worldmodel->leafs) - 1;
 	if ( (l < 0) || !(checkpvs[l>>3] & (1 << (l & 7))) )
 	{
 		c_notvis++;
@@ -927,7 +996,7 @@ static void PF_localcmd (void)
 	const char	*str;
 
 	str = G_STRING(OFS_PARM0);
-	Cbuf_AddText (str);
+	SV_InstanceAddText (str);
 }
 
 /*
@@ -1030,7 +1099,7 @@ static void PF_ftos (void)
 	char	*s;
 
 	v = G_FLOAT(OFS_PARM0);
-	s = PR_GetTempString();
+	s = PR_AllocTempString(64);
 	if (v == (int)v)
 		sprintf (s, "%d",(int)v);
 	else
@@ -1049,7 +1118,7 @@ static void PF_vtos (void)
 {
 	char	*s;
 
-	s = PR_GetTempString();
+	s = PR_AllocTempString(160);
 	sprintf (s, "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
 	G_INT(OFS_RETURN) = PR_SetEngineString(s);
 }
@@ -1120,7 +1189,7 @@ static void PF_precache_sound (void)
 	const char	*s;
 	int		i;
 
-	if (sv.state != ss_loading)
+	if (sv->state != ss_loading)
 		PR_RunError ("PF_Precache_*: Precache can only be done in spawn functions");
 
 	s = G_STRING(OFS_PARM0);
@@ -1129,12 +1198,12 @@ static void PF_precache_sound (void)
 
 	for (i = 0; i < MAX_SOUNDS; i++)
 	{
-		if (!sv.sound_precache[i])
+		if (!sv->sound_precache[i])
 		{
-			sv.sound_precache[i] = s;
+			sv->sound_precache[i] = PR_KeepString (s);
 			return;
 		}
-		if (!strcmp(sv.sound_precache[i], s))
+		if (!strcmp(sv->sound_precache[i], s))
 			return;
 	}
 	PR_RunError ("PF_precache_sound: overflow");
@@ -1145,7 +1214,7 @@ static void PF_precache_model (void)
 	const char	*s;
 	int		i;
 
-	if (sv.state != ss_loading)
+	if (sv->state != ss_loading)
 		PR_RunError ("PF_Precache_*: Precache can only be done in spawn functions");
 
 	s = G_STRING(OFS_PARM0);
@@ -1154,13 +1223,14 @@ static void PF_precache_model (void)
 
 	for (i = 0; i < MAX_MODELS; i++)
 	{
-		if (!sv.model_precache[i])
+		if (!sv->model_precache[i])
 		{
-			sv.model_precache[i] = s;
-			sv.models[i] = Mod_ForName (s, true);
+			sv->model_precache[i] = PR_KeepString (s);
+			sv->models[i] = Mod_ForName (s, true);
+			Mod_Reference (sv->models[i]);
 			return;
 		}
-		if (!strcmp(sv.model_precache[i], s))
+		if (!strcmp(sv->model_precache[i], s))
 			return;
 	}
 	PR_RunError ("PF_precache_model: overflow");
@@ -1286,11 +1356,17 @@ static void PF_lightstyle (void)
 		return;
 	}
 
-// change the string in sv
-	sv.lightstyles[style] = val;
+// change the string in sv, copying temp strings to a buffer of its own
+// (clients don't keep more than MAX_STYLESTRING characters either)
+	if (PR_IsTempString (val))
+	{
+		q_strlcpy (sv->lightstylebuf[style], val, MAX_STYLESTRING);
+		val = sv->lightstylebuf[style];
+	}
+	sv->lightstyles[style] = val;
 
 // send message to all clients on this server
-	if (sv.state != ss_active)
+	if (sv->state != ss_active)
 		return;
 
 	for (j = 0, client = svs.clients; j < svs.maxclients; j++, client++)
@@ -1525,7 +1601,7 @@ static sizebuf_t *WriteDest (void)
 	switch (dest)
 	{
 	case MSG_BROADCAST:
-		return &sv.datagram;
+		return &sv->datagram;
 
 	case MSG_ONE:
 		ent = PROG_TO_EDICT(pr_global_struct->msg_entity);
@@ -1535,10 +1611,10 @@ static sizebuf_t *WriteDest (void)
 		return &svs.clients[entnum-1].message;
 
 	case MSG_ALL:
-		return &sv.reliable_datagram;
+		return &sv->reliable_datagram;
 
 	case MSG_INIT:
-		return sv.signon;
+		return sv->signon;
 
 	default:
 		PR_RunError ("WriteDest: bad destination");
@@ -1570,12 +1646,12 @@ static void PF_WriteLong (void)
 
 static void PF_WriteAngle (void)
 {
-	MSG_WriteAngle (WriteDest(), G_FLOAT(OFS_PARM1), sv.protocolflags);
+	MSG_WriteAngle (WriteDest(), G_FLOAT(OFS_PARM1), sv->protocolflags);
 }
 
 static void PF_WriteCoord (void)
 {
-	MSG_WriteCoord (WriteDest(), G_FLOAT(OFS_PARM1), sv.protocolflags);
+	MSG_WriteCoord (WriteDest(), G_FLOAT(OFS_PARM1), sv->protocolflags);
 }
 
 static void PF_WriteString (void)
@@ -1585,7 +1661,7 @@ static void PF_WriteString (void)
 
 static void PF_WriteEntity (void)
 {
-	MSG_WriteShort (WriteDest(), G_EDICTNUM(OFS_PARM1));
+	MSG_WriteEntity (WriteDest(), G_EDICTNUM(OFS_PARM1), sv->protocolflags);
 }
 
 //=============================================================================
@@ -1606,7 +1682,7 @@ static void PF_makestatic (void)
 	//johnfitz
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (sv.protocol == PROTOCOL_NETQUAKE)
+	if (sv->protocol == PROTOCOL_NETQUAKE)
 	{
 		if (SV_ModelIndex(PR_GetString(ent->v.model)) & 0xFF00 || (int)(ent->v.frame) & 0xFF00)
 		{
@@ -1623,7 +1699,7 @@ static void PF_makestatic (void)
 		if (ent->alpha != ENTALPHA_DEFAULT)
 			bits |= B_ALPHA;
 
-		if (sv.protocol == PROTOCOL_RMQ)
+		if (sv->protocol == PROTOCOL_RMQ)
 		{
 			eval_t* val;
 			val = GetEdictFieldValueByName(ent, "scale");
@@ -1641,38 +1717,38 @@ static void PF_makestatic (void)
 
 	if (bits)
 	{
-		MSG_WriteByte (sv.signon, svc_spawnstatic2);
-		MSG_WriteByte (sv.signon, bits);
+		MSG_WriteByte (sv->signon, svc_spawnstatic2);
+		MSG_WriteByte (sv->signon, bits);
 	}
 	else
-		MSG_WriteByte (sv.signon, svc_spawnstatic);
+		MSG_WriteByte (sv->signon, svc_spawnstatic);
 
 	if (bits & B_LARGEMODEL)
-		MSG_WriteShort (sv.signon, SV_ModelIndex(PR_GetString(ent->v.model)));
+		MSG_WriteShort (sv->signon, SV_ModelIndex(PR_GetString(ent->v.model)));
 	else
-		MSG_WriteByte (sv.signon, SV_ModelIndex(PR_GetString(ent->v.model)));
+		MSG_WriteByte (sv->signon, SV_ModelIndex(PR_GetString(ent->v.model)));
 
 	if (bits & B_LARGEFRAME)
-		MSG_WriteShort (sv.signon, ent->v.frame);
+		MSG_WriteShort (sv->signon, ent->v.frame);
 	else
-		MSG_WriteByte (sv.signon, ent->v.frame);
+		MSG_WriteByte (sv->signon, ent->v.frame);
 	//johnfitz
 
-	MSG_WriteByte (sv.signon, ent->v.colormap);
-	MSG_WriteByte (sv.signon, ent->v.skin);
+	MSG_WriteByte (sv->signon, ent->v.colormap);
+	MSG_WriteByte (sv->signon, ent->v.skin);
 	for (i = 0; i < 3; i++)
 	{
-		MSG_WriteCoord(sv.signon, ent->v.origin[i], sv.protocolflags);
-		MSG_WriteAngle(sv.signon, ent->v.angles[i], sv.protocolflags);
+		MSG_WriteCoord(sv->signon, ent->v.origin[i], sv->protocolflags);
+		MSG_WriteAngle(sv->signon, ent->v.angles[i], sv->protocolflags);
 	}
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (bits & B_ALPHA)
-		MSG_WriteByte (sv.signon, ent->alpha);
+		MSG_WriteByte (sv->signon, ent->alpha);
 	//johnfitz
 
 	if (bits & B_SCALE)
-		MSG_WriteByte (sv.signon, ent->scale);
+		MSG_WriteByte (sv->signon, ent->scale);
 
 // throw the entity away now
 	ED_Free (ent);
@@ -1718,7 +1794,7 @@ static void PF_changelevel (void)
 	svs.changelevel_issued = true;
 
 	s = G_STRING(OFS_PARM0);
-	Cbuf_AddText (va("changelevel %s\n",s));
+	SV_InstanceAddText (va("changelevel %s\n",s));
 }
 
 /*
@@ -1988,9 +2064,7 @@ static void PF_cl_getstat_string(void)
 		G_INT(OFS_RETURN) = 0;
 	else
 	{
-		char *result = PR_GetTempString();
-		q_strlcpy(result, cl.statss[stnum], STRINGTEMP_LENGTH);
-		G_INT(OFS_RETURN) = PR_SetEngineString(result);
+		G_INT(OFS_RETURN) = PR_MakeTempString(cl.statss[stnum]);
 	}
 }
 
@@ -2425,22 +2499,27 @@ static void PF_strlen(void)
 static void PF_strcat(void)
 {
 	int		i;
-	char *out = PR_GetTempString();
-	size_t s;
+	char *out;
+	const char *s[8];
+	size_t l[8];
+	size_t len;
 
-	out[0] = 0;
-	s = 0;
+	len = 0;
 	for (i = 0; i < qcvm->argc; i++)
 	{
-		s = q_strlcat(out, G_STRING((OFS_PARM0+i*3)), STRINGTEMP_LENGTH);
-		if (s >= STRINGTEMP_LENGTH)
-		{
-			Con_Warning("PF_strcat: overflow (string truncated)\n");
-			break;
-		}
+		s[i] = G_STRING((OFS_PARM0+i*3));
+		l[i] = strlen(s[i]);
+		len += l[i];
 	}
 
+	out = PR_AllocTempString(len+1);
 	G_INT(OFS_RETURN) = PR_SetEngineString(out);
+	for (i = 0; i < qcvm->argc; i++)
+	{
+		memcpy(out, s[i], l[i]);
+		out += l[i];
+	}
+	*out = 0;
 }
 static void PF_substring(void)
 {
@@ -2476,13 +2555,7 @@ static void PF_substring(void)
 	//utf-8 should switch to bytes now.
 	s += start;
 
-	if (length >= STRINGTEMP_LENGTH)
-	{
-		length = STRINGTEMP_LENGTH-1;
-		Con_Warning("PF_substring: truncation\n");
-	}
-
-	string = PR_GetTempString();
+	string = PR_AllocTempString(length+1);
 	memcpy(string, s, length);
 	string[length] = '\0';
 	G_INT(OFS_RETURN) = PR_SetEngineString(string);
@@ -2562,9 +2635,9 @@ static void PF_str2chr(void)
 }
 static void PF_chr2str(void)
 {
-	char *ret = PR_GetTempString(), *out;
+	char *ret = PR_AllocTempString(qcvm->argc+1), *out;
 	int i;
-	for (i = 0, out=ret; out-ret < STRINGTEMP_LENGTH-6 && i < qcvm->argc; i++)
+	for (i = 0, out=ret; i < qcvm->argc; i++)
 	{
 		unsigned int u = G_FLOAT(OFS_PARM0 + i*3);
 		if (u >= 0xe000 && u < 0xe100)
@@ -2670,14 +2743,11 @@ static void PF_strconv (void)
 	const unsigned char *string = (const unsigned char*)PF_VarString(3);
 	int len = strlen((const char*)string);
 	int i;
-	unsigned char *resbuf = (unsigned char*)PR_GetTempString();
+	unsigned char *resbuf = (unsigned char*)PR_AllocTempString(len+1);
 	unsigned char *result = resbuf;
 
 	//UTF-8-FIXME: cope with utf+^U etc
 
-	if (len >= STRINGTEMP_LENGTH)
-		len = STRINGTEMP_LENGTH-1;
-
 	for (i = 0; i < len; i++, string++, result++)	//should this be done backwards?
 	{
 		if (*string >= '0' && *string <= '9')	//normal numbers...
@@ -3081,8 +3151,18 @@ finished:
 
 static void PF_sprintf(void)
 {
-	char *outbuf = PR_GetTempString();
-	PF_sprintf_internal(G_STRING(OFS_PARM0), 1, outbuf, STRINGTEMP_LENGTH);
+	char *outbuf;
+	size_t size = STRINGTEMP_LENGTH;
+
+	// output that fills the whole buffer may have been cut short, so retry with a bigger one
+	for (;;)
+	{
+		outbuf = PR_AllocTempString(size);
+		PF_sprintf_internal(G_STRING(OFS_PARM0), 1, outbuf, size);
+		if (strlen(outbuf) < size-1 || size >= STRINGTEMP_MAXLENGTH)
+			break;
+		size *= 2;
+	}
 	G_INT(OFS_RETURN) = PR_SetEngineString(outbuf);
 }
 
@@ -3158,9 +3238,7 @@ static void PF_ArgV(void)
 		G_INT(OFS_RETURN) = 0;
 	else
 	{
-		char *ret = PR_GetTempString();
-		q_strlcpy(ret, qctoken[idx].token, STRINGTEMP_LENGTH);
-		G_INT(OFS_RETURN) = PR_SetEngineString(ret);
+		G_INT(OFS_RETURN) = PR_MakeTempString(qctoken[idx].token);
 	}
 }
 
@@ -3181,8 +3259,8 @@ static void PF_stov(void)
 }
 static void PF_etos(void)
 {	//yes, this is lame
-	char *result = PR_GetTempString();
-	q_snprintf(result, STRINGTEMP_LENGTH, "entity %i", G_EDICTNUM(OFS_PARM0));
+	char *result = PR_AllocTempString(32);
+	q_snprintf(result, 32, "entity %i", G_EDICTNUM(OFS_PARM0));
 	G_INT(OFS_RETURN) = PR_SetEngineString(result);
 }
 static void PF_ftoi(void)
@@ -3216,18 +3294,18 @@ static struct svcustomstat_s *PR_CustomStat(int idx, int type)
 		return NULL;
 	}
 
-	for (i = 0; i < sv.numcustomstats; i++)
+	for (i = 0; i < sv->numcustomstats; i++)
 	{
-		if (sv.customstats[i].idx == idx && (sv.customstats[i].type==ev_string) == (type==ev_string))
+		if (sv->customstats[i].idx == idx && (sv->customstats[i].type==ev_string) == (type==ev_string))
 			break;
 	}
-	if (i == sv.numcustomstats)
-		sv.numcustomstats++;
-	sv.customstats[i].idx = idx;
-	sv.customstats[i].type = type;
-	sv.customstats[i].fld = 0;
-	sv.customstats[i].ptr = NULL;
-	return &sv.customstats[i];
+	if (i == sv->numcustomstats)
+		sv->numcustomstats++;
+	sv->customstats[i].idx = idx;
+	sv->customstats[i].type = type;
+	sv->customstats[i].fld = 0;
+	sv->customstats[i].ptr = NULL;
+	return &sv->customstats[i];
 }
 static void PF_clientstat(void)
 {
@@ -3436,6 +3514,8 @@ builtindef_t pr_builtindefs[] =
 	{"tokenize_console",		PF_BOTH(PF_tokenize_console),	514,	DP_QC_TOKENIZE_CONSOLE},		// float(string str)
 
 	{"sprintf",					PF_BOTH(PF_sprintf),			627,	DP_QC_SPRINTF},					// string(string fmt, ...)
+
+	{"tracelines",				PF_SSQC(PF_tracelines),			0,		IW_QC_TRACELINES},				// float(vector start, float nomonsters, entity ignore, vector end1, ...)
 };
 int pr_numbuiltindefs = Q_COUNTOF(pr_builtindefs);
 
@@ -38,6 +38,7 @@ const int type_size[NUM_TYPE_SIZES] = {
 
 static ddef_t	*ED_FieldAtOfs (int ofs);
 static qboolean	ED_ParseEpair (void *base, ddef_t *key, const char *s, qboolean zoned);
+static void		PR_FreeTempStrings (void);
 
 cvar_t	nomonsters = {"nomonsters", "0", CVAR_NONE};
 cvar_t	gamecfg = {"gamecfg", "0", CVAR_NONE};
@@ -51,17 +52,49 @@ cvar_t	saved2 = {"saved2", "0", CVAR_ARCHIVE};
 cvar_t	saved3 = {"saved3", "0", CVAR_ARCHIVE};
 cvar_t	saved4 = {"saved4", "0", CVAR_ARCHIVE};
 
+/*
+=================
+PR_Alloc
+
+Zero filled memory that lives as long as the current VM's progs and is
+freed by PR_ClearProgs. Every server instance loads its own progs, so
+this can't come from the hunk.
+=================
+*/
+void *PR_Alloc (size_t size)
+{
+	void *ptr = calloc (1, size ? size : 1);
+	if (!ptr)
+		Sys_Error ("PR_Alloc: couldn't allocate %" SDL_PRIu64 " bytes", (uint64_t) size);
+	VEC_PUSH (qcvm->allocs, ptr);
+	return ptr;
+}
+
+/*
+=================
+PR_FreeAllocs
+=================
+*/
+static void PR_FreeAllocs (qcvm_t *vm)
+{
+	size_t i;
+
+	for (i = 0; i < VEC_SIZE (vm->allocs); i++)
+		free (vm->allocs[i]);
+	VEC_FREE (vm->allocs);
+}
+
 /*
 =================
 PR_HashInit
 =================
 */
-static void PR_HashInit (prhashtable_t *table, int capacity, const char *name)
+static void PR_HashInit (prhashtable_t *table, int capacity)
 {
 	capacity *= 2; // 50% load factor
 	table->capacity = capacity;
-	table->strings = (const char **) Hunk_AllocName (sizeof(*table->strings) * capacity, name);
-	table->indices = (int         *) Hunk_AllocName (sizeof(*table->indices) * capacity, name);
+	table->strings = (const char **) PR_Alloc (sizeof(*table->strings) * capacity);
+	table->indices = (int         *) PR_Alloc (sizeof(*table->indices) * capacity);
 }
 
 /*
@@ -127,15 +160,15 @@ static void PR_InitHashTables (void)
 {
 	int i;
 
-	PR_HashInit (&qcvm->ht_fields, qcvm->progs->numfielddefs, "ht_fields");
+	PR_HashInit (&qcvm->ht_fields, qcvm->progs->numfielddefs);
 	for (i = 0; i < qcvm->progs->numfielddefs; i++)
 		PR_HashAdd (&qcvm->ht_fields, qcvm->fielddefs[i].s_name, i);
 
-	PR_HashInit (&qcvm->ht_functions, qcvm->progs->numfunctions, "ht_functions");
+	PR_HashInit (&qcvm->ht_functions, qcvm->progs->numfunctions);
 	for (i = 0; i < qcvm->progs->numfunctions; i++)
 		PR_HashAdd (&qcvm->ht_functions, qcvm->functions[i].s_name, i);
 
-	PR_HashInit (&qcvm->ht_globals, qcvm->progs->numglobaldefs, "ht_globals");
+	PR_HashInit (&qcvm->ht_globals, qcvm->progs->numglobaldefs);
 	for (i = 0; i < qcvm->progs->numglobaldefs; i++)
 		PR_HashAdd (&qcvm->ht_globals, qcvm->globaldefs[i].s_name, i);
 }
@@ -215,11 +248,11 @@ edict_t *ED_Alloc (void)
 		}
 	}
 
-	if (qcvm->num_edicts == qcvm->max_edicts) //johnfitz -- use sv.max_edicts instead of MAX_EDICTS
+	if (qcvm->num_edicts == qcvm->max_edicts) //johnfitz -- use sv->max_edicts instead of MAX_EDICTS
 		Host_Error ("ED_Alloc: no free edicts (max_edicts is %i)", qcvm->max_edicts);
 
 	e = EDICT_NUM(qcvm->num_edicts++);
-	memset(e, 0, qcvm->edict_size); // ericw -- switched sv.edicts to malloc(), so we are accessing uninitialized memory and must fully zero it, not just ED_ClearEdict
+	memset(e, 0, qcvm->edict_size); // ericw -- switched sv->edicts to malloc(), so we are accessing uninitialized memory and must fully zero it, not just ED_ClearEdict
 	e->baseline.scale = ENTSCALE_DEFAULT;
 
 	return e;
@@ -976,10 +1009,10 @@ void ED_PrintEdicts (void)
 	int		i;
 	qcvm_t	*oldqcvm;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
-	PR_PushQCVM(&sv.qcvm, &oldqcvm);
+	PR_PushQCVM(&sv->qcvm, &oldqcvm);
 	Con_Printf ("%i entities\n", qcvm->num_edicts);
 	for (i = 0; i < qcvm->num_edicts; i++)
 		ED_PrintNum (i);
@@ -998,11 +1031,11 @@ static void ED_PrintEdict_f (void)
 	int		i;
 	qcvm_t	*oldqcvm;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
 	i = Q_atoi (Cmd_Argv(1));
-	PR_PushQCVM(&sv.qcvm, &oldqcvm);
+	PR_PushQCVM(&sv->qcvm, &oldqcvm);
 	if (i < 0 || i >= qcvm->num_edicts)
 	{
 		Con_Printf("Bad edict number\n");
@@ -1022,10 +1055,10 @@ static void ED_PrintEdict_Completion_f (const char *partial)
 	qcvm_t	*oldqcvm;
 	int		i;
 
-	if (!sv.active || Cmd_Argc () > 2 || VEC_SIZE (bbox_linked) == 0)
+	if (!sv->active || Cmd_Argc () > 2 || VEC_SIZE (bbox_linked) == 0)
 		return;
 
-	PR_PushQCVM (&sv.qcvm, &oldqcvm);
+	PR_PushQCVM (&sv->qcvm, &oldqcvm);
 	for (i = 0; i < (int) VEC_SIZE (bbox_linked); i++)
 	{
 		edict_t *ed = bbox_linked[i];
@@ -1047,10 +1080,10 @@ static void ED_Count (void)
 	int		i, active, models, solid, step;
 	qcvm_t	*oldqcvm;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
-	PR_PushQCVM(&sv.qcvm, &oldqcvm);
+	PR_PushQCVM(&sv->qcvm, &oldqcvm);
 	active = models = solid = step = 0;
 	for (i = 0; i < qcvm->num_edicts; i++)
 	{
@@ -1408,7 +1441,7 @@ const char *ED_ParseEdict (const char *data, edict_t *ent)
 			sprintf (com_token, "0 %s 0", temp);
 		}
 
-		if (!ED_ParseEpair ((void *)&ent->v, key, com_token, qcvm != &sv.qcvm))
+		if (!ED_ParseEpair ((void *)&ent->v, key, com_token, qcvm != &sv->qcvm))
 			Host_Error ("ED_ParseEdict: parse error");
 	}
 
@@ -1487,39 +1520,39 @@ void ED_LoadFromFile (const char *data)
 
 		classname = PR_GetString (ent->v.classname);
 
-		if (sv.mapchecks.active)
+		if (sv->mapchecks.active)
 		{
 			int skillflags = (int)ent->v.spawnflags & (SPAWNFLAG_NOT_EASY|SPAWNFLAG_NOT_MEDIUM|SPAWNFLAG_NOT_HARD);
 			if (!(skillflags & SPAWNFLAG_NOT_EASY))
-				sv.mapchecks.skill_ents[0]++;
+				sv->mapchecks.skill_ents[0]++;
 			if (!(skillflags & SPAWNFLAG_NOT_MEDIUM))
-				sv.mapchecks.skill_ents[1]++;
+				sv->mapchecks.skill_ents[1]++;
 			if (!(skillflags & SPAWNFLAG_NOT_HARD))
-				sv.mapchecks.skill_ents[2]++;
+				sv->mapchecks.skill_ents[2]++;
 
 			if (strcmp (classname, "trigger_changelevel") == 0)
 			{
 				ddef_t *mapfield = ED_FindField ("map");
-				sv.mapchecks.trigger_changelevel++;
+				sv->mapchecks.trigger_changelevel++;
 				if (mapfield && (mapfield->type & ~DEF_SAVEGLOBAL) == ev_string)
 				{
 					eval_t		*val = GetEdictFieldValue (ent, mapfield->ofs);
 					const char	*map = COM_SkipSpace (PR_GetString (val->string));
 					if (*map)
 					{
-						sv.mapchecks.changelevel = map;
-						sv.mapchecks.valid_changelevel++;
+						sv->mapchecks.changelevel = map;
+						sv->mapchecks.valid_changelevel++;
 					}
 				}
 			}
 			else if (ED_IsSkillSelector (ent))
-				sv.mapchecks.skill_triggers++;
+				sv->mapchecks.skill_triggers++;
 			else if (strcmp (classname, "info_intermission") == 0)
-				sv.mapchecks.intermission++;
+				sv->mapchecks.intermission++;
 			else if (strcmp (classname, "info_player_coop") == 0)
-				sv.mapchecks.coop_spawns++;
+				sv->mapchecks.coop_spawns++;
 			else if (strcmp (classname, "info_player_deathmatch") == 0)
-				sv.mapchecks.dm_spawns++;
+				sv->mapchecks.dm_spawns++;
 		}
 
 		// remove things from different skill levels or deathmatch
@@ -1542,7 +1575,7 @@ void ED_LoadFromFile (const char *data)
 		}
 
 		// remove monsters if nomonsters is set
-		if (sv.nomonsters && !Q_strncmp (classname, "monster_", 8))
+		if (sv->nomonsters && !Q_strncmp (classname, "monster_", 8))
 		{
 			ED_Free (ent);
 			inhibit++;
@@ -1637,8 +1670,11 @@ void PR_ClearProgs(qcvm_t *vm)
 {
 	qcvm_t *oldvm = qcvm;
 	if (!vm->progs)
+	{
+		PR_FreeAllocs (vm);
 		return;	//wasn't loaded.
-	if (vm == &sv.qcvm)
+	}
+	if (vm == &sv->qcvm)
 		Host_WaitForSaveThread ();
 	qcvm = NULL;
 	PR_SwitchQCVM(vm);
@@ -1646,9 +1682,11 @@ void PR_ClearProgs(qcvm_t *vm)
 
 	if (qcvm->knownstrings)
 		Z_Free ((void *)qcvm->knownstrings);
-	free(qcvm->edicts); // ericw -- sv.edicts switched to use malloc()
+	PR_FreeTempStrings ();
+	ED_FreeEdictStore ();
 	if (qcvm->fielddefs != (ddef_t *)((byte *)qcvm->progs + qcvm->progs->ofs_fielddefs))
 		free(qcvm->fielddefs);
+	PR_FreeAllocs (qcvm);
 	memset(qcvm, 0, sizeof(*qcvm));
 
 	qcvm = NULL;
@@ -1677,9 +1715,9 @@ void PR_AutoCvarChanged(cvar_t *var)
 	ddef_t *glob;
 	qcvm_t *oldqcvm = qcvm;
 	PR_SwitchQCVM(NULL);
-	if (sv.active)
+	if (sv->active)
 	{
-		PR_SwitchQCVM(&sv.qcvm);
+		PR_SwitchQCVM(&sv->qcvm);
 		n = va("autocvar_%s", var->name);
 		glob = ED_FindGlobal(n);
 		if (glob)
@@ -1716,7 +1754,7 @@ void PR_EnableExtensions (void)
 	unsigned int i;
 	unsigned int numautocvars = 0;
 
-	if (!pr_checkextension.value && qcvm == &sv.qcvm)
+	if (!pr_checkextension.value && qcvm == &sv->qcvm)
 	{
 		Con_DPrintf("not enabling qc extensions\n");
 		return;
@@ -1866,7 +1904,7 @@ static void PR_InitBuiltins (void)
 	for (i = MAX_BUILTINS - 2, j = 0; j < pr_numbuiltindefs; j++)
 	{
 		builtindef_t *def = &pr_builtindefs[j];
-		builtin_t func = (qcvm == &sv.qcvm) ? def->ssqcfunc : def->csqcfunc;
+		builtin_t func = (qcvm == &sv->qcvm) ? def->ssqcfunc : def->csqcfunc;
 		if (!def->number)
 			def->number = i--;
 		if (func)
@@ -1989,8 +2027,8 @@ static void PR_FindEntityFields (void)
 	}
 
 	qcvm->numentityfields = count;
-	qcvm->entityfieldofs = (int *) Hunk_AllocName (qcvm->numentityfields * sizeof (int), "entityfieldofs");
-	qcvm->entityfields = (ddef_t **) Hunk_AllocName (qcvm->numentityfields * sizeof (ddef_t*), "entityfields");
+	qcvm->entityfieldofs = (int *) PR_Alloc (qcvm->numentityfields * sizeof (int));
+	qcvm->entityfields = (ddef_t **) PR_Alloc (qcvm->numentityfields * sizeof (ddef_t*));
 
 	count = 0;
 	for (i = 1; i < qcvm->progs->numfielddefs; i++)
@@ -2027,7 +2065,7 @@ static void PR_FindFunctionRanges (void)
 	int		i, mark;
 	int		*order;
 
-	qcvm->functionsizes = (int *) Hunk_AllocName (qcvm->progs->numfunctions * sizeof (*order), "func_sizes");
+	qcvm->functionsizes = (int *) PR_Alloc (qcvm->progs->numfunctions * sizeof (*order));
 	mark = Hunk_LowMark ();
 
 	order = (int *) Hunk_AllocNoFill (qcvm->progs->numfunctions * sizeof (*order));
@@ -2063,12 +2101,11 @@ static void PR_FillOffsetTables (void)
 		int			*maxofs;
 		int			numdefs;
 		ddef_t		*defs;
-		const char	*allocname;
 	}
 	passes[] =
 	{
-		{ &qcvm->ofstofield,	&qcvm->maxfieldofs,		qcvm->progs->numfielddefs,	qcvm->fielddefs,	"ofstofield"	},
-		{ &qcvm->ofstoglobal,	&qcvm->maxglobalofs,	qcvm->progs->numglobaldefs,	qcvm->globaldefs,	"ofstoglobal"	},
+		{ &qcvm->ofstofield,	&qcvm->maxfieldofs,		qcvm->progs->numfielddefs,	qcvm->fielddefs		},
+		{ &qcvm->ofstoglobal,	&qcvm->maxglobalofs,	qcvm->progs->numglobaldefs,	qcvm->globaldefs	},
 	};
 
 	for (pass = 0; pass < (int) Q_COUNTOF (passes); pass++)
@@ -2079,7 +2116,7 @@ static void PR_FillOffsetTables (void)
 		*passes[pass].maxofs = maxofs;
 
 		// alloc table and fill it with -1
-		data = *passes[pass].offsets = (int *) Hunk_AllocNameNoFill ((maxofs + 1) * sizeof (int), passes[pass].allocname);
+		data = *passes[pass].offsets = (int *) PR_Alloc ((maxofs + 1) * sizeof (int));
 		for (i = 0; i <= maxofs; i++)
 			data[i] = -1;
 
@@ -2101,9 +2138,10 @@ qboolean PR_LoadProgs (const char *filename, qboolean fatal)
 
 	PR_ClearProgs(qcvm);	//just in case.
 
-	qcvm->progs = (dprograms_t *)COM_LoadHunkFile (filename, NULL);
+	qcvm->progs = (dprograms_t *)COM_LoadMallocFile (filename, NULL);
 	if (!qcvm->progs)
 		return false;
+	VEC_PUSH (qcvm->allocs, qcvm->progs);	// freed with the rest by PR_ClearProgs
 	Con_DPrintf ("Programs occupy %" SDL_PRIs64 "K.\n", com_filesize/1024);
 
 	qcvm->crc = CRC_Block (qcvm->progs, com_filesize);
@@ -2278,6 +2316,7 @@ void PR_Init (void)
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("pr_tempstrings", PR_TempStrings_f);
 	Cvar_RegisterVariable (&nomonsters);
 	Cvar_SetCallback (&nomonsters, ED_Nomonsters_f);
 	Cvar_RegisterVariable (&gamecfg);
@@ -2293,10 +2332,76 @@ void PR_Init (void)
 }
 
 
+/*
+=================
+ED_AllocEdictStore
+
+Reserves address space for max_edicts up front so edicts never move
+(QC entity references are byte offsets from qcvm->edicts), but only
+commits memory for the first few. Falls back to fewer edicts if the
+address space isn't available (32-bit builds).
+=================
+*/
+void ED_AllocEdictStore (int max_edicts, int initial)
+{
+	max_edicts = q_min (max_edicts, INT_MAX / qcvm->edict_size);
+
+	for (;;)
+	{
+		qcvm->edicts = (edict_t *) Sys_ReserveMemory ((size_t)max_edicts * qcvm->edict_size);
+		if (qcvm->edicts || max_edicts <= MIN_EDICTS)
+			break;
+		max_edicts /= 2;
+	}
+	if (!qcvm->edicts)
+		Sys_Error ("ED_AllocEdictStore: couldn't reserve %d edicts x %d bytes", max_edicts, qcvm->edict_size);
+
+	qcvm->max_edicts = max_edicts;
+	qcvm->committed_edicts = 0;
+	ED_GrowEdictStore (initial);
+}
+
+/*
+=================
+ED_GrowEdictStore
+
+Makes sure at least count edicts are backed by memory
+=================
+*/
+void ED_GrowEdictStore (int count)
+{
+	if (count <= qcvm->committed_edicts)
+		return;
+	if (count > qcvm->max_edicts)
+		Host_Error ("ED_GrowEdictStore: %d edicts exceeds max_edicts (%d)", count, qcvm->max_edicts);
+
+	count = (count + EDICT_STORE_CHUNK - 1) / EDICT_STORE_CHUNK * EDICT_STORE_CHUNK;
+	count = q_min (count, qcvm->max_edicts);
+	if (!Sys_CommitMemory (qcvm->edicts, (size_t)count * qcvm->edict_size))
+		Sys_Error ("ED_GrowEdictStore: out of memory (%d edicts x %d bytes)", count, qcvm->edict_size);
+
+	qcvm->committed_edicts = count;
+}
+
+/*
+=================
+ED_FreeEdictStore
+=================
+*/
+void ED_FreeEdictStore (void)
+{
+	Sys_ReleaseMemory (qcvm->edicts, (size_t)qcvm->max_edicts * qcvm->edict_size);
+	qcvm->edicts = NULL;
+	qcvm->max_edicts = 0;
+	qcvm->committed_edicts = 0;
+}
+
 edict_t *EDICT_NUM(int n)
 {
 	if (n < 0 || n >= qcvm->max_edicts)
 		Host_Error ("EDICT_NUM: bad number %i", n);
+	if (n >= qcvm->committed_edicts)
+		ED_GrowEdictStore (n + 1);
 	return (edict_t *)((byte *)qcvm->edicts + (n)*qcvm->edict_size);
 }
 
@@ -2358,6 +2463,222 @@ static int PR_AllocStringSlot (void)
 	return (int)i;
 }
 
+/*
+Temp strings live in a per-VM bump arena that is reset the first time one
+is requested in a new host frame. Each one is preceded by the index of its
+knownstrings slot, so PR_SetEngineString can map it back without a search.
+Temp slots are kept from frame to frame and handed out in order; on reset
+they point at pr_expiredtempstring so stale uses can be reported. Slots a
+burst reserved beyond what the last frame needed (and PR_TEMP_KEEPSLOTS)
+go back to the free list, so a single spike doesn't pin them for good.
+*/
+
+#define	PR_TEMP_CHUNK_SIZE		(64 * 1024)
+#define	PR_TEMP_KEEPSLOTS		1024
+
+static char pr_expiredtempstring[1];
+
+static void PR_ResetTempStrings (void)
+{
+	size_t	i, total, keep;
+
+	for (i = 0; i < (size_t) qcvm->numtempstrings; i++)
+		qcvm->knownstrings[qcvm->tempslots[i]] = pr_expiredtempstring;
+
+	keep = q_max ((size_t) qcvm->numtempstrings, PR_TEMP_KEEPSLOTS);
+	while (VEC_SIZE (qcvm->tempslots) > keep)
+	{
+		int slot = VEC_LAST (qcvm->tempslots);
+		VEC_POP (qcvm->tempslots);
+		qcvm->knownstrings[slot] = (const char *) qcvm->firstfreeknownstring;
+		qcvm->firstfreeknownstring = &qcvm->knownstrings[slot];
+	}
+	qcvm->numtempstrings = 0;
+	qcvm->tempbytes = 0;
+	qcvm->tempused = 0;
+	qcvm->tempframe = host_framecount;
+
+	// if the arena had to grow, merge it into a single chunk
+	// so that the next frames don't need any allocations
+	if (VEC_SIZE (qcvm->tempchunks) > 1)
+	{
+		prtempchunk_t chunk;
+
+		total = 0;
+		for (i = 0; i < VEC_SIZE (qcvm->tempchunks); i++)
+		{
+			total += qcvm->tempchunks[i].size;
+			free (qcvm->tempchunks[i].base);
+		}
+		VEC_CLEAR (qcvm->tempchunks);
+
+		chunk.size = total;
+		chunk.base = (char *) malloc (total);
+		if (!chunk.base)
+			Sys_Error ("PR_ResetTempStrings: couldn't allocate %" SDL_PRIu64 " bytes", (uint64_t) total);
+		VEC_PUSH (qcvm->tempchunks, chunk);
+	}
+}
+
+static void PR_FreeTempStrings (void)
+{
+	size_t i;
+
+	for (i = 0; i < VEC_SIZE (qcvm->tempchunks); i++)
+		free (qcvm->tempchunks[i].base);
+	VEC_FREE (qcvm->tempchunks);
+	VEC_FREE (qcvm->tempslots);
+	qcvm->numtempstrings = 0;
+	qcvm->tempused = 0;
+}
+
+/*
+============
+PR_AllocTempString
+
+Returns an empty string buffer of size bytes that stays valid until the end of the frame
+============
+*/
+char *PR_AllocTempString (size_t size)
+{
+	prtempchunk_t	*chunk;
+	size_t			need;
+	char			*p;
+	int				slot;
+
+	if (qcvm->tempframe != host_framecount)
+		PR_ResetTempStrings ();
+
+	size = q_max (size, 1);
+	need = (sizeof (slot) + size + sizeof (slot) - 1) & ~(sizeof (slot) - 1);
+	chunk = VEC_SIZE (qcvm->tempchunks) ? &VEC_LAST (qcvm->tempchunks) : NULL;
+	if (!chunk || qcvm->tempused + need > chunk->size)
+	{
+		prtempchunk_t newchunk;
+		newchunk.size = q_max (need, PR_TEMP_CHUNK_SIZE);
+		newchunk.base = (char *) malloc (newchunk.size);
+		if (!newchunk.base)
+			Sys_Error ("PR_AllocTempString: couldn't allocate %" SDL_PRIu64 " bytes", (uint64_t) newchunk.size);
+		VEC_PUSH (qcvm->tempchunks, newchunk);
+		chunk = &VEC_LAST (qcvm->tempchunks);
+		qcvm->tempused = 0;
+	}
+
+	if ((size_t) qcvm->numtempstrings == VEC_SIZE (qcvm->tempslots))
+	{
+		slot = PR_AllocStringSlot ();
+		VEC_PUSH (qcvm->tempslots, slot);
+	}
+	slot = qcvm->tempslots[qcvm->numtempstrings++];
+
+	p = chunk->base + qcvm->tempused;
+	memcpy (p, &slot, sizeof (slot));
+	p += sizeof (slot);
+	*p = '\0';
+	qcvm->tempused += need;
+	qcvm->knownstrings[slot] = p;
+
+	qcvm->tempbytes += size;
+	qcvm->peaktempbytes = q_max (qcvm->peaktempbytes, qcvm->tempbytes);
+	qcvm->peaktempstrings = q_max (qcvm->peaktempstrings, qcvm->numtempstrings);
+
+	return p;
+}
+
+/*
+============
+PR_FindTempString
+
+Returns the knownstrings slot of a temp string from this frame, or -1
+============
+*/
+static int PR_FindTempString (const char *s)
+{
+	size_t	i;
+	int		slot;
+
+	for (i = 0; i < VEC_SIZE (qcvm->tempchunks); i++)
+	{
+		const prtempchunk_t *chunk = &qcvm->tempchunks[i];
+		if (!PTR_IN_RANGE (s, chunk->base + sizeof (slot), chunk->base + chunk->size))
+			continue;
+		memcpy (&slot, s - sizeof (slot), sizeof (slot));
+		if (slot >= 0 && slot < qcvm->numknownstrings && qcvm->knownstrings[slot] == s)
+			return slot;
+		break;
+	}
+
+	return -1;
+}
+
+/*
+============
+PR_IsTempString
+
+True if s won't survive the next PR_ResetTempStrings
+============
+*/
+qboolean PR_IsTempString (const char *s)
+{
+	return PR_FindTempString (s) >= 0;
+}
+
+/*
+============
+PR_KeepString
+
+Returns s, or a copy that lives as long as the progs if it is a temp
+string: for the precache tables, which are only ever filled once per entry
+and must outlive the current frame
+============
+*/
+const char *PR_KeepString (const char *s)
+{
+	size_t	size;
+	char	*copy;
+
+	if (PR_FindTempString (s) < 0)
+		return s;
+	size = strlen (s) + 1;
+	copy = (char *) PR_Alloc (size);
+	memcpy (copy, s, size);
+	return copy;
+}
+
+int PR_MakeTempString (const char *val)
+{
+	size_t len = strlen (val);
+	char *tmp = PR_AllocTempString (len + 1);
+	memcpy (tmp, val, len + 1);
+	return PR_SetEngineString (tmp);
+}
+
+static void PR_PrintTempStrings (const char *name, qcvm_t *vm)
+{
+	size_t i, capacity = 0;
+
+	if (!vm->progs)
+		return;
+	for (i = 0; i < VEC_SIZE (vm->tempchunks); i++)
+		capacity += vm->tempchunks[i].size;
+	Con_Printf ("%-6s %6d strings %8" SDL_PRIu64 " bytes (peak %d strings %" SDL_PRIu64 " bytes, arena %" SDL_PRIu64 " bytes)\n",
+		name, vm->numtempstrings, (uint64_t) vm->tempbytes,
+		vm->peaktempstrings, (uint64_t) vm->peaktempbytes, (uint64_t) capacity);
+}
+
+/*
+============
+PR_TempStrings_f
+
+Prints temp string usage for the last frame each VM allocated in
+============
+*/
+void PR_TempStrings_f (void)
+{
+	PR_PrintTempStrings ("server", &sv->qcvm);
+	PR_PrintTempStrings ("csqc", &cl.qcvm);
+}
+
 static qboolean PR_IsValidString (const char *p)
 {
 	uintptr_t d;
@@ -2379,6 +2700,8 @@ const char *PR_GetString (int num)
 			Host_Error ("PR_GetString: attempt to get a non-existant string %d\n", num);
 			return "";
 		}
+		if (qcvm->knownstrings[-1 - num] == pr_expiredtempstring)
+			Con_DPrintf2 ("PR_GetString: temp string %d used after the frame it was made in\n", num);
 		return qcvm->knownstrings[-1 - num];
 	}
 	else
@@ -2404,13 +2727,16 @@ int PR_SetEngineString (const char *s)
 
 	if (!s)
 		return 0;
-#if 0	/* can't: sv.model_precache & sv.sound_precache points to pr_strings */
+#if 0	/* can't: sv->model_precache & sv->sound_precache points to pr_strings */
 	if (s >= pr_strings && s <= pr_strings + pr_stringssize)
 		Host_Error("PR_SetEngineString: \"%s\" in pr_strings area\n", s);
 #else
 	if (s >= qcvm->strings && s <= qcvm->strings + qcvm->stringssize - 2)
 		return (int)(s - qcvm->strings);
 #endif
+	i = PR_FindTempString (s);
+	if (i >= 0)
+		return -1 - i;
 	for (i = 0; i < qcvm->numknownstrings; i++)
 	{
 		if (qcvm->knownstrings[i] == s)
@@ -2430,7 +2756,7 @@ int PR_AllocString (int size, char **ptr)
 	if (!size)
 		return 0;
 	i = PR_AllocStringSlot ();
-	qcvm->knownstrings[i] = (char *)Hunk_AllocName(size, "string");
+	qcvm->knownstrings[i] = (char *)PR_Alloc(size);
 	if (ptr)
 		*ptr = (char *) qcvm->knownstrings[i];
 	return -1 - i;
@@ -2461,7 +2787,7 @@ void SaveData_Fill (savedata_t *save)
 
 	Host_SavegameComment (save->comment);
 
-	q_strlcpy (save->mapname, sv.name, sizeof (save->mapname));
+	q_strlcpy (save->mapname, sv->name, sizeof (save->mapname));
 	for (i = 0; i < NUM_SPAWN_PARMS; i++)
 		save->spawn_parms[i] = svs.clients->spawn_parms[i];
 	save->skill = current_skill;
@@ -2473,8 +2799,8 @@ void SaveData_Fill (savedata_t *save)
 	size += qcvm->edict_size * qcvm->num_edicts;
 
 	for (i = 0; i < MAX_LIGHTSTYLES; i++)
-		if (sv.lightstyles[i])
-			size += strlen (sv.lightstyles[i]) + 1;
+		if (sv->lightstyles[i])
+			size += strlen (sv->lightstyles[i]) + 1;
 
 	for (i = 0; i < qcvm->numknownstrings; i++)
 	{
@@ -2513,11 +2839,11 @@ void SaveData_Fill (savedata_t *save)
 	/* lightstyles */
 	for (i = 0; i < MAX_LIGHTSTYLES; i++)
 	{
-		if (sv.lightstyles[i])
+		if (sv->lightstyles[i])
 		{
-			int len = strlen (sv.lightstyles[i]) + 1;
+			int len = strlen (sv->lightstyles[i]) + 1;
 			save->lightstyles[i] = (const char *) (save->buffer + ofs);
-			memcpy (save->buffer + ofs, sv.lightstyles[i], len);
+			memcpy (save->buffer + ofs, sv->lightstyles[i], len);
 			ofs += len;
 		}
 		else
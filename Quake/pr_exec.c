@@ -223,10 +223,10 @@ void PR_Profile_f (void)
 	int		pmax;
 	dfunction_t	*f, *best;
 
-	if (!sv.active)
+	if (!sv->active)
 		return;
 
-	PR_SwitchQCVM(&sv.qcvm);
+	PR_SwitchQCVM(&sv->qcvm);
 
 	num = 0;
 	do
@@ -586,7 +586,7 @@ void PR_ExecuteProgram (func_t fnum)
 #ifdef PARANOID
 		NUM_FOR_EDICT(ed);	// Make sure it's in range
 #endif
-		if (ed == (edict_t *)qcvm->edicts && sv.state == ss_active)
+		if (ed == (edict_t *)qcvm->edicts && sv->state == ss_active)
 		{
 			qcvm->xstatement = st - qcvm->statements;
 			PR_RunError("assignment to world entity");
@@ -0,0 +1,621 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// prof.c -- frame profiler
+
+#include "quakedef.h"
+
+#define PROF_NAME_LEN		32
+#define PROF_MAX_DEPTH		32
+#define PROF_MAX_GPU_ZONES	256		// per frame
+#define PROF_LATENCY		4		// frames in flight before timer queries are read back
+#define PROF_HISTORY		128		// frames shown in the graph
+#define PROF_MAX_STATS		64		// distinct zone names tracked for the overlay
+#define PROF_MAX_LINES		12		// zones listed in the overlay
+#define PROF_GPU_THREAD		0		// trace thread id for the GPU timeline
+
+cvar_t	scr_profile = {"scr_profile", "0", CVAR_NONE};
+
+typedef struct
+{
+	char			name[PROF_NAME_LEN];
+	double			begin;
+	double			end;
+	unsigned long	thread;
+	int				depth;
+} profzone_t;
+
+typedef struct
+{
+	char			name[PROF_NAME_LEN];
+	int				depth;
+	int				beginquery;
+	int				endquery;		// -1 if the zone was never closed
+} profgpuzone_t;
+
+typedef struct
+{
+	qboolean		active;			// recorded, but not resolved yet
+	int				framenum;
+	double			begin;
+	double			end;
+	profzone_t		*cpuzones;
+	profgpuzone_t	gpuzones[PROF_MAX_GPU_ZONES];
+	int				numgpuzones;
+	GLuint			queries[PROF_MAX_GPU_ZONES * 2];
+	int				numqueries;
+	qboolean		hasqueries;
+	double			gpubase;		// CPU time at which the first timer query was issued
+} profframe_t;
+
+typedef struct
+{
+	char			name[PROF_NAME_LEN];
+	double			cpu, gpu;		// smoothed, in milliseconds
+	double			framecpu, framegpu;
+} profstat_t;
+
+static struct
+{
+	qboolean		recording;
+	int				framenum;
+	profframe_t		frames[PROF_LATENCY];
+	profframe_t		*current;
+	SDL_SpinLock	lock;
+	unsigned long	mainthread;
+
+	int				gpustack[PROF_MAX_DEPTH];
+	int				gpudepth;
+
+	float			cpuhistory[PROF_HISTORY];
+	float			gpuhistory[PROF_HISTORY];
+	int				historypos;
+
+	profstat_t		stats[PROF_MAX_STATS];
+	int				numstats;
+
+	FILE			*trace;
+	char			tracename[MAX_OSPATH];
+	int				tracefirstframe;
+	int				traceframes;	// frames left to write
+	double			tracestart;
+	qboolean		tracecomma;
+} prof;
+
+static THREAD_LOCAL struct
+{
+	int				depth;
+	char			names[PROF_MAX_DEPTH][PROF_NAME_LEN];
+	double			begin[PROF_MAX_DEPTH];	// -1 = not recorded
+} prof_thread;
+
+/*
+==============================================================================
+
+CPU/GPU ZONES
+
+==============================================================================
+*/
+
+/*
+================
+Prof_BeginZone
+================
+*/
+void Prof_BeginZone (const char *name)
+{
+	int depth = prof_thread.depth++;
+
+	if (depth >= PROF_MAX_DEPTH)
+		return;
+
+	if (!prof.recording)
+	{
+		prof_thread.begin[depth] = -1.0;
+		return;
+	}
+
+	q_strlcpy (prof_thread.names[depth], name, PROF_NAME_LEN);
+	prof_thread.begin[depth] = Sys_DoubleTime ();
+}
+
+/*
+================
+Prof_EndZone
+================
+*/
+void Prof_EndZone (void)
+{
+	profzone_t	zone;
+	int			depth;
+
+	if (prof_thread.depth <= 0)
+		return;
+	depth = --prof_thread.depth;
+	if (depth >= PROF_MAX_DEPTH || prof_thread.begin[depth] < 0.0)
+		return;
+
+	memcpy (zone.name, prof_thread.names[depth], PROF_NAME_LEN);
+	zone.begin = prof_thread.begin[depth];
+	zone.end = Sys_DoubleTime ();
+	zone.thread = SDL_ThreadID ();
+	zone.depth = depth;
+
+	SDL_AtomicLock (&prof.lock);
+	if (prof.current)
+		VEC_PUSH (prof.current->cpuzones, zone);
+	SDL_AtomicUnlock (&prof.lock);
+}
+
+/*
+================
+Prof_BeginGPUZone
+================
+*/
+void Prof_BeginGPUZone (const char *name)
+{
+	profframe_t		*frame = prof.current;
+	profgpuzone_t	*zone;
+	int				index = -1;
+
+	Prof_BeginZone (name);
+
+	if (!frame)
+		return;
+
+	if (prof.gpudepth < PROF_MAX_DEPTH && frame->numgpuzones < PROF_MAX_GPU_ZONES)
+	{
+		if (!frame->hasqueries)
+		{
+			GL_GenQueriesFunc (countof (frame->queries), frame->queries);
+			frame->hasqueries = true;
+		}
+		if (!frame->numqueries)
+			frame->gpubase = Sys_DoubleTime ();
+
+		index = frame->numgpuzones++;
+		zone = &frame->gpuzones[index];
+		q_strlcpy (zone->name, name, PROF_NAME_LEN);
+		zone->depth = prof.gpudepth;
+		zone->beginquery = frame->numqueries++;
+		zone->endquery = -1;
+		GL_QueryCounterFunc (frame->queries[zone->beginquery], GL_TIMESTAMP);
+	}
+
+	if (prof.gpudepth < PROF_MAX_DEPTH)
+		prof.gpustack[prof.gpudepth] = index;
+	prof.gpudepth++;
+}
+
+/*
+================
+Prof_EndGPUZone
+================
+*/
+void Prof_EndGPUZone (void)
+{
+	profframe_t	*frame = prof.current;
+	int			index;
+
+	if (frame && prof.gpudepth > 0)
+	{
+		prof.gpudepth--;
+		index = prof.gpudepth < PROF_MAX_DEPTH ? prof.gpustack[prof.gpudepth] : -1;
+		if (index >= 0)
+		{
+			profgpuzone_t *zone = &frame->gpuzones[index];
+			zone->endquery = frame->numqueries++;
+			GL_QueryCounterFunc (frame->queries[zone->endquery], GL_TIMESTAMP);
+		}
+	}
+
+	Prof_EndZone ();
+}
+
+/*
+==============================================================================
+
+FRAME RESOLVE
+
+==============================================================================
+*/
+
+/*
+================
+Prof_FindStat
+================
+*/
+static profstat_t *Prof_FindStat (const char *name)
+{
+	profstat_t	*stat;
+	int			i;
+
+	for (i = 0; i < prof.numstats; i++)
+		if (!strcmp (prof.stats[i].name, name))
+			return &prof.stats[i];
+
+	if (prof.numstats == PROF_MAX_STATS)
+		return NULL;
+
+	stat = &prof.stats[prof.numstats++];
+	memset (stat, 0, sizeof (*stat));
+	q_strlcpy (stat->name, name, sizeof (stat->name));
+
+	return stat;
+}
+
+/*
+================
+Prof_WriteTraceEvent
+================
+*/
+static void Prof_WriteTraceEvent (const char *name, const char *cat, double begin, double end, unsigned long thread)
+{
+	const char *p;
+
+	fprintf (prof.trace, "%s\n{\"name\":\"", prof.tracecomma ? "," : "");
+	for (p = name; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			fprintf (prof.trace, "\\%c", *p);
+		else if ((unsigned char) *p >= 32)
+			fputc (*p, prof.trace);
+	}
+	fprintf (prof.trace, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lu}",
+		cat, (begin - prof.tracestart) * 1e6, (end - begin) * 1e6, thread);
+	prof.tracecomma = true;
+}
+
+/*
+================
+Prof_FinishTrace
+================
+*/
+static void Prof_FinishTrace (void)
+{
+	fprintf (prof.trace, "\n]}\n");
+	fclose (prof.trace);
+	prof.trace = NULL;
+	prof.traceframes = 0;
+
+	Con_SafePrintf ("Wrote ");
+	Con_LinkPrintf (prof.tracename, "%s", COM_SkipPath (prof.tracename));
+	Con_SafePrintf ("\n");
+}
+
+/*
+================
+Prof_ResolveFrame
+
+Reads back timer queries and updates the graph, overlay stats and trace.
+Returns false if the GPU hasn't finished the frame yet and wait is false.
+================
+*/
+static qboolean Prof_ResolveFrame (profframe_t *frame, qboolean wait)
+{
+	GLuint64	timestamps[PROF_MAX_GPU_ZONES * 2];
+	GLuint64	gpumin = 0, gpumax = 0;
+	qboolean	tracing;
+	double		cpu, gpu;
+	int			i;
+
+	if (frame->numqueries > 0 && !wait)
+	{
+		GLint available = 0;
+		GL_GetQueryObjectivFunc (frame->queries[frame->numqueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+	}
+
+	for (i = 0; i < frame->numqueries; i++)
+		GL_GetQueryObjectui64vFunc (frame->queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+	for (i = 0; i < prof.numstats; i++)
+		prof.stats[i].framecpu = prof.stats[i].framegpu = 0.0;
+
+	tracing = prof.trace && frame->framenum >= prof.tracefirstframe;
+	if (tracing)
+	{
+		if (frame->framenum == prof.tracefirstframe)
+			prof.tracestart = frame->begin;
+		Prof_WriteTraceEvent (va ("Frame %d", frame->framenum), "frame", frame->begin, frame->end, prof.mainthread);
+	}
+
+	for (i = 0; i < (int) VEC_SIZE (frame->cpuzones); i++)
+	{
+		const profzone_t *zone = &frame->cpuzones[i];
+		profstat_t *stat = Prof_FindStat (zone->name);
+		if (stat)
+			stat->framecpu += (zone->end - zone->begin) * 1000.0;
+		if (tracing)
+			Prof_WriteTraceEvent (zone->name, "cpu", zone->begin, zone->end, zone->thread);
+	}
+
+	for (i = 0; i < frame->numgpuzones; i++)
+	{
+		const profgpuzone_t *zone = &frame->gpuzones[i];
+		GLuint64 begin = timestamps[zone->beginquery];
+		GLuint64 end;
+		profstat_t *stat;
+
+		if (zone->endquery < 0)
+			continue;
+		end = timestamps[zone->endquery];
+		if (!gpumin || begin < gpumin)
+			gpumin = begin;
+		if (end > gpumax)
+			gpumax = end;
+
+		stat = Prof_FindStat (zone->name);
+		if (stat)
+			stat->framegpu += (end - begin) / 1e6;
+	}
+
+	// GPU timestamps use a different clock, align the first query with the time it was issued
+	if (tracing)
+	{
+		for (i = 0; i < frame->numgpuzones; i++)
+		{
+			const profgpuzone_t *zone = &frame->gpuzones[i];
+			if (zone->endquery < 0)
+				continue;
+			Prof_WriteTraceEvent (zone->name, "gpu",
+				frame->gpubase + (timestamps[zone->beginquery] - gpumin) / 1e9,
+				frame->gpubase + (timestamps[zone->endquery] - gpumin) / 1e9,
+				PROF_GPU_THREAD
+			);
+		}
+		if (--prof.traceframes <= 0)
+			Prof_FinishTrace ();
+	}
+
+	for (i = 0; i < prof.numstats; i++)
+	{
+		profstat_t *stat = &prof.stats[i];
+		stat->cpu += (stat->framecpu - stat->cpu) * 0.1;
+		stat->gpu += (stat->framegpu - stat->gpu) * 0.1;
+	}
+
+	cpu = (frame->end - frame->begin) * 1000.0;
+	gpu = (gpumax - gpumin) / 1e6;
+	prof.cpuhistory[prof.historypos] = cpu;
+	prof.gpuhistory[prof.historypos] = gpu;
+	prof.historypos = (prof.historypos + 1) % PROF_HISTORY;
+
+	frame->active = false;
+
+	return true;
+}
+
+/*
+================
+Prof_BeginFrame
+================
+*/
+void Prof_BeginFrame (void)
+{
+	profframe_t *frame;
+
+	// previous frame was interrupted by a host error
+	if (prof.current)
+		Prof_EndFrame ();
+
+	prof_thread.depth = 0;
+	prof.gpudepth = 0;
+	prof.recording = scr_profile.value || prof.trace;
+	if (!prof.recording)
+		return;
+
+	frame = &prof.frames[prof.framenum % PROF_LATENCY];
+	if (frame->active)
+		Prof_ResolveFrame (frame, true);
+
+	SDL_AtomicLock (&prof.lock);
+	frame->active = true;
+	frame->framenum = prof.framenum;
+	frame->begin = Sys_DoubleTime ();
+	frame->end = frame->begin;
+	frame->numgpuzones = 0;
+	frame->numqueries = 0;
+	frame->gpubase = frame->begin;
+	VEC_CLEAR (frame->cpuzones);
+	prof.current = frame;
+	SDL_AtomicUnlock (&prof.lock);
+}
+
+/*
+================
+Prof_EndFrame
+================
+*/
+void Prof_EndFrame (void)
+{
+	int i;
+
+	if (!prof.current)
+		return;
+
+	SDL_AtomicLock (&prof.lock);
+	prof.current->end = Sys_DoubleTime ();
+	prof.current = NULL;
+	SDL_AtomicUnlock (&prof.lock);
+
+	prof.framenum++;
+
+	// resolve finished frames in order, oldest first
+	for (i = 0; i < PROF_LATENCY; i++)
+	{
+		profframe_t *frame = &prof.frames[(prof.framenum + i) % PROF_LATENCY];
+		if (frame->active && !Prof_ResolveFrame (frame, false))
+			break;
+	}
+}
+
+/*
+==============================================================================
+
+OVERLAY
+
+==============================================================================
+*/
+
+/*
+================
+Prof_CompareStats
+================
+*/
+static int Prof_CompareStats (const void *pa, const void *pb)
+{
+	const profstat_t *a = *(const profstat_t **) pa;
+	const profstat_t *b = *(const profstat_t **) pb;
+	double wa = q_max (a->cpu, a->gpu);
+	double wb = q_max (b->cpu, b->gpu);
+
+	if (wa != wb)
+		return wa < wb ? 1 : -1;
+	return strcmp (a->name, b->name);
+}
+
+/*
+================
+Prof_Draw
+================
+*/
+void Prof_Draw (void)
+{
+	static const float	cpucolor[3] = {1.f, 1.f, 1.f};
+	static const float	gpucolor[3] = {0.25f, 1.f, 0.25f};
+	static const float	linecolor[3] = {1.f, 0.25f, 0.25f};
+	const float			maxms = 33.3f;
+	const int			graphw = 28*8;
+	const int			graphh = 48;
+	const float			colw = graphw / (float) PROF_HISTORY;
+	profstat_t			*sorted[PROF_MAX_STATS];
+	int					i, x, y, count, pos;
+	float				h;
+
+	if (!scr_profile.value)
+		return;
+
+	GL_SetCanvas (CANVAS_TOPRIGHT);
+
+	x = 320 - graphw;
+	y = 8;
+
+	Draw_Fill (x - 4, y - 4, graphw + 4, graphh + 8 + 8*(PROF_MAX_LINES + 2) + 4, 0, 0.5f);
+
+	// frame time graph, newest on the right, GPU drawn over CPU
+	for (i = 0; i < PROF_HISTORY; i++)
+	{
+		pos = (prof.historypos + i) % PROF_HISTORY;
+		h = q_min (prof.cpuhistory[pos] / maxms, 1.f) * graphh;
+		Draw_FillEx (x + i * colw, y + graphh - h, colw, h, cpucolor, 0.5f);
+		h = q_min (prof.gpuhistory[pos] / maxms, 1.f) * graphh;
+		Draw_FillEx (x + i * colw, y + graphh - h, colw, h, gpucolor, 0.5f);
+	}
+	// 60 fps line
+	Draw_FillEx (x, y + graphh * (1.f - 16.7f / maxms), graphw, 0.5f, linecolor, 0.75f);
+	y += graphh + 4;
+
+	pos = (prof.historypos + PROF_HISTORY - 1) % PROF_HISTORY;
+	Draw_String (x, y, va ("cpu %5.2f ms   gpu %5.2f ms", prof.cpuhistory[pos], prof.gpuhistory[pos]));
+	y += 12;
+
+	for (i = 0, count = 0; i < prof.numstats; i++)
+		sorted[count++] = &prof.stats[i];
+	qsort (sorted, count, sizeof (sorted[0]), Prof_CompareStats);
+
+	count = q_min (count, PROF_MAX_LINES);
+	for (i = 0; i < count; i++, y += 8)
+	{
+		const profstat_t *stat = sorted[i];
+		Draw_String (x, y, va ("%-16.16s %5.2f %5.2f", stat->name, stat->cpu, stat->gpu));
+	}
+}
+
+/*
+==============================================================================
+
+TRACE EXPORT
+
+==============================================================================
+*/
+
+/*
+================
+Prof_Trace_f
+
+profile_trace [numframes] [filename]
+================
+*/
+static void Prof_Trace_f (void)
+{
+	char	relname[MAX_OSPATH];
+	int		numframes;
+
+	if (prof.trace)
+	{
+		Con_Printf ("Trace capture already in progress (%d frames left)\n", prof.traceframes);
+		return;
+	}
+
+	numframes = Cmd_Argc () >= 2 ? atoi (Cmd_Argv (1)) : 120;
+	if (numframes <= 0)
+	{
+		Con_Printf ("usage: profile_trace [numframes] [filename]\n");
+		return;
+	}
+
+	q_strlcpy (relname, Cmd_Argc () >= 3 ? Cmd_Argv (2) : "trace", sizeof (relname));
+	if (strstr (relname, ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return;
+	}
+	COM_AddExtension (relname, ".json", sizeof (relname));
+	q_snprintf (prof.tracename, sizeof (prof.tracename), "%s/%s", com_gamedir, relname);
+
+	prof.trace = Sys_fopen (prof.tracename, "wb");
+	if (!prof.trace)
+	{
+		Con_Printf ("ERROR: couldn't create %s\n", relname);
+		return;
+	}
+
+	fprintf (prof.trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf (prof.trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"Main\"}},\n", prof.mainthread);
+	fprintf (prof.trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", PROF_GPU_THREAD);
+	prof.tracecomma = true;
+	prof.traceframes = numframes;
+	prof.tracefirstframe = prof.framenum + 1;
+
+	Con_Printf ("Capturing %d frames\n", numframes);
+}
+
+/*
+================
+Prof_Init
+================
+*/
+void Prof_Init (void)
+{
+	prof.mainthread = SDL_ThreadID ();
+
+	Cvar_RegisterVariable (&scr_profile);
+	Cmd_AddCommand ("profile_trace", Prof_Trace_f);
+}
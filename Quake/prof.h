@@ -0,0 +1,41 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+// prof.h -- frame profiler (CPU zones per thread, GPU zones via timer queries)
+
+extern	cvar_t	scr_profile;
+
+void Prof_Init (void);
+void Prof_BeginFrame (void);
+void Prof_EndFrame (void);
+
+// CPU zones can be opened on any thread, but must be closed on the same one
+void Prof_BeginZone (const char *name);
+void Prof_EndZone (void);
+
+// GPU zones also record a CPU zone; render thread only (see GL_BeginGroup)
+void Prof_BeginGPUZone (const char *name);
+void Prof_EndGPUZone (void);
+
+void Prof_Draw (void);
+
+#endif	/* _PROF_H_ */
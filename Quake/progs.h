@@ -188,6 +188,7 @@ struct pr_extfields_s
 	QCEXTENSION(DP_QC_TOKENIZE_CONSOLE)			\
 	QCEXTENSION(DP_QC_STRFTIME)					\
 	QCEXTENSION(KRIMZON_SV_PARSECLIENTCOMMAND)	\
+	QCEXTENSION(IW_QC_TRACELINES)				\
 
 typedef enum
 {
@@ -200,6 +201,12 @@ typedef enum
 	QCEXT_COUNT,
 } qcextension_t;
 
+typedef struct prtempchunk_s
+{
+	char			*base;
+	size_t			size;
+} prtempchunk_t;
+
 typedef struct qcvm_s
 {
 	dprograms_t		*progs;
@@ -240,9 +247,21 @@ typedef struct qcvm_s
 	int				numknownstrings;
 	const char		**firstfreeknownstring; // free list (singly linked)
 
+	// temp strings (see PR_AllocTempString), recycled once per host frame
+	prtempchunk_t	*tempchunks;		// VEC of arena chunks
+	size_t			tempused;			// bytes used in the last chunk
+	int				*tempslots;			// VEC of knownstrings slots reserved for temps
+	int				numtempstrings;		// temps handed out this frame
+	int				tempframe;			// host_framecount at the last reset
+	size_t			tempbytes;			// bytes handed out this frame
+	size_t			peaktempbytes;
+	int				peaktempstrings;
+
 	unsigned char	*knownzone;
 	size_t			knownzonesize;
 
+	void			**allocs;			// VEC of PR_Alloc blocks, the progs file first
+
 	ddef_t			*globaldefs;
 
 	prhashtable_t	ht_fields;
@@ -263,7 +282,8 @@ typedef struct qcvm_s
 	double		time;
 	int			num_edicts;
 	int			reserved_edicts;
-	int			max_edicts;
+	int			max_edicts;			// address space is reserved for this many
+	int			committed_edicts;	// backed by memory, grows on demand
 	link_t		free_edicts;		// linked list of free edicts
 	edict_t		*edicts;			// can NOT be array indexed, because
 									// edict_t is variable sized, but can
@@ -326,6 +346,12 @@ const char *PR_GetString (int num);
 int PR_SetEngineString (const char *s);
 void PR_ClearEngineString (int num);
 int PR_AllocString (int bufferlength, char **ptr);
+char *PR_AllocTempString (size_t size);
+qboolean PR_IsTempString (const char *s);
+const char *PR_KeepString (const char *s);
+void *PR_Alloc (size_t size);
+int PR_MakeTempString (const char *val);
+void PR_TempStrings_f (void);
 
 void PR_Profile_f (void);
 
@@ -348,6 +374,10 @@ void ED_LoadFromFile (const char *data);
 #define EDICT_NUM(n)		((edict_t *)(sv.edicts+ (n)*pr_edict_size))
 #define NUM_FOR_EDICT(e)	(((byte *)(e) - sv.edicts) / pr_edict_size)
 */
+void ED_AllocEdictStore (int max_edicts, int initial);
+void ED_GrowEdictStore (int count);
+void ED_FreeEdictStore (void);
+
 edict_t *EDICT_NUM(int);
 int NUM_FOR_EDICT(edict_t*);
 int SAVE_NUM_FOR_EDICT (savedata_t *save, edict_t *e);
@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define PRFL_EDICTSCALE		(1 << 5)
 #define PRFL_ALPHASANITY	(1 << 6)	// cleanup insanity with alpha
 #define PRFL_INT32COORD		(1 << 7)
+#define PRFL_LARGEEDICTS	(1 << 8)	// entity numbers are 24-bit (short + byte) instead of short
 #define PRFL_MOREFLAGS		(1 << 31)	// not supported
 
 // if the high bit of the servercmd is set, the low bits are fast update flags:
@@ -224,6 +225,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define svc_backtolobby		55
 #define svc_localsound		56
 
+// ironwail extension, only sent to clients that asked for it with "predict 1"
+#define svc_moveack		57	// [long] last move sequence [byte] MOVEACK_* [float3] origin [float3] velocity
+
+#define MOVEACK_ONGROUND		(1<<0)
+#define MOVEACK_JUMPRELEASED	(1<<1)
+#define MOVEACK_PREDICTABLE		(1<<2)	// walking, alive and out of water
+
+// ironwail extension, only sent to clients that asked for it with "entkeep 1"
+#define svc_entkeep		58	// [byte] count, count * [entity]: visible but not updated this time, keep as is
+
 //
 // client to server
 //
@@ -232,6 +243,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	clc_disconnect	2
 #define	clc_move		3		// [usercmd_t]
 #define	clc_stringcmd	4		// [string] message
+#define	clc_moveseq		20		// [long] sequence of the clc_move in the same packet, only after svc_moveack
 
 //
 // temp entity events
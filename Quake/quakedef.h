@@ -103,8 +103,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // per-level limits
 //
 #define	MIN_EDICTS	256		// johnfitz -- lowest allowed value for max_edicts cvar
-#define	MAX_EDICTS	32000		// johnfitz -- highest allowed value for max_edicts cvar
-						// ents past 8192 can't play sounds in the standard protocol
+#define	MAX_EDICTS	(1<<20)		// johnfitz -- highest allowed value for max_edicts cvar
+						// ents past 8192 can't play sounds in the standard protocol,
+						// ents past 32767 need PROTOCOL_RMQ with PRFL_LARGEEDICTS
+#define	EDICT_STORE_CHUNK	1024	// edicts are committed in chunks of this many
 #define	MAX_LIGHTSTYLES	64
 #define	MAX_MODELS	4096		// johnfitz -- was 256
 #define	MAX_SOUNDS	2048		// johnfitz -- was 256
@@ -289,6 +291,7 @@ typedef struct
 #include "menu.h"
 #include "cdaudio.h"
 #include "glquake.h"
+#include "prof.h"
 
 
 //=============================================================================
@@ -305,6 +308,7 @@ extern qboolean noclip_anglehack;
 extern	quakeparms_t *host_parms;
 
 extern	cvar_t		sys_ticrate;
+extern	cvar_t		sys_idlewait;
 extern	cvar_t		sys_nostdout;
 extern	cvar_t		developer;
 extern	cvar_t		map_checks;
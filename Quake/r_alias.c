@@ -51,7 +51,7 @@ typedef struct {
 } lerpdata_t;
 //johnfitz
 
-#define MAX_ALIAS_INSTANCES 256
+#define MAX_ALIAS_INSTANCES 1024
 
 typedef struct aliasinstance_s {
 	float		worldmatrix[12];
@@ -60,12 +60,20 @@ typedef struct aliasinstance_s {
 	int32_t		pose1;
 	int32_t		pose2;
 	float		blend;
-	int32_t		padding;
+	int32_t		palette;	// first bone in the skinning output (PV_IQM only)
 } aliasinstance_t;
 
+typedef struct aliasdraw_s {
+	gltexture_t	*textures[2];
+} aliasdraw_t;
+
 struct ibuf_s {
 	int			count;
 	entity_t	*ent;
+	int			totalverts;
+
+	bmodel_draw_indirect_t	*cmds;
+	aliasdraw_t				*draws;
 
 	struct {
 		float	matviewproj[16];
@@ -288,6 +296,127 @@ void R_SetupAliasLighting (entity_t	*e)
 	VectorScale (lightcolor, 1.0f / 200.0f, lightcolor);
 }
 
+/*
+=================
+R_GetAliasSurfaceTextures
+=================
+*/
+static qboolean R_GetAliasSurfaceTextures (aliashdr_t *mainhdr, aliashdr_t *hdr, int anim, qboolean showtris, int alphapixels, gltexture_t *textures[2])
+{
+	int skinnum = ibuf.ent->skinnum;
+
+	if ((skinnum >= hdr->numskins) || (skinnum < 0)) skinnum = 0;
+	textures[0] = hdr->gltextures[skinnum][anim];
+	if (!textures[0])
+		return false;
+	if (alphapixels >= 0 && !(textures[0]->flags & TEXPREF_ALPHAPIXELS) != !alphapixels)
+		return false;
+
+	textures[1] = hdr->fbtextures[skinnum][anim];
+	if (hdr == mainhdr && ibuf.ent->colormap != vid.colormap && !gl_nocolors.value)
+		if (CL_IsPlayerEnt (ibuf.ent)) textures[0] = playertextures[ibuf.ent - cl_entities - 1];
+	if (!gl_fullbrights.value) textures[1] = blacktexture;
+	if (r_lightmap_cheatsafe) { textures[0] = greytexture; textures[1] = blacktexture; }
+	if (!textures[1]) textures[1] = blacktexture;
+	if (showtris) { textures[0] = blacktexture; textures[1] = whitetexture; }
+
+	return true;
+}
+
+/*
+=================
+R_AddAliasDrawCalls
+
+Appends one indirect draw per surface covering all the instances in the batch.
+alphapixels: 0 = only opaque skins, 1 = only skins with alpha pixels, -1 = all
+=================
+*/
+static void R_AddAliasDrawCalls (aliashdr_t *mainhdr, int anim, qboolean showtris, int alphapixels)
+{
+	aliashdr_t *hdr;
+
+	VEC_CLEAR (ibuf.cmds);
+	VEC_CLEAR (ibuf.draws);
+
+	for (hdr = mainhdr; hdr; hdr = Mod_NextSurface (hdr))
+	{
+		bmodel_draw_indirect_t cmd;
+		aliasdraw_t draw;
+
+		if (!R_GetAliasSurfaceTextures (mainhdr, hdr, anim, showtris, alphapixels, draw.textures))
+			continue;
+
+		cmd.count = hdr->numindexes;
+		cmd.instanceCount = ibuf.count;
+		cmd.firstIndex = (GLuint)(hdr->eboofs / sizeof (unsigned short));
+		cmd.baseVertex = 0;
+		cmd.baseInstance = 0;
+
+		VEC_PUSH (ibuf.cmds, cmd);
+		VEC_PUSH (ibuf.draws, draw);
+		rs_aliaspasses += hdr->numtris * ibuf.count;
+	}
+}
+
+/*
+=================
+R_FlushAliasDrawCalls
+
+Issues one multi-draw per run of surfaces sharing the same textures
+=================
+*/
+static void R_FlushAliasDrawCalls (void)
+{
+	GLuint	buf;
+	GLbyte	*ofs;
+	size_t	i, first, numcmds = VEC_SIZE (ibuf.cmds);
+
+	if (!numcmds)
+		return;
+
+	GL_Upload (GL_DRAW_INDIRECT_BUFFER, ibuf.cmds, sizeof (ibuf.cmds[0]) * numcmds, &buf, &ofs);
+	GL_BindBuffer (GL_DRAW_INDIRECT_BUFFER, buf);
+
+	for (first = 0; first < numcmds; first = i)
+	{
+		for (i = first + 1; i < numcmds; i++)
+			if (memcmp (ibuf.draws[i].textures, ibuf.draws[first].textures, sizeof (ibuf.draws[i].textures)) != 0)
+				break;
+
+		GL_BindTextures (0, 2, ibuf.draws[first].textures);
+		GL_MultiDrawElementsIndirectFunc (GL_TRIANGLES, GL_UNSIGNED_SHORT, ofs + first * sizeof (ibuf.cmds[0]), i - first, sizeof (ibuf.cmds[0]));
+	}
+}
+
+/*
+=================
+R_SkinAliasInstances
+
+Computes the bone palette of every instance in the batch (PV_IQM only).
+Returns the palette buffer range in buffer/offset/size.
+=================
+*/
+static void R_SkinAliasInstances (aliashdr_t *mainhdr, const GLuint buffers[2], const GLintptr offsets[2], const GLsizeiptr sizes[2],
+	GLuint *outbuf, GLintptr *outofs, GLsizeiptr *outsize)
+{
+	GLuint		buf;
+	size_t		ofs;
+	GLsizeiptr	size = sizeof (bonepose_t) * mainhdr->numbones * ibuf.count;
+
+	GL_ReserveDeviceMemory (GL_SHADER_STORAGE_BUFFER, size, &buf, &ofs);
+
+	GL_UseProgram (glprogs.alias_skin);
+	GL_BindBuffersRange (GL_SHADER_STORAGE_BUFFER, 1, 2, buffers, offsets, sizes);
+	GL_BindBufferRange (GL_SHADER_STORAGE_BUFFER, 3, buf, ofs, size);
+	GL_Uniform1iFunc (0, mainhdr->numbones);
+	GL_DispatchComputeFunc ((mainhdr->numbones * ibuf.count + 63) / 64, 1, 1);
+	GL_MemoryBarrierFunc (GL_SHADER_STORAGE_BARRIER_BIT);
+
+	*outbuf = buf;
+	*outofs = ofs;
+	*outsize = size;
+}
+
 /*
 =================
 R_FlushAliasInstances
@@ -297,11 +426,10 @@ void R_FlushAliasInstances (qboolean showtris)
 {
 	extern cvar_t r_softemu_mdl_warp;
 	qmodel_t* model;
-	aliashdr_t* mainhdr, *hdr;
+	aliashdr_t* mainhdr;
 	qboolean	alphatest, translucent, oit;
-	int			totalverts;
 	int			poseverttype;
-	int			skinnum, anim, mode;
+	int			anim, mode;
 	unsigned	state, opaque_state, transparent_state;
 	GLuint		buf;
 	GLbyte* ofs;
@@ -309,7 +437,6 @@ void R_FlushAliasInstances (qboolean showtris)
 	GLuint		buffers[2];
 	GLintptr	offsets[2];
 	GLsizeiptr	sizes[2];
-	gltexture_t* textures[2];
 
 	if (!ibuf.count)
 		return;
@@ -336,7 +463,6 @@ void R_FlushAliasInstances (qboolean showtris)
 		mode = r_softemu_mdl_warp.value > 0.f ? ALIASSHADER_NOPERSP : ALIASSHADER_STANDARD;
 		break;
 	}
-	GL_UseProgram (glprogs.alias[oit][mode][alphatest][poseverttype]);
 
 	if (poseverttype == PV_IQM)
 		state = GLS_CULL_BACK | GLS_ATTRIBS (5);
@@ -346,11 +472,6 @@ void R_FlushAliasInstances (qboolean showtris)
 	opaque_state = (state | GLS_BLEND_OPAQUE) & ~(GLS_BLEND_ALPHA_OIT | GLS_NO_ZWRITE);
 	transparent_state = (state | GLS_BLEND_ALPHA) & ~(GLS_BLEND_OPAQUE | GLS_CULL_BACK);
 
-	if (translucent)
-	{
-		GL_SetState ((state | GLS_BLEND_ALPHA_OIT | GLS_NO_ZWRITE) & ~GLS_CULL_BACK);
-	}
-
 	memcpy (ibuf.global.matviewproj, r_matviewproj, sizeof (r_matviewproj));
 	memcpy (ibuf.global.eyepos, r_refdef.vieworg, sizeof (r_refdef.vieworg));
 	memcpy (ibuf.global.fog, r_framedata.fogdata, 3 * sizeof (float));
@@ -364,9 +485,6 @@ void R_FlushAliasInstances (qboolean showtris)
 	ibuf_size = sizeof (ibuf.global) + sizeof (ibuf.inst[0]) * ibuf.count;
 	GL_Upload (GL_SHADER_STORAGE_BUFFER, &ibuf.global, ibuf_size, &buf, &ofs);
 
-	for (hdr = mainhdr, totalverts = 0; hdr; hdr = Mod_NextSurface (hdr))
-		totalverts += hdr->numverts_vbo;
-
 	buffers[0] = buf;
 	offsets[0] = (GLintptr)ofs;
 	sizes[0] = ibuf_size;
@@ -374,17 +492,28 @@ void R_FlushAliasInstances (qboolean showtris)
 	{
 	case PV_IQM:
 		buffers[1] = model->meshvbo; offsets[1] = mainhdr->vboposeofs; sizes[1] = sizeof (bonepose_t) * mainhdr->numbones * mainhdr->numposes;
+		// lerp the bone poses once per instance instead of once per vertex
+		R_SkinAliasInstances (mainhdr, buffers, offsets, sizes, &buffers[1], &offsets[1], &sizes[1]);
 		break;
 	case PV_MD3:
-		buffers[1] = model->meshvbo; offsets[1] = mainhdr->vbovertofs; sizes[1] = sizeof (md3pose_t) * totalverts * mainhdr->numposes;
+		buffers[1] = model->meshvbo; offsets[1] = mainhdr->vbovertofs; sizes[1] = sizeof (md3pose_t) * ibuf.totalverts * mainhdr->numposes;
 		break;
 	case PV_QUAKE1:
-		buffers[1] = model->meshvbo; offsets[1] = mainhdr->vbovertofs; sizes[1] = sizeof (meshxyz_t) * totalverts * mainhdr->numposes;
+		buffers[1] = model->meshvbo; offsets[1] = mainhdr->vbovertofs; sizes[1] = sizeof (meshxyz_t) * ibuf.totalverts * mainhdr->numposes;
 		break;
 	default:
+		ibuf.count = 0;
+		GL_EndGroup ();
 		return;
 	}
 
+	GL_UseProgram (glprogs.alias[oit][mode][alphatest][poseverttype]);
+
+	if (translucent)
+	{
+		GL_SetState ((state | GLS_BLEND_ALPHA_OIT | GLS_NO_ZWRITE) & ~GLS_CULL_BACK);
+	}
+
 	GL_BindBuffer (GL_ARRAY_BUFFER, model->meshvbo);
 	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, model->meshindexesvbo);
 	GL_BindBuffersRange (GL_SHADER_STORAGE_BUFFER, 1, 2, buffers, offsets, sizes);
@@ -402,62 +531,20 @@ void R_FlushAliasInstances (qboolean showtris)
 		GL_VertexAttribPointerFunc (0, 2, GL_FLOAT, GL_FALSE, sizeof (meshst_t), (void*)mainhdr->vbostofs);
 	}
 
-	if (!translucent)
-		GL_SetState (opaque_state);
-
-	for (hdr = mainhdr; hdr; hdr = Mod_NextSurface (hdr))
+	if (translucent)
 	{
-		skinnum = ibuf.ent->skinnum;
-		if ((skinnum >= hdr->numskins) || (skinnum < 0)) skinnum = 0;
-		textures[0] = hdr->gltextures[skinnum][anim];
-		if (!textures[0]) continue;
-
-		if (!translucent && (textures[0]->flags & TEXPREF_ALPHAPIXELS))
-		{
-			continue;
-		}
-		textures[1] = hdr->fbtextures[skinnum][anim];
-		if (hdr == mainhdr && ibuf.ent->colormap != vid.colormap && !gl_nocolors.value)
-			if (CL_IsPlayerEnt (ibuf.ent)) textures[0] = playertextures[ibuf.ent - cl_entities - 1];
-		if (!gl_fullbrights.value) textures[1] = blacktexture;
-		if (r_lightmap_cheatsafe) { textures[0] = greytexture; textures[1] = blacktexture; }
-		if (!textures[1]) textures[1] = blacktexture;
-		if (showtris) { textures[0] = blacktexture; textures[1] = whitetexture; }
-
-		GL_BindTextures (0, 2, textures);
-		GL_DrawElementsInstancedFunc (GL_TRIANGLES, hdr->numindexes, GL_UNSIGNED_SHORT, (void*)hdr->eboofs, ibuf.count);
-		rs_aliaspasses += hdr->numtris * ibuf.count;
+		R_AddAliasDrawCalls (mainhdr, anim, showtris, -1);
+		R_FlushAliasDrawCalls ();
 	}
-
-	if (!translucent)
+	else
 	{
-		GL_SetState (transparent_state);
-
-		for (hdr = mainhdr; hdr; hdr = Mod_NextSurface (hdr))
-		{
-			skinnum = ibuf.ent->skinnum;
-			if ((skinnum >= hdr->numskins) || (skinnum < 0)) skinnum = 0;
-			textures[0] = hdr->gltextures[skinnum][anim];
-			if (!textures[0]) continue;
-
-			if (!(textures[0]->flags & TEXPREF_ALPHAPIXELS))
-			{ 
-				continue;
-			}
-
-			textures[1] = hdr->fbtextures[skinnum][anim];
-			if (hdr == mainhdr && ibuf.ent->colormap != vid.colormap && !gl_nocolors.value)
-				if (CL_IsPlayerEnt (ibuf.ent)) textures[0] = playertextures[ibuf.ent - cl_entities - 1];
-			if (!gl_fullbrights.value) textures[1] = blacktexture;
-			if (r_lightmap_cheatsafe) { textures[0] = greytexture; textures[1] = blacktexture; }
-			if (!textures[1]) textures[1] = blacktexture;
-			if (showtris) { textures[0] = blacktexture; textures[1] = whitetexture; }
-
-			GL_BindTextures (0, 2, textures);
-			GL_DrawElementsInstancedFunc (GL_TRIANGLES, hdr->numindexes, GL_UNSIGNED_SHORT, (void*)hdr->eboofs, ibuf.count);
-			rs_aliaspasses += hdr->numtris * ibuf.count;
-		}
+		GL_SetState (opaque_state);
+		R_AddAliasDrawCalls (mainhdr, anim, showtris, 0);
+		R_FlushAliasDrawCalls ();
 
+		GL_SetState (transparent_state);
+		R_AddAliasDrawCalls (mainhdr, anim, showtris, 1);
+		R_FlushAliasDrawCalls ();
 	}
 
 	ibuf.count = 0;
@@ -568,7 +655,6 @@ static void R_DrawAliasModel_Real (entity_t *e, aliasmode_t mode)
 	float		fovscale = 1.0f;
 	float		model_matrix[16];
 	aliasinstance_t	*instance;
-	int			totalverts;
 
 	//
 	// setup pose/lerp data -- do it first so we don't miss updates due to culling
@@ -647,9 +733,13 @@ static void R_DrawAliasModel_Real (entity_t *e, aliasmode_t mode)
 		R_FlushAliasInstances (mode == ALIAS_SHOWTRIS);
 
 	if (!ibuf.count)
+	{
 		ibuf.ent = e;
+		for (hdr = paliashdr, ibuf.totalverts = 0; hdr; hdr = Mod_NextSurface (hdr))
+			ibuf.totalverts += hdr->numverts_vbo;
+	}
 
-	instance = &ibuf.inst[ibuf.count++];
+	instance = &ibuf.inst[ibuf.count];
 
 	MatrixTranspose4x3 (model_matrix, instance->worldmatrix);
 
@@ -660,20 +750,21 @@ static void R_DrawAliasModel_Real (entity_t *e, aliasmode_t mode)
 	instance->pose1 = lerpdata.pose1;
 	instance->pose2 = lerpdata.pose2;
 	instance->blend = lerpdata.blend;
-
-	for (hdr = paliashdr, totalverts = 0; hdr; hdr = Mod_NextSurface (hdr))
-		totalverts += hdr->numverts_vbo;
+	instance->palette = 0;
 
 	if (paliashdr->poseverttype == PV_QUAKE1 || paliashdr->poseverttype == PV_MD3)
 	{
-		instance->pose1 *= totalverts;
-		instance->pose2 *= totalverts;
+		instance->pose1 *= ibuf.totalverts;
+		instance->pose2 *= ibuf.totalverts;
 	}
 	else if (paliashdr->poseverttype == PV_IQM)
 	{
 		instance->pose1 *= paliashdr->numbones;
 		instance->pose2 *= paliashdr->numbones;
+		instance->palette = ibuf.count * paliashdr->numbones;
 	}
+
+	ibuf.count++;
 }
 
 /*
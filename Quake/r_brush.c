@@ -48,6 +48,23 @@ gltexture_t		*lightmap_texture;
 int				lightmap_width;
 int				lightmap_height;
 
+cvar_t			r_lightmapcache = {"r_lightmapcache", "0", CVAR_ARCHIVE};
+
+typedef struct {
+	int				mins[2];
+	int				maxs[2];
+} lmrect_t;
+
+#define BAKED_LIGHTMAP_SCALE	2	// baked texels are stored at half intensity, clamping at 2x overbright
+
+static unsigned		*lightmap_baked_data;
+static gltexture_t	*lightmap_baked_texture;
+static lmrect_t		*lightmap_baked_dirty;						// per lightmap block
+static int			*lightmap_baked_style_surfs[MAX_LIGHTSTYLES];	// lit_surfs indices using each animated style
+static int			*lightmap_baked_surf_frame;					// last r_framecount a surface was composited
+static int			lightmap_baked_styles[MAX_LIGHTSTYLES];			// 8.8 style values last composited, -1 = invalid
+static qboolean		lightmap_baked_active;
+
 
 /*
 ===============
@@ -288,6 +305,28 @@ static void GL_FillSurfaceLightmap (msurface_t *surf)
 	}
 }
 
+/*
+==================
+GL_FreeBakedLightmapData
+==================
+*/
+static void GL_FreeBakedLightmapData (void)
+{
+	int i;
+
+	free (lightmap_baked_data);
+	lightmap_baked_data = NULL;
+	free (lightmap_baked_dirty);
+	lightmap_baked_dirty = NULL;
+	free (lightmap_baked_surf_frame);
+	lightmap_baked_surf_frame = NULL;
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		VEC_FREE (lightmap_baked_style_surfs[i]);
+
+	lightmap_baked_texture = NULL; // freed by the texture manager
+	lightmap_baked_active = false;
+}
+
 /*
 ==================
 GL_FreeLightmapData
@@ -308,6 +347,8 @@ static void GL_FreeLightmapData (void)
 
 	VEC_CLEAR (lit_surfs);
 
+	GL_FreeBakedLightmapData ();
+
 	lightmap_texture = NULL; // freed by the texture manager
 	last_lightmap_allocated = 0;
 	lightmap_count = 0;
@@ -526,6 +567,249 @@ void GL_BuildLightmaps (void)
 	//johnfitz
 }
 
+/*
+=============================================================
+
+	BAKED LIGHTMAP CACHE
+
+Composites all the lightstyles of a surface into a single texel
+so the world shader only needs one lightmap tap. Only surfaces
+using a style whose value changed since the last frame are
+recomposited, and only the dirty rectangle of each lightmap
+block is uploaded.
+
+=============================================================
+*/
+
+/*
+========================
+GL_GetBakedStyleValue
+========================
+*/
+static int GL_GetBakedStyleValue (int style)
+{
+	// must match GetLightStyle in the world shader
+	if (style < MAX_LIGHTSTYLES)
+		return (int)(r_lightbuffer.lightstyles[style] * 256.f + 0.5f);
+	return 256;
+}
+
+/*
+========================
+GL_BakeSurfaceLightmap
+========================
+*/
+static void GL_BakeSurfaceLightmap (msurface_t *surf)
+{
+	lightmap_t	*lm;
+	lmrect_t	*rect;
+	int			smax, tmax;
+	int			xofs, yofs;
+	int			map, s, t, facesize;
+	int			scale[MAXLIGHTMAPS];
+	unsigned	*dst;
+	const byte	*src;
+
+	if (!surf->samples || surf->styles[0] == 255)
+		return;
+
+	lm = &lightmaps[surf->lightmaptexturenum];
+	smax = (surf->extents[0]>>4)+1;
+	tmax = (surf->extents[1]>>4)+1;
+	xofs = lm->xofs + surf->light_s;
+	yofs = lm->yofs + surf->light_t;
+	facesize = smax * tmax * 3;
+
+	for (map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++)
+		scale[map] = GL_GetBakedStyleValue (surf->styles[map]);
+
+	src = surf->samples;
+	dst = lightmap_baked_data + yofs * lightmap_width + xofs;
+	for (t = 0; t < tmax; t++, dst += lightmap_width)
+	{
+		for (s = 0; s < smax; s++, src += 3)
+		{
+			const byte *mapsrc = src;
+			unsigned r = 0, g = 0, b = 0;
+			int i;
+
+			for (i = 0; i < map; i++, mapsrc += facesize)
+			{
+				r += mapsrc[0] * scale[i];
+				g += mapsrc[1] * scale[i];
+				b += mapsrc[2] * scale[i];
+			}
+
+			r /= 256 * BAKED_LIGHTMAP_SCALE;
+			g /= 256 * BAKED_LIGHTMAP_SCALE;
+			b /= 256 * BAKED_LIGHTMAP_SCALE;
+			dst[s] = q_min (r, 255u) | (q_min (g, 255u) << 8) | (q_min (b, 255u) << 16) | 0xff000000u;
+		}
+	}
+
+	rect = &lightmap_baked_dirty[surf->lightmaptexturenum];
+	rect->mins[0] = q_min (rect->mins[0], surf->light_s);
+	rect->mins[1] = q_min (rect->mins[1], surf->light_t);
+	rect->maxs[0] = q_max (rect->maxs[0], surf->light_s + smax);
+	rect->maxs[1] = q_max (rect->maxs[1], surf->light_t + tmax);
+
+	rs_dynamiclightmaps++;
+}
+
+/*
+========================
+GL_ResetBakedDirtyRects
+========================
+*/
+static void GL_ResetBakedDirtyRects (void)
+{
+	int i;
+
+	for (i = 0; i < lightmap_count; i++)
+	{
+		lmrect_t *rect = &lightmap_baked_dirty[i];
+		rect->mins[0] = rect->mins[1] = INT_MAX;
+		rect->maxs[0] = rect->maxs[1] = 0;
+	}
+}
+
+/*
+========================
+GL_AllocBakedLightmap
+
+Called the first time the cache is enabled on a map
+========================
+*/
+static void GL_AllocBakedLightmap (void)
+{
+	size_t	i, j, lmsize = (size_t)lightmap_width * lightmap_height;
+	int		map;
+
+	lightmap_baked_data = (unsigned *) malloc (lmsize * sizeof (*lightmap_baked_data));
+	lightmap_baked_dirty = (lmrect_t *) malloc (lightmap_count * sizeof (*lightmap_baked_dirty));
+	lightmap_baked_surf_frame = (int *) calloc (VEC_SIZE (lit_surfs), sizeof (*lightmap_baked_surf_frame));
+	if (!lightmap_baked_data || !lightmap_baked_dirty || (VEC_SIZE (lit_surfs) && !lightmap_baked_surf_frame))
+		Sys_Error ("GL_AllocBakedLightmap: out of memory on %" SDL_PRIu64 " bytes", (uint64_t)(lmsize * sizeof (*lightmap_baked_data)));
+
+	// keep the reserved texel and black samples, every lit surface is overwritten below
+	memcpy (lightmap_baked_data, lightmap_data, lmsize * sizeof (*lightmap_baked_data));
+
+	for (i = 0, j = VEC_SIZE (lit_surfs); i < j; i++)
+	{
+		msurface_t *surf = lit_surfs[i];
+		if (!surf->samples)
+			continue;
+		for (map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++)
+			if (surf->styles[map] < MAX_LIGHTSTYLES)
+				VEC_PUSH (lightmap_baked_style_surfs[surf->styles[map]], (int)i);
+		GL_BakeSurfaceLightmap (surf);
+	}
+
+	for (map = 0; map < MAX_LIGHTSTYLES; map++)
+		lightmap_baked_styles[map] = GL_GetBakedStyleValue (map);
+
+	lightmap_baked_texture =
+		TexMgr_LoadImage (cl.worldmodel, "lightmap_baked", lightmap_width, lightmap_height,
+			SRC_LIGHTMAP, (byte *)lightmap_baked_data, "", (src_offset_t)lightmap_baked_data,
+			TEXPREF_ALPHA | TEXPREF_LINEAR | TEXPREF_NOPICMIP
+		);
+
+	GL_ResetBakedDirtyRects ();
+}
+
+/*
+========================
+GL_UploadBakedDirtyRects
+========================
+*/
+static void GL_UploadBakedDirtyRects (void)
+{
+	int			i;
+	qboolean	bound = false;
+
+	for (i = 0; i < lightmap_count; i++)
+	{
+		lmrect_t	*rect = &lightmap_baked_dirty[i];
+		int			x, y;
+
+		if (rect->maxs[0] <= rect->mins[0])
+			continue;
+
+		if (!bound)
+		{
+			GL_Bind (GL_TEXTURE0, lightmap_baked_texture);
+			glPixelStorei (GL_UNPACK_ROW_LENGTH, lightmap_width);
+			bound = true;
+		}
+
+		x = lightmaps[i].xofs + rect->mins[0];
+		y = lightmaps[i].yofs + rect->mins[1];
+		glTexSubImage2D (GL_TEXTURE_2D, 0, x, y, rect->maxs[0] - rect->mins[0], rect->maxs[1] - rect->mins[1],
+			gl_lightmap_format, GL_UNSIGNED_BYTE, lightmap_baked_data + y * lightmap_width + x);
+	}
+
+	if (bound)
+		glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+
+	GL_ResetBakedDirtyRects ();
+}
+
+/*
+========================
+R_UpdateBakedLightmaps -- called once per frame, after R_AnimateLight
+========================
+*/
+void R_UpdateBakedLightmaps (void)
+{
+	int i, j, style, value;
+
+	lightmap_baked_active = false;
+	r_framedata.bakedlightscale = 0.f;
+
+	if (!r_lightmapcache.value || !lightmap_data || !cl.worldmodel || !cl.worldmodel->lightdata)
+	{
+		// force a full refresh next time the cache is enabled
+		for (style = 0; style < MAX_LIGHTSTYLES; style++)
+			lightmap_baked_styles[style] = -1;
+		return;
+	}
+
+	if (!lightmap_baked_data)
+		GL_AllocBakedLightmap ();
+
+	for (style = 0; style < MAX_LIGHTSTYLES; style++)
+	{
+		value = GL_GetBakedStyleValue (style);
+		if (value == lightmap_baked_styles[style])
+			continue;
+		lightmap_baked_styles[style] = value;
+
+		for (i = 0, j = VEC_SIZE (lightmap_baked_style_surfs[style]); i < j; i++)
+		{
+			int idx = lightmap_baked_style_surfs[style][i];
+			if (lightmap_baked_surf_frame[idx] == r_framecount)
+				continue;
+			lightmap_baked_surf_frame[idx] = r_framecount;
+			GL_BakeSurfaceLightmap (lit_surfs[idx]);
+		}
+	}
+
+	GL_UploadBakedDirtyRects ();
+
+	lightmap_baked_active = true;
+	r_framedata.bakedlightscale = BAKED_LIGHTMAP_SCALE;
+}
+
+/*
+========================
+R_GetLightmapTexture
+========================
+*/
+gltexture_t *R_GetLightmapTexture (void)
+{
+	return lightmap_baked_active ? lightmap_baked_texture : lightmap_texture;
+}
+
 /*
 =============================================================
 
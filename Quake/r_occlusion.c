@@ -0,0 +1,474 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_occlusion.c -- hierarchical-Z occlusion culling
+
+// After the opaque pass, the scene depth is reduced into a max-depth pyramid
+// (framebufs.hiz). On the next frame the cull/mark compute shader tests world
+// surfaces against it using the view it was built with. Entities are drawn
+// from CPU-side lists, so a coarse pyramid level is also read back a few
+// frames late and entity boxes are tested against that on the CPU.
+//
+// Depth is stored as "farness" (0 = near plane, 1 = far plane) regardless of
+// reversed Z, so the reduction is always a max and the test is always
+// nearest box depth > farthest occluder depth.
+
+#include "quakedef.h"
+
+#define OCCLUSION_FRAMES		3		// readbacks in flight
+#define OCCLUSION_READBACK_SIZE	64		// max readback level size, in texels
+#define OCCLUSION_MAX_TEXELS	64		// CPU test gives up on boxes covering more texels than this
+
+cvar_t	r_occlusion = {"r_occlusion", "0", CVAR_ARCHIVE};
+
+int		rs_occlusion_surfs, rs_occlusion_surfs_culled;
+int		rs_occlusion_ents, rs_occlusion_ents_culled;
+
+typedef struct hizview_s
+{
+	float		viewproj[16];
+	vec3_t		vieworg;
+	double		time;
+	int			framecount;
+	int			width, height;		// viewport size, in pixels
+} hizview_t;
+
+typedef struct hizreadback_s
+{
+	GLsync		fence;
+	GLuint		counters;			// world surfaces [tested, culled]
+	GLuint		pbo;
+	hizview_t	view;
+	int			level;
+	int			stride, rows;		// texture level size
+} hizreadback_t;
+
+static struct
+{
+	qboolean		valid;			// framebufs.hiz holds the depth for 'view'
+	hizview_t		view;
+
+	hizreadback_t	readback[OCCLUSION_FRAMES];
+	int				current;
+
+	qboolean		cpuvalid;
+	hizview_t		cpuview;
+	int				cpulevel;
+	int				cpustride, cpurows;
+	float			cpudata[OCCLUSION_READBACK_SIZE * OCCLUSION_READBACK_SIZE];
+} occlusion;
+
+/*
+================
+R_ClearOcclusion
+
+Invalidates the pyramid and pending readbacks (new map, resized framebuffers)
+================
+*/
+void R_ClearOcclusion (void)
+{
+	int i;
+
+	occlusion.valid = false;
+	occlusion.cpuvalid = false;
+
+	for (i = 0; i < OCCLUSION_FRAMES; i++)
+	{
+		hizreadback_t *rb = &occlusion.readback[i];
+		if (rb->fence)
+		{
+			GL_DeleteSyncFunc (rb->fence);
+			rb->fence = NULL;
+		}
+	}
+}
+
+/*
+================
+R_OcclusionViewDepth
+
+Returns the farness of a window-space depth value
+================
+*/
+static float R_OcclusionViewDepth (float ndcz)
+{
+	if (gl_clipcontrol_able)
+		return 1.f - ndcz;
+	return ndcz * 0.5f + 0.5f;
+}
+
+/*
+================
+R_OcclusionTestBox
+
+Returns true if the box, grown by 'margin' units, is hidden behind
+the depth in 'data' (one level of a pyramid built from 'view')
+================
+*/
+static qboolean R_OcclusionTestBox (const hizview_t *view, const float *data, int level, int stride, int rows,
+	const vec3_t mins, const vec3_t maxs, float margin)
+{
+	const float	*m = view->viewproj;
+	float		ndcmin[3], ndcmax[3], nearest, farthest;
+	int			i, x, y, x0, y0, x1, y1, shift;
+
+	ndcmin[0] = ndcmin[1] = ndcmin[2] = 1e30f;
+	ndcmax[0] = ndcmax[1] = ndcmax[2] = -1e30f;
+
+	for (i = 0; i < 8; i++)
+	{
+		vec3_t	p;
+		float	clip[4];
+		int		j;
+
+		p[0] = (i & 1) ? maxs[0] + margin : mins[0] - margin;
+		p[1] = (i & 2) ? maxs[1] + margin : mins[1] - margin;
+		p[2] = (i & 4) ? maxs[2] + margin : mins[2] - margin;
+
+		for (j = 0; j < 4; j++)
+			clip[j] = m[0*4 + j] * p[0] + m[1*4 + j] * p[1] + m[2*4 + j] * p[2] + m[3*4 + j];
+
+		// crosses the near plane
+		if (clip[3] < 1.f)
+			return false;
+
+		for (j = 0; j < 3; j++)
+		{
+			float v = clip[j] / clip[3];
+			ndcmin[j] = q_min (ndcmin[j], v);
+			ndcmax[j] = q_max (ndcmax[j], v);
+		}
+	}
+
+	// no depth information outside of the view the pyramid was built from
+	if (ndcmin[0] < -1.f || ndcmin[1] < -1.f || ndcmax[0] > 1.f || ndcmax[1] > 1.f)
+		return false;
+
+	nearest = q_min (R_OcclusionViewDepth (ndcmin[2]), R_OcclusionViewDepth (ndcmax[2]));
+
+	shift = level + 1;
+	x0 = CLAMP (0, (int)((ndcmin[0] * 0.5f + 0.5f) * view->width), view->width - 1) >> shift;
+	y0 = CLAMP (0, (int)((ndcmin[1] * 0.5f + 0.5f) * view->height), view->height - 1) >> shift;
+	x1 = CLAMP (0, (int)((ndcmax[0] * 0.5f + 0.5f) * view->width), view->width - 1) >> shift;
+	y1 = CLAMP (0, (int)((ndcmax[1] * 0.5f + 0.5f) * view->height), view->height - 1) >> shift;
+	x1 = q_min (x1, stride - 1);
+	y1 = q_min (y1, rows - 1);
+
+	if ((x1 - x0 + 1) * (y1 - y0 + 1) > OCCLUSION_MAX_TEXELS)
+		return false;
+
+	farthest = 0.f;
+	for (y = y0; y <= y1; y++)
+		for (x = x0; x <= x1; x++)
+			farthest = q_max (farthest, data[y * stride + x]);
+
+	return nearest > farthest;
+}
+
+/*
+================
+R_OcclusionUsable
+
+Returns true if a pyramid captured with 'view' can still be used this frame
+================
+*/
+static qboolean R_OcclusionUsable (const hizview_t *view)
+{
+	return r_occlusion.value && view->framecount < r_framecount && view->framecount + OCCLUSION_FRAMES + 1 >= r_framecount;
+}
+
+/*
+================
+R_UpdateOcclusionReadback
+
+Picks up the newest finished readback, if any
+================
+*/
+void R_UpdateOcclusionReadback (void)
+{
+	int i, newest = -1;
+
+	rs_occlusion_ents = rs_occlusion_ents_culled = 0;
+
+	if (!r_occlusion.value)
+	{
+		R_ClearOcclusion ();
+		return;
+	}
+
+	// oldest to newest
+	for (i = 1; i <= OCCLUSION_FRAMES; i++)
+	{
+		int idx = (occlusion.current + i) % OCCLUSION_FRAMES;
+		hizreadback_t *rb = &occlusion.readback[idx];
+		GLenum result;
+
+		if (!rb->fence)
+			continue;
+		result = GL_ClientWaitSyncFunc (rb->fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			break;
+		if (newest != -1)
+		{
+			GL_DeleteSyncFunc (occlusion.readback[newest].fence);
+			occlusion.readback[newest].fence = NULL;
+		}
+		newest = idx;
+	}
+
+	if (newest == -1)
+	{
+		if (occlusion.cpuvalid && !R_OcclusionUsable (&occlusion.cpuview))
+			occlusion.cpuvalid = false;
+		return;
+	}
+
+	{
+		hizreadback_t	*rb = &occlusion.readback[newest];
+		const GLuint	*counters;
+		const float		*texels;
+
+		GL_DeleteSyncFunc (rb->fence);
+		rb->fence = NULL;
+
+		GL_BindBuffer (GL_COPY_READ_BUFFER, rb->counters);
+		counters = (const GLuint *) GL_MapBufferRangeFunc (GL_COPY_READ_BUFFER, 0, 2 * sizeof (GLuint), GL_MAP_READ_BIT);
+		if (counters)
+		{
+			rs_occlusion_surfs = counters[0];
+			rs_occlusion_surfs_culled = counters[1];
+			GL_UnmapBufferFunc (GL_COPY_READ_BUFFER);
+		}
+		GL_BindBuffer (GL_COPY_READ_BUFFER, 0);
+
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, rb->pbo);
+		texels = (const float *) GL_MapBufferRangeFunc (GL_PIXEL_PACK_BUFFER, 0, rb->stride * rb->rows * sizeof (float), GL_MAP_READ_BIT);
+		if (texels)
+		{
+			memcpy (occlusion.cpudata, texels, rb->stride * rb->rows * sizeof (float));
+			GL_UnmapBufferFunc (GL_PIXEL_PACK_BUFFER);
+			occlusion.cpuview = rb->view;
+			occlusion.cpulevel = rb->level;
+			occlusion.cpustride = rb->stride;
+			occlusion.cpurows = rb->rows;
+			occlusion.cpuvalid = R_OcclusionUsable (&occlusion.cpuview);
+		}
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+	}
+}
+
+/*
+================
+R_CullOcclusionEntity
+
+Returns true if the entity was hidden behind the depth of a recent frame.
+Both the camera and the entity may have moved since then, so the box is
+grown by the camera displacement and by how far the entity could have
+travelled in the meantime.
+================
+*/
+qboolean R_CullOcclusionEntity (entity_t *e)
+{
+	vec3_t	mins, maxs, delta;
+	float	margin;
+	double	dt;
+
+	if (!occlusion.cpuvalid || !r_occlusion.value)
+		return false;
+
+	rs_occlusion_ents++;
+
+	VectorSubtract (r_refdef.vieworg, occlusion.cpuview.vieworg, delta);
+	margin = VectorLength (delta) + 1.f;
+
+	dt = cl.mtime[0] - cl.mtime[1];
+	if (e->msgtime == cl.mtime[0] && dt > 0.0)
+	{
+		VectorSubtract (e->msg_origins[0], e->msg_origins[1], delta);
+		margin += VectorLength (delta) * fabs (cl.time - occlusion.cpuview.time) / dt;
+	}
+
+	R_GetEntityBounds (e, mins, maxs);
+	if (!R_OcclusionTestBox (&occlusion.cpuview, occlusion.cpudata, occlusion.cpulevel,
+			occlusion.cpustride, occlusion.cpurows, mins, maxs, margin))
+		return false;
+
+	rs_occlusion_ents_culled++;
+	return true;
+}
+
+/*
+================
+R_SetupOcclusionCull
+
+Fills in the occlusion part of the cull/mark inputs and binds
+the pyramid (texture unit 0) and the counters (SSBO binding 6)
+================
+*/
+void R_SetupOcclusionCull (gpu_hizcull_t *cull)
+{
+	hizreadback_t *rb = &occlusion.readback[occlusion.current];
+	vec3_t delta;
+
+	memset (cull, 0, sizeof (*cull));
+
+	if (!rb->counters)
+	{
+		rb->counters = GL_CreateBuffer (GL_COPY_READ_BUFFER, GL_STREAM_READ, "occlusion counters", 2 * sizeof (GLuint), NULL);
+		GL_BindBuffer (GL_COPY_READ_BUFFER, 0);
+	}
+	if (r_occlusion.value)
+	{
+		static const GLuint zero[2] = {0, 0};
+		GL_BindBuffer (GL_COPY_WRITE_BUFFER, rb->counters);
+		GL_BufferSubDataFunc (GL_COPY_WRITE_BUFFER, 0, sizeof (zero), zero);
+		GL_BindBuffer (GL_COPY_WRITE_BUFFER, 0);
+	}
+	GL_BindBufferRange (GL_SHADER_STORAGE_BUFFER, 6, rb->counters, 0, 2 * sizeof (GLuint));
+
+	if (!occlusion.valid || !R_OcclusionUsable (&occlusion.view) || occlusion.view.framecount != r_framecount - 1)
+	{
+		GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, 0);
+		return;
+	}
+
+	VectorSubtract (r_refdef.vieworg, occlusion.view.vieworg, delta);
+	memcpy (cull->viewproj, occlusion.view.viewproj, sizeof (cull->viewproj));
+	cull->margin = VectorLength (delta) + 1.f;
+	cull->size[0] = occlusion.view.width;
+	cull->size[1] = occlusion.view.height;
+	cull->size[2] = framebufs.hiz.levels;
+	cull->size[3] = gl_clipcontrol_able;
+
+	GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, framebufs.hiz.tex);
+}
+
+/*
+================
+R_BuildOcclusionPyramid
+
+Reduces the depth of the opaque pass into framebufs.hiz
+================
+*/
+void R_BuildOcclusionPyramid (void)
+{
+	hizreadback_t	*rb;
+	GLuint			depthtex;
+	GLenum			target;
+	int				samples, vx, vy, vw, vh, w, h, level;
+
+	if (!r_occlusion.value || !framebufs.hiz.tex)
+	{
+		occlusion.valid = false;
+		return;
+	}
+
+	if (GL_NeedsSceneEffects ())
+	{
+		depthtex = framebufs.scene.depth_stencil_tex;
+		samples = framebufs.scene.samples;
+		vx = 0;
+		vy = 0;
+		vw = r_refdef.vrect.width / r_refdef.scale;
+		vh = r_refdef.vrect.height / r_refdef.scale;
+	}
+	else
+	{
+		// GL_NeedsPostprocess makes sure we're not rendering to the default framebuffer
+		depthtex = framebufs.composite.depth_stencil_tex;
+		samples = 1;
+		vx = glx + r_refdef.vrect.x;
+		vy = gly + glheight - r_refdef.vrect.y - r_refdef.vrect.height;
+		vw = r_refdef.vrect.width;
+		vh = r_refdef.vrect.height;
+	}
+
+	if (vw <= 0 || vh <= 0)
+	{
+		occlusion.valid = false;
+		return;
+	}
+
+	GL_BeginGroup ("Hi-Z pyramid");
+
+	target = samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+	w = (vw + 1) >> 1;
+	h = (vh + 1) >> 1;
+
+	GL_UseProgram (glprogs.hiz_init[samples > 1]);
+	GL_BindNative (GL_TEXTURE0, target, depthtex);
+	GL_BindImageTextureFunc (1, framebufs.hiz.tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	GL_Uniform4iFunc (0, vx, vy, vw, vh);
+	GL_Uniform2iFunc (1, gl_clipcontrol_able, samples);
+	GL_DispatchComputeFunc ((w + 7) / 8, (h + 7) / 8, 1);
+	GL_BindNative (GL_TEXTURE0, target, 0);
+
+	GL_UseProgram (glprogs.hiz_reduce);
+	for (level = 1; level < framebufs.hiz.levels; level++)
+	{
+		GL_MemoryBarrierFunc (GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		GL_BindImageTextureFunc (1, framebufs.hiz.tex, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		GL_BindImageTextureFunc (2, framebufs.hiz.tex, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		GL_Uniform2iFunc (0, w, h);
+		w = (w + 1) >> 1;
+		h = (h + 1) >> 1;
+		GL_DispatchComputeFunc ((w + 7) / 8, (h + 7) / 8, 1);
+	}
+	GL_MemoryBarrierFunc (GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	occlusion.valid = true;
+	memcpy (occlusion.view.viewproj, r_matviewproj, sizeof (occlusion.view.viewproj));
+	VectorCopy (r_refdef.vieworg, occlusion.view.vieworg);
+	occlusion.view.time = cl.time;
+	occlusion.view.framecount = r_framecount;
+	occlusion.view.width = vw;
+	occlusion.view.height = vh;
+
+	// copy a coarse level for the CPU-side entity tests
+	rb = &occlusion.readback[occlusion.current];
+	if (rb->fence)
+	{
+		GL_DeleteSyncFunc (rb->fence);
+		rb->fence = NULL;
+	}
+	if (!rb->pbo)
+	{
+		rb->pbo = GL_CreateBuffer (GL_PIXEL_PACK_BUFFER, GL_STREAM_READ, "occlusion readback",
+			OCCLUSION_READBACK_SIZE * OCCLUSION_READBACK_SIZE * sizeof (float), NULL);
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	for (level = 0; level < framebufs.hiz.levels - 1; level++)
+		if ((framebufs.hiz.width >> level) <= OCCLUSION_READBACK_SIZE && (framebufs.hiz.height >> level) <= OCCLUSION_READBACK_SIZE)
+			break;
+	rb->level = level;
+	rb->stride = q_max (framebufs.hiz.width >> level, 1);
+	rb->rows = q_max (framebufs.hiz.height >> level, 1);
+	rb->view = occlusion.view;
+
+	GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, framebufs.hiz.tex);
+	GL_BindBuffer (GL_PIXEL_PACK_BUFFER, rb->pbo);
+	glGetTexImage (GL_TEXTURE_2D, level, GL_RED, GL_FLOAT, NULL);
+	GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+	GL_BindNative (GL_TEXTURE0, GL_TEXTURE_2D, 0);
+
+	rb->fence = GL_FenceSyncFunc (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	occlusion.current = (occlusion.current + 1) % OCCLUSION_FRAMES;
+
+	GL_EndGroup ();
+}
@@ -28,7 +28,6 @@ extern cvar_t gl_fullbrights, r_oldskyleaf, r_showtris; //johnfitz
 extern cvar_t gl_zfix; // QuakeSpasm z-fighting fix
 extern cvar_t r_oit;
 
-extern gltexture_t *lightmap_texture;
 
 extern GLuint gl_bmodel_vbo;
 extern size_t gl_bmodel_vbo_size;
@@ -46,6 +45,7 @@ typedef struct gpumark_frame_s {
 	GLuint		oldskyleaf;
 	GLuint		framecount;
 	GLuint		padding[3];
+	gpu_hizcull_t	occlusion;
 } gpumark_frame_t;
 
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel);
@@ -89,6 +89,7 @@ static void R_MarkVisSurfaces (byte* vis)
 	GL_MemoryBarrierFunc (GL_SHADER_STORAGE_BARRIER_BIT);
 
 	GL_UseProgram (glprogs.cull_mark);
+	R_SetupOcclusionCull (&frame.occlusion);
 	GL_BindBufferRange (GL_SHADER_STORAGE_BUFFER, 2, gl_bmodel_ibo, 0, gl_bmodel_ibo_size);
 	GL_Upload (GL_SHADER_STORAGE_BUFFER, vis, vissize, &buf, &ofs);
 	GL_BindBufferRange (GL_SHADER_STORAGE_BUFFER, 3, buf, (GLintptr)ofs, vissize);
@@ -461,7 +462,7 @@ static void R_DrawBrushModels_Real (entity_t **ents, int count, brushpass_t pass
 	R_ResetBModelCalls (program);
 	GL_SetState (state);
 	if (pass <= BP_ALPHATEST)
-		GL_Bind (GL_TEXTURE2, r_fullbright_cheatsafe ? greytexture : lightmap_texture);
+		GL_Bind (GL_TEXTURE2, r_fullbright_cheatsafe ? greytexture : R_GetLightmapTexture ());
 	else if (pass == BP_SKYCUBEMAP)
 		GL_Bind (GL_TEXTURE2, skybox->cubemap);
 
@@ -560,7 +561,7 @@ void R_DrawBrushModels_Water (entity_t **ents, int count, qboolean translucent)
 
 	R_ResetBModelCalls (program);
 	GL_SetState (state);
-	GL_Bind (GL_TEXTURE2, r_fullbright_cheatsafe ? greytexture : lightmap_texture);
+	GL_Bind (GL_TEXTURE2, r_fullbright_cheatsafe ? greytexture : R_GetLightmapTexture ());
 
 	GL_Upload (GL_SHADER_STORAGE_BUFFER, bmodel_instances, sizeof(bmodel_instances[0]) * totalinst, &buf, &ofs);
 	GL_BindBufferRange (GL_SHADER_STORAGE_BUFFER, 2, buf, (GLintptr)ofs, sizeof(bmodel_instances[0]) * count);
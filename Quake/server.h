@@ -60,10 +60,12 @@ typedef struct
 	struct qmodel_s	*models[MAX_MODELS];
 	const char	*sound_precache[MAX_SOUNDS];	// NULL terminated
 	const char	*lightstyles[MAX_LIGHTSTYLES];
+	char		lightstylebuf[MAX_LIGHTSTYLES][MAX_STYLESTRING];	// copies of values that aren't persistent strings
 	server_state_t	state;			// some actions are only valid during load
 
 	sizebuf_t	datagram;
 	byte		datagram_buf[MAX_DATAGRAM];
+	int		datagramsound;	// part of datagram that is svc_sound, for telemetry
 
 	sizebuf_t	reliable_datagram;	// copied to all clients at end of frame
 	byte		reliable_datagram_buf[MAX_DATAGRAM];
@@ -140,6 +142,11 @@ typedef struct client_s
 	struct qsocket_s *netconnection;	// communications handle
 
 	usercmd_t		cmd;				// movement
+	qboolean		predict;			// client asked for svc_moveack
+	unsigned int	moveseq;			// last clc_moveseq received
+	qboolean		entkeep;			// client understands svc_entkeep
+	byte			*entages;			// ticks each entity went without an update
+	int				numentages;
 	vec3_t			wishdir;			// intended motion calced from cmd
 
 	sizebuf_t		message;			// can be added to at any time,
@@ -151,6 +158,7 @@ typedef struct client_s
 
 	float			ping_times[NUM_PING_TIMES];
 	int				num_pings;			// ping_times[num_pings%NUM_PING_TIMES]
+	double			lagtime;			// server time the client last saw, from clc_move
 
 // spawn parms are carried from level to level
 	float			spawn_parms[NUM_SPAWN_PARMS];
@@ -161,6 +169,8 @@ typedef struct client_s
 	int				oldstats_i[MAX_CL_STATS];		//previous values of stats. if these differ from the current values, reflag resendstats.
 	float			oldstats_f[MAX_CL_STATS];		//previous values of stats. if these differ from the current values, reflag resendstats.
 	char			*oldstats_s[MAX_CL_STATS];
+
+	netstats_t		netstats;			// outgoing bandwidth telemetry
 } client_t;
 
 
@@ -260,7 +270,12 @@ extern	cvar_t	fraglimit;
 extern	cvar_t	timelimit;
 
 extern	server_static_t	svs;				// persistant server info
-extern	server_t		sv;					// local server
+extern	server_t		*sv;				// local server, or the instance being run
+
+#define	MAX_SV_INSTANCES	8
+
+extern	int				sv_instance;		// index of sv in the instance table
+extern	int				sv_numinstances;
 
 extern	client_t	*host_client;
 
@@ -271,6 +286,7 @@ extern	edict_t		*sv_player;
 void SV_Init (void);
 
 void SV_StartParticle (vec3_t org, vec3_t dir, int color, int count);
+int SV_MaxEntityNum (void);
 void SV_StartSound (edict_t *entity, int channel, const char *sample, int volume,
     float attenuation);
 void SV_LocalSound (client_t *client, const char *sample); // for 2021 rerelease
@@ -294,6 +310,7 @@ void SV_ClientPrintf (const char *fmt, ...) FUNC_PRINTF(1,2);
 void SV_BroadcastPrintf (const char *fmt, ...) FUNC_PRINTF(1,2);
 
 void SV_Physics (void);
+int ClipVelocity (vec3_t in, vec3_t normal, vec3_t out, float overbounce);
 
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink);
@@ -307,4 +324,20 @@ void SV_RunClients (void);
 void SV_SaveSpawnparms (void);
 void SV_SpawnServer (const char *server);
 
+void SV_LagCompInit (void);
+void SV_LagCompClear (void);
+void SV_LagCompRecord (void);
+qboolean SV_LagCompBegin (edict_t *shooter, const vec3_t start, const vec3_t end);
+void SV_LagCompEnd (void);
+
+void SV_InitInstances (void);
+void SV_SwitchInstance (int num);
+qboolean SV_OtherInstancesActive (void);
+qboolean SV_InstancesIdle (void);
+void SV_ClearInstance (void);
+void SV_ClearIdleInstances (void);
+qboolean SV_AcceptsNewClients (void);
+void SV_InstanceAddText (const char *text);
+void SV_ShutdownInstances (qboolean crash);
+
 #endif	/* QUAKE_SERVER_H */
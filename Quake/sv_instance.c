@@ -0,0 +1,406 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_instance.c -- several independent servers in one dedicated process
+
+#include "quakedef.h"
+
+/*
+
+A dedicated server started with "-instances <n>" runs up to MAX_SV_INSTANCES
+servers side by side, each with its own map, progs, edicts and clients.  sv
+always points at the instance being worked on and svs holds its clients;
+the host frame switches to every running instance in turn, so the rest of
+the server code never needs to know there is more than one.
+
+New connections go to the first running instance that has a free slot.
+Console commands apply to instance 0 unless prefixed with "instance <n>",
+and commands queued by an instance's QC (changelevel, localcmd) are routed
+back to it that way.
+
+Models, sounds and the pak indices are shared: an instance loading a map
+someone else already has reuses the loaded copy. The hunk is only freed when
+no instance is running, so nothing an instance loads for itself goes there:
+its progs, strings and signon buffers are malloc'd and freed with the progs,
+and brush models and sprites are loaded into arenas of their own, reference
+counted by the instances using them and freed when the last one lets go.
+
+*/
+
+typedef struct
+{
+	server_t			*server;
+	server_static_t		svs;				// parked here while another instance is current
+	int					activeconnections;
+	char				pendingtext[1024];	// SV_InstanceAddText input up to the last newline
+} svinstance_t;
+
+static svinstance_t	sv_instances[MAX_SV_INSTANCES];
+
+int		sv_instance;
+int		sv_numinstances = 1;
+
+/*
+==================
+SV_SwitchInstance
+==================
+*/
+void SV_SwitchInstance (int num)
+{
+	svinstance_t	*from, *to;
+	qboolean		switchvm;
+
+	if (num == sv_instance)
+		return;
+	if (num < 0 || num >= sv_numinstances)
+		Sys_Error ("SV_SwitchInstance: bad instance %d", num);
+
+	from = &sv_instances[sv_instance];
+	to = &sv_instances[num];
+
+	switchvm = qcvm == &sv->qcvm;
+	if (switchvm)
+		PR_SwitchQCVM (NULL);
+
+	from->svs = svs;
+	from->activeconnections = net_activeconnections;
+	svs = to->svs;
+	net_activeconnections = to->activeconnections;
+	sv = to->server;
+	sv_instance = num;
+
+	if (switchvm)
+		PR_SwitchQCVM (&sv->qcvm);
+}
+
+/*
+==================
+SV_OtherInstancesActive
+==================
+*/
+qboolean SV_OtherInstancesActive (void)
+{
+	int i;
+
+	for (i = 0; i < sv_numinstances; i++)
+		if (i != sv_instance && sv_instances[i].server->active)
+			return true;
+
+	return false;
+}
+
+/*
+==================
+SV_InstancesIdle
+
+True if no running instance has a client to simulate for
+==================
+*/
+qboolean SV_InstancesIdle (void)
+{
+	server_static_t	*st;
+	int				i, j;
+
+	for (i = 0; i < sv_numinstances; i++)
+	{
+		if (!sv_instances[i].server->active)
+			continue;
+		st = i == sv_instance ? &svs : &sv_instances[i].svs;
+		for (j = 0; j < st->maxclients; j++)
+			if (st->clients[j].active)
+				return false;
+	}
+
+	return true;
+}
+
+/*
+==================
+SV_FreeInstance
+
+Frees an instance's progs and lets go of its models
+==================
+*/
+static void SV_FreeInstance (server_t *server)
+{
+	int i;
+
+	// inline models first, they go away with their world
+	for (i = MAX_MODELS - 1; i > 0; i--)
+		Mod_Release (server->models[i]);
+	PR_ClearProgs (&server->qcvm);
+	memset (server, 0, sizeof (*server));
+}
+
+/*
+==================
+SV_ClearInstance
+
+Host_ClearMemory for the current instance while others are still running
+==================
+*/
+void SV_ClearInstance (void)
+{
+	Con_DPrintf ("Clearing instance %d\n", sv_instance);
+	SV_FreeInstance (sv);
+}
+
+/*
+==================
+SV_ClearIdleInstances
+
+Releases the progs of stopped instances before the hunk under them is freed
+==================
+*/
+void SV_ClearIdleInstances (void)
+{
+	server_t	*server;
+	int			i;
+
+	for (i = 0; i < sv_numinstances; i++)
+	{
+		server = sv_instances[i].server;
+		if (i == sv_instance || server->active)
+			continue;
+		SV_FreeInstance (server);
+	}
+}
+
+/*
+==================
+SV_AcceptsNewClients
+
+Only one instance listens for new connections: the first one running a map
+with a free slot, or the first one running a map if they are all full, so
+that the "server is full" reply still goes out.
+==================
+*/
+qboolean SV_AcceptsNewClients (void)
+{
+	svinstance_t	*inst;
+	qboolean		active, full;
+	int				i, first;
+
+	for (i = 0, first = -1; i < sv_numinstances; i++)
+	{
+		inst = &sv_instances[i];
+		if (i == sv_instance)
+		{
+			active = sv->active;
+			full = net_activeconnections >= svs.maxclients;
+		}
+		else
+		{
+			active = inst->server->active;
+			full = inst->activeconnections >= inst->svs.maxclients;
+		}
+		if (!active)
+			continue;
+		if (!full)
+			return i == sv_instance;
+		if (first < 0)
+			first = i;
+	}
+
+	return first < 0 || first == sv_instance;
+}
+
+/*
+==================
+SV_InstanceAddLines
+
+Prefixes every command in text so that it runs in the current instance
+==================
+*/
+static void SV_InstanceAddLines (const char *text)
+{
+	char	line[1024];
+	char	cmd[1040];
+	int		i, quotes, comment;
+
+	// split the same way Cbuf_Execute does
+	while (*text)
+	{
+		quotes = 0;
+		comment = false;
+		for (i = 0; text[i]; i++)
+		{
+			if (text[i] == '"')
+				quotes++;
+			if (text[i] == '/' && text[i + 1] == '/')
+				comment = true;
+			if (!(quotes&1) && !comment && text[i] == ';')
+				break;
+			if (text[i] == '\n')
+				break;
+		}
+
+		q_strlcpy (line, text, q_min (i + 1, (int) sizeof (line)));
+		if (*COM_SkipSpace (line))
+		{
+			q_snprintf (cmd, sizeof (cmd), "instance %d %s\n", sv_instance, line);
+			Cbuf_AddText (cmd);
+		}
+
+		text += text[i] ? i + 1 : i;
+	}
+}
+
+/*
+==================
+SV_InstanceAddText
+
+Cbuf_AddText for commands issued by the current instance's QC. QC often
+builds a command over several localcmd calls, so text is held back until
+its line is complete.
+==================
+*/
+void SV_InstanceAddText (const char *text)
+{
+	svinstance_t	*inst;
+	char			*eol;
+
+	if (sv_instance == 0)
+	{
+		Cbuf_AddText (text);
+		return;
+	}
+
+	inst = &sv_instances[sv_instance];
+	if (strlen (inst->pendingtext) + strlen (text) >= sizeof (inst->pendingtext))
+	{
+		Con_Printf ("SV_InstanceAddText: overflow\n");
+		inst->pendingtext[0] = 0;
+		return;
+	}
+	q_strlcat (inst->pendingtext, text, sizeof (inst->pendingtext));
+
+	eol = strrchr (inst->pendingtext, '\n');
+	if (!eol)
+		return;
+	*eol = 0;
+	SV_InstanceAddLines (inst->pendingtext);
+	memmove (inst->pendingtext, eol + 1, strlen (eol + 1) + 1);
+}
+
+/*
+==================
+SV_ShutdownInstances
+
+Host_ShutdownServer for every instance, leaving instance 0 current
+==================
+*/
+void SV_ShutdownInstances (qboolean crash)
+{
+	int i;
+
+	for (i = sv_numinstances - 1; i >= 0; i--)
+	{
+		SV_SwitchInstance (i);
+		Host_ShutdownServer (crash);
+	}
+}
+
+/*
+==================
+SV_Instance_f
+
+instance                   lists the instances
+instance <n> <command>     runs a console command in instance n
+==================
+*/
+static void SV_Instance_f (void)
+{
+	svinstance_t	*inst;
+	server_t		*server;
+	char			command[1024];
+	const char		*args;
+	int				i, num, players, maxplayers;
+
+	if (Cmd_Argc () < 2)
+	{
+		for (i = 0; i < sv_numinstances; i++)
+		{
+			inst = &sv_instances[i];
+			server = inst->server;
+			players = i == sv_instance ? net_activeconnections : inst->activeconnections;
+			maxplayers = i == sv_instance ? svs.maxclients : inst->svs.maxclients;
+			Con_Printf ("%d: %-16s %2d/%2d players\n", i, server->active ? server->name : "(idle)", players, maxplayers);
+		}
+		return;
+	}
+
+	num = Q_atoi (Cmd_Argv (1));
+	if (num < 0 || num >= sv_numinstances)
+	{
+		Con_Printf ("No instance %s (%d running, see -instances)\n", Cmd_Argv (1), sv_numinstances);
+		return;
+	}
+	if (Cmd_Argc () < 3)
+	{
+		Con_Printf ("usage: %s <instance> <command>\n", Cmd_Argv (0));
+		return;
+	}
+
+	// Cmd_ExecuteString overwrites Cmd_Args, so keep a copy
+	args = COM_SkipSpace (COM_Parse (Cmd_Args ()));
+	q_strlcpy (command, args, sizeof (command));
+
+	i = sv_instance;
+	SV_SwitchInstance (num);
+	Cmd_ExecuteString (command, src_command);
+	SV_SwitchInstance (i);
+}
+
+/*
+==================
+SV_InitInstances
+
+Called once svs has been set up for the primary instance
+==================
+*/
+void SV_InitInstances (void)
+{
+	svinstance_t	*inst;
+	int				i;
+
+	i = COM_CheckParm ("-instances");
+	if (i)
+	{
+		if (cls.state != ca_dedicated)
+			Sys_Error ("-instances only works with -dedicated");
+		if (i >= com_argc - 1)
+			Sys_Error ("SV_InitInstances: you must specify a number after -instances");
+		sv_numinstances = CLAMP (1, Q_atoi (com_argv[i+1]), MAX_SV_INSTANCES);
+	}
+
+	sv_instances[0].server = sv;
+	for (i = 1; i < sv_numinstances; i++)
+	{
+		inst = &sv_instances[i];
+		inst->server = (server_t *) calloc (1, sizeof (server_t));
+		if (!inst->server)
+			Sys_Error ("SV_InitInstances: out of memory");
+		inst->svs = svs;
+		inst->svs.clients = (struct client_s *) Hunk_AllocName (svs.maxclientslimit*sizeof(client_t), "clients");
+	}
+
+	Cmd_AddCommand ("instance", SV_Instance_f);
+}
@@ -0,0 +1,273 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_lagcomp.c -- rewinding players and monsters for hitscan traces
+
+#include "quakedef.h"
+
+/*
+
+With sv_lagcompensation 1 the server remembers where players and monsters
+were in each of the last LAGCOMP_FRAMES updates it sent out.  When a client's
+QC fires a traceline (shotgun pellets, lightning), every other solid player
+or monster near the line is moved back to where that client saw it, i.e. at
+the server time the client echoed in its last clc_move, for the duration of
+that one trace.  The rewind never reaches further back than
+sv_lagcompensation_max seconds, so laggy clients can't shoot around corners
+by much, and only boxes the line can actually reach get relinked.
+
+*/
+
+cvar_t	sv_lagcompensation = {"sv_lagcompensation", "0", CVAR_NONE};
+cvar_t	sv_lagcompensation_max = {"sv_lagcompensation_max", "0.25", CVAR_NONE};	// seconds
+
+#define LAGCOMP_FRAMES	64
+
+typedef struct
+{
+	int			entnum;
+	vec3_t		origin;
+} lagcompent_t;
+
+typedef struct
+{
+	double			time;
+	lagcompent_t	*ents;		// sorted by entnum
+} lagcompframe_t;
+
+typedef struct
+{
+	edict_t		*ent;
+	vec3_t		origin;
+} lagcompsaved_t;
+
+typedef struct
+{
+	lagcompframe_t	frames[LAGCOMP_FRAMES];
+	int				count;				// frames recorded since the last reset
+} lagcomphistory_t;
+
+static lagcomphistory_t	lagcomp_history[MAX_SV_INSTANCES];	// one per server instance
+
+#define lagcomp_frames	lagcomp_history[sv_instance].frames
+#define lagcomp_count	lagcomp_history[sv_instance].count
+static lagcompsaved_t	*lagcomp_saved;		// entities moved by SV_LagCompBegin
+
+/*
+==================
+SV_LagCompClear
+==================
+*/
+void SV_LagCompClear (void)
+{
+	lagcomp_count = 0;
+}
+
+/*
+==================
+SV_LagCompRecord
+
+Remembers where players and monsters are in the update about to be sent
+==================
+*/
+void SV_LagCompRecord (void)
+{
+	lagcompframe_t	*frame;
+	lagcompent_t	rec;
+	edict_t			*ent;
+	int				e;
+
+	if (!sv_lagcompensation.value)
+	{
+		lagcomp_count = 0;
+		return;
+	}
+
+	if (lagcomp_count)
+	{
+		frame = &lagcomp_frames[(lagcomp_count - 1) % LAGCOMP_FRAMES];
+		if (frame->time == qcvm->time)
+			return;		// paused, or several host frames per server frame
+		if (frame->time > qcvm->time)
+			lagcomp_count = 0;	// new map
+	}
+
+	frame = &lagcomp_frames[lagcomp_count++ % LAGCOMP_FRAMES];
+	frame->time = qcvm->time;
+	VEC_CLEAR (frame->ents);
+
+	for (e = 1, ent = EDICT_NUM (1); e < qcvm->num_edicts; e++, ent = NEXT_EDICT (ent))
+	{
+		if (ent->free)
+			continue;
+		if (ent->v.solid != SOLID_SLIDEBOX && ent->v.solid != SOLID_BBOX)
+			continue;
+		if (e > svs.maxclients && !((int)ent->v.flags & FL_MONSTER))
+			continue;
+		rec.entnum = e;
+		VectorCopy (ent->v.origin, rec.origin);
+		VEC_PUSH (frame->ents, rec);
+	}
+}
+
+/*
+==================
+SV_LagCompFind
+==================
+*/
+static const lagcompent_t *SV_LagCompFind (const lagcompframe_t *frame, int entnum)
+{
+	int lo = 0, hi = VEC_SIZE (frame->ents) - 1, mid;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		if (frame->ents[mid].entnum == entnum)
+			return &frame->ents[mid];
+		if (frame->ents[mid].entnum < entnum)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return NULL;
+}
+
+/*
+==================
+SV_LagCompBegin
+
+Moves everyone the line from start to end could hit back to where shooter
+saw them. Returns true if SV_LagCompEnd has to be called after the trace.
+==================
+*/
+qboolean SV_LagCompBegin (edict_t *shooter, const vec3_t start, const vec3_t end)
+{
+	const lagcompframe_t	*from, *to;
+	const lagcompent_t		*rec, *next;
+	lagcompsaved_t			saved;
+	client_t				*client;
+	edict_t					*ent;
+	vec3_t					origin, linemins, linemaxs;
+	double					target;
+	float					frac;
+	int						i, j, num;
+
+	if (!sv_lagcompensation.value || !lagcomp_count || VEC_SIZE (lagcomp_saved) || qcvm != &sv->qcvm)
+		return false;
+
+	num = NUM_FOR_EDICT (shooter);
+	if (num < 1 || num > svs.maxclients)
+		return false;
+	client = svs.clients + num - 1;
+	if (!client->active || !client->spawned || client->lagtime <= 0)
+		return false;
+
+	target = q_max (client->lagtime, qcvm->time - q_max (sv_lagcompensation_max.value, 0.f));
+	if (target >= qcvm->time)
+		return false;
+
+	// newest frame not after target, and the one after it to lerp towards
+	from = to = NULL;
+	for (i = 0; i < q_min (lagcomp_count, LAGCOMP_FRAMES); i++)
+	{
+		from = &lagcomp_frames[(lagcomp_count - 1 - i) % LAGCOMP_FRAMES];
+		if (from->time <= target)
+			break;
+		to = from;
+	}
+	frac = 0.f;
+	if (from->time > target)
+		to = NULL;		// history doesn't reach back that far, use the oldest frame as is
+	else if (to)
+		frac = (target - from->time) / (to->time - from->time);
+
+	for (i = 0; i < 3; i++)
+	{
+		linemins[i] = q_min (start[i], end[i]);
+		linemaxs[i] = q_max (start[i], end[i]);
+	}
+
+	for (j = 0; j < VEC_SIZE (from->ents); j++)
+	{
+		rec = &from->ents[j];
+		ent = EDICT_NUM (rec->entnum);
+		if (ent == shooter || ent->free || ent->freetime > from->time)
+			continue;	// gone, or a different entity in the same slot
+		if (ent->v.solid != SOLID_SLIDEBOX && ent->v.solid != SOLID_BBOX)
+			continue;
+
+		VectorCopy (rec->origin, origin);
+		if (to && (next = SV_LagCompFind (to, rec->entnum)) != NULL)
+			VectorLerp (rec->origin, next->origin, frac, origin);
+		if (VectorCompare (origin, ent->v.origin))
+			continue;
+
+		// skip boxes the line can't reach either now or back then
+		for (i = 0; i < 3; i++)
+		{
+			if (q_min (origin[i], ent->v.origin[i]) + ent->v.mins[i] > linemaxs[i] ||
+				q_max (origin[i], ent->v.origin[i]) + ent->v.maxs[i] < linemins[i])
+				break;
+		}
+		if (i < 3)
+			continue;
+
+		saved.ent = ent;
+		VectorCopy (ent->v.origin, saved.origin);
+		VEC_PUSH (lagcomp_saved, saved);
+		VectorCopy (origin, ent->v.origin);
+		SV_LinkEdict (ent, false);
+	}
+
+	return VEC_SIZE (lagcomp_saved) != 0;
+}
+
+/*
+==================
+SV_LagCompEnd
+
+Puts everything SV_LagCompBegin moved back where it belongs
+==================
+*/
+void SV_LagCompEnd (void)
+{
+	lagcompsaved_t	*saved;
+	int				i;
+
+	for (i = VEC_SIZE (lagcomp_saved) - 1; i >= 0; i--)
+	{
+		saved = &lagcomp_saved[i];
+		VectorCopy (saved->origin, saved->ent->v.origin);
+		SV_LinkEdict (saved->ent, false);
+	}
+	VEC_CLEAR (lagcomp_saved);
+}
+
+/*
+==================
+SV_LagCompInit
+==================
+*/
+void SV_LagCompInit (void)
+{
+	Cvar_RegisterVariable (&sv_lagcompensation);
+	Cvar_RegisterVariable (&sv_lagcompensation_max);
+}
@@ -24,7 +24,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
-server_t	sv;
+static server_t	sv_primary;			// instance 0, the only one without -instances
+server_t	*sv = &sv_primary;
 server_static_t	svs;
 
 static char	localmodels[MAX_MODELS][8];	// inline model names for precache
@@ -34,6 +35,7 @@ int		sv_protocol = PROTOCOL_RMQ; //johnfitz
 extern cvar_t nomonsters;
 
 static cvar_t sv_netsort = {"sv_netsort", "1", CVAR_NONE};
+static cvar_t sv_entbudget = {"sv_entbudget", "0", CVAR_NONE};	// entity update bytes per client per tick, 0 = whole datagram
 
 //============================================================================
 
@@ -62,30 +64,30 @@ void SV_CalcStats(client_t *client, int *statsi, float *statsf, const char **sta
 
 	//FIXME: add support for clientstat/globalstat qc builtins.
 
-	for (i = 0; i < sv.numcustomstats; i++)
+	for (i = 0; i < sv->numcustomstats; i++)
 	{
-		eval_t *eval = sv.customstats[i].ptr;
+		eval_t *eval = sv->customstats[i].ptr;
 		if (!eval)
-			eval = GetEdictFieldValue(ent, sv.customstats[i].fld);
+			eval = GetEdictFieldValue(ent, sv->customstats[i].fld);
 
-		switch(sv.customstats[i].type)
+		switch(sv->customstats[i].type)
 		{
 		case ev_ext_integer:
-			statsi[sv.customstats[i].idx] = eval->_int;
+			statsi[sv->customstats[i].idx] = eval->_int;
 			break;
 		case ev_entity:
-			statsi[sv.customstats[i].idx] = NUM_FOR_EDICT(PROG_TO_EDICT(eval->edict));
+			statsi[sv->customstats[i].idx] = NUM_FOR_EDICT(PROG_TO_EDICT(eval->edict));
 			break;
 		case ev_float:
-			statsf[sv.customstats[i].idx] = eval->_float;
+			statsf[sv->customstats[i].idx] = eval->_float;
 			break;
 		case ev_vector:
-			statsf[sv.customstats[i].idx+0] = eval->vector[0];
-			statsf[sv.customstats[i].idx+1] = eval->vector[1];
-			statsf[sv.customstats[i].idx+2] = eval->vector[2];
+			statsf[sv->customstats[i].idx+0] = eval->vector[0];
+			statsf[sv->customstats[i].idx+1] = eval->vector[1];
+			statsf[sv->customstats[i].idx+2] = eval->vector[2];
 			break;
 		case ev_string:		//not supported in this build... send with svcfte_updatestatstring on change, which is annoying.
-			statss[sv.customstats[i].idx] = PR_GetString(eval->string);
+			statss[sv->customstats[i].idx] = PR_GetString(eval->string);
 			break;
 		case ev_void:		//nothing...
 		case ev_field:		//panic! everyone panic!
@@ -118,7 +120,7 @@ void SV_Protocol_f (void)
 		else
 		{
 			sv_protocol = i;
-			if (sv.active)
+			if (sv->active)
 				Con_Printf ("changes will not take effect until the next level load.\n");
 		}
 		break;
@@ -128,6 +130,9 @@ void SV_Protocol_f (void)
 	}
 }
 
+static void SV_BenchNet_f (void);
+static void SV_PVSStats_f (void);
+
 /*
 ===============
 SV_Init
@@ -151,6 +156,9 @@ void SV_Init (void)
 	extern	cvar_t	sv_altnoclip; //johnfitz
 	extern	cvar_t	sv_gameplayfix_random;
 	extern	cvar_t	sv_gameplayfix_elevators;
+	extern	cvar_t	sv_pushbroadphase;
+	extern	cvar_t	sv_hulltrace;
+	extern	cvar_t	sv_tracecache;
 	extern	cvar_t	sv_autoload;
 	extern	cvar_t	sv_autosave;
 	extern	cvar_t	sv_autosave_interval;
@@ -173,12 +181,21 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_altnoclip); //johnfitz
 	Cvar_RegisterVariable (&sv_gameplayfix_random);
 	Cvar_RegisterVariable (&sv_gameplayfix_elevators);
+	Cvar_RegisterVariable (&sv_pushbroadphase);
+	Cvar_RegisterVariable (&sv_hulltrace);
+	Cvar_RegisterVariable (&sv_tracecache);
 	Cvar_RegisterVariable (&sv_netsort);
+	Cvar_RegisterVariable (&sv_entbudget);
+	SV_LagCompInit ();
 	Cvar_RegisterVariable (&sv_autoload);
 	Cvar_RegisterVariable (&sv_autosave);
 	Cvar_RegisterVariable (&sv_autosave_interval);
 
 	Cmd_AddCommand ("sv_protocol", &SV_Protocol_f); //johnfitz
+	Cmd_AddCommand ("pvsstats", &SV_PVSStats_f);
+	Cmd_AddCommand ("sv_benchnet", &SV_BenchNet_f);
+	Cmd_AddCommand ("sv_benchtrace", &SV_BenchTrace_f);
+	Cmd_AddCommand ("sv_tracecachestats", &SV_TraceCacheStats_f);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -224,12 +241,12 @@ void SV_StartParticle (vec3_t org, vec3_t dir, int color, int count)
 {
 	int		i, v;
 
-	if (sv.datagram.cursize > MAX_DATAGRAM-18)
+	if (sv->datagram.cursize > MAX_DATAGRAM-18)
 		return;
-	MSG_WriteByte (&sv.datagram, svc_particle);
-	MSG_WriteCoord (&sv.datagram, org[0], sv.protocolflags);
-	MSG_WriteCoord (&sv.datagram, org[1], sv.protocolflags);
-	MSG_WriteCoord (&sv.datagram, org[2], sv.protocolflags);
+	MSG_WriteByte (&sv->datagram, svc_particle);
+	MSG_WriteCoord (&sv->datagram, org[0], sv->protocolflags);
+	MSG_WriteCoord (&sv->datagram, org[1], sv->protocolflags);
+	MSG_WriteCoord (&sv->datagram, org[2], sv->protocolflags);
 	for (i=0 ; i<3 ; i++)
 	{
 		v = dir[i]*16;
@@ -237,10 +254,24 @@ void SV_StartParticle (vec3_t org, vec3_t dir, int color, int count)
 			v = 127;
 		else if (v < -128)
 			v = -128;
-		MSG_WriteChar (&sv.datagram, v);
+		MSG_WriteChar (&sv->datagram, v);
 	}
-	MSG_WriteByte (&sv.datagram, count);
-	MSG_WriteByte (&sv.datagram, color);
+	MSG_WriteByte (&sv->datagram, count);
+	MSG_WriteByte (&sv->datagram, color);
+}
+
+/*
+==================
+SV_MaxEntityNum
+
+Highest entity number the current protocol can address
+==================
+*/
+int SV_MaxEntityNum (void)
+{
+	if (sv->protocolflags & PRFL_LARGEEDICTS)
+		return 0xFFFFFF;
+	return 0x7FFF; // other clients read entity numbers as signed shorts
 }
 
 /*
@@ -272,17 +303,17 @@ void SV_StartSound (edict_t *entity, int channel, const char *sample, int volume
 	if (channel < 0 || channel > 7)
 		Host_Error ("SV_StartSound: channel = %i", channel);
 
-	if (sv.datagram.cursize > MAX_DATAGRAM-21)
+	if (sv->datagram.cursize > MAX_DATAGRAM-21)
 		return;
 
 // find precache number for sound
-	for (sound_num = 1; sound_num < MAX_SOUNDS && sv.sound_precache[sound_num]; sound_num++)
+	for (sound_num = 1; sound_num < MAX_SOUNDS && sv->sound_precache[sound_num]; sound_num++)
 	{
-		if (!strcmp(sample, sv.sound_precache[sound_num]))
+		if (!strcmp(sample, sv->sound_precache[sound_num]))
 			break;
 	}
 
-	if (sound_num == MAX_SOUNDS || !sv.sound_precache[sound_num])
+	if (sound_num == MAX_SOUNDS || !sv->sound_precache[sound_num])
 	{
 		Con_Printf ("SV_StartSound: %s not precached\n", sample);
 		return;
@@ -299,45 +330,49 @@ void SV_StartSound (edict_t *entity, int channel, const char *sample, int volume
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (ent >= 8192)
 	{
-		if (sv.protocol == PROTOCOL_NETQUAKE)
+		if (sv->protocol == PROTOCOL_NETQUAKE || ent > SV_MaxEntityNum ())
 			return; //don't send any info protocol can't support
 		field_mask |= SND_LARGEENTITY;
 	}
 	if (sound_num >= 256 || channel >= 8)
 	{
-		if (sv.protocol == PROTOCOL_NETQUAKE)
+		if (sv->protocol == PROTOCOL_NETQUAKE)
 			return; //don't send any info protocol can't support
 		field_mask |= SND_LARGESOUND;
 	}
 	//johnfitz
 
-	if (sv.datagram.cursize > MAX_DATAGRAM-21)
+	if (sv->datagram.cursize > MAX_DATAGRAM-21)
 		return;
 
+	sv->datagramsound -= sv->datagram.cursize;
+
 // directed messages go only to the entity the are targeted on
-	MSG_WriteByte (&sv.datagram, svc_sound);
-	MSG_WriteByte (&sv.datagram, field_mask);
+	MSG_WriteByte (&sv->datagram, svc_sound);
+	MSG_WriteByte (&sv->datagram, field_mask);
 	if (field_mask & SND_VOLUME)
-		MSG_WriteByte (&sv.datagram, volume);
+		MSG_WriteByte (&sv->datagram, volume);
 	if (field_mask & SND_ATTENUATION)
-		MSG_WriteByte (&sv.datagram, attenuation*64);
+		MSG_WriteByte (&sv->datagram, attenuation*64);
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (field_mask & SND_LARGEENTITY)
 	{
-		MSG_WriteShort (&sv.datagram, ent);
-		MSG_WriteByte (&sv.datagram, channel);
+		MSG_WriteEntity (&sv->datagram, ent, sv->protocolflags);
+		MSG_WriteByte (&sv->datagram, channel);
 	}
 	else
-		MSG_WriteShort (&sv.datagram, (ent<<3) | channel);
+		MSG_WriteShort (&sv->datagram, (ent<<3) | channel);
 	if (field_mask & SND_LARGESOUND)
-		MSG_WriteShort (&sv.datagram, sound_num);
+		MSG_WriteShort (&sv->datagram, sound_num);
 	else
-		MSG_WriteByte (&sv.datagram, sound_num);
+		MSG_WriteByte (&sv->datagram, sound_num);
 	//johnfitz
 
 	for (i = 0; i < 3; i++)
-		MSG_WriteCoord (&sv.datagram, entity->v.origin[i]+0.5*(entity->v.mins[i]+entity->v.maxs[i]), sv.protocolflags);
+		MSG_WriteCoord (&sv->datagram, entity->v.origin[i]+0.5*(entity->v.mins[i]+entity->v.maxs[i]), sv->protocolflags);
+
+	sv->datagramsound += sv->datagram.cursize;
 }
 
 /*
@@ -349,12 +384,12 @@ void SV_LocalSound (client_t *client, const char *sample)
 {
 	int	sound_num, field_mask;
 
-	for (sound_num = 1; sound_num < MAX_SOUNDS && sv.sound_precache[sound_num]; sound_num++)
+	for (sound_num = 1; sound_num < MAX_SOUNDS && sv->sound_precache[sound_num]; sound_num++)
 	{
-		if (!strcmp(sample, sv.sound_precache[sound_num]))
+		if (!strcmp(sample, sv->sound_precache[sound_num]))
 			break;
 	}
-	if (sound_num == MAX_SOUNDS || !sv.sound_precache[sound_num])
+	if (sound_num == MAX_SOUNDS || !sv->sound_precache[sound_num])
 	{
 		Con_Printf ("SV_LocalSound: %s not precached\n", sample);
 		return;
@@ -363,7 +398,7 @@ void SV_LocalSound (client_t *client, const char *sample)
 	field_mask = 0;
 	if (sound_num >= 256)
 	{
-		if (sv.protocol == PROTOCOL_NETQUAKE)
+		if (sv->protocol == PROTOCOL_NETQUAKE)
 			return;
 		field_mask = SND_LARGESOUND;
 	}
@@ -411,12 +446,12 @@ void SV_SendServerinfo (client_t *client)
 	MSG_WriteString (&client->message,message);
 
 	MSG_WriteByte (&client->message, svc_serverinfo);
-	MSG_WriteLong (&client->message, sv.protocol); //johnfitz -- sv.protocol instead of PROTOCOL_VERSION
+	MSG_WriteLong (&client->message, sv->protocol); //johnfitz -- sv->protocol instead of PROTOCOL_VERSION
 	
-	if (sv.protocol == PROTOCOL_RMQ)
+	if (sv->protocol == PROTOCOL_RMQ)
 	{
 		// mh - now send protocol flags so that the client knows the protocol features to expect
-		MSG_WriteLong (&client->message, sv.protocolflags);
+		MSG_WriteLong (&client->message, sv->protocolflags);
 	}
 	
 	MSG_WriteByte (&client->message, svs.maxclients);
@@ -429,13 +464,13 @@ void SV_SendServerinfo (client_t *client)
 	MSG_WriteString (&client->message, PR_GetString(qcvm->edicts->v.message));
 
 	//johnfitz -- only send the first 256 model and sound precaches if protocol is 15
-	for (i = 1, s = sv.model_precache+1; *s; s++,i++)
-		if (sv.protocol != PROTOCOL_NETQUAKE || i < 256)
+	for (i = 1, s = sv->model_precache+1; *s; s++,i++)
+		if (sv->protocol != PROTOCOL_NETQUAKE || i < 256)
 			MSG_WriteString (&client->message, *s);
 	MSG_WriteByte (&client->message, 0);
 
-	for (i = 1, s = sv.sound_precache+1; *s; s++, i++)
-		if (sv.protocol != PROTOCOL_NETQUAKE || i < 256)
+	for (i = 1, s = sv->sound_precache+1; *s; s++, i++)
+		if (sv->protocol != PROTOCOL_NETQUAKE || i < 256)
 			MSG_WriteString (&client->message, *s);
 	MSG_WriteByte (&client->message, 0);
 	//johnfitz
@@ -447,7 +482,7 @@ void SV_SendServerinfo (client_t *client)
 
 // set view
 	MSG_WriteByte (&client->message, svc_setview);
-	MSG_WriteShort (&client->message, NUM_FOR_EDICT(client->edict));
+	MSG_WriteEntity (&client->message, NUM_FOR_EDICT(client->edict), sv->protocolflags);
 
 	MSG_WriteByte (&client->message, svc_signonnum);
 	MSG_WriteByte (&client->message, 1);
@@ -484,8 +519,9 @@ void SV_ConnectClient (int clientnum)
 // set up the client_t
 	netconnection = client->netconnection;
 
-	if (sv.loadgame)
+	if (sv->loadgame)
 		memcpy (spawn_parms, client->spawn_parms, sizeof(spawn_parms));
+	free (client->entages);
 	memset (client, 0, sizeof(*client));
 	client->netconnection = netconnection;
 
@@ -497,7 +533,7 @@ void SV_ConnectClient (int clientnum)
 	client->message.maxsize = sizeof(client->msgbuf);
 	client->message.allowoverflow = true;		// we can catch it
 
-	if (sv.loadgame)
+	if (sv->loadgame)
 		memcpy (client->spawn_parms, spawn_parms, sizeof(spawn_parms));
 	else
 	{
@@ -525,6 +561,9 @@ void SV_CheckForNewClients (void)
 //
 // check for new connections
 //
+	if (!SV_AcceptsNewClients ())
+		return;		// another instance has room for them
+
 	while (1)
 	{
 		ret = NET_CheckNewConnections ();
@@ -564,7 +603,8 @@ SV_ClearDatagram
 */
 void SV_ClearDatagram (void)
 {
-	SZ_Clear (&sv.datagram);
+	SZ_Clear (&sv->datagram);
+	sv->datagramsound = 0;
 }
 
 /*
@@ -582,6 +622,30 @@ static int	fatbytes;
 static byte	*fatpvs;
 static int	fatpvs_capacity;
 
+// most clients stand in one or two leafs, so the fat pvs is cached by the
+// set of leafs within 8 units rather than by origin
+#define FATPVS_MAXLEAFS		16
+#define FATPVS_CACHESIZE	32
+
+typedef struct
+{
+	qmodel_t	*model;
+	int			generation;
+	int			numleafs;
+	int			leafs[FATPVS_MAXLEAFS];
+	unsigned	lastused;
+	int			capacity;
+	byte		*pvs;
+} fatpvsentry_t;
+
+static fatpvsentry_t	fatpvs_cache[FATPVS_CACHESIZE];
+static unsigned			fatpvs_tick;
+static int				fatpvs_numleafs;
+static int				fatpvs_leafs[FATPVS_MAXLEAFS];
+static unsigned			fatpvs_hits;
+static unsigned			fatpvs_misses;
+static unsigned			fatpvs_overflows;
+
 void SV_AddToFatPVS (vec3_t org, mnode_t *node, qmodel_t *worldmodel) //johnfitz -- added worldmodel as a parameter
 {
 	int		i;
@@ -617,6 +681,121 @@ void SV_AddToFatPVS (vec3_t org, mnode_t *node, qmodel_t *worldmodel) //johnfitz
 	}
 }
 
+/*
+=============
+SV_CollectFatLeafs
+
+Same traversal as SV_AddToFatPVS, but only records the non-solid leafs.
+Returns false if there are more than FATPVS_MAXLEAFS of them.
+=============
+*/
+static qboolean SV_CollectFatLeafs (vec3_t org, mnode_t *node, qmodel_t *worldmodel)
+{
+	mplane_t	*plane;
+	float		d;
+
+	while (1)
+	{
+		if (node->contents < 0)
+		{
+			if (node->contents != CONTENTS_SOLID)
+			{
+				if (fatpvs_numleafs == FATPVS_MAXLEAFS)
+					return false;
+				fatpvs_leafs[fatpvs_numleafs++] = (mleaf_t *)node - worldmodel->leafs;
+			}
+			return true;
+		}
+
+		plane = node->plane;
+		d = DotProduct (org, plane->normal) - plane->dist;
+		if (d > 8)
+			node = node->children[0];
+		else if (d < -8)
+			node = node->children[1];
+		else
+		{
+			if (!SV_CollectFatLeafs (org, node->children[0], worldmodel))
+				return false;
+			node = node->children[1];
+		}
+	}
+}
+
+/*
+=============
+SV_CachedFatPVS
+=============
+*/
+static byte *SV_CachedFatPVS (qmodel_t *worldmodel)
+{
+	fatpvsentry_t	*e, *best;
+	byte			*pvs;
+	int				i, j;
+
+	fatpvs_tick++;
+
+	best = &fatpvs_cache[0];
+	for (i = 0, e = fatpvs_cache; i < FATPVS_CACHESIZE; i++, e++)
+	{
+		if (e->model == worldmodel && e->generation == mod_pvsgeneration &&
+			e->numleafs == fatpvs_numleafs &&
+			!memcmp (e->leafs, fatpvs_leafs, sizeof (fatpvs_leafs[0]) * fatpvs_numleafs))
+		{
+			fatpvs_hits++;
+			e->lastused = fatpvs_tick;
+			return e->pvs;
+		}
+		if (e->lastused < best->lastused)
+			best = e;
+	}
+
+	fatpvs_misses++;
+	e = best;
+	if (e->pvs == NULL || fatbytes > e->capacity)
+	{
+		e->capacity = fatbytes;
+		e->pvs = (byte *) realloc (e->pvs, e->capacity);
+		if (!e->pvs)
+			Sys_Error ("SV_FatPVS: realloc() failed on %d bytes", e->capacity);
+	}
+
+	e->model = worldmodel;
+	e->generation = mod_pvsgeneration;
+	e->numleafs = fatpvs_numleafs;
+	memcpy (e->leafs, fatpvs_leafs, sizeof (fatpvs_leafs[0]) * fatpvs_numleafs);
+	e->lastused = fatpvs_tick;
+
+	Q_memset (e->pvs, 0, fatbytes);
+	for (i = 0; i < fatpvs_numleafs; i++)
+	{
+		pvs = Mod_LeafPVS (&worldmodel->leafs[fatpvs_leafs[i]], worldmodel);
+		for (j = 0; j < fatbytes; j++)
+			e->pvs[j] |= pvs[j];
+	}
+
+	return e->pvs;
+}
+
+/*
+=============
+SV_PVSStats_f
+=============
+*/
+static void SV_PVSStats_f (void)
+{
+	unsigned	total = fatpvs_hits + fatpvs_misses;
+	qboolean	reset = Cmd_Argc () > 1 && !q_strcasecmp (Cmd_Argv (1), "reset");
+
+	Mod_PVSCacheStats (reset);
+	Con_Printf ("fat pvs: %u hits, %u misses, %u uncached (%.1f%% hit rate)\n",
+		fatpvs_hits, fatpvs_misses, fatpvs_overflows,
+		total ? 100.0 * fatpvs_hits / total : 0.0);
+
+	if (reset)
+		fatpvs_hits = fatpvs_misses = fatpvs_overflows = 0;
+}
+
 /*
 =============
 SV_FatPVS
@@ -627,8 +806,19 @@ given point.
 */
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel) //johnfitz -- added worldmodel as a parameter
 {
+	extern cvar_t pvs_cachesize;
+
 	fatbytes = (worldmodel->numleafs+7)>>3; // ericw -- was +31, assumed to be a bug/typo
 	fatbytes = (fatbytes + VIS_ALIGN_MASK) & ~VIS_ALIGN_MASK; // round up
+
+	if (pvs_cachesize.value > 0.f)
+	{
+		fatpvs_numleafs = 0;
+		if (SV_CollectFatLeafs (org, worldmodel->nodes, worldmodel))
+			return SV_CachedFatPVS (worldmodel);
+		fatpvs_overflows++;
+	}
+
 	if (fatpvs == NULL || fatbytes > fatpvs_capacity)
 	{
 		fatpvs_capacity = fatbytes;
@@ -678,30 +868,303 @@ qboolean SV_VisibleToClient (edict_t *client, edict_t *test, qmodel_t *worldmode
 
 #define MAX_NET_EDICTS 65536
 
-static uint16_t		net_edicts[MAX_NET_EDICTS];
+static uint32_t		net_edicts[MAX_NET_EDICTS];
 static byte			net_edict_dists[MAX_NET_EDICTS];
 static int			net_edict_bins[256];
-static uint16_t		net_edicts_sorted[MAX_NET_EDICTS];
+static uint32_t		net_edicts_sorted[MAX_NET_EDICTS];
+static uint32_t		net_edicts_held[MAX_NET_EDICTS];
+
+// Packed (structure-of-arrays) copy of the few edict fields the per-client
+// entity loop reads. It is gathered once per frame in SV_SendClientMessages,
+// after physics and QC have run, so each client only walks compact arrays
+// of potentially visible edicts instead of striding over every edict_t.
+typedef struct
+{
+	int			*ents;			// edict numbers with a visible model, ascending
+	int			*numleafs;
+	int			*firstleaf;		// offset into leafs
+	int			*leafs;
+	float		*absmin;		// 3 floats per entry
+	float		*absmax;		// 3 floats per entry
+} nethot_t;
+
+static nethot_t		net_hot;
+
+/*
+=============
+SV_GatherNetHot
+
+Builds the hot-field mirror from count edicts laid out stride bytes apart
+=============
+*/
+static void SV_GatherNetHot (nethot_t *hot, edict_t *first, int count, int stride, qboolean checkmodel)
+{
+	int		e;
+	edict_t	*ent;
+
+	VEC_CLEAR (hot->ents);
+	VEC_CLEAR (hot->numleafs);
+	VEC_CLEAR (hot->firstleaf);
+	VEC_CLEAR (hot->leafs);
+	VEC_CLEAR (hot->absmin);
+	VEC_CLEAR (hot->absmax);
+
+	count = q_min (count, SV_MaxEntityNum () + 1);
+	for (e = 1; e < count; e++)
+	{
+		ent = (edict_t *) ((byte *) first + e * stride);
+
+		// ignore ents without visible models
+		if (!ent->v.modelindex || (checkmodel && !PR_GetString(ent->v.model)[0]))
+			continue;
+
+		//johnfitz -- don't send model>255 entities if protocol is 15
+		if (sv->protocol == PROTOCOL_NETQUAKE && (int)ent->v.modelindex & 0xFF00)
+			continue;
+
+		VEC_PUSH (hot->ents, e);
+		VEC_PUSH (hot->numleafs, ent->num_leafs);
+		VEC_PUSH (hot->firstleaf, VEC_SIZE (hot->leafs));
+		Vec_Append ((void **) &hot->leafs, sizeof (hot->leafs[0]), ent->leafnums, ent->num_leafs);
+		Vec_Append ((void **) &hot->absmin, sizeof (hot->absmin[0]), ent->v.absmin, 3);
+		Vec_Append ((void **) &hot->absmax, sizeof (hot->absmax[0]), ent->v.absmax, 3);
+	}
+}
+
+/*
+=============
+SV_NetHotVisible
+
+Returns true if entry k of the mirror touches a leaf in pvs
+=============
+*/
+static qboolean SV_NetHotVisible (const nethot_t *hot, int k, const byte *pvs)
+{
+	int			i, n;
+	const int	*leafs;
+
+	n = hot->numleafs[k];
+	leafs = hot->leafs + hot->firstleaf[k];
+	for (i = 0; i < n; i++)
+		if (pvs[leafs[i] >> 3] & (1 << (leafs[i] & 7)))
+			return true;
+
+	// ericw -- added ent->num_leafs < MAX_ENT_LEAFS condition.
+	//
+	// if ent->num_leafs == MAX_ENT_LEAFS, the ent is visible from too many leafs
+	// for us to say whether it's in the PVS, so don't try to vis cull it.
+	// this commonly happens with rotators, because they often have huge bboxes
+	// spanning the entire map, or really tall lifts, etc.
+	return n >= MAX_ENT_LEAFS;
+}
+
+/*
+=============
+SV_BenchNet_f
+
+Times the per-client visibility pass of SV_WriteEntitiesToClient on a
+synthetic world, reading the edicts directly vs. through the mirror,
+and checks that both find the same edicts
+=============
+*/
+static void SV_BenchNet_f (void)
+{
+	enum { NUMLEAFS = 4096, PASSES = 32, MODFIELDS = 256 };
+	nethot_t	hot;
+	byte		pvs[NUMLEAFS / 8];
+	byte		*edicts;
+	edict_t		*ent;
+	int			*directlist, *hotlist;
+	int			numents, stride, e, i, k, pass;
+	int			withmodel, visible, hotvisible;
+	double		start, direct, gather, mirror;
+
+	numents = Cmd_Argc () > 1 ? atoi (Cmd_Argv (1)) : 16384;
+	numents = CLAMP (2, numents, MAX_NET_EDICTS);
+	stride = sizeof (edict_t) + MODFIELDS * sizeof (float);
+
+	edicts = (byte *) calloc (numents, stride);
+	if (!edicts)
+	{
+		Con_Printf ("sv_benchnet: couldn't allocate %d edicts\n", numents);
+		return;
+	}
+
+	// roughly one in four edicts has a model, a quarter of the leafs are visible
+	srand (numents);
+	withmodel = 0;
+	for (e = 1; e < numents; e++)
+	{
+		ent = (edict_t *) (edicts + e * stride);
+		if (rand () & 3)
+			continue;
+		withmodel++;
+		ent->v.modelindex = 1 + rand () % 255;
+		ent->num_leafs = (rand () & 63) ? 1 + rand () % 4 : MAX_ENT_LEAFS;
+		for (i = 0; i < ent->num_leafs; i++)
+			ent->leafnums[i] = rand () % NUMLEAFS;
+		for (i = 0; i < 3; i++)
+		{
+			ent->v.absmin[i] = (rand () % 8192) - 4096;
+			ent->v.absmax[i] = ent->v.absmin[i] + 16 + rand () % 64;
+		}
+	}
+	for (i = 0; i < (int) sizeof (pvs); i++)
+		pvs[i] = rand () & rand ();
+
+	visible = 0;
+	start = Sys_DoubleTime ();
+	for (pass = 0; pass < PASSES; pass++)
+	{
+		for (e = 1; e < numents; e++)
+		{
+			ent = (edict_t *) (edicts + e * stride);
+			if (!ent->v.modelindex)
+				continue;
+			for (i = 0; i < ent->num_leafs; i++)
+				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
+					break;
+			if (i == ent->num_leafs && ent->num_leafs < MAX_ENT_LEAFS)
+				continue;
+			visible++;
+		}
+	}
+	direct = (Sys_DoubleTime () - start) / PASSES;
+
+	memset (&hot, 0, sizeof (hot));
+	start = Sys_DoubleTime ();
+	for (pass = 0; pass < PASSES; pass++)
+		SV_GatherNetHot (&hot, (edict_t *) edicts, numents, stride, false);
+	gather = (Sys_DoubleTime () - start) / PASSES;
+
+	hotvisible = 0;
+	start = Sys_DoubleTime ();
+	for (pass = 0; pass < PASSES; pass++)
+		for (k = 0; k < VEC_SIZE (hot.ents); k++)
+			if (SV_NetHotVisible (&hot, k, pvs))
+				hotvisible++;
+	mirror = (Sys_DoubleTime () - start) / PASSES;
+
+	// untimed pass: both must find exactly the same edicts
+	directlist = hotlist = NULL;
+	for (e = 1; e < numents; e++)
+	{
+		ent = (edict_t *) (edicts + e * stride);
+		if (!ent->v.modelindex)
+			continue;
+		for (i = 0; i < ent->num_leafs; i++)
+			if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
+				break;
+		if (i == ent->num_leafs && ent->num_leafs < MAX_ENT_LEAFS)
+			continue;
+		VEC_PUSH (directlist, e);
+	}
+	for (k = 0; k < VEC_SIZE (hot.ents); k++)
+		if (SV_NetHotVisible (&hot, k, pvs))
+			VEC_PUSH (hotlist, hot.ents[k]);
+	if (VEC_SIZE (directlist))
+		qsort (directlist, VEC_SIZE (directlist), sizeof (directlist[0]), SV_CompareEdictNums);
+	if (VEC_SIZE (hotlist))
+		qsort (hotlist, VEC_SIZE (hotlist), sizeof (hotlist[0]), SV_CompareEdictNums);
+
+	Con_Printf ("%d edicts of %d bytes, %d with models, %d visible\n", numents, stride, withmodel, visible / PASSES);
+	if (hotvisible != visible)
+		Con_Printf ("mismatch: mirror found %d visible\n", hotvisible / PASSES);
+	else
+	{
+		for (k = 0; k < VEC_SIZE (directlist) && directlist[k] == hotlist[k]; k++)
+			;
+		if (k < VEC_SIZE (directlist))
+			Con_Printf ("mismatch: edict %d vs %d in the mirror\n", directlist[k], hotlist[k]);
+	}
+	Con_Printf ("direct: %7.3f ms per client\n", direct * 1000.0);
+	Con_Printf ("mirror: %7.3f ms per client + %.3f ms gather per frame\n", mirror * 1000.0, gather * 1000.0);
+
+	VEC_FREE (hot.ents);
+	VEC_FREE (hot.numleafs);
+	VEC_FREE (hot.firstleaf);
+	VEC_FREE (hot.leafs);
+	VEC_FREE (hot.absmin);
+	VEC_FREE (hot.absmax);
+	VEC_FREE (directlist);
+	VEC_FREE (hotlist);
+	free (edicts);
+}
+
+/*
+=============
+SV_EntKeepSize
+
+Bytes needed for svc_entkeep messages covering count entities
+=============
+*/
+static int SV_EntKeepSize (int count)
+{
+	int entsize = (sv->protocolflags & PRFL_LARGEEDICTS) ? 3 : 2;
+	return count * entsize + 2 * ((count + 254) / 255);
+}
+
+/*
+=============
+SV_EntityAges
+
+Per-entity count of ticks each visible entity has gone without an update,
+only kept for clients that understand svc_entkeep
+=============
+*/
+static byte *SV_EntityAges (client_t *client)
+{
+	if (client->numentages < qcvm->max_edicts)
+	{
+		client->entages = (byte *) realloc (client->entages, qcvm->max_edicts);
+		if (!client->entages)
+			Sys_Error ("SV_EntityAges: out of memory");
+		memset (client->entages + client->numentages, 0, qcvm->max_edicts - client->numentages);
+		client->numentages = qcvm->max_edicts;
+	}
+	return client->entages;
+}
 
 /*
 =============
 SV_WriteEntitiesToClient
 
+Clients that asked for "entkeep 1" get a scheduled update: each entity's
+sort key is boosted by the number of ticks it has been left out, updates
+stop at sv_entbudget bytes, and the visible entities that didn't make it
+are listed in svc_entkeep so the client holds them in place until their
+turn comes.  Everybody else gets the closest entities that fit.
+
+Returns the number of visible entities that didn't fit in msg
 =============
 */
-void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
+int SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 {
-	int		e, i, j, numents;
+	int		e, i, j, k, numents, dropped = 0;
 	int		bits;
 	byte	*pvs;
 	vec3_t	org, forward, right, up;
 	float	miss, dist, size;
 	eval_t	*val;
 	edict_t	*ent;
+	int		clentnum;
+	client_t	*client;
+	byte	*ages;
+	qboolean	sort;
+	int		budget, numheld;
+
+	clentnum = NUM_FOR_EDICT (clent);
+	client = svs.clients + clentnum - 1;
+	ages = client->entkeep ? SV_EntityAges (client) : NULL;
+	sort = sv_netsort.value || ages;
+	numheld = 0;
+	budget = msg->maxsize;
+	if (ages && sv_entbudget.value > 0)
+		budget = q_min (budget, msg->cursize + (int) sv_entbudget.value);
 
 // find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
-	pvs = SV_FatPVS (org, sv.worldmodel);
+	pvs = SV_FatPVS (org, sv->worldmodel);
 
 // find the client's orientation
 	AngleVectors (clent->v.v_angle, forward, right, up);
@@ -710,82 +1173,68 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 	memset (net_edict_bins, 0, sizeof (net_edict_bins));
 
 // add clent
-	if (sv_netsort.value)
+	if (sort)
 	{
-		net_edicts[0] = NUM_FOR_EDICT (clent);
+		net_edicts[0] = clentnum;
 		net_edict_dists[0] = 0;
 		net_edict_bins[0] = 1;
 	}
 	else
-		net_edicts_sorted[0] = NUM_FOR_EDICT (clent);
+		net_edicts_sorted[0] = clentnum;
 	numents = 1;
 
 // add all other entities that touch the pvs
-	ent = NEXT_EDICT(qcvm->edicts);
-	for (e=1 ; e<qcvm->num_edicts ; e++, ent = NEXT_EDICT(ent))
+	for (k=0 ; k<VEC_SIZE (net_hot.ents) ; k++)
 	{
-		if (ent != clent)	// clent already added before the loop
-		{
-			// ignore ents without visible models
-			if (!ent->v.modelindex || !PR_GetString(ent->v.model)[0])
-				continue;
+		e = net_hot.ents[k];
+		if (e == clentnum)	// clent already added before the loop
+			continue;
 
-			//johnfitz -- don't send model>255 entities if protocol is 15
-			if (sv.protocol == PROTOCOL_NETQUAKE && (int)ent->v.modelindex & 0xFF00)
-				continue;
+		if (!SV_NetHotVisible (&net_hot, k, pvs))
+			continue;		// not visible
 
-			// ignore if not touching a PV leaf
-			for (i=0 ; i < ent->num_leafs ; i++)
-				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
-					break;
-			
-			// ericw -- added ent->num_leafs < MAX_ENT_LEAFS condition.
-			//
-			// if ent->num_leafs == MAX_ENT_LEAFS, the ent is visible from too many leafs
-			// for us to say whether it's in the PVS, so don't try to vis cull it.
-			// this commonly happens with rotators, because they often have huge bboxes
-			// spanning the entire map, or really tall lifts, etc.
-			if (i == ent->num_leafs && ent->num_leafs < MAX_ENT_LEAFS)
-				continue;		// not visible
+		if (sort)
+		{
+			const float *absmin = net_hot.absmin + k*3;
+			const float *absmax = net_hot.absmax + k*3;
 
-			if (sv_netsort.value)
+			// compute ent bbox size and distance from org to the closest point in ent's bbox
+			dist = size = 0.f;
+			for (i=0 ; i<3 ; i++)
 			{
-				// compute ent bbox size and distance from org to the closest point in ent's bbox
-				dist = size = 0.f;
-				for (i=0 ; i<3 ; i++)
-				{
-					float delta = CLAMP (ent->v.absmin[i], org[i], ent->v.absmax[i]) - org[i];
-					dist += delta * delta;
-					delta = ent->v.absmax[i] - ent->v.absmin[i];
-					size += delta * delta;
-				}
-				size = q_max (1.f, size);
+				float delta = CLAMP (absmin[i], org[i], absmax[i]) - org[i];
+				dist += delta * delta;
+				delta = absmax[i] - absmin[i];
+				size += delta * delta;
+			}
+			size = q_max (1.f, size);
 
-				// use scaled square root of (distance/size) as sort key
-				dist = 8.f * sqrt (sqrt (dist/size));
-				net_edict_dists[numents] = (int) q_min (dist, 255.f);
-				net_edicts[numents] = e;
+			// use scaled square root of (distance/size) as sort key
+			dist = 8.f * sqrt (sqrt (dist/size));
+			net_edict_dists[numents] = (int) q_min (dist, 255.f);
+			net_edicts[numents] = e;
 
-				// compute max distance along forward axis
-				dist = 0.f;
-				for (i=0 ; i<3 ; i++)
-					dist += ((forward[i] < 0.f ? ent->v.absmin[i] : ent->v.absmax[i]) - org[i]) * forward[i];
-				if (dist < 0.f)
-					net_edict_dists[numents] |= 128; // deprioritize entities behind the client
+			// compute max distance along forward axis
+			dist = 0.f;
+			for (i=0 ; i<3 ; i++)
+				dist += ((forward[i] < 0.f ? absmin[i] : absmax[i]) - org[i]) * forward[i];
+			if (dist < 0.f)
+				net_edict_dists[numents] |= 128; // deprioritize entities behind the client
 
-				net_edict_bins[net_edict_dists[numents]]++;
-			}
-			else
-				net_edicts_sorted[numents] = e;
+			// entities that keep getting left out climb towards the front of the queue
+			if (ages && ages[e])
+				net_edict_dists[numents] = (int) q_max (0.f, net_edict_dists[numents] - 24.f * log (1.f + ages[e]) / log (2.f));
 
-			if (++numents == MAX_NET_EDICTS)
-				break;
+			net_edict_bins[net_edict_dists[numents]]++;
 		}
 		else
-			continue;
+			net_edicts_sorted[numents] = e;
+
+		if (++numents == MAX_NET_EDICTS)
+			break;
 	}
 
-	if (sv_netsort.value)
+	if (sort)
 	{
 		// compute bin offsets
 		e = 0;
@@ -811,7 +1260,19 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		// assumed here.  And, for protocol 85 the max size is actually 24 bytes.
 		// For float coords and angles the limit is 40.
 		// FIXME: Use tighter limit according to protocol flags and send bits.
-		if (msg->cursize + 40 > msg->maxsize)
+		if (ages && j > 0 && msg->cursize + 40 + SV_EntKeepSize (numheld) > budget)
+		{
+			// out of budget, hold it in place on the client if there's room for that
+			if (msg->cursize + SV_EntKeepSize (numheld + 1) > msg->maxsize)
+			{
+				dropped = numents - j;
+				break;
+			}
+			net_edicts_held[numheld++] = e;
+			ages[e] = q_min (ages[e] + 1, 255);
+			continue;
+		}
+		if (msg->cursize + 40 + SV_EntKeepSize (numheld) > msg->maxsize)
 		{
 			//johnfitz -- less spammy overflow message
 			if (!dev_overflows.packetsize || dev_overflows.packetsize + CONSOLE_RESPAM_TIME < realtime )
@@ -819,10 +1280,14 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 				Con_Printf ("Packet overflow!\n");
 				dev_overflows.packetsize = realtime;
 			}
-			goto stats;
+			dropped = numents - j;
+			break;
 			//johnfitz
 		}
 
+		if (ages)
+			ages[e] = 0;
+
 // send an update
 		bits = 0;
 
@@ -878,7 +1343,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 			ent->scale = ENTSCALE_DEFAULT;
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
-		if (sv.protocol != PROTOCOL_NETQUAKE)
+		if (sv->protocol != PROTOCOL_NETQUAKE)
 		{
 
 			if (ent->baseline.alpha != ent->alpha) bits |= U_ALPHA;
@@ -913,7 +1378,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		//johnfitz
 
 		if (bits & U_LONGENTITY)
-			MSG_WriteShort (msg,e);
+			MSG_WriteEntity (msg, e, sv->protocolflags);
 		else
 			MSG_WriteByte (msg,e);
 
@@ -928,17 +1393,17 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		if (bits & U_EFFECTS)
 			MSG_WriteByte (msg, (int)ent->v.effects & qcvm->effects_mask);
 		if (bits & U_ORIGIN1)
-			MSG_WriteCoord (msg, ent->v.origin[0], sv.protocolflags);
+			MSG_WriteCoord (msg, ent->v.origin[0], sv->protocolflags);
 		if (bits & U_ANGLE1)
-			MSG_WriteAngle(msg, ent->v.angles[0], sv.protocolflags);
+			MSG_WriteAngle(msg, ent->v.angles[0], sv->protocolflags);
 		if (bits & U_ORIGIN2)
-			MSG_WriteCoord (msg, ent->v.origin[1], sv.protocolflags);
+			MSG_WriteCoord (msg, ent->v.origin[1], sv->protocolflags);
 		if (bits & U_ANGLE2)
-			MSG_WriteAngle(msg, ent->v.angles[1], sv.protocolflags);
+			MSG_WriteAngle(msg, ent->v.angles[1], sv->protocolflags);
 		if (bits & U_ORIGIN3)
-			MSG_WriteCoord (msg, ent->v.origin[2], sv.protocolflags);
+			MSG_WriteCoord (msg, ent->v.origin[2], sv->protocolflags);
 		if (bits & U_ANGLE3)
-			MSG_WriteAngle(msg, ent->v.angles[2], sv.protocolflags);
+			MSG_WriteAngle(msg, ent->v.angles[2], sv->protocolflags);
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		if (bits & U_ALPHA)
@@ -954,13 +1419,24 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		//johnfitz
 	}
 
+// tell the client which visible entities to keep as they are
+	for (j=0 ; j<numheld ; j+=255)
+	{
+		k = q_min (numheld - j, 255);
+		MSG_WriteByte (msg, svc_entkeep);
+		MSG_WriteByte (msg, k);
+		for (i=0 ; i<k ; i++)
+			MSG_WriteEntity (msg, net_edicts_held[j+i], sv->protocolflags);
+	}
+
 	//johnfitz -- devstats
-stats:
 	if (msg->cursize > 1024 && dev_peakstats.packetsize <= 1024)
 		Con_DWarning ("%i byte packet exceeds standard limit of 1024 (max = %d).\n", msg->cursize, msg->maxsize);
 	dev_stats.packetsize = msg->cursize;
 	dev_peakstats.packetsize = q_max(msg->cursize, dev_peakstats.packetsize);
 	//johnfitz
+
+	return dropped;
 }
 
 /*
@@ -1005,7 +1481,7 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 		MSG_WriteByte (msg, ent->v.dmg_save);
 		MSG_WriteByte (msg, ent->v.dmg_take);
 		for (i=0 ; i<3 ; i++)
-			MSG_WriteCoord (msg, other->v.origin[i] + 0.5*(other->v.mins[i] + other->v.maxs[i]), sv.protocolflags );
+			MSG_WriteCoord (msg, other->v.origin[i] + 0.5*(other->v.mins[i] + other->v.maxs[i]), sv->protocolflags );
 
 		ent->v.dmg_take = 0;
 		ent->v.dmg_save = 0;
@@ -1021,7 +1497,7 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	{
 		MSG_WriteByte (msg, svc_setangle);
 		for (i=0 ; i < 3 ; i++)
-			MSG_WriteAngle (msg, ent->v.angles[i], sv.protocolflags );
+			MSG_WriteAngle (msg, ent->v.angles[i], sv->protocolflags );
 		ent->v.fixangle = 0;
 	}
 
@@ -1068,7 +1544,7 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	  bits |= SU_WEAPON;
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (sv.protocol != PROTOCOL_NETQUAKE)
+	if (sv->protocol != PROTOCOL_NETQUAKE)
 	{
 		if (bits & SU_WEAPON && SV_ModelIndex(PR_GetString(ent->v.weaponmodel)) & 0xFF00) bits |= SU_WEAPON2;
 		if ((int)ent->v.armorvalue & 0xFF00) bits |= SU_ARMOR2;
@@ -1173,6 +1649,37 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	}
 }
 
+/*
+=======================
+SV_WriteMoveAck
+
+Tells a predicting client which of its moves the player state reflects
+=======================
+*/
+static void SV_WriteMoveAck (client_t *client, sizebuf_t *msg)
+{
+	edict_t	*ent;
+	int		flags, i;
+
+	ent = client->edict;
+	flags = 0;
+	if ((int)ent->v.flags & FL_ONGROUND)
+		flags |= MOVEACK_ONGROUND;
+	if ((int)ent->v.flags & FL_JUMPRELEASED)
+		flags |= MOVEACK_JUMPRELEASED;
+	if (ent->v.movetype == MOVETYPE_WALK && ent->v.health > 0 && ent->v.waterlevel < 2 &&
+		!((int)ent->v.flags & FL_WATERJUMP) && qcvm->time >= ent->v.teleport_time)
+		flags |= MOVEACK_PREDICTABLE;
+
+	MSG_WriteByte (msg, svc_moveack);
+	MSG_WriteLong (msg, client->moveseq);
+	MSG_WriteByte (msg, flags);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteFloat (msg, ent->v.origin[i]);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteFloat (msg, ent->v.velocity[i]);
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -1182,6 +1689,8 @@ qboolean SV_SendClientDatagram (client_t *client)
 {
 	byte		buf[MAX_DATAGRAM];
 	sizebuf_t	msg;
+	netsample_t	*stats = NetStats_Current (&client->netstats);
+	int			start;
 
 	msg.data = buf;
 	msg.maxsize = sizeof(buf);
@@ -1197,12 +1706,25 @@ qboolean SV_SendClientDatagram (client_t *client)
 
 // add the client specific data to the datagram
 	SV_WriteClientdataToMessage (client->edict, &msg);
+	if (client->predict)
+		SV_WriteMoveAck (client, &msg);
+	stats->bytes[NETCAT_CLIENTDATA] += msg.cursize;
 
-	SV_WriteEntitiesToClient (client->edict, &msg);
+	start = msg.cursize;
+	stats->droppedents += SV_WriteEntitiesToClient (client->edict, &msg);
+	stats->bytes[NETCAT_ENTITIES] += msg.cursize - start;
 
 // copy the server datagram if there is space
-	if (msg.cursize + sv.datagram.cursize < msg.maxsize)
-		SZ_Write (&msg, sv.datagram.data, sv.datagram.cursize);
+	if (msg.cursize + sv->datagram.cursize < msg.maxsize)
+	{
+		SZ_Write (&msg, sv->datagram.data, sv->datagram.cursize);
+		stats->bytes[NETCAT_SOUND] += sv->datagramsound;
+		stats->bytes[NETCAT_TEMPENTS] += sv->datagram.cursize - sv->datagramsound;
+	}
+	else if (sv->datagram.cursize)
+		stats->overflows++;
+
+	NetStats_Datagram (&client->netstats, msg.cursize, msg.maxsize);
 
 // send the datagram
 	if (NET_SendUnreliableMessage (client->netconnection, &msg) == -1)
@@ -1331,10 +1853,10 @@ void SV_UpdateToReliableMessages (void)
 			continue;
 		SV_WriteStats (client);
 		SV_WriteUnderwaterOverride (client);
-		SZ_Write (&client->message, sv.reliable_datagram.data, sv.reliable_datagram.cursize);
+		SZ_Write (&client->message, sv->reliable_datagram.data, sv->reliable_datagram.cursize);
 	}
 
-	SZ_Clear (&sv.reliable_datagram);
+	SZ_Clear (&sv->reliable_datagram);
 }
 
 
@@ -1374,12 +1896,20 @@ void SV_SendClientMessages (void)
 // update frags, names, etc
 	SV_UpdateToReliableMessages ();
 
+// refresh the packed copy of the edict fields SV_WriteEntitiesToClient reads
+	SV_GatherNetHot (&net_hot, qcvm->edicts, qcvm->num_edicts, qcvm->edict_size, true);
+
+// remember where everyone is in this update, for lag compensation
+	SV_LagCompRecord ();
+
 // build individual updates
 	for (i=0, host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
 	{
 		if (!host_client->active)
 			continue;
 
+		NetStats_Begin (&host_client->netstats, host_client->netconnection);
+
 		if (host_client->spawned)
 		{
 			if (!SV_SendClientDatagram (host_client))
@@ -1401,9 +1931,9 @@ void SV_SendClientMessages (void)
 			if (host_client->sendsignon == PRESPAWN_SIGNONBUFS)
 			{
 				qboolean local = SV_IsLocalClient (host_client);
-				while (host_client->signonidx < sv.num_signon_buffers)
+				while (host_client->signonidx < sv->num_signon_buffers)
 				{
-					sizebuf_t *signon = sv.signon_buffers[host_client->signonidx];
+					sizebuf_t *signon = sv->signon_buffers[host_client->signonidx];
 					if (host_client->message.cursize + signon->cursize > host_client->message.maxsize)
 						break;
 					SZ_Write (&host_client->message, signon->data, signon->cursize);
@@ -1414,7 +1944,7 @@ void SV_SendClientMessages (void)
 					if (!local)
 						break;
 				}
-				if (host_client->signonidx == sv.num_signon_buffers)
+				if (host_client->signonidx == sv->num_signon_buffers)
 					host_client->sendsignon = PRESPAWN_SIGNONMSG;
 			}
 			if (host_client->sendsignon == PRESPAWN_SIGNONMSG)
@@ -1450,6 +1980,7 @@ void SV_SendClientMessages (void)
 				SV_DropClient (false);	// went to another level
 			else
 			{
+				NetStats_Reliable (&host_client->netstats, host_client->message.cursize);
 				if (NET_SendMessage (host_client->netconnection
 				, &host_client->message) == -1)
 					SV_DropClient (true);	// if the message couldn't send, kick off
@@ -1461,6 +1992,8 @@ void SV_SendClientMessages (void)
 		}
 	}
 
+// hand anything the drivers batched up to the kernel
+	NET_Flush ();
 
 // clear muzzle flashes
 	SV_CleanupEnts ();
@@ -1485,14 +2018,17 @@ SV_AddSignonBuffer
 static void SV_AddSignonBuffer (void)
 {
 	sizebuf_t *sb;
-	if (sv.num_signon_buffers >= MAX_SIGNON_BUFFERS)
+	if (sv->num_signon_buffers >= MAX_SIGNON_BUFFERS)
 		Host_Error ("SV_AddSignonBuffer overflow\n");
 
-	sb = (sizebuf_t *) Hunk_AllocName (sizeof (sizebuf_t) + SIGNON_SIZE, "signon");
+	// freed along with the server's progs, like everything else owned by the instance
+	if (qcvm != &sv->qcvm)
+		Host_Error ("SV_AddSignonBuffer: server VM not active");
+	sb = (sizebuf_t *) PR_Alloc (sizeof (sizebuf_t) + SIGNON_SIZE);
 	sb->data = (byte *)(sb + 1);
 	sb->maxsize = SIGNON_SIZE;
-	sv.signon_buffers[sv.num_signon_buffers++] = sb;
-	sv.signon = sb;
+	sv->signon_buffers[sv->num_signon_buffers++] = sb;
+	sv->signon = sb;
 }
 
 /*
@@ -1502,7 +2038,7 @@ SV_ReserveSignonSpace
 */
 void SV_ReserveSignonSpace (int numbytes)
 {
-	if (sv.signon->cursize + numbytes > sv.signon->maxsize)
+	if (sv->signon->cursize + numbytes > sv->signon->maxsize)
 		SV_AddSignonBuffer ();
 }
 
@@ -1519,10 +2055,10 @@ int SV_ModelIndex (const char *name)
 	if (!name || !name[0])
 		return 0;
 
-	for (i=0 ; i<MAX_MODELS && sv.model_precache[i] ; i++)
-		if (!strcmp(sv.model_precache[i], name))
+	for (i=0 ; i<MAX_MODELS && sv->model_precache[i] ; i++)
+		if (!strcmp(sv->model_precache[i], name))
 			return i;
-	if (i==MAX_MODELS || !sv.model_precache[i])
+	if (i==MAX_MODELS || !sv->model_precache[i])
 		Sys_Error ("SV_ModelIndex: model %s not precached", name);
 	return i;
 }
@@ -1547,6 +2083,8 @@ void SV_CreateBaseline (void)
 			continue;
 		if (entnum > svs.maxclients && !svent->v.modelindex)
 			continue;
+		if (entnum > SV_MaxEntityNum ())
+			break;
 
 	//
 	// create entity baseline
@@ -1568,7 +2106,7 @@ void SV_CreateBaseline (void)
 			svent->baseline.modelindex = SV_ModelIndex(PR_GetString(svent->v.model));
 			svent->baseline.alpha = svent->alpha; //johnfitz -- alpha support
 			svent->baseline.scale = ENTSCALE_DEFAULT;
-			if (sv.protocol == PROTOCOL_RMQ)
+			if (sv->protocol == PROTOCOL_RMQ)
 			{
 				eval_t* val;
 				val = GetEdictFieldValueByName(svent, "scale");
@@ -1579,7 +2117,7 @@ void SV_CreateBaseline (void)
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		bits = 0;
-		if (sv.protocol == PROTOCOL_NETQUAKE) //still want to send baseline in PROTOCOL_NETQUAKE, so reset these values
+		if (sv->protocol == PROTOCOL_NETQUAKE) //still want to send baseline in PROTOCOL_NETQUAKE, so reset these values
 		{
 			if (svent->baseline.modelindex & 0xFF00)
 				svent->baseline.modelindex = 0;
@@ -1608,43 +2146,43 @@ void SV_CreateBaseline (void)
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		if (bits)
-			MSG_WriteByte (sv.signon, svc_spawnbaseline2);
+			MSG_WriteByte (sv->signon, svc_spawnbaseline2);
 		else
-			MSG_WriteByte (sv.signon, svc_spawnbaseline);
+			MSG_WriteByte (sv->signon, svc_spawnbaseline);
 		//johnfitz
 
-		MSG_WriteShort (sv.signon,entnum);
+		MSG_WriteEntity (sv->signon, entnum, sv->protocolflags);
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		if (bits)
-			MSG_WriteByte (sv.signon, bits);
+			MSG_WriteByte (sv->signon, bits);
 
 		if (bits & B_LARGEMODEL)
-			MSG_WriteShort (sv.signon, svent->baseline.modelindex);
+			MSG_WriteShort (sv->signon, svent->baseline.modelindex);
 		else
-			MSG_WriteByte (sv.signon, svent->baseline.modelindex);
+			MSG_WriteByte (sv->signon, svent->baseline.modelindex);
 
 		if (bits & B_LARGEFRAME)
-			MSG_WriteShort (sv.signon, svent->baseline.frame);
+			MSG_WriteShort (sv->signon, svent->baseline.frame);
 		else
-			MSG_WriteByte (sv.signon, svent->baseline.frame);
+			MSG_WriteByte (sv->signon, svent->baseline.frame);
 		//johnfitz
 
-		MSG_WriteByte (sv.signon, svent->baseline.colormap);
-		MSG_WriteByte (sv.signon, svent->baseline.skin);
+		MSG_WriteByte (sv->signon, svent->baseline.colormap);
+		MSG_WriteByte (sv->signon, svent->baseline.skin);
 		for (i=0 ; i<3 ; i++)
 		{
-			MSG_WriteCoord(sv.signon, svent->baseline.origin[i], sv.protocolflags);
-			MSG_WriteAngle(sv.signon, svent->baseline.angles[i], sv.protocolflags);
+			MSG_WriteCoord(sv->signon, svent->baseline.origin[i], sv->protocolflags);
+			MSG_WriteAngle(sv->signon, svent->baseline.angles[i], sv->protocolflags);
 		}
 
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		if (bits & B_ALPHA)
-			MSG_WriteByte (sv.signon, svent->baseline.alpha);
+			MSG_WriteByte (sv->signon, svent->baseline.alpha);
 		//johnfitz
 
 		if (bits & B_SCALE)
-			MSG_WriteByte (sv.signon, svent->baseline.scale);
+			MSG_WriteByte (sv->signon, svent->baseline.scale);
 	}
 }
 
@@ -1745,7 +2283,7 @@ static void SV_PrintMapCheck (mapcheck_t status, const char *format, ...)
 	else
 	{
 		Con_SafePrintf ("\xDB%c\xDD %s\n", status == MAPCHECK_PARTIAL ? '-' ^ 0x80 : ' ', COM_TintString (str, tinted, sizeof (tinted)));
-		sv.mapchecks.numwarnings++;
+		sv->mapchecks.numwarnings++;
 	}
 }
 
@@ -1770,20 +2308,20 @@ static void SV_PrintMapChecklist (void)
 	Con_SafePrintf ("\n");
 	Con_SafePrintf ("=====================================\n");
 	Con_SafePrintf ("\n");
-	Con_SafePrintf ("Map checklist (%s):\n\n", COM_SkipPath (sv.modelname));
+	Con_SafePrintf ("Map checklist (%s):\n\n", COM_SkipPath (sv->modelname));
 
 	//
 	// light data
 	//
-	SV_PrintMapCheck (sv.worldmodel->lightdata != NULL ? MAPCHECK_OK : MAPCHECK_FAILED, "lightmap data");
+	SV_PrintMapCheck (sv->worldmodel->lightdata != NULL ? MAPCHECK_OK : MAPCHECK_FAILED, "lightmap data");
 
 	//
 	// vis data
 	//
-	if (!sv.worldmodel->visdata)
+	if (!sv->worldmodel->visdata)
 	{
 		char pointfile[MAX_OSPATH];
-		q_snprintf (pointfile, sizeof (pointfile), "maps/%s.pts", sv.name);
+		q_snprintf (pointfile, sizeof (pointfile), "maps/%s.pts", sv->name);
 		if (COM_FileExists (pointfile, NULL))
 			SV_PrintMapCheck (MAPCHECK_FAILED, "vis data (unsealed map?)");
 		else
@@ -1795,52 +2333,52 @@ static void SV_PrintMapChecklist (void)
 	//
 	// changelevel trigger
 	//
-	if (!sv.mapchecks.trigger_changelevel)
+	if (!sv->mapchecks.trigger_changelevel)
 		SV_PrintMapCheck (MAPCHECK_FAILED, "trigger_changelevel");
-	else if (sv.mapchecks.trigger_changelevel == 1)
+	else if (sv->mapchecks.trigger_changelevel == 1)
 	{
-		if (sv.mapchecks.valid_changelevel == sv.mapchecks.trigger_changelevel)
-			SV_PrintMapCheck (MAPCHECK_OK, "trigger_changelevel (%s)", sv.mapchecks.changelevel);
+		if (sv->mapchecks.valid_changelevel == sv->mapchecks.trigger_changelevel)
+			SV_PrintMapCheck (MAPCHECK_OK, "trigger_changelevel (%s)", sv->mapchecks.changelevel);
 		else
 			SV_PrintMapCheck (MAPCHECK_PARTIAL, "trigger_changelevel (missing \"map\" key)");
 	}
 	else
 	{
-		if (sv.mapchecks.valid_changelevel == sv.mapchecks.trigger_changelevel)
-			SV_PrintMapCheck (MAPCHECK_OK, "trigger_changelevel (%d)", sv.mapchecks.trigger_changelevel);
+		if (sv->mapchecks.valid_changelevel == sv->mapchecks.trigger_changelevel)
+			SV_PrintMapCheck (MAPCHECK_OK, "trigger_changelevel (%d)", sv->mapchecks.trigger_changelevel);
 		else
 			SV_PrintMapCheck (MAPCHECK_PARTIAL, "trigger_changelevel (%d/%d missing \"map\" key)",
-				sv.mapchecks.trigger_changelevel - sv.mapchecks.valid_changelevel,
-				sv.mapchecks.trigger_changelevel
+				sv->mapchecks.trigger_changelevel - sv->mapchecks.valid_changelevel,
+				sv->mapchecks.trigger_changelevel
 			);
 	}
 
 	//
 	// intermission camera
 	//
-	if (!sv.mapchecks.intermission)
+	if (!sv->mapchecks.intermission)
 		SV_PrintMapCheck (MAPCHECK_FAILED, "info_intermission");
 	else
-		SV_PrintMapCheck (MAPCHECK_OK, "info_intermission (%d)", sv.mapchecks.intermission);
+		SV_PrintMapCheck (MAPCHECK_OK, "info_intermission (%d)", sv->mapchecks.intermission);
 
 	//
 	// skill levels
 	//
-	skill_levels = sv.mapchecks.skill_triggers > 0 ||
-		(sv.mapchecks.skill_ents[0] != sv.mapchecks.skill_ents[1] || sv.mapchecks.skill_ents[1] != sv.mapchecks.skill_ents[2]);
+	skill_levels = sv->mapchecks.skill_triggers > 0 ||
+		(sv->mapchecks.skill_ents[0] != sv->mapchecks.skill_ents[1] || sv->mapchecks.skill_ents[1] != sv->mapchecks.skill_ents[2]);
 	SV_PrintMapCheck (skill_levels ? MAPCHECK_OK : MAPCHECK_FAILED, "skill spawnflags/triggers");
 
 	//
 	// coop spawn points
 	//
-	SV_PrintMapCheck (SV_MapCheckThresh (sv.mapchecks.coop_spawns, MIN_COOP_SPAWN_POINTS),
-		"info_player_coop (%d/%d+)", sv.mapchecks.coop_spawns, MIN_COOP_SPAWN_POINTS);
+	SV_PrintMapCheck (SV_MapCheckThresh (sv->mapchecks.coop_spawns, MIN_COOP_SPAWN_POINTS),
+		"info_player_coop (%d/%d+)", sv->mapchecks.coop_spawns, MIN_COOP_SPAWN_POINTS);
 
 	//
 	// deathmatch spawn points
 	//
-	SV_PrintMapCheck (SV_MapCheckThresh (sv.mapchecks.dm_spawns, MIN_DM_SPAWN_POINTS),
-		"info_player_deathmatch (%d/%d+)", sv.mapchecks.dm_spawns, MIN_DM_SPAWN_POINTS);
+	SV_PrintMapCheck (SV_MapCheckThresh (sv->mapchecks.dm_spawns, MIN_DM_SPAWN_POINTS),
+		"info_player_deathmatch (%d/%d+)", sv->mapchecks.dm_spawns, MIN_DM_SPAWN_POINTS);
 
 	//
 	// music track
@@ -1866,11 +2404,11 @@ static void SV_PrintMapChecklist (void)
 	// warn about multiple skies (e.g. "Slip Tripping" / markiesm1.bsp), of which only the last would get rendered in other engines,
 	// and sky textures with non-standard sizes (e.g. "Tears of the False God" / ad_tears.bsp), which could even crash older engines 
 	//
-	numskies = sv.worldmodel->texofs[(int)TEXTYPE_SKY + 1] - sv.worldmodel->texofs[TEXTYPE_SKY];
+	numskies = sv->worldmodel->texofs[(int)TEXTYPE_SKY + 1] - sv->worldmodel->texofs[TEXTYPE_SKY];
 	count = 0;
 	for (i = 0; i < numskies; i++)
 	{
-		texture_t *tex = sv.worldmodel->textures[sv.worldmodel->usedtextures[sv.worldmodel->texofs[TEXTYPE_SKY] + i]];
+		texture_t *tex = sv->worldmodel->textures[sv->worldmodel->usedtextures[sv->worldmodel->texofs[TEXTYPE_SKY] + i]];
 		if (tex->width != 256 || tex->height != 128)
 			count++;
 	}
@@ -1879,7 +2417,7 @@ static void SV_PrintMapChecklist (void)
 		SV_PrintMapCheck (MAPCHECK_FAILED, "compat: single %ssky texture (%d found)", count > 0 ? "256 x 128 " : "", numskies);
 		for (i = 0; i < numskies; i++)
 		{
-			texture_t *tex = sv.worldmodel->textures[sv.worldmodel->usedtextures[sv.worldmodel->texofs[TEXTYPE_SKY] + i]];
+			texture_t *tex = sv->worldmodel->textures[sv->worldmodel->usedtextures[sv->worldmodel->texofs[TEXTYPE_SKY] + i]];
 			if (tex->width != 256 || tex->height != 128)
 				q_snprintf (buf, sizeof (buf), " (%d x %d)", tex->width, tex->height);
 			else
@@ -1925,7 +2463,7 @@ void SV_SpawnServer (const char *server)
 //
 // tell all connected clients that we are going to a new level
 //
-	if (sv.active)
+	if (sv->active)
 	{
 		SV_SendReconnect ();
 	}
@@ -1946,22 +2484,22 @@ void SV_SpawnServer (const char *server)
 //
 // set up the new server
 //
-	//memset (&sv, 0, sizeof(sv));
+	//memset (sv, 0, sizeof(*sv));
 	Host_ClearMemory ();
 
-	q_strlcpy (sv.name, server, sizeof(sv.name));
+	q_strlcpy (sv->name, server, sizeof(sv->name));
 	if (developer.value || map_checks.value)
-		sv.mapchecks.active = true;
+		sv->mapchecks.active = true;
 
-	sv.protocol = sv_protocol; // johnfitz
+	sv->protocol = sv_protocol; // johnfitz
 	
-	if (sv.protocol == PROTOCOL_RMQ)
+	if (sv->protocol == PROTOCOL_RMQ)
 	{
 		// set up the protocol flags used by this server
 		// (note - these could be cvar-ised so that server admins could choose the protocol features used by their servers)
-		sv.protocolflags = PRFL_INT32COORD | PRFL_SHORTANGLE;
+		sv->protocolflags = PRFL_INT32COORD | PRFL_SHORTANGLE;
 	}
-	else sv.protocolflags = 0;
+	else sv->protocolflags = 0;
 
 	PR_SwitchQCVM(vm);
 // load progs to get entity field count
@@ -1969,60 +2507,62 @@ void SV_SpawnServer (const char *server)
 
 // allocate server memory
 	/* Host_ClearMemory() called above already cleared the whole sv structure */
-	qcvm->max_edicts = CLAMP (MIN_EDICTS,(int)max_edicts.value,MAX_EDICTS); //johnfitz -- max_edicts cvar
-	qcvm->edicts = (edict_t *) malloc (qcvm->max_edicts*qcvm->edict_size); // ericw -- sv.edicts switched to use malloc()
-	if (!qcvm->edicts)
-		Sys_Error ("SV_SpawnServer: out of memory (%d edicts x %d bytes)", qcvm->max_edicts, qcvm->edict_size);
+	ED_AllocEdictStore (CLAMP (MIN_EDICTS,(int)max_edicts.value,MAX_EDICTS), svs.maxclients+1); //johnfitz -- max_edicts cvar
 	ClearLink (&qcvm->free_edicts);
+	if (qcvm->max_edicts > 0x8000 && sv->protocol == PROTOCOL_RMQ)
+		sv->protocolflags |= PRFL_LARGEEDICTS;
 
-	sv.datagram.maxsize = sizeof(sv.datagram_buf);
-	sv.datagram.cursize = 0;
-	sv.datagram.data = sv.datagram_buf;
+	sv->datagram.maxsize = sizeof(sv->datagram_buf);
+	sv->datagram.cursize = 0;
+	sv->datagram.data = sv->datagram_buf;
 
-	sv.reliable_datagram.maxsize = sizeof(sv.reliable_datagram_buf);
-	sv.reliable_datagram.cursize = 0;
-	sv.reliable_datagram.data = sv.reliable_datagram_buf;
+	sv->reliable_datagram.maxsize = sizeof(sv->reliable_datagram_buf);
+	sv->reliable_datagram.cursize = 0;
+	sv->reliable_datagram.data = sv->reliable_datagram_buf;
 
 	SV_AddSignonBuffer ();
 
 // leave slots at start for clients only
 	qcvm->num_edicts = svs.maxclients+1;
-	memset(qcvm->edicts, 0, qcvm->num_edicts*qcvm->edict_size); // ericw -- sv.edicts switched to use malloc()
+	memset(qcvm->edicts, 0, qcvm->num_edicts*qcvm->edict_size); // ericw -- sv->edicts switched to use malloc()
 	for (i=0 ; i<svs.maxclients ; i++)
 	{
 		ent = EDICT_NUM(i+1);
 		svs.clients[i].edict = ent;
 	}
 
-	sv.state = ss_loading;
-	sv.paused = false;
-	sv.nomonsters = (nomonsters.value != 0.f);
+	sv->state = ss_loading;
+	sv->paused = false;
+	sv->nomonsters = (nomonsters.value != 0.f);
 
 	qcvm->time = 1.0;
 
-	q_strlcpy (sv.name, server, sizeof(sv.name));
-	q_snprintf (sv.modelname, sizeof(sv.modelname), "maps/%s.bsp", server);
-	sv.worldmodel = Mod_ForName (sv.modelname, false);
-	if (!sv.worldmodel)
+	q_strlcpy (sv->name, server, sizeof(sv->name));
+	q_snprintf (sv->modelname, sizeof(sv->modelname), "maps/%s.bsp", server);
+	sv->worldmodel = Mod_ForName (sv->modelname, false);
+	if (!sv->worldmodel)
 	{
-		Con_Printf ("Couldn't spawn server %s\n", sv.modelname);
-		sv.active = false;
+		Con_Printf ("Couldn't spawn server %s\n", sv->modelname);
+		sv->active = false;
 		return;
 	}
-	sv.models[1] = sv.worldmodel;
+	sv->models[1] = sv->worldmodel;
+	Mod_Reference (sv->worldmodel);
 
 //
 // clear world interaction links
 //
 	SV_ClearWorld ();
+	SV_LagCompClear ();
 
-	sv.sound_precache[0] = dummy;
-	sv.model_precache[0] = dummy;
-	sv.model_precache[1] = sv.modelname;
-	for (i=1 ; i<sv.worldmodel->numsubmodels ; i++)
+	sv->sound_precache[0] = dummy;
+	sv->model_precache[0] = dummy;
+	sv->model_precache[1] = sv->modelname;
+	for (i=1 ; i<sv->worldmodel->numsubmodels ; i++)
 	{
-		sv.model_precache[1+i] = localmodels[i];
-		sv.models[i+1] = Mod_ForName (localmodels[i], false);
+		sv->model_precache[1+i] = localmodels[i];
+		sv->models[i+1] = Mod_ForSubmodel (sv->worldmodel, i);
+		Mod_Reference (sv->models[i+1]);
 	}
 
 //
@@ -2030,7 +2570,7 @@ void SV_SpawnServer (const char *server)
 //
 	ent = EDICT_NUM(0);
 	memset (&ent->v, 0, qcvm->progs->entityfields * 4);
-	ent->v.model = PR_SetEngineString(sv.worldmodel->name);
+	ent->v.model = PR_SetEngineString(sv->worldmodel->name);
 	ent->v.modelindex = 1;		// world model
 	ent->v.solid = SOLID_BSP;
 	ent->v.movetype = MOVETYPE_PUSH;
@@ -2040,17 +2580,17 @@ void SV_SpawnServer (const char *server)
 	else
 		pr_global_struct->deathmatch = deathmatch.value;
 
-	pr_global_struct->mapname = PR_SetEngineString(sv.name);
+	pr_global_struct->mapname = PR_SetEngineString(sv->name);
 
 // serverflags are for cross level information (sigils)
 	pr_global_struct->serverflags = svs.serverflags;
 
-	ED_LoadFromFile (sv.worldmodel->entities);
+	ED_LoadFromFile (sv->worldmodel->entities);
 
-	sv.active = true;
+	sv->active = true;
 
 // all setup is completed, any further precache statements are errors
-	sv.state = ss_active;
+	sv->state = ss_active;
 
 // run two frames to allow everything to settle
 	host_frametime = 0.1;
@@ -2061,8 +2601,8 @@ void SV_SpawnServer (const char *server)
 	SV_CreateBaseline ();
 
 	//johnfitz -- warn if signon buffer larger than standard server can handle
-	for (i = 0, signonsize = 0; i < sv.num_signon_buffers; i++)
-		signonsize += sv.signon_buffers[i]->cursize;
+	for (i = 0, signonsize = 0; i < sv->num_signon_buffers; i++)
+		signonsize += sv->signon_buffers[i]->cursize;
 	if (signonsize > 64000-2)
 		Con_DWarning ("%i byte signon buffer exceeds QS limit of 63998.\n", signonsize);
 	else if (signonsize > 8000-2) //max size that will fit into 8000-sized client->message buffer with 2 extra bytes on the end
@@ -2076,7 +2616,7 @@ void SV_SpawnServer (const char *server)
 
 	Con_DPrintf ("Server spawned.\n");
 
-	if (sv.mapchecks.active)
+	if (sv->mapchecks.active)
 		SV_PrintMapChecklist ();
 }
 
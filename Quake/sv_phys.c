@@ -431,14 +431,17 @@ SV_PushMove
 ============
 */
 cvar_t sv_gameplayfix_elevators = {"sv_gameplayfix_elevators", "2", CVAR_ARCHIVE}; // 0=off; 1=clients only; 2=all entities
+cvar_t sv_pushbroadphase = {"sv_pushbroadphase", "1", CVAR_NONE}; // 0=scan all edicts for every pusher
 void SV_PushMove (edict_t *pusher, float movetime)
 {
 	int			i, e;
 	edict_t		*check, *block;
 	vec4_t		mins, maxs, move;
 	vec3_t		entorig, pushorig;
+	vec3_t		sweptmins, sweptmaxs;
 	float		solid_backup;
-	int			num_moved;
+	int			num_moved, num_check, checkidx;
+	int			*check_nums;
 	edict_t		**moved_edict; //johnfitz -- dynamically allocate
 	vec3_t		*moved_from; //johnfitz -- dynamically allocate
 	int			mark; //johnfitz
@@ -468,15 +471,37 @@ void SV_PushMove (edict_t *pusher, float movetime)
 	mark = Hunk_LowMark ();
 	moved_edict = (edict_t **) Hunk_AllocNoFill (qcvm->num_edicts*sizeof(edict_t *));
 	moved_from = (vec3_t *) Hunk_AllocNoFill (qcvm->num_edicts*sizeof(vec3_t));
+	check_nums = (int *) Hunk_AllocNoFill (qcvm->num_edicts*sizeof(int));
 	//johnfitz
 
+// gather the candidates in edict order: either everything linked in the
+// volume swept by the pusher (which includes anything standing on it),
+// or every edict if the broad-phase is disabled
+	if (sv_pushbroadphase.value)
+	{
+		for (i=0 ; i<3 ; i++)
+		{
+			sweptmins[i] = q_min (mins[i], mins[i] - move[i]);
+			sweptmaxs[i] = q_max (maxs[i], maxs[i] - move[i]);
+		}
+		num_check = SV_AreaEdicts (sweptmins, sweptmaxs, check_nums, qcvm->num_edicts);
+	}
+	else
+	{
+		for (num_check=0 ; num_check<qcvm->num_edicts-1 ; num_check++)
+			check_nums[num_check] = num_check + 1;
+	}
+
 // see if any solid entities are inside the final position
 	num_moved = 0;
-	check = NEXT_EDICT(qcvm->edicts);
-	for (e=1 ; e<qcvm->num_edicts ; e++, check = NEXT_EDICT(check))
+	for (checkidx=0 ; checkidx<num_check ; checkidx++)
 	{
 		qboolean riding;
 		int movemask;
+		e = check_nums[checkidx];
+		if (e <= 0 || e >= qcvm->num_edicts)
+			continue;
+		check = EDICT_NUM(e);
 		if (check->free)
 			continue;
 		movemask = 1 << (int)check->v.movetype;
@@ -1247,7 +1272,7 @@ void SV_Physics (void)
 	else
 	  entity_cap = qcvm->num_edicts;
 
-	//for (i=0 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
+	//for (i=0 ; i<sv->num_edicts ; i++, ent = NEXT_EDICT(ent))
 	for (i=0 ; i<entity_cap ; i++, ent = NEXT_EDICT(ent))
 	{
 		if (ent->free)
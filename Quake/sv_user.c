@@ -442,17 +442,18 @@ void SV_ReadClientMove (usercmd_t *move)
 	int		bits;
 
 // read ping time
+	host_client->lagtime = MSG_ReadFloat ();
 	host_client->ping_times[host_client->num_pings%NUM_PING_TIMES]
-		= qcvm->time - MSG_ReadFloat ();
+		= qcvm->time - host_client->lagtime;
 	host_client->num_pings++;
 
 // read current angles
 	for (i=0 ; i<3 ; i++)
 		//johnfitz -- 16-bit angles for PROTOCOL_FITZQUAKE
-		if (sv.protocol == PROTOCOL_NETQUAKE)
-			angle[i] = MSG_ReadAngle (sv.protocolflags);
+		if (sv->protocol == PROTOCOL_NETQUAKE)
+			angle[i] = MSG_ReadAngle (sv->protocolflags);
 		else
-			angle[i] = MSG_ReadAngle16 (sv.protocolflags);
+			angle[i] = MSG_ReadAngle16 (sv->protocolflags);
 		//johnfitz
 
 	VectorCopy (angle, host_client->edict->v.v_angle);
@@ -588,6 +589,10 @@ nextmsg:
 					ret = 1;
 				else if (q_strncasecmp(s, "ban", 3) == 0)
 					ret = 1;
+				else if (q_strncasecmp(s, "predict", 7) == 0)
+					ret = 1;
+				else if (q_strncasecmp(s, "entkeep", 7) == 0)
+					ret = 1;
 
 				if (ret == 1)
 					Cmd_ExecuteString (s, src_client);
@@ -602,6 +607,10 @@ nextmsg:
 			case clc_move:
 				SV_ReadClientMove (&host_client->cmd);
 				break;
+
+			case clc_moveseq:
+				host_client->moveseq = MSG_ReadLong ();
+				break;
 			}
 		}
 	} while (ret == 1);
@@ -640,7 +649,7 @@ void SV_RunClients (void)
 		}
 
 // always pause in single player if in console or menus
-		if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
+		if (!sv->paused && (svs.maxclients > 1 || key_dest == key_game) )
 			SV_ClientThink ();
 	}
 }
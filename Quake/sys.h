@@ -114,6 +114,13 @@ int Sys_FileType (const char *path);
 
 qboolean Sys_IsDebuggerPresent (void);
 
+// reserves address space without backing it with memory, returns NULL on failure
+void *Sys_ReserveMemory (size_t size);
+// makes the first size bytes of a reservation usable (zero-filled), can be called again with a larger size
+qboolean Sys_CommitMemory (void *base, size_t size);
+// releases a whole reservation
+void Sys_ReleaseMemory (void *base, size_t size);
+
 void *Sys_LoadLibrary (const char *path);
 void *Sys_GetLibraryFunction (void *lib, const char *func);
 void Sys_CloseLibrary (void *lib);
@@ -149,6 +156,15 @@ const char *Sys_ConsoleInput (void);
 void Sys_Sleep (unsigned long msecs);
 // yield for about 'msecs' milliseconds.
 
+qboolean Sys_StartTicker (double interval);
+// arm a periodic timer for the dedicated server frame loop.
+// returns false if the platform has none, in which case the caller polls.
+
+int Sys_WaitTicker (double idletimeout);
+// block until the next tick and return the number of ticks elapsed.
+// if idletimeout > 0, ignore ticks and instead sleep for up to idletimeout
+// seconds or until a listen socket or the console becomes readable.
+
 void Sys_SendKeyEvents (void);
 // Perform Key_Event () callbacks until the input que is empty
 
@@ -39,6 +39,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <dirent.h>
 #include <pwd.h>
 #include <dlfcn.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <stdint.h>
+#endif
 
 #if defined(SDL_FRAMEWORK) || defined(NO_SDL_CONFIG)
 #if defined(USE_SDL2)
@@ -850,6 +856,12 @@ void Sys_ReportError (const char *error, ...)
 	q_vsnprintf (text, sizeof(text), error, argptr);
 	va_end (argptr);
 
+	// get the error into the log before attempting shutdown
+	Con_DebugLog ("QUAKE ERROR: ");
+	Con_DebugLog (text);
+	Con_DebugLog ("\n");
+	LOG_Flush ();
+
 	fputs (errortxt1, stderr);
 	Host_Shutdown ();
 	fputs (errortxt2, stderr);
@@ -954,6 +966,99 @@ void Sys_Sleep (unsigned long msecs)
 	SDL_Delay (msecs);
 }
 
+#if defined(__linux__)
+#include "net_sys.h"
+#include "net_defs.h"
+
+static int ticker_fd = -1;
+
+qboolean Sys_StartTicker (double interval)
+{
+	struct itimerspec its;
+
+	if (interval <= 0.0)
+		return false;
+
+	if (ticker_fd == -1)
+	{
+		ticker_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (ticker_fd == -1)
+		{
+			Sys_Printf ("timerfd_create failed: %s\n", strerror (errno));
+			return false;
+		}
+	}
+
+	its.it_interval.tv_sec = (time_t) interval;
+	its.it_interval.tv_nsec = (long) ((interval - its.it_interval.tv_sec) * 1e9);
+	if (!its.it_interval.tv_sec && !its.it_interval.tv_nsec)
+		its.it_interval.tv_nsec = 1;
+	its.it_value = its.it_interval;
+
+	if (timerfd_settime (ticker_fd, 0, &its, NULL) == -1)
+	{
+		Sys_Printf ("timerfd_settime failed: %s\n", strerror (errno));
+		close (ticker_fd);
+		ticker_fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+int Sys_WaitTicker (double idletimeout)
+{
+	struct pollfd	fds[MAX_NET_DRIVERS + 1];
+	sys_socket_t	sockets[MAX_NET_DRIVERS];
+	int		i, count, numsockets;
+	uint64_t	expirations;
+
+	count = 0;
+	if (idletimeout > 0.0)
+	{
+		numsockets = NET_GetListenSockets (sockets, MAX_NET_DRIVERS);
+		for (i = 0; i < numsockets; i++)
+		{
+			fds[count].fd = sockets[i];
+			fds[count].events = POLLIN;
+			count++;
+		}
+		if (stdinIsATTY)
+		{
+			fds[count].fd = STDIN_FILENO;
+			fds[count].events = POLLIN;
+			count++;
+		}
+		if (poll (fds, count, (int) (idletimeout * 1000.0)) == -1 && errno != EINTR)
+			Sys_Error ("Sys_WaitTicker: poll failed: %s", strerror (errno));
+	}
+	else
+	{
+		fds[0].fd = ticker_fd;
+		fds[0].events = POLLIN;
+		while (poll (fds, 1, -1) == -1)
+			if (errno != EINTR)
+				Sys_Error ("Sys_WaitTicker: poll failed: %s", strerror (errno));
+	}
+
+	// drain the timer so it doesn't stay readable
+	if (read (ticker_fd, &expirations, sizeof (expirations)) != sizeof (expirations))
+		return 0;
+
+	return (int) q_min (expirations, (uint64_t) INT_MAX);
+}
+#else
+qboolean Sys_StartTicker (double interval)
+{
+	return false;
+}
+
+int Sys_WaitTicker (double idletimeout)
+{
+	return 0;
+}
+#endif
+
 void Sys_SendKeyEvents (void)
 {
 	IN_Commands();		//ericw -- allow joysticks to add keys so they can be used to confirm SCR_ModalMessage
@@ -964,6 +1069,25 @@ void Sys_ActivateKeyFilter (qboolean active)
 {
 }
 
+void *Sys_ReserveMemory (size_t size)
+{
+	void *base = mmap (NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	return base == MAP_FAILED ? NULL : base;
+}
+
+qboolean Sys_CommitMemory (void *base, size_t size)
+{
+	size_t page = (size_t) sysconf (_SC_PAGESIZE);
+	size = (size + page - 1) & ~(page - 1);
+	return mprotect (base, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void Sys_ReleaseMemory (void *base, size_t size)
+{
+	if (base)
+		munmap (base, size);
+}
+
 void *Sys_LoadLibrary (const char *path)
 {
 	return dlopen (path, RTLD_LAZY);
@@ -1055,6 +1055,12 @@ void Sys_ReportError (const char *error, ...)
 
 	PR_SwitchQCVM(NULL);
 
+	// get the error into the log before attempting shutdown
+	Con_DebugLog ("QUAKE ERROR: ");
+	Con_DebugLog (text);
+	Con_DebugLog ("\n");
+	LOG_Flush ();
+
 	if (!MultiByteToWideChar (CP_UTF8, 0, text, -1, wtext, countof (wtext)))
 		wcscpy (wtext, L"An unknown error has occurred");
 
@@ -1202,6 +1208,16 @@ void Sys_Sleep (unsigned long msecs)
 	SDL_Delay (msecs);
 }
 
+qboolean Sys_StartTicker (double interval)
+{
+	return false;
+}
+
+int Sys_WaitTicker (double idletimeout)
+{
+	return 0;
+}
+
 void Sys_SendKeyEvents (void)
 {
 	IN_Commands();		//ericw -- allow joysticks to add keys so they can be used to confirm SCR_ModalMessage
@@ -1226,6 +1242,22 @@ void Sys_ActivateKeyFilter (qboolean active)
 	}
 }
 
+void *Sys_ReserveMemory (size_t size)
+{
+	return VirtualAlloc (NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+qboolean Sys_CommitMemory (void *base, size_t size)
+{
+	return VirtualAlloc (base, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void Sys_ReleaseMemory (void *base, size_t size)
+{
+	if (base)
+		VirtualFree (base, 0, MEM_RELEASE);
+}
+
 void *Sys_LoadLibrary (const char *path)
 {
 	wchar_t wpath[MAX_PATH];
@@ -46,6 +46,11 @@ typedef struct
 
 
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
+static int SV_LegacyPointContents (hull_t *hull, int num, vec3_t p);
+static void SV_ResetTraceCache (void);
+
+cvar_t	sv_hulltrace = {"sv_hulltrace", "1", CVAR_NONE};	// 0 = recursive, 1 = compiled, 2 = compiled and verified
+cvar_t	sv_tracecache = {"sv_tracecache", "1", CVAR_NONE};
 
 /*
 ===============================================================================
@@ -59,6 +64,7 @@ HULL BOXES
 static	hull_t		box_hull;
 static	mclipnode_t	box_clipnodes[6]; //johnfitz -- was dclipnode_t
 static	mplane_t	box_planes[6];
+static	mhullnode_t	box_nodes[6];
 
 /*
 ===================
@@ -75,6 +81,7 @@ void SV_InitBoxHull (void)
 
 	box_hull.clipnodes = box_clipnodes;
 	box_hull.planes = box_planes;
+	box_hull.nodes = box_nodes;
 	box_hull.firstclipnode = 0;
 	box_hull.lastclipnode = 5;
 
@@ -92,6 +99,11 @@ void SV_InitBoxHull (void)
 
 		box_planes[i].type = i>>1;
 		box_planes[i].normal[i>>1] = 1;
+
+		VectorCopy (box_planes[i].normal, box_nodes[i].normal);
+		box_nodes[i].type = box_planes[i].type;
+		box_nodes[i].children[0] = box_clipnodes[i].children[0];
+		box_nodes[i].children[1] = box_clipnodes[i].children[1];
 	}
 
 }
@@ -114,6 +126,13 @@ hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
 	box_planes[4].dist = maxs[2];
 	box_planes[5].dist = mins[2];
 
+	box_nodes[0].dist = maxs[0];
+	box_nodes[1].dist = mins[0];
+	box_nodes[2].dist = maxs[1];
+	box_nodes[3].dist = mins[1];
+	box_nodes[4].dist = maxs[2];
+	box_nodes[5].dist = mins[2];
+
 	return &box_hull;
 }
 
@@ -143,7 +162,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 			Host_Error ("SOLID_BSP without MOVETYPE_PUSH (%s at %f %f %f)",
 				    PR_GetString(ent->v.classname), ent->v.origin[0], ent->v.origin[1], ent->v.origin[2]);
 
-		model = sv.models[ (int)ent->v.modelindex ];
+		model = sv->models[ (int)ent->v.modelindex ];
 
 		if (!model || model->type != mod_brush)
 			Host_Error ("SOLID_BSP with a non bsp model (%s at %f %f %f)",
@@ -190,14 +209,18 @@ typedef struct areanode_s
 	struct areanode_s	*children[2];
 	link_t	trigger_edicts;
 	link_t	solid_edicts;
+	link_t	nonsolid_edicts;	// only used by SV_AreaEdicts
 } areanode_t;
 
 // Note: changing this can affect droptofloor
 #define	AREA_DEPTH	4
 #define	AREA_NODES	(2<<AREA_DEPTH)
 
-static	areanode_t	sv_areanodes[AREA_NODES];
-static	int			sv_numareanodes;
+static	areanode_t	sv_areanodes_all[MAX_SV_INSTANCES][AREA_NODES];	// one tree per server instance
+static	int			sv_numareanodes_all[MAX_SV_INSTANCES];
+
+#define	sv_areanodes	sv_areanodes_all[sv_instance]
+#define	sv_numareanodes	sv_numareanodes_all[sv_instance]
 
 /*
 ===============
@@ -216,6 +239,7 @@ areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 
 	ClearLink (&anode->trigger_edicts);
 	ClearLink (&anode->solid_edicts);
+	ClearLink (&anode->nonsolid_edicts);
 
 	if (depth == AREA_DEPTH)
 	{
@@ -256,7 +280,9 @@ void SV_ClearWorld (void)
 
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
-	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+	SV_CreateAreaNode (0, sv->worldmodel->mins, sv->worldmodel->maxs);
+
+	SV_ResetTraceCache ();
 }
 
 
@@ -380,6 +406,84 @@ void SV_TouchLinks (edict_t *ent)
 }
 
 
+/*
+====================
+SV_AreaEdictsInList
+====================
+*/
+static void SV_AreaEdictsInList (const link_t *list, const vec3_t mins, const vec3_t maxs, int *nums, int *count, int maxcount)
+{
+	const link_t	*l;
+	edict_t			*check;
+
+	for (l = list->next ; l != list ; l = l->next)
+	{
+		check = EDICT_FROM_AREA(l);
+		if ( check->v.absmin[0] >= maxs[0]
+		|| check->v.absmin[1] >= maxs[1]
+		|| check->v.absmin[2] >= maxs[2]
+		|| check->v.absmax[0] <= mins[0]
+		|| check->v.absmax[1] <= mins[1]
+		|| check->v.absmax[2] <= mins[2] )
+			continue;
+
+		if (*count == maxcount)
+			return; // should never happen
+
+		nums[(*count)++] = NUM_FOR_EDICT (check);
+	}
+}
+
+/*
+====================
+SV_AreaEdictsInNode
+====================
+*/
+static void SV_AreaEdictsInNode (const areanode_t *node, const vec3_t mins, const vec3_t maxs, int *nums, int *count, int maxcount)
+{
+	SV_AreaEdictsInList (&node->solid_edicts, mins, maxs, nums, count, maxcount);
+	SV_AreaEdictsInList (&node->trigger_edicts, mins, maxs, nums, count, maxcount);
+	SV_AreaEdictsInList (&node->nonsolid_edicts, mins, maxs, nums, count, maxcount);
+
+// recurse down both sides
+	if (node->axis == -1)
+		return;
+
+	if (maxs[node->axis] > node->dist)
+		SV_AreaEdictsInNode (node->children[0], mins, maxs, nums, count, maxcount);
+	if (mins[node->axis] < node->dist)
+		SV_AreaEdictsInNode (node->children[1], mins, maxs, nums, count, maxcount);
+}
+
+/*
+====================
+SV_CompareEdictNums
+====================
+*/
+int SV_CompareEdictNums (const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+====================
+SV_AreaEdicts
+
+Fills nums with the numbers of all the linked edicts (regardless of solidity)
+whose absmin/absmax overlap the given box, sorted by edict number
+so callers see them in the same order as a linear scan would.
+====================
+*/
+int SV_AreaEdicts (const vec3_t mins, const vec3_t maxs, int *nums, int maxcount)
+{
+	int count = 0;
+
+	SV_AreaEdictsInNode (sv_areanodes, mins, maxs, nums, &count, maxcount);
+	qsort (nums, count, sizeof (nums[0]), SV_CompareEdictNums);
+
+	return count;
+}
+
 /*
 ===============
 SV_FindTouchedLeafs
@@ -404,7 +508,7 @@ void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
 	if ( node->contents < 0)
 	{
 		leaf = (mleaf_t *)node;
-		leafnum = leaf - sv.worldmodel->leafs - 1;
+		leafnum = leaf - sv->worldmodel->leafs - 1;
 
 		ent->leafnums[ent->num_leafs] = leafnum;
 		ent->num_leafs++;
@@ -442,7 +546,7 @@ qboolean SV_BoxInPVS (vec3_t mins, vec3_t maxs, byte *pvs, mnode_t *node)
 	if (node->contents < 0)
 	{
 		leaf = (mleaf_t *)node;
-		leafnum = leaf - sv.worldmodel->leafs - 1;
+		leafnum = leaf - sv->worldmodel->leafs - 1;
 		return pvs[leafnum >> 3] & (1 << (leafnum & 7));
 	}
 
@@ -472,7 +576,11 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 		SV_UnlinkEdict (ent);	// unlink from old position
 
 	if (ent == qcvm->edicts)
+	{
+		if (qcvm == &sv->qcvm)
+			SV_InvalidateTraceCache ();	// cached world clips may be stale
 		return;		// don't add the world
+	}
 
 	if (ent->free)
 		return;
@@ -506,10 +614,7 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 // link to PVS leafs
 	ent->num_leafs = 0;
 	if (ent->v.modelindex)
-		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
-
-	if (ent->v.solid == SOLID_NOT)
-		return;
+		SV_FindTouchedLeafs (ent, sv->worldmodel->nodes);
 
 // find the first node that the ent's box crosses
 	node = sv_areanodes;
@@ -527,6 +632,13 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 
 // link it in
 
+	if (ent->v.solid == SOLID_NOT)
+	{
+		// not clipped against, but still needs to be found by pushers
+		InsertLinkBefore (&ent->area, &node->nonsolid_edicts);
+		return;
+	}
+
 	if (ent->v.solid == SOLID_TRIGGER)
 		InsertLinkBefore (&ent->area, &node->trigger_edicts);
 	else
@@ -547,6 +659,34 @@ POINT TESTING IN HULLS
 ===============================================================================
 */
 
+/*
+==================
+SV_CompiledPointContents
+
+Same as SV_LegacyPointContents, using the hull's compiled nodes
+==================
+*/
+static int SV_CompiledPointContents (const hull_t *hull, int num, const vec3_t p)
+{
+	const mhullnode_t	*node;
+	float				d;
+
+	while (num >= 0)
+	{
+		if (num < hull->firstclipnode || num > hull->lastclipnode)
+			Sys_Error ("SV_HullPointContents: bad node number");
+
+		node = hull->nodes + num;
+		if (node->type < 3)
+			d = p[node->type] - node->dist;
+		else
+			d = DoublePrecisionDotProduct (node->normal, p) - node->dist;
+		num = node->children[d < 0];
+	}
+
+	return num;
+}
+
 /*
 ==================
 SV_HullPointContents
@@ -554,6 +694,19 @@ SV_HullPointContents
 ==================
 */
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
+{
+	if (hull->nodes && sv_hulltrace.value)
+		return SV_CompiledPointContents (hull, num, p);
+	return SV_LegacyPointContents (hull, num, p);
+}
+
+/*
+==================
+SV_LegacyPointContents
+
+==================
+*/
+static int SV_LegacyPointContents (hull_t *hull, int num, vec3_t p)
 {
 	float		d;
 	mclipnode_t	*node; //johnfitz -- was dclipnode_t
@@ -591,7 +744,7 @@ int SV_PointContents (vec3_t p)
 {
 	int		cont;
 
-	cont = SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	cont = SV_HullPointContents (&sv->worldmodel->hulls[0], 0, p);
 	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
 		cont = CONTENTS_WATER;
 	return cont;
@@ -599,7 +752,7 @@ int SV_PointContents (vec3_t p)
 
 int SV_TruePointContents (vec3_t p)
 {
-	return SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	return SV_HullPointContents (&sv->worldmodel->hulls[0], 0, p);
 }
 
 //===========================================================================
@@ -718,7 +871,7 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 		return false;
 
 #ifdef PARANOID
-	if (SV_HullPointContents (sv_hullmodel, mid, node->children[side])
+	if (SV_LegacyPointContents (sv_hullmodel, mid, node->children[side])
 	== CONTENTS_SOLID)
 	{
 		Con_Printf ("mid PointInHullSolid\n");
@@ -726,7 +879,7 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 	}
 #endif
 
-	if (SV_HullPointContents (hull, node->children[side^1], mid)
+	if (SV_LegacyPointContents (hull, node->children[side^1], mid)
 	!= CONTENTS_SOLID)
 // go past the node
 		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
@@ -748,7 +901,7 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 		trace->plane.dist = -plane->dist;
 	}
 
-	while (SV_HullPointContents (hull, hull->firstclipnode, mid)
+	while (SV_LegacyPointContents (hull, hull->firstclipnode, mid)
 	== CONTENTS_SOLID)
 	{ // shouldn't really happen, but does occasionally
 		frac -= 0.1;
@@ -771,6 +924,316 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 }
 
 
+#define	HULL_STACK_SIZE		64
+
+// a segment split by a node, waiting for its near side to be traced
+typedef struct
+{
+	int			num;
+	int			side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} hullframe_t;
+
+/*
+==================
+SV_HullImpact
+
+The far side of the split in frame is solid: fill in the impact point
+==================
+*/
+static qboolean SV_HullImpact (const hull_t *hull, hullframe_t *frame, trace_t *trace)
+{
+	const mhullnode_t	*node = hull->nodes + frame->num;
+	int					i;
+
+	if (trace->allsolid)
+		return false;		// never got out of the solid area
+
+	if (!frame->side)
+	{
+		VectorCopy (node->normal, trace->plane.normal);
+		trace->plane.dist = node->dist;
+	}
+	else
+	{
+		VectorSubtract (vec3_origin, node->normal, trace->plane.normal);
+		trace->plane.dist = -node->dist;
+	}
+
+	while (SV_CompiledPointContents (hull, hull->firstclipnode, frame->mid)
+	== CONTENTS_SOLID)
+	{ // shouldn't really happen, but does occasionally
+		frame->frac -= 0.1;
+		if (frame->frac < 0)
+		{
+			trace->fraction = frame->midf;
+			VectorCopy (frame->mid, trace->endpos);
+			Con_DPrintf ("backup past 0\n");
+			return false;
+		}
+		frame->midf = frame->p1f + (frame->p2f - frame->p1f)*frame->frac;
+		for (i=0 ; i<3 ; i++)
+			frame->mid[i] = frame->p1[i] + frame->frac*(frame->p2[i] - frame->p1[i]);
+	}
+
+	trace->fraction = frame->midf;
+	VectorCopy (frame->mid, trace->endpos);
+
+	return false;
+}
+
+/*
+==================
+SV_HullTrace
+
+Non-recursive version of SV_RecursiveHullCheck over the hull's compiled
+nodes. The arithmetic is kept identical, so results match bit for bit
+(see sv_hulltrace 2). With SSE2, the distances of both end points to a
+non-axial plane are computed together in double precision.
+==================
+*/
+qboolean SV_HullTrace (hull_t *hull, int num, float p1f, float p2f, vec3_t p1in, vec3_t p2in, trace_t *trace)
+{
+	hullframe_t			stack[HULL_STACK_SIZE];
+	hullframe_t			overflow, *frame;
+	const mhullnode_t	*node;
+	int					depth, i;
+	float				t1, t2;
+	vec3_t				p1, p2;
+
+	VectorCopy (p1in, p1);
+	VectorCopy (p2in, p2);
+	depth = 0;
+
+	for (;;)
+	{
+	// descend to a leaf, splitting the segment at every node it crosses
+		while (num >= 0)
+		{
+			if (num < hull->firstclipnode || num > hull->lastclipnode)
+				Sys_Error ("SV_RecursiveHullCheck: bad node number");
+
+			node = hull->nodes + num;
+			if (node->type < 3)
+			{
+				t1 = p1[node->type] - node->dist;
+				t2 = p2[node->type] - node->dist;
+			}
+			else
+			{
+#ifdef USE_SSE2
+				__m128d d =		  _mm_mul_pd (_mm_set1_pd (node->normal[0]), _mm_set_pd (p2[0], p1[0]));
+				d = _mm_add_pd (d, _mm_mul_pd (_mm_set1_pd (node->normal[1]), _mm_set_pd (p2[1], p1[1])));
+				d = _mm_add_pd (d, _mm_mul_pd (_mm_set1_pd (node->normal[2]), _mm_set_pd (p2[2], p1[2])));
+				d = _mm_sub_pd (d, _mm_set1_pd (node->dist));
+				t1 = (float) _mm_cvtsd_f64 (d);
+				t2 = (float) _mm_cvtsd_f64 (_mm_unpackhi_pd (d, d));
+#else
+				t1 = DoublePrecisionDotProduct (node->normal, p1) - node->dist;
+				t2 = DoublePrecisionDotProduct (node->normal, p2) - node->dist;
+#endif
+			}
+
+			if (t1 >= 0 && t2 >= 0)
+			{
+				num = node->children[0];
+				continue;
+			}
+			if (t1 < 0 && t2 < 0)
+			{
+				num = node->children[1];
+				continue;
+			}
+
+			frame = depth < HULL_STACK_SIZE ? &stack[depth++] : &overflow;
+			frame->num = num;
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+			if (t1 < 0)
+				frame->frac = (t1 + DIST_EPSILON)/(t1-t2);
+			else
+				frame->frac = (t1 - DIST_EPSILON)/(t1-t2);
+			if (frame->frac < 0)
+				frame->frac = 0;
+			if (frame->frac > 1)
+				frame->frac = 1;
+
+			frame->p1f = p1f;
+			frame->p2f = p2f;
+			frame->midf = p1f + (p2f - p1f)*frame->frac;
+			for (i=0 ; i<3 ; i++)
+				frame->mid[i] = p1[i] + frame->frac*(p2[i] - p1[i]);
+			VectorCopy (p1, frame->p1);
+			VectorCopy (p2, frame->p2);
+
+			frame->side = (t1 < 0);
+
+			if (frame == &overflow)
+			{
+			// unusually deep tree, let the recursive version handle the near side
+				if (!SV_RecursiveHullCheck (hull, node->children[frame->side], p1f, frame->midf, p1, frame->mid, trace))
+					return false;
+				goto farside;
+			}
+
+		// move up to the node
+			num = node->children[frame->side];
+			p2f = frame->midf;
+			VectorCopy (frame->mid, p2);
+		}
+
+	// check for empty
+		if (num != CONTENTS_SOLID)
+		{
+			trace->allsolid = false;
+			if (num == CONTENTS_EMPTY)
+				trace->inopen = true;
+			else
+				trace->inwater = true;
+		}
+		else
+			trace->startsolid = true;
+
+		if (!depth)
+			return true;
+		frame = &stack[--depth];
+
+	farside:
+		num = hull->nodes[frame->num].children[frame->side^1];
+		if (SV_CompiledPointContents (hull, num, frame->mid) == CONTENTS_SOLID)
+			return SV_HullImpact (hull, frame, trace);
+
+	// go past the node
+		p1f = frame->midf;
+		p2f = frame->p2f;
+		VectorCopy (frame->mid, p1);
+		VectorCopy (frame->p2, p2);
+	}
+}
+
+/*
+==================
+SV_TraceHull
+
+Traces a line through a hull with the implementation selected by sv_hulltrace
+==================
+*/
+static void SV_TraceHull (hull_t *hull, vec3_t start, vec3_t end, trace_t *trace)
+{
+	trace_t		check;
+
+	if (!hull->nodes || !sv_hulltrace.value)
+	{
+		SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start, end, trace);
+		return;
+	}
+
+	if (sv_hulltrace.value >= 2)
+		check = *trace;
+
+	SV_HullTrace (hull, hull->firstclipnode, 0, 1, start, end, trace);
+
+	if (sv_hulltrace.value >= 2)
+	{
+		SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start, end, &check);
+		if (memcmp (&check, trace, sizeof (check)) != 0)
+			Con_Printf ("sv_hulltrace: mismatch tracing (%g %g %g)-(%g %g %g): fraction %g vs %g\n",
+				start[0], start[1], start[2], end[0], end[1], end[2], trace->fraction, check.fraction);
+	}
+}
+
+/*
+==================
+SV_BenchTrace_f
+
+Times random traces through the world's hulls with both implementations
+==================
+*/
+void SV_BenchTrace_f (void)
+{
+	int			i, h, count, mismatches;
+	float		*rays, *r;
+	double		start, recursive, compiled;
+	hull_t		*hull;
+	trace_t		a, b;
+	qmodel_t	*world = sv->worldmodel;
+
+	if (!sv->active || !world)
+	{
+		Con_Printf ("sv_benchtrace: no map running\n");
+		return;
+	}
+
+	count = Cmd_Argc () > 1 ? atoi (Cmd_Argv (1)) : 100000;
+	count = CLAMP (1, count, 10000000);
+	rays = (float *) malloc (count * 6 * sizeof (float));
+	if (!rays)
+	{
+		Con_Printf ("sv_benchtrace: couldn't allocate %d rays\n", count);
+		return;
+	}
+
+	// half of the rays span the map, the other half are short moves
+	srand (count);
+	for (i = 0, r = rays; i < count; i++, r += 6)
+	{
+		for (h = 0; h < 3; h++)
+		{
+			r[h] = world->mins[h] + (world->maxs[h] - world->mins[h]) * (rand () / (float) RAND_MAX);
+			if (i & 1)
+				r[3+h] = r[h] + (rand () % 513) - 256;
+			else
+				r[3+h] = world->mins[h] + (world->maxs[h] - world->mins[h]) * (rand () / (float) RAND_MAX);
+		}
+	}
+
+	for (h = 0; h < 2; h++)
+	{
+		hull = &world->hulls[h];
+		if (!hull->nodes)
+			continue;
+
+		#define RESET_TRACE(t, end) do { memset (&(t), 0, sizeof (t)); (t).fraction = 1; (t).allsolid = true; VectorCopy ((end), (t).endpos); } while (0)
+
+		start = Sys_DoubleTime ();
+		for (i = 0, r = rays; i < count; i++, r += 6)
+		{
+			RESET_TRACE (a, r+3);
+			SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, r, r+3, &a);
+		}
+		recursive = Sys_DoubleTime () - start;
+
+		start = Sys_DoubleTime ();
+		for (i = 0, r = rays; i < count; i++, r += 6)
+		{
+			RESET_TRACE (b, r+3);
+			SV_HullTrace (hull, hull->firstclipnode, 0, 1, r, r+3, &b);
+		}
+		compiled = Sys_DoubleTime () - start;
+
+		mismatches = 0;
+		for (i = 0, r = rays; i < count; i++, r += 6)
+		{
+			RESET_TRACE (a, r+3);
+			RESET_TRACE (b, r+3);
+			SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, r, r+3, &a);
+			SV_HullTrace (hull, hull->firstclipnode, 0, 1, r, r+3, &b);
+			if (memcmp (&a, &b, sizeof (a)) != 0)
+				mismatches++;
+		}
+
+		#undef RESET_TRACE
+
+		Con_Printf ("hull %d: recursive %8.0f traces/s, compiled %8.0f traces/s (%.2fx), %d mismatches\n",
+			h, count / q_max (recursive, 1e-9), count / q_max (compiled, 1e-9),
+			recursive / q_max (compiled, 1e-9), mismatches);
+	}
+
+	free (rays);
+}
+
 /*
 ==================
 SV_ClipMoveToEntity
@@ -799,7 +1262,7 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	VectorSubtract (end, offset, end_l);
 
 // trace a line through the apropriate clipping hull
-	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	SV_TraceHull (hull, start_l, end_l, &trace);
 
 // fix trace up by the offset
 	if (trace.fraction != 1)
@@ -925,6 +1388,128 @@ boxmaxs[0] = boxmaxs[1] = boxmaxs[2] = 9999;
 #endif
 }
 
+/*
+===============================================================================
+
+WORLD TRACE CACHE
+
+Monster AI tends to repeat the same traces, both within a frame and across
+frames while nothing moves. The world's clip against a move only depends on
+the move itself, so it is memoized here in a direct-mapped table keyed by the
+exact move. Brush entities are still clipped live in SV_ClipToLinks, so only
+relinking the world itself or loading a new map invalidates the cache.
+Each server instance has a table of its own, allocated with its first map.
+
+===============================================================================
+*/
+
+#define	TRACECACHE_SIZE		4096	// must be a power of two
+
+typedef struct
+{
+	float		key[12];			// start, end, mins, maxs
+	int			generation;
+	trace_t		trace;
+} tracecacheentry_t;
+
+typedef struct
+{
+	tracecacheentry_t	entries[TRACECACHE_SIZE];
+	int					generation;		// entries from older generations are empty
+	int					hits;
+	int					misses;
+} tracecache_t;
+
+static tracecache_t		*tracecache_all[MAX_SV_INSTANCES];	// one table per server instance
+
+#define	tracecache		tracecache_all[sv_instance]
+
+/*
+===============
+SV_InvalidateTraceCache
+===============
+*/
+void SV_InvalidateTraceCache (void)
+{
+	if (tracecache)
+		tracecache->generation++;
+}
+
+/*
+===============
+SV_ResetTraceCache
+===============
+*/
+static void SV_ResetTraceCache (void)
+{
+	if (!tracecache)
+	{
+		tracecache = (tracecache_t *) calloc (1, sizeof (*tracecache));
+		if (!tracecache)
+			Sys_Error ("SV_ResetTraceCache: couldn't allocate %" SDL_PRIu64 " bytes", (uint64_t) sizeof (*tracecache));
+	}
+	tracecache->generation++;
+	tracecache->hits = tracecache->misses = 0;
+}
+
+/*
+===============
+SV_ClipMoveToWorld
+
+SV_ClipMoveToEntity for the world, through the trace cache
+===============
+*/
+static trace_t SV_ClipMoveToWorld (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	float				key[12];
+	uint32_t			hash, bits;
+	tracecacheentry_t	*entry;
+	int					i;
+
+	if (qcvm != &sv->qcvm || !sv_tracecache.value || !tracecache)
+		return SV_ClipMoveToEntity (qcvm->edicts, start, mins, maxs, end);
+
+	VectorCopy (start, key + 0);
+	VectorCopy (end, key + 3);
+	VectorCopy (mins, key + 6);
+	VectorCopy (maxs, key + 9);
+
+	// hash the coordinates with their lowest mantissa bits dropped,
+	// the entry itself is only used on an exact match
+	hash = 2166136261u;
+	for (i = 0; i < 12; i++)
+	{
+		memcpy (&bits, &key[i], sizeof (bits));
+		hash = (hash ^ (bits >> 8)) * 16777619u;
+	}
+	entry = &tracecache->entries[(hash ^ (hash >> 16)) & (TRACECACHE_SIZE - 1)];
+
+	if (entry->generation == tracecache->generation && !memcmp (entry->key, key, sizeof (key)))
+	{
+		tracecache->hits++;
+		return entry->trace;
+	}
+
+	tracecache->misses++;
+	memcpy (entry->key, key, sizeof (key));
+	entry->generation = tracecache->generation;
+	entry->trace = SV_ClipMoveToEntity (qcvm->edicts, start, mins, maxs, end);
+
+	return entry->trace;
+}
+
+/*
+===============
+SV_TraceCacheStats_f
+===============
+*/
+void SV_TraceCacheStats_f (void)
+{
+	int hits = tracecache ? tracecache->hits : 0;
+	int total = tracecache ? hits + tracecache->misses : 0;
+	Con_Printf ("%d world traces, %d cached (%.1f%%)\n", total, hits, total ? 100.0 * hits / total : 0.0);
+}
+
 /*
 ==================
 SV_Move
@@ -938,7 +1523,7 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 	memset ( &clip, 0, sizeof ( moveclip_t ) );
 
 // clip to world
-	clip.trace = SV_ClipMoveToEntity ( qcvm->edicts, start, mins, maxs, end );
+	clip.trace = SV_ClipMoveToWorld ( start, mins, maxs, end );
 
 	clip.start = start;
 	clip.end = end;
@@ -60,6 +60,13 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+int SV_AreaEdicts (const vec3_t mins, const vec3_t maxs, int *nums, int maxcount);
+// fills nums with the sorted numbers of all linked edicts (including SOLID_NOT)
+// whose absolute bounds overlap the box, returns the count
+
+int SV_CompareEdictNums (const void *a, const void *b);
+// qsort comparator for arrays of edict numbers (ints)
+
 int SV_PointContents (vec3_t p);
 int SV_TruePointContents (vec3_t p);
 // returns the CONTENTS_* value from the world at the given point.
@@ -82,6 +89,10 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+qboolean SV_HullTrace (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+void SV_BenchTrace_f (void);
+void SV_InvalidateTraceCache (void);
+void SV_TraceCacheStats_f (void);
 
 #endif	/* _QUAKE_WORLD_H */
 
@@ -23,26 +23,50 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
-#define	DYNAMIC_SIZE	(4 * 1024 * 1024) // ericw -- was 512KB (64-bit) / 384KB (32-bit)
-
-#define	ZONEID	0x1d4a11
-#define MINFRAGMENT	64
+#define	ZONEID		0x1d4a11
+#define	ZONE_LARGE	0xff		// size class of blocks that come straight from malloc
+
+#ifndef NDEBUG
+#define	ZONE_DEBUG	1			// check ids and trailing trash markers
+#define	ZONE_TRAILER	4
+#else
+#define	ZONE_DEBUG	0
+#define	ZONE_TRAILER	0
+#endif
 
 typedef struct memblock_s
 {
-	int	size;		// including the header and possibly tiny fragments
-	int	tag;		// a tag of 0 is a free block
-	int	id;		// should be ZONEID
-	int	pad;		// pad to 64 bit boundary
-	struct	memblock_s	*next, *prev;
+	int		size;		// requested size, excluding the header
+	short	tag;		// a tag of 0 is a free block
+	short	sizeclass;	// index into zone_classes, or ZONE_LARGE
+	int		id;			// should be ZONEID
+	int		pad;		// pad to 16-byte boundary
 } memblock_t;
 
+typedef struct freeblock_s
+{
+	memblock_t			header;
+	struct freeblock_s	*next;
+} freeblock_t;
+
+typedef struct zoneslab_s
+{
+	struct zoneslab_s	*next;
+} zoneslab_t;
+
+#define	ZONE_SLAB_HEADER	16	// keeps blocks 16-byte aligned
+
 typedef struct
 {
-	int		size;		// total bytes malloced, including header
-	memblock_t	blocklist;	// start / end cap for linked list
-	memblock_t	*rover;
-} memzone_t;
+	int			blocksize;	// including the header
+	freeblock_t	*freelist;
+	zoneslab_t	*slabs;
+	int			numslabs;
+	int			numused;
+	int			peakused;
+} zoneclass_t;
+
+#define	ZONE_SLAB_SIZE	(64 * 1024)
 
 void Cache_FreeLow (int new_low_hunk);
 
@@ -52,140 +76,188 @@ void Cache_FreeLow (int new_low_hunk);
 
 						ZONE MEMORY ALLOCATION
 
-There is never any space between memblocks, and there will never be two
-contiguous free memblocks.
+Small blocks are rounded up to one of a fixed set of size classes, each
+with its own free list fed by 64 KB slabs, so allocating and freeing is
+O(1) and blocks of different sizes never fragment each other.
+Slabs are kept for the lifetime of the process.
 
-The rover can be left pointing at a non-empty block
+Anything bigger than the largest class goes straight to the system allocator.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
 ==============================================================================
 */
 
-static memzone_t	*mainzone;
+static zoneclass_t zone_classes[] =
+{
+	{  32}, {  48}, {  64}, {  80}, {  96}, { 128}, { 160}, { 192},
+	{ 256}, { 320}, { 384}, { 512}, { 640}, { 768}, {1024}, {1280},
+	{1536}, {2048}, {3072}, {4096},
+};
 
+#define	ZONE_LOOKUP_GRANULARITY	16
+#define	ZONE_MAX_CLASS_SIZE		4096
 
+static byte		zone_lookup[ZONE_MAX_CLASS_SIZE / ZONE_LOOKUP_GRANULARITY + 1];	// (blocksize + 15) / 16 -> size class
+
+static int		zone_numlarge;
+static size_t	zone_largebytes;
+static int		zone_numallocs;
+
+#if ZONE_DEBUG
 /*
 ========================
-Z_Free
+Z_SetTrailer / Z_GetTrailer
+
+The trash marker is not necessarily aligned
 ========================
 */
-void Z_Free (void *ptr)
+static void Z_SetTrailer (void *ptr, int size)
 {
-	memblock_t	*block, *other;
+	int id = ZONEID;
+	memcpy ((byte *)ptr + size, &id, sizeof (id));
+}
+
+static int Z_GetTrailer (const void *ptr, int size)
+{
+	int id;
+	memcpy (&id, (const byte *)ptr + size, sizeof (id));
+	return id;
+}
+#endif
+
+/*
+========================
+Z_GetBlock
+========================
+*/
+static memblock_t *Z_GetBlock (void *ptr, const char *func)
+{
+	memblock_t *block;
 
 	if (!ptr)
-		Sys_Error ("Z_Free: NULL pointer");
+		Sys_Error ("%s: NULL pointer", func);
 
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
+#if ZONE_DEBUG
 	if (block->id != ZONEID)
-		Sys_Error ("Z_Free: freed a pointer without ZONEID");
+		Sys_Error ("%s: pointer without ZONEID", func);
 	if (block->tag == 0)
-		Sys_Error ("Z_Free: freed a freed pointer");
+		Sys_Error ("%s: pointer already freed", func);
+	if (Z_GetTrailer (ptr, block->size) != ZONEID)
+		Sys_Error ("%s: memory trashed past the end of a %i byte block", func, block->size);
+#endif
+
+	return block;
+}
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free (void *ptr)
+{
+	memblock_t	*block;
+	freeblock_t	*freeblock;
+	zoneclass_t	*zc;
 
+	block = Z_GetBlock (ptr, "Z_Free");
 	block->tag = 0;		// mark as free
+	zone_numallocs--;
 
-	other = block->prev;
-	if (!other->tag)
-	{	// merge with previous free block
-		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if (block == mainzone->rover)
-			mainzone->rover = other;
-		block = other;
+	if (block->sizeclass == ZONE_LARGE)
+	{
+		zone_numlarge--;
+		zone_largebytes -= block->size;
+		free (block);
+		return;
 	}
 
-	other = block->next;
-	if (!other->tag)
-	{	// merge the next free block onto the end
-		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
-		if (other == mainzone->rover)
-			mainzone->rover = block;
-	}
+	zc = &zone_classes[block->sizeclass];
+	zc->numused--;
+
+	freeblock = (freeblock_t *) block;
+	freeblock->next = zc->freelist;
+	zc->freelist = freeblock;
 }
 
+/*
+========================
+Z_AllocSlab
+========================
+*/
+static void Z_AllocSlab (zoneclass_t *zc)
+{
+	zoneslab_t	*slab;
+	byte		*p, *end;
+	int			classnum = zc - zone_classes;
+
+	slab = (zoneslab_t *) malloc (ZONE_SLAB_SIZE);
+	if (!slab)
+		Sys_Error ("Z_AllocSlab: out of memory for %i byte blocks", zc->blocksize);
+	slab->next = zc->slabs;
+	zc->slabs = slab;
+	zc->numslabs++;
+
+	// carve the slab into free blocks, keeping the lowest address at the head of the list
+	p = (byte *) slab + ZONE_SLAB_HEADER;
+	end = (byte *) slab + ZONE_SLAB_SIZE - zc->blocksize;
+	for (end -= (end - p) % zc->blocksize; end >= p; end -= zc->blocksize)
+	{
+		freeblock_t *block = (freeblock_t *) end;
+		block->header.tag = 0;
+		block->header.sizeclass = classnum;
+		block->header.id = ZONEID;
+		block->next = zc->freelist;
+		zc->freelist = block;
+	}
+}
 
 static void *Z_TagMalloc (int size, int tag)
 {
-	int		extra;
-	memblock_t	*start, *rover, *newblock, *base;
+	int			blocksize;
+	memblock_t	*base;
+	zoneclass_t	*zc;
 
 	if (!tag)
 		Sys_Error ("Z_TagMalloc: tried to use a 0 tag");
+	if (size < 0)
+		Sys_Error ("Z_TagMalloc: negative size %i", size);
 
-//
-// scan through the block list looking for the first free block
-// of sufficient size
-//
-	size += sizeof(memblock_t);	// account for size of block header
-	size += 4;					// space for memory trash tester
-	size = (size + 7) & ~7;		// align to 8-byte boundary
-
-	base = rover = mainzone->rover;
-	start = base->prev;
+	blocksize = size + sizeof(memblock_t) + ZONE_TRAILER;
 
-	do
+	if (blocksize > ZONE_MAX_CLASS_SIZE)
 	{
-		if (rover == start)	// scaned all the way around the list
+		base = (memblock_t *) malloc (blocksize);
+		if (!base)
 			return NULL;
-		if (rover->tag)
-			base = rover = rover->next;
-		else
-			rover = rover->next;
-	} while (base->tag || base->size < size);
-
-//
-// found a block big enough
-//
-	extra = base->size - size;
-	if (extra >  MINFRAGMENT)
-	{	// there will be a free fragment after the allocated block
-		newblock = (memblock_t *) ((byte *)base + size );
-		newblock->size = extra;
-		newblock->tag = 0;			// free block
-		newblock->prev = base;
-		newblock->id = ZONEID;
-		newblock->next = base->next;
-		newblock->next->prev = newblock;
-		base->next = newblock;
-		base->size = size;
+		base->sizeclass = ZONE_LARGE;
+		zone_numlarge++;
+		zone_largebytes += size;
+	}
+	else
+	{
+		zc = &zone_classes[zone_lookup[(blocksize + ZONE_LOOKUP_GRANULARITY - 1) / ZONE_LOOKUP_GRANULARITY]];
+		if (!zc->freelist)
+			Z_AllocSlab (zc);
+		base = &zc->freelist->header;
+		zc->freelist = zc->freelist->next;
+		zc->numused++;
+		zc->peakused = q_max (zc->peakused, zc->numused);
 	}
 
-	base->tag = tag;				// no longer a free block
-
-	mainzone->rover = base->next;	// next allocation will start looking here
-
+	base->size = size;
+	base->tag = tag;
 	base->id = ZONEID;
+	zone_numallocs++;
 
+#if ZONE_DEBUG
 // marker for memory trash testing
-	*(int *)((byte *)base + base->size - 4) = ZONEID;
-
-	return (void *) ((byte *)base + sizeof(memblock_t));
-}
-
-/*
-========================
-Z_CheckHeap
-========================
-*/
-static void Z_CheckHeap (void)
-{
-	memblock_t	*block;
+	Z_SetTrailer (base + 1, size);
+#endif
 
-	for (block = mainzone->blocklist.next ; ; block = block->next)
-	{
-		if (block->next == &mainzone->blocklist)
-			break;			// all blocks have been hit
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Sys_Error ("Z_CheckHeap: block size does not touch the next block");
-		if ( block->next->prev != block)
-			Sys_Error ("Z_CheckHeap: next block doesn't have proper back link");
-		if (!block->tag && !block->next->tag)
-			Sys_Error ("Z_CheckHeap: two consecutive free blocks");
-	}
+	return (void *) (base + 1);
 }
 
 
@@ -198,7 +270,6 @@ void *Z_Malloc (int size)
 {
 	void	*buf;
 
-	Z_CheckHeap ();	// DEBUG
 	buf = Z_TagMalloc (size, 1);
 	if (!buf)
 		Sys_Error ("Z_Malloc: failed on allocation of %i bytes",size);
@@ -215,33 +286,38 @@ Z_Realloc
 void *Z_Realloc(void *ptr, int size)
 {
 	int old_size;
-	void *old_ptr;
+	void *new_ptr;
 	memblock_t *block;
 
 	if (!ptr)
 		return Z_Malloc (size);
 
-	block = (memblock_t *) ((byte *) ptr - sizeof (memblock_t));
-	if (block->id != ZONEID)
-		Sys_Error ("Z_Realloc: realloced a pointer without ZONEID");
-	if (block->tag == 0)
-		Sys_Error ("Z_Realloc: realloced a freed pointer");
-
+	block = Z_GetBlock (ptr, "Z_Realloc");
 	old_size = block->size;
-	old_size -= (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
-	old_ptr = ptr;
 
-	Z_Free (ptr);
-	ptr = Z_TagMalloc (size, 1);
-	if (!ptr)
+	// grow or shrink in place if the block still fits its size class
+	if (block->sizeclass != ZONE_LARGE &&
+		size >= 0 && size + (int)(sizeof(memblock_t) + ZONE_TRAILER) <= zone_classes[block->sizeclass].blocksize)
+	{
+		block->size = size;
+#if ZONE_DEBUG
+		Z_SetTrailer (ptr, size);
+#endif
+		if (old_size < size)
+			memset ((byte *)ptr + old_size, 0, size - old_size);
+		return ptr;
+	}
+
+	new_ptr = Z_TagMalloc (size, block->tag);
+	if (!new_ptr)
 		Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
 
-	if (ptr != old_ptr)
-		memmove (ptr, old_ptr, q_min(old_size, size));
+	memcpy (new_ptr, ptr, q_min(old_size, size));
 	if (old_size < size)
-		memset ((byte *)ptr + old_size, 0, size - old_size);
+		memset ((byte *)new_ptr + old_size, 0, size - old_size);
+	Z_Free (ptr);
 
-	return ptr;
+	return new_ptr;
 }
 
 char *Z_Strdup (const char *s)
@@ -258,26 +334,36 @@ char *Z_Strdup (const char *s)
 Z_Print
 ========================
 */
-void Z_Print (memzone_t *zone)
+static void Z_Print (void)
 {
-	memblock_t	*block;
+	size_t	i, slabbytes = 0, usedbytes = 0;
 
-	Con_Printf ("zone size: %i  location: %p\n",mainzone->size,mainzone);
-
-	for (block = zone->blocklist.next ; ; block = block->next)
+	Con_SafePrintf ("\n");
+	Con_SafePrintf (" class : slabs :   used :   peak :   free\n");
+	Con_SafePrintf ("-----------------------------------------\n");
+	for (i = 0; i < countof (zone_classes); i++)
 	{
-		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
-			block, block->size, block->tag);
-
-		if (block->next == &zone->blocklist)
-			break;			// all blocks have been hit
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Con_Printf ("ERROR: block size does not touch the next block\n");
-		if ( block->next->prev != block)
-			Con_Printf ("ERROR: next block doesn't have proper back link\n");
-		if (!block->tag && !block->next->tag)
-			Con_Printf ("ERROR: two consecutive free blocks\n");
+		const zoneclass_t *zc = &zone_classes[i];
+		int capacity = zc->numslabs * ((ZONE_SLAB_SIZE - ZONE_SLAB_HEADER) / zc->blocksize);
+		if (!zc->numslabs)
+			continue;
+		Con_SafePrintf ("%6i : %5i : %6i : %6i : %6i\n", zc->blocksize, zc->numslabs, zc->numused, zc->peakused, capacity - zc->numused);
+		slabbytes += zc->numslabs * (size_t) ZONE_SLAB_SIZE;
+		usedbytes += zc->numused * (size_t) zc->blocksize;
 	}
+	Con_SafePrintf ("-----------------------------------------\n");
+	Con_SafePrintf ("%i blocks, %.1f/%.1f KB used in slabs, %i large blocks (%.1f KB)\n",
+		zone_numallocs, usedbytes / 1024.0, slabbytes / 1024.0, zone_numlarge, zone_largebytes / 1024.0);
+}
+
+/*
+========================
+Z_Print_f
+========================
+*/
+static void Z_Print_f (void)
+{
+	Z_Print ();
 }
 
 
@@ -308,6 +394,7 @@ typedef struct hunkseg_s
 static int				hunk_low_used;
 static int				hunk_numsegments;
 static hunkseg_t		*hunk_segments[MAX_SEGMENTS];
+static void				***hunk_arena;		// VEC collecting allocations, see Hunk_BeginArena
 
 typedef enum
 {
@@ -548,6 +635,15 @@ static void *Hunk_AllocInternal (int size, const char *name, hunkflags_t flags)
 	if (size < 0)
 		Sys_Error ("Hunk_Alloc: bad size: %i", size);
 
+	if (hunk_arena)
+	{
+		h = (hunk_t *) ((flags & HF_CLEAR) ? calloc (1, size) : malloc (size));
+		if (!h)
+			Sys_Error ("Hunk_Alloc: failed on %i bytes", size);
+		VEC_PUSH (*hunk_arena, (void *) h);
+		return (void *) h;
+	}
+
 	size = sizeof(hunk_t) + ((size+15)&~15);
 
 	i = Hunk_SegForOfs (hunk_low_used);
@@ -652,6 +748,8 @@ void *Hunk_AllocNoFill (int size)
 
 int	Hunk_LowMark (void)
 {
+	if (hunk_arena)
+		return (int) VEC_SIZE (*hunk_arena);
 	return hunk_low_used;
 }
 
@@ -659,6 +757,16 @@ void Hunk_FreeToLowMark (int mark)
 {
 	int i;
 
+	if (hunk_arena)
+	{
+		if (mark < 0 || mark > (int) VEC_SIZE (*hunk_arena))
+			Sys_Error ("Hunk_FreeToLowMark: bad arena mark %i", mark);
+		for (i = mark; i < (int) VEC_SIZE (*hunk_arena); i++)
+			free ((*hunk_arena)[i]);
+		VEC_POP_N (*hunk_arena, VEC_SIZE (*hunk_arena) - mark);
+		return;
+	}
+
 	if (mark < 0 || mark > hunk_low_used)
 		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
 
@@ -675,6 +783,44 @@ char *Hunk_Strdup (const char *s, const char *name)
 	return ptr;
 }
 
+/*
+===================
+Hunk_BeginArena
+===================
+*/
+void Hunk_BeginArena (void ***arena)
+{
+	if (hunk_arena)
+		Sys_Error ("Hunk_BeginArena: already in an arena");
+	hunk_arena = arena;
+}
+
+/*
+===================
+Hunk_EndArena
+===================
+*/
+void Hunk_EndArena (void)
+{
+	hunk_arena = NULL;
+}
+
+/*
+===================
+Hunk_FreeArena
+===================
+*/
+void Hunk_FreeArena (void ***arena)
+{
+	size_t i;
+
+	if (hunk_arena == arena)
+		Sys_Error ("Hunk_FreeArena: arena in use");
+	for (i = 0; i < VEC_SIZE (*arena); i++)
+		free ((*arena)[i]);
+	VEC_FREE (*arena);
+}
+
 /*
 ===============================================================================
 
@@ -1008,23 +1154,21 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 //============================================================================
 
 
-static void Memory_InitZone (memzone_t *zone, int size)
+/*
+========================
+Memory_InitZone
+========================
+*/
+static void Memory_InitZone (void)
 {
-	memblock_t	*block;
-
-// set the entire zone to one free block
+	int i, j;
 
-	zone->blocklist.next = zone->blocklist.prev = block =
-		(memblock_t *)( (byte *)zone + sizeof(memzone_t) );
-	zone->blocklist.tag = 1;	// in use block
-	zone->blocklist.id = 0;
-	zone->blocklist.size = 0;
-	zone->rover = block;
-
-	block->prev = block->next = &zone->blocklist;
-	block->tag = 0;			// free block
-	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+	for (i = 0, j = 0; i < countof (zone_lookup); i++)
+	{
+		while (zone_classes[j].blocksize < i * ZONE_LOOKUP_GRANULARITY)
+			j++;
+		zone_lookup[i] = j;
+	}
 }
 
 /*
@@ -1034,9 +1178,6 @@ Memory_Init
 */
 void Memory_Init (void *buf, int size)
 {
-	int p;
-	int zonesize = DYNAMIC_SIZE;
-
 	hunk_segments[0] = (hunkseg_t *) buf;
 	hunk_segments[0]->base = 0;
 	hunk_segments[0]->size = size - sizeof (hunkseg_t);
@@ -1044,17 +1185,14 @@ void Memory_Init (void *buf, int size)
 	hunk_low_used = 0;
 
 	Cache_Init ();
-	p = COM_CheckParm ("-zone");
-	if (p)
-	{
-		if (p < com_argc-1)
-			zonesize = Q_atoi (com_argv[p+1]) * 1024;
-		else
-			Sys_Error ("Memory_Init: you must specify a size in KB after -zone");
-	}
-	mainzone = (memzone_t *) Hunk_AllocName (zonesize, "zone" );
-	Memory_InitZone (mainzone, zonesize);
+	Memory_InitZone ();
+	if (COM_CheckParm ("-zone"))
+		Sys_Printf ("Memory_Init: -zone is obsolete, the zone grows on demand\n");
+	Sys_Printf ("Zone: %i size classes up to %i bytes, %i KB slabs%s\n",
+		(int) countof (zone_classes), ZONE_MAX_CLASS_SIZE - (int)(sizeof(memblock_t) + ZONE_TRAILER),
+		ZONE_SLAB_SIZE / 1024, ZONE_DEBUG ? ", debug checks enabled" : "");
 
 	Cmd_AddCommand ("hunk_print", Hunk_Print_f); //johnfitz
+	Cmd_AddCommand ("zone_print", Z_Print_f);
 }
 
@@ -39,10 +39,15 @@ Hunk allocations should be given a name, so the Hunk_Print () function
 can display usage.
 Hunk allocations are guaranteed to be 16 byte aligned.
 
+Between Hunk_BeginArena and Hunk_EndArena, hunk allocations (and marks)
+come from the system allocator instead and are collected in the arena, so
+that they can be freed with Hunk_FreeArena regardless of what else is on
+the hunk.
+
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
-strings from command input.  There is only about 48K for it, allocated at
-the very bottom of the hunk.
+strings from command input.  Small blocks come from per-size-class slabs,
+large ones from the system allocator, so the zone is not part of the hunk.
 
 Cache_??? Cache memory is for objects that can be dynamically loaded and
 can usefully stay persistant between levels.  The size of the cache
@@ -63,8 +68,6 @@ client and server low hunk allocations
 
 startup hunk allocations
 
-Zone block
-
 ----- Bottom of Memory -----
 
 
@@ -93,6 +96,10 @@ char *Hunk_Strdup (const char *s, const char *name);
 int	Hunk_LowMark (void);
 void Hunk_FreeToLowMark (int mark);
 
+void Hunk_BeginArena (void ***arena);
+void Hunk_EndArena (void);
+void Hunk_FreeArena (void ***arena);
+
 void Hunk_Check (void);
 
 typedef struct cache_user_s